@@ -0,0 +1,592 @@
+/**
+ * @file cffmodule.c
+ * @brief Python extension exposing in-process CFF generation.
+ *
+ * Wraps the builder so Python code can generate and embed CFFs from their
+ * parameters and read the result through the buffer protocol, without
+ * files or parsing. A Matrix is the bitmap itself: a read-only
+ * rows x (8 * words per row) array of bytes, bit j of row i being bit
+ * (j % 8) of byte j / 8, so NumPy views it with
+ * np.unpackbits(np.asarray(m), axis=1, bitorder="little")[:, :m.cols].
+ * Matrix.csc() returns the compressed sparse column form, whose indptr
+ * and indices are exported the same way.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <structmember.h>
+#include <stdint.h>
+#include <string.h>
+#include "cff_builder.h"
+#include "cff_file_generator.h"
+
+/*
+ * DATA STRUCTURES
+ */
+
+/**
+ * @brief Python object holding a CFF matrix in one contiguous block.
+ */
+typedef struct {
+    PyObject_HEAD
+    uint64_t** matrix;                          /**< Matrix from build_cff_matrix. */
+    long rows;                                  /**< Number of rows. */
+    long cols;                                  /**< Number of columns. */
+    char construction;                          /**< Construction of the last step. */
+    int d;                                      /**< CFF parameter d. */
+    int num_steps;                              /**< Number of steps. */
+    long Fq_steps[CFF_BINARY_MAX_STEPS];        /**< Finite field size of every step. */
+    long k_steps[CFF_BINARY_MAX_STEPS];         /**< Maximum polynomial degree of every step. */
+    Py_ssize_t shape[2];                        /**< Buffer shape (rows, bytes per row). */
+    Py_ssize_t strides[2];                      /**< Buffer strides. */
+} CFFMatrixObject;
+
+/**
+ * @brief Python object holding a CFF matrix in CSC form.
+ */
+typedef struct {
+    PyObject_HEAD
+    struct cff_csc_matrix* csc;                 /**< Matrix from bitmap_to_csc. */
+} CFFCSCObject;
+
+/**
+ * @brief Read-only one-dimensional view of an array owned by another object.
+ */
+typedef struct {
+    PyObject_HEAD
+    PyObject* owner;                            /**< Object that owns the data. */
+    void* data;                                 /**< First element. */
+    Py_ssize_t length;                          /**< Number of elements. */
+    Py_ssize_t itemsize;                        /**< Size of every element. */
+    const char* format;                         /**< struct-module format of the elements. */
+} CFFArrayObject;
+
+static PyTypeObject CFFMatrixType;
+static PyTypeObject CFFCSCType;
+static PyTypeObject CFFArrayType;
+
+/*
+ * HELPER FUNCTION PROTOTYPES
+ */
+
+/**
+ * @brief Wraps a built matrix in a new Matrix object.
+ *
+ * @param matrix Matrix from build_cff_matrix (owned by the object afterwards).
+ * @param rows Number of rows.
+ * @param cols Number of columns.
+ * @return New reference, or NULL on error.
+ */
+static PyObject* new_matrix_object(uint64_t** matrix, long rows, long cols);
+
+/**
+ * @brief Creates a memoryview over an array owned by another object.
+ *
+ * @param owner Object kept alive while the view exists.
+ * @param data First element.
+ * @param length Number of elements.
+ * @param itemsize Size of every element.
+ * @param format struct-module format of the elements.
+ * @return New memoryview, or NULL on error.
+ */
+static PyObject* array_view(PyObject* owner, void* data, Py_ssize_t length, Py_ssize_t itemsize, const char* format);
+
+/*
+ * MODULE FUNCTIONS
+ */
+
+/**
+ * @brief cff.generate(d, q, k, block_size="f"): generates an initial CFF.
+ *
+ * @param self Module.
+ * @param args Positional arguments.
+ * @param kwargs Keyword arguments.
+ * @return New Matrix, or NULL with ValueError if the parameters are invalid.
+ */
+static PyObject* cff_generate(PyObject* self, PyObject* args, PyObject* kwargs) {
+    (void) self;
+    static char* keywords[] = { "d", "q", "k", "block_size", NULL };
+    int d;
+    long q, k;
+    const char* block_size = "f";
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "ill|s", keywords, &d, &q, &k, &block_size)) return NULL;
+    if (block_size[0] != 'm' && block_size[0] != 'f') {
+        PyErr_SetString(PyExc_ValueError, "block_size must be 'm' (minimum) or 'f' (full)");
+        return NULL;
+    }
+    long p, n;
+    if (!decompose_prime_power(q, &p, &n)) {
+        PyErr_Format(PyExc_ValueError, "q = %ld is not a prime power", q);
+        return NULL;
+    }
+
+    long rows = 0, cols = 0;
+    uint64_t** matrix;
+    Py_BEGIN_ALLOW_THREADS
+    matrix = build_cff_matrix('p', block_size[0], d, NULL, 0, 0, &q, &k, 1, &rows, &cols);
+    Py_END_ALLOW_THREADS
+    if (matrix == NULL) {
+        PyErr_SetString(PyExc_ValueError, "failed to generate the CFF");
+        return NULL;
+    }
+
+    CFFMatrixObject* result = (CFFMatrixObject*) new_matrix_object(matrix, rows, cols);
+    if (result == NULL) return NULL;
+    result->construction = 'p';
+    result->d = d;
+    result->num_steps = 1;
+    result->Fq_steps[0] = q;
+    result->k_steps[0] = k;
+    return (PyObject*) result;
+}
+
+/**
+ * @brief cff.embed(matrix, q, k, construction="p", block_size="f"): embeds a CFF.
+ *
+ * The previous matrix is read in place and left untouched; d and the
+ * previous steps come from it.
+ *
+ * @param self Module.
+ * @param args Positional arguments.
+ * @param kwargs Keyword arguments.
+ * @return New Matrix, or NULL with ValueError if the parameters are invalid.
+ */
+static PyObject* cff_embed(PyObject* self, PyObject* args, PyObject* kwargs) {
+    (void) self;
+    static char* keywords[] = { "matrix", "q", "k", "construction", "block_size", NULL };
+    CFFMatrixObject* old;
+    long q, k;
+    const char* construction = "p";
+    const char* block_size = "f";
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!ll|ss", keywords, &CFFMatrixType, &old, &q, &k, &construction, &block_size)) return NULL;
+    if (construction[0] != 'p' && construction[0] != 'm') {
+        PyErr_SetString(PyExc_ValueError, "construction must be 'p' (polynomial) or 'm' (monotone)");
+        return NULL;
+    }
+    if (construction[0] == 'p' && block_size[0] != 'm' && block_size[0] != 'f') {
+        PyErr_SetString(PyExc_ValueError, "block_size must be 'm' (minimum) or 'f' (full)");
+        return NULL;
+    }
+    if (old->num_steps >= CFF_BINARY_MAX_STEPS) {
+        PyErr_Format(PyExc_ValueError, "at most %d steps are supported", CFF_BINARY_MAX_STEPS);
+        return NULL;
+    }
+
+    // Same rules as check_cff_field_steps: polynomial steps extend the previous
+    // field, monotone steps only need the base field of the first step
+    long p, n, prev_p, prev_n, first_p, first_n;
+    long prev_q = old->Fq_steps[old->num_steps - 1];
+    if (!decompose_prime_power(q, &p, &n) || !decompose_prime_power(prev_q, &prev_p, &prev_n) ||
+        !decompose_prime_power(old->Fq_steps[0], &first_p, &first_n)) {
+        PyErr_Format(PyExc_ValueError, "q = %ld is not a prime power", q);
+        return NULL;
+    }
+    if (p != prev_p) {
+        PyErr_Format(PyExc_ValueError, "q = %ld is not a power of %ld, the characteristic of the previous field", q, prev_p);
+        return NULL;
+    }
+    if (construction[0] == 'p' && n % prev_n != 0) {
+        PyErr_Format(PyExc_ValueError, "F_%ld does not contain the previous field F_%ld", q, prev_q);
+        return NULL;
+    }
+    if (construction[0] == 'm' && n % first_n != 0) {
+        PyErr_Format(PyExc_ValueError, "F_%ld does not contain the base field F_%ld", q, old->Fq_steps[0]);
+        return NULL;
+    }
+
+    int num_steps = old->num_steps + 1;
+    long Fq_steps[CFF_BINARY_MAX_STEPS], k_steps[CFF_BINARY_MAX_STEPS];
+    memcpy(Fq_steps, old->Fq_steps, old->num_steps * sizeof(long));
+    memcpy(k_steps, old->k_steps, old->num_steps * sizeof(long));
+    Fq_steps[num_steps - 1] = q;
+    k_steps[num_steps - 1] = k;
+    char step_block_size = (construction[0] == 'p') ? block_size[0] : '\0';
+
+    long rows = 0, cols = 0;
+    uint64_t** matrix;
+    Py_BEGIN_ALLOW_THREADS
+    matrix = build_cff_matrix(construction[0], step_block_size, old->d, old->matrix, old->rows, old->cols, Fq_steps, k_steps, num_steps, &rows, &cols);
+    Py_END_ALLOW_THREADS
+    if (matrix == NULL) {
+        PyErr_SetString(PyExc_ValueError, "failed to embed the CFF");
+        return NULL;
+    }
+
+    CFFMatrixObject* result = (CFFMatrixObject*) new_matrix_object(matrix, rows, cols);
+    if (result == NULL) return NULL;
+    result->construction = construction[0];
+    result->d = old->d;
+    result->num_steps = num_steps;
+    memcpy(result->Fq_steps, Fq_steps, num_steps * sizeof(long));
+    memcpy(result->k_steps, k_steps, num_steps * sizeof(long));
+    return (PyObject*) result;
+}
+
+/**
+ * @brief cff.set_huge_pages(mode=None): sets how large buffers are backed.
+ *
+ * Applies to every later generate() and embed() of the process.
+ *
+ * @param self Module.
+ * @param args Positional arguments.
+ * @return None, or NULL with ValueError if the mode is invalid.
+ */
+static PyObject* cff_set_huge_pages(PyObject* self, PyObject* args) {
+    (void) self;
+    const char* mode = NULL;
+    if (!PyArg_ParseTuple(args, "|z", &mode)) return NULL;
+    if (mode == NULL || strcmp(mode, "off") == 0) {
+        set_cff_huge_pages(0);
+    } else if (strcmp(mode, "thp") == 0) {
+        set_cff_huge_pages('t');
+    } else if (strcmp(mode, "hugetlb") == 0) {
+        set_cff_huge_pages('h');
+    } else {
+        PyErr_SetString(PyExc_ValueError, "mode must be None, 'off', 'thp' or 'hugetlb'");
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+/*
+ * MATRIX TYPE
+ */
+
+/**
+ * @brief Exports the bitmap as a read-only rows x bytes-per-row byte array.
+ *
+ * @param obj Matrix object.
+ * @param view View to be filled.
+ * @param flags Requested buffer features.
+ * @return 0 on success, -1 on error.
+ */
+static int matrix_getbuffer(PyObject* obj, Py_buffer* view, int flags) {
+    CFFMatrixObject* self = (CFFMatrixObject*) obj;
+    if (flags & PyBUF_WRITABLE) {
+        PyErr_SetString(PyExc_BufferError, "CFF matrices are read-only");
+        view->obj = NULL;
+        return -1;
+    }
+
+    view->buf = self->matrix[0];
+    view->obj = obj;
+    Py_INCREF(obj);
+    view->len = self->shape[0] * self->shape[1];
+    view->itemsize = 1;
+    view->readonly = 1;
+    view->format = (flags & PyBUF_FORMAT) ? "B" : NULL;
+    view->ndim = 2;
+    view->shape = self->shape;
+    view->strides = self->strides;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    return 0;
+}
+
+/**
+ * @brief Matrix.csc(): converts the matrix to compressed sparse column form.
+ *
+ * @param obj Matrix object.
+ * @param unused Unused.
+ * @return New CSC object.
+ */
+static PyObject* matrix_csc(PyObject* obj, PyObject* unused) {
+    (void) unused;
+    CFFMatrixObject* self = (CFFMatrixObject*) obj;
+    CFFCSCObject* result = PyObject_New(CFFCSCObject, &CFFCSCType);
+    if (result == NULL) return NULL;
+
+    Py_BEGIN_ALLOW_THREADS
+    result->csc = bitmap_to_csc(self->matrix, self->rows, self->cols);
+    Py_END_ALLOW_THREADS
+    return (PyObject*) result;
+}
+
+/**
+ * @brief Matrix.steps: list of (q, k) pairs, one per step.
+ *
+ * @param obj Matrix object.
+ * @param closure Unused.
+ * @return New list.
+ */
+static PyObject* matrix_steps(PyObject* obj, void* closure) {
+    (void) closure;
+    CFFMatrixObject* self = (CFFMatrixObject*) obj;
+    PyObject* steps = PyList_New(self->num_steps);
+    if (steps == NULL) return NULL;
+    for (int i = 0; i < self->num_steps; i++) {
+        PyObject* step = Py_BuildValue("(ll)", self->Fq_steps[i], self->k_steps[i]);
+        if (step == NULL) {
+            Py_DECREF(steps);
+            return NULL;
+        }
+        PyList_SET_ITEM(steps, i, step);
+    }
+    return steps;
+}
+
+/**
+ * @brief Matrix.construction: construction of the last step ('p' or 'm').
+ *
+ * @param obj Matrix object.
+ * @param closure Unused.
+ * @return New string.
+ */
+static PyObject* matrix_construction(PyObject* obj, void* closure) {
+    (void) closure;
+    return PyUnicode_FromStringAndSize(&((CFFMatrixObject*) obj)->construction, 1);
+}
+
+/**
+ * @brief Frees a Matrix object.
+ *
+ * @param obj Matrix object.
+ */
+static void matrix_dealloc(PyObject* obj) {
+    free_contiguous_matrix(((CFFMatrixObject*) obj)->matrix);
+    Py_TYPE(obj)->tp_free(obj);
+}
+
+static PyBufferProcs matrix_buffer = { matrix_getbuffer, NULL };
+
+static PyMemberDef matrix_members[] = {
+    { "rows", T_LONG, offsetof(CFFMatrixObject, rows), READONLY, "Number of rows." },
+    { "cols", T_LONG, offsetof(CFFMatrixObject, cols), READONLY, "Number of columns." },
+    { "d", T_INT, offsetof(CFFMatrixObject, d), READONLY, "CFF parameter d." },
+    { NULL, 0, 0, 0, NULL }
+};
+
+static PyGetSetDef matrix_getset[] = {
+    { "steps", matrix_steps, NULL, "List of (q, k) pairs, one per step.", NULL },
+    { "construction", matrix_construction, NULL, "Construction of the last step ('p' or 'm').", NULL },
+    { NULL, NULL, NULL, NULL, NULL }
+};
+
+static PyMethodDef matrix_methods[] = {
+    { "csc", matrix_csc, METH_NOARGS, "Returns the matrix in compressed sparse column form." },
+    { NULL, NULL, 0, NULL }
+};
+
+static PyTypeObject CFFMatrixType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "cff.Matrix",
+    .tp_basicsize = sizeof(CFFMatrixObject),
+    .tp_dealloc = matrix_dealloc,
+    .tp_as_buffer = &matrix_buffer,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "CFF bit matrix, exported as a read-only rows x bytes-per-row uint8 buffer (bits little-endian).",
+    .tp_methods = matrix_methods,
+    .tp_members = matrix_members,
+    .tp_getset = matrix_getset,
+};
+
+/*
+ * CSC TYPE
+ */
+
+/**
+ * @brief CSC.indptr: start of every column in indices (int64, cols + 1 entries).
+ *
+ * @param obj CSC object.
+ * @param closure Unused.
+ * @return New memoryview.
+ */
+static PyObject* csc_indptr(PyObject* obj, void* closure) {
+    (void) closure;
+    struct cff_csc_matrix* csc = ((CFFCSCObject*) obj)->csc;
+    return array_view(obj, csc->col_offsets, csc->cols + 1, sizeof(int64_t), "q");
+}
+
+/**
+ * @brief CSC.indices: row indices of the ones, column by column (uint32, or uint64 beyond 2^32 rows).
+ *
+ * @param obj CSC object.
+ * @param closure Unused.
+ * @return New memoryview.
+ */
+static PyObject* csc_indices(PyObject* obj, void* closure) {
+    (void) closure;
+    struct cff_csc_matrix* csc = ((CFFCSCObject*) obj)->csc;
+    return array_view(obj, csc->row_indices, csc->col_offsets[csc->cols], csc->index_bytes, (csc->index_bytes == 8) ? "Q" : "I");
+}
+
+/**
+ * @brief CSC.rows and CSC.cols.
+ *
+ * @param obj CSC object.
+ * @param closure Non-NULL for cols.
+ * @return New integer.
+ */
+static PyObject* csc_size(PyObject* obj, void* closure) {
+    struct cff_csc_matrix* csc = ((CFFCSCObject*) obj)->csc;
+    return PyLong_FromLong(closure ? csc->cols : csc->rows);
+}
+
+/**
+ * @brief Frees a CSC object.
+ *
+ * @param obj CSC object.
+ */
+static void csc_dealloc(PyObject* obj) {
+    free_cff_csc(((CFFCSCObject*) obj)->csc);
+    Py_TYPE(obj)->tp_free(obj);
+}
+
+static PyGetSetDef csc_getset[] = {
+    { "indptr", csc_indptr, NULL, "Start of every column in indices (int64, cols + 1 entries).", NULL },
+    { "indices", csc_indices, NULL, "Row indices of the ones, column by column, ascending (uint32, or uint64 beyond 2^32 rows).", NULL },
+    { "rows", csc_size, NULL, "Number of rows.", NULL },
+    { "cols", csc_size, NULL, "Number of columns.", (void*) 1 },
+    { NULL, NULL, NULL, NULL, NULL }
+};
+
+static PyTypeObject CFFCSCType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "cff.CSC",
+    .tp_basicsize = sizeof(CFFCSCObject),
+    .tp_dealloc = csc_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "CFF matrix in compressed sparse column form (scipy.sparse.csc_matrix layout).",
+    .tp_getset = csc_getset,
+};
+
+/*
+ * ARRAY VIEW TYPE
+ */
+
+/**
+ * @brief Exports the array as a read-only one-dimensional buffer.
+ *
+ * @param obj Array object.
+ * @param view View to be filled.
+ * @param flags Requested buffer features.
+ * @return 0 on success, -1 on error.
+ */
+static int array_getbuffer(PyObject* obj, Py_buffer* view, int flags) {
+    CFFArrayObject* self = (CFFArrayObject*) obj;
+    if (PyBuffer_FillInfo(view, obj, self->data, self->length * self->itemsize, 1, flags) < 0) return -1;
+    view->itemsize = self->itemsize;
+    view->format = (flags & PyBUF_FORMAT) ? (char*) self->format : NULL;
+    if (flags & PyBUF_ND) view->shape = &self->length;
+    if ((flags & PyBUF_STRIDES) == PyBUF_STRIDES) view->strides = &self->itemsize;
+    return 0;
+}
+
+/**
+ * @brief Frees an Array object.
+ *
+ * @param obj Array object.
+ */
+static void array_dealloc(PyObject* obj) {
+    Py_XDECREF(((CFFArrayObject*) obj)->owner);
+    Py_TYPE(obj)->tp_free(obj);
+}
+
+static PyBufferProcs array_buffer = { array_getbuffer, NULL };
+
+static PyTypeObject CFFArrayType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "cff._Array",
+    .tp_basicsize = sizeof(CFFArrayObject),
+    .tp_dealloc = array_dealloc,
+    .tp_as_buffer = &array_buffer,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Read-only view of an array owned by a CFF object.",
+};
+
+/*
+ * MODULE DEFINITION
+ */
+
+static PyMethodDef cff_methods[] = {
+    { "generate", (PyCFunction) (void (*)(void)) cff_generate, METH_VARARGS | METH_KEYWORDS,
+      "generate(d, q, k, block_size='f') -> Matrix\n\nGenerates an initial polynomial CFF." },
+    { "embed", (PyCFunction) (void (*)(void)) cff_embed, METH_VARARGS | METH_KEYWORDS,
+      "embed(matrix, q, k, construction='p', block_size='f') -> Matrix\n\nEmbeds a CFF into the field of size q." },
+    { "set_huge_pages", cff_set_huge_pages, METH_VARARGS,
+      "set_huge_pages(mode=None)\n\nBacks large matrix, table and index buffers with 'thp' or 'hugetlb' pages (Linux), or normal pages." },
+    { NULL, NULL, 0, NULL }
+};
+
+static struct PyModuleDef cff_module = {
+    PyModuleDef_HEAD_INIT,
+    "cff",
+    "In-process generation of polynomial and monotone CFFs.",
+    -1,
+    cff_methods,
+    NULL, NULL, NULL, NULL
+};
+
+/**
+ * @brief Initialises the cff module.
+ *
+ * @return New module, or NULL on error.
+ */
+PyMODINIT_FUNC PyInit_cff(void) {
+    if (PyType_Ready(&CFFMatrixType) < 0 || PyType_Ready(&CFFCSCType) < 0 || PyType_Ready(&CFFArrayType) < 0) return NULL;
+
+    PyObject* module = PyModule_Create(&cff_module);
+    if (module == NULL) return NULL;
+
+    Py_INCREF(&CFFMatrixType);
+    Py_INCREF(&CFFCSCType);
+    if (PyModule_AddObject(module, "Matrix", (PyObject*) &CFFMatrixType) < 0 ||
+        PyModule_AddObject(module, "CSC", (PyObject*) &CFFCSCType) < 0) {
+        Py_DECREF(module);
+        return NULL;
+    }
+    return module;
+}
+
+/*
+ * HELPER FUNCTIONS
+ */
+
+/**
+ * @brief Wraps a built matrix in a new Matrix object.
+ *
+ * @param matrix Matrix from build_cff_matrix (owned by the object afterwards).
+ * @param rows Number of rows.
+ * @param cols Number of columns.
+ * @return New reference, or NULL on error.
+ */
+static PyObject* new_matrix_object(uint64_t** matrix, long rows, long cols) {
+    CFFMatrixObject* self = PyObject_New(CFFMatrixObject, &CFFMatrixType);
+    if (self == NULL) {
+        free_contiguous_matrix(matrix);
+        return NULL;
+    }
+    self->matrix = matrix;
+    self->rows = rows;
+    self->cols = cols;
+    self->shape[0] = rows;
+    self->shape[1] = WORDS_FOR_BITS(cols) * (Py_ssize_t) sizeof(uint64_t);
+    self->strides[0] = self->shape[1];
+    self->strides[1] = 1;
+    return (PyObject*) self;
+}
+
+/**
+ * @brief Creates a memoryview over an array owned by another object.
+ *
+ * @param owner Object kept alive while the view exists.
+ * @param data First element.
+ * @param length Number of elements.
+ * @param itemsize Size of every element.
+ * @param format struct-module format of the elements.
+ * @return New memoryview, or NULL on error.
+ */
+static PyObject* array_view(PyObject* owner, void* data, Py_ssize_t length, Py_ssize_t itemsize, const char* format) {
+    CFFArrayObject* array = PyObject_New(CFFArrayObject, &CFFArrayType);
+    if (array == NULL) return NULL;
+    Py_INCREF(owner);
+    array->owner = owner;
+    array->data = data;
+    array->length = length;
+    array->itemsize = itemsize;
+    array->format = format;
+
+    PyObject* view = PyMemoryView_FromObject((PyObject*) array);
+    Py_DECREF(array);
+    return view;
+}
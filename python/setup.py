@@ -0,0 +1,34 @@
+"""
+setup.py - Build script for the cff Python extension.
+
+Builds the builder sources together with cffmodule.c into a single
+extension module. FLINT, GMP and OpenMP must be installed as for the
+command line tool; extra include and library paths (e.g. Homebrew's)
+can be passed through CFLAGS and LDFLAGS.
+
+FLINT is linked as a shared library, as the command line tool links it:
+on Linux the extension asks the linker for libflint.so by name, so a
+static libflint.a found first on the search path (usually built without
+-fPIC, and unusable in a shared module) is never picked up.
+
+Usage:
+    cd python && python3 setup.py build_ext --inplace
+"""
+
+import os
+import sys
+from setuptools import setup, Extension
+
+SRC_DIR = os.path.join("..", "src")
+FLINT_LIBRARY = ":libflint.so" if sys.platform.startswith("linux") else "flint"
+
+cff = Extension(
+    "cff",
+    sources=["cffmodule.c"] + [os.path.join(SRC_DIR, name) for name in ("cff_builder.c", "cff_file_generator.c", "cff_recipe.c", "cff_plan.c")],
+    include_dirs=[SRC_DIR],
+    libraries=[FLINT_LIBRARY, "gmp", "m"],
+    extra_compile_args=["-fopenmp"],
+    extra_link_args=["-fopenmp"],
+)
+
+setup(name="cff", version="1.0", description="In-process generation of polynomial and monotone CFFs", ext_modules=[cff])
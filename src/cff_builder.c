@@ -6,12 +6,20 @@
  * polynomial and monotone constructions over finite fields.
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h> 
-#include <math.h>
-#include <glib.h>
 #include <omp.h>
+#include <pthread.h>
+#if defined(__linux__)
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
 #include "flint/flint.h"
 #include "flint/fmpz.h"
 #include "flint/fq_nmod.h"
@@ -19,35 +27,70 @@
 #include "flint/nmod_poly.h"
 #include "cff_builder.h"
 #include "cff_file_generator.h"
-
-/* 
- *  GLOBAL VARIABLES
- */
-
-static fq_nmod_ctx_t global_ctx;
-static int global_ctx_initialized = 0;
+#include "cff_recipe.h"
 
 /*
  *   FUNCTION PROTOTYPES
  */
 
 /* Main Functions */
-void generate_cff(char construction, char block_size, int d, long fq, long k);
-void embed_cff(char construction, char block_size, const char *cff_file, int d, long Fq, long k);
-generated_cffs generate_new_cff_blocks(char construction, char block_size, int d, long* Fq_steps, long* k_steps, int num_steps);
+void generate_cff(char construction, char block_size, int d, long fq, long k, char format, const char* output, int labels, long tile_rows, int shard, int num_shards);
+void embed_cff(char construction, char block_size, const char *cff_file, int d, long Fq, long k, char format, const char* output, int labels, long tile_rows, int shard, int num_shards, int streamed);
+void chain_cff(char construction, char block_size, int d, long* Fq_steps, long* k_steps, int num_steps, char format, int labels);
+int extract_cff(const char* archive_file, int step, char format, const char* output, int labels);
+int merge_cff(const char* output, char* const* shard_files, int count);
+int query_cff(const char* recipe_file, char query, long index, long col);
+uint64_t** embed_cff_matrix(char construction, char block_size, int d, uint64_t** cff_old_old, long old_rows, long old_cols, long* Fq_steps, long* k_steps, int num_steps, long* new_rows, long* new_cols);
+uint64_t** build_cff_matrix(char construction, char block_size, int d, uint64_t** cff_old, long old_rows, long old_cols, long* Fq_steps, long* k_steps, int num_steps, long* rows, long* cols);
+void embedded_cff_size(long old_rows, long old_cols, const generated_cffs* blocks, long* new_rows, long* new_cols);
+void place_cff_blocks(uint64_t** final_cff, uint64_t** cff_old_old, long old_rows, long old_cols, const generated_cffs* blocks);
+void embedded_cff_row(uint64_t* out, long row, const uint64_t* old_row, long old_rows, long old_cols, const generated_cffs* blocks);
+static void embed_cff_stream(char construction, char block_size, FILE* input, int d, long Fq, long k, char format, const char* filename, int labels, long tile_rows, int shard, int num_shards);
+static inline void or_shifted_row(uint64_t* dst, long col_offset, const uint64_t* src, long cols);
+generated_cffs generate_new_cff_blocks(char construction, char block_size, int d, long* Fq_steps, long* k_steps, int num_steps, const cff_row_sink* sink);
+int prepare_cff_step(cff_step* step, char construction, char block_size, int d, const long* Fq_steps, const long* k_steps, int num_steps);
+long cff_step_new_rows(char construction, char block_size, int d, const long* Fq_steps, const long* k_steps, int num_steps, long* dk_size);
+void free_cff_step(cff_step* step);
+
+/* Output Helper Functions */
+void initial_cff_filename(char* filename, size_t size, char block_size, int d, long fq, long k, char format);
+void embedded_cff_filename(char* filename, size_t size, char construction, char block_size, int d, long Fq, long k, char format);
+static void* write_cff_job(void* arg);
+static void stream_job_rows(void* arg, uint64_t** matrix, long first, long count, long rows, long cols);
+static const char* format_extension(char format);
+static void write_step_labels(const char* matrix_filename, char construction, char block_size, int d, long* Fq_steps, long* k_steps, int num_steps, long old_rows, long old_cols);
 
 /* CFF Matrix Generation Functions */
-uint64_t** generate_single_cff(long* num_rows, const element_pair* combos, long num_combos, GHashTable* inverted_evals, long num_polys);
-
-/* Hash Table Functions */
-guint fq_nmod_hash_func(gconstpointer key);
-gboolean fq_nmod_equal_func(gconstpointer a, gconstpointer b);
-GHashTable* create_inverted_evaluation_index(long num_points, long num_polys, const fq_nmod_t* points, const fq_nmod_poly_t* polys, const fq_nmod_ctx_t ctx);
-void g_array_destroy_wrapper(gpointer data);
-void g_hash_table_destroy_wrapper(gpointer data);
+uint64_t** generate_single_cff(long* num_rows, const element_pair* combos, long num_combos, const inverted_index* index, const fq_nmod_ctx_t ctx, const cff_row_sink* sink, const cff_block_target* target);
+uint64_t** generate_single_cff_from_table(long* num_rows, const element_pair* combos, long num_combos, const evaluation_table* table, const fq_nmod_ctx_t ctx, const cff_row_sink* sink, const cff_block_target* target);
+static inline uint64_t byte_equality_mask(const uint8_t* bytes, uint8_t value);
+static inline void or_target_word(uint64_t* word, uint64_t bits, int shared);
+long* group_rows_by_x(const element_pair* combos, long num_combos, long* num_groups, long* max_group_rows);
+long tile_words_for_rows(long group_rows, long words_per_row);
+long task_count(long total);
+static inline long first_posting_from(const long* postings, long count, long col);
+static inline long first_posting32_from(const uint32_t* postings, long count, long col);
+
+/* Tiled Generation Functions */
+static void generate_cff_tiled(cff_write_job* job, char construction, char block_size, int d, long tile_rows, int shard, int num_shards);
+static void shard_row_range(long rows, int shard, int num_shards, long* first, long* end);
+static int shard_filename(char* out, size_t size, const char* filename, int shard, int num_shards);
+static int check_output_path(const char* output);
+static int open_block_tiles(cff_block_tiles* tiles, char construction, char block_size, int d, long* Fq_steps, long* k_steps, int num_steps);
+static void load_block_tiles(cff_block_tiles* tiles, long first, long count, long old_rows);
+static uint64_t** generate_block_rows(const cff_block_tiles* tiles, const element_pair* combos, long count, int new_polys, const cff_block_target* target);
+static void generate_blocks_into(const cff_block_tiles* tiles, uint64_t** final_cff, uint64_t** cff_old_old, long old_rows, long old_cols);
+static void release_block_tile(cff_block_tiles* tiles);
+static void close_block_tiles(cff_block_tiles* tiles);
+
+/* Evaluation Table Functions */
+evaluation_table create_evaluation_table(long num_points, long num_polys, const fq_nmod_t* points, const fq_nmod_poly_t* polys, const fq_nmod_ctx_t ctx);
+
+/* Inverted Index Functions */
+inverted_index create_inverted_evaluation_index(long num_points, long num_polys, const fq_nmod_t* points, const fq_nmod_poly_t* polys, const fq_nmod_ctx_t ctx);
 
 /* Element Combination Functions */
-combination_partitions generate_combinations(char construction, int dk_size, const subfield_partition* partitions, int num_partitions, const fq_nmod_ctx_t ctx);
+combination_partitions generate_combinations(char construction, long dk_size, const subfield_partition* partitions, int num_partitions, const fq_nmod_ctx_t ctx);
 void add_pair_to_list(element_pair** list, long* count, long* capacity, const fq_nmod_t x, const fq_nmod_t y, const fq_nmod_ctx_t ctx);
 
 /* Polynomial Functions */
@@ -61,18 +104,44 @@ void add_poly_to_list(fq_nmod_poly_t** list, long* count, long* capacity, const
 void get_element_by_arithmetic(fq_nmod_t result, ulong i, const fq_nmod_ctx_t ctx);
 subfield_partition* partition_by_subfields(const long* Fq_steps, int num_steps, const fq_nmod_ctx_t ctx);
 long find_element_index(const fq_nmod_t element, const fq_nmod_t* list, long list_count, const fq_nmod_ctx_t ctx);
+long element_index(const fq_nmod_t element, ulong p);
 void add_element_to_list(fq_nmod_t** list, long* count, long* capacity, const fq_nmod_t element, const fq_nmod_ctx_t ctx);
 
+/* Thread Placement Functions */
+int bind_cff_threads(char policy);
+void unbind_cff_thread(void);
+#if defined(__linux__)
+static long node_ordered_cpus(int* cpus, const cpu_set_t* allowed);
+static int read_cpu_list(const char* path, cpu_set_t* set);
+#endif
+
 /* Mathematical Utility Functions */
 static int is_prime(long n);
-static int decompose_prime_power(long q, long* p_out, long* n_out);
+int decompose_prime_power(long q, long* p_out, long* n_out);
+int check_cff_field_steps(char construction, const long* Fq_steps, int num_steps);
+long checked_mul(long a, long b);
+long checked_add(long a, long b);
+long checked_pow(long base, long exponent);
+
+/* Buffer Allocation Functions */
+void set_cff_huge_pages(char mode);
+void* alloc_cff_buffer(size_t bytes);
+void free_cff_buffer(void* buffer);
+#if defined(__linux__)
+static char* map_huge_buffer(size_t length);
+static void prefault_buffer(char* base, size_t length);
+#endif
 
 /* Memory Deallocation Functions */
 void free_matrix(uint64_t** matrix, long rows);
+uint64_t** alloc_contiguous_matrix(long rows, long cols);
+void free_contiguous_matrix(uint64_t** matrix);
 void free_subfield_partitions(subfield_partition* partitions, int num_steps, const fq_nmod_ctx_t ctx);
 void free_combination_partitions(combination_partitions* combos, const fq_nmod_ctx_t ctx);
 static void free_generated_cffs(generated_cffs* cffs);
 static void free_polynomial_partition(polynomial_partition* poly_part, const fq_nmod_ctx_t ctx);
+void free_evaluation_table(evaluation_table* table);
+void free_inverted_index(inverted_index* index);
 
 /* 
  *  MAIN FUNCTIONS
@@ -82,32 +151,68 @@ static void free_polynomial_partition(polynomial_partition* poly_part, const fq_
  * @brief Generates an initial CFF from basic parameters.
  * 
  * Creates a CFF from scratch using the provided parameters and saves it to file.
+ * Text and binary files are written while the matrix is generated: each
+ * batch of finished rows goes to a streaming writer, whose thread writes
+ * it to disk while the next batch is computed.
  * 
  * @param construction Construction type ('p' for embedding CFFs, 'm' for monotone CFFs).
  * @param block_size Define the size of CFF rows.
  * @param d CFF parameter d.
  * @param fq Finite field size.
  * @param k Maximum polynomial degree.
+ * @param format Output file format ('b' binary, 't' text, 'c' CSC, 'e' Elias-Fano, 'm' Matrix Market, 's' CSR, 'r' recipe, 'a' archive).
+ * @param output Output file path ("-" for stdout), or NULL for the default name in CFFs/.
+ * @param labels 1 to also write the row/column label side file.
+ * @param tile_rows Rows per tile for out-of-core generation (text or binary output), or 0 to keep the matrix in memory.
+ * @param shard Index of the shard to generate, from 0 to num_shards - 1.
+ * @param num_shards Number of shards the rows are split into, or 0 to generate the whole matrix.
  */
-void generate_cff(char construction, char block_size, int d, long fq, long k) {
-    long t0, n0;
-    
-    if(block_size == 'f'){
-        t0 = fq*fq;
-    } else {
-        t0 = (d*k+1) * fq;
+void generate_cff(char construction, char block_size, int d, long fq, long k, char format, const char* output, int labels, long tile_rows, int shard, int num_shards) {
+    if (!check_output_path(output)) return;
+    cff_write_job job = {0};
+    initial_cff_filename(job.filename, sizeof(job.filename), block_size, d, fq, k, format);
+    if (output != NULL) snprintf(job.filename, sizeof(job.filename), "%s", output);
+    char matrix_filename[CFF_PATH_MAX];
+    snprintf(matrix_filename, sizeof(matrix_filename), "%s", job.filename);
+    if (num_shards > 0 && !shard_filename(job.filename, sizeof(job.filename), matrix_filename, shard, num_shards)) return;
+
+    if (format == 'r') {
+        cff_recipe recipe = { .d = d, .num_steps = 1 };
+        recipe.steps[0] = (cff_recipe_step) { construction, block_size, fq, k };
+        if (write_cff_recipe(job.filename, &recipe)) printf("Initial CFF recipe written to '%s'.\n", job.filename);
+        return;
     }
-    n0 = (long)pow(fq, k + 1);
-    
-    char filename0[100];
-    snprintf(filename0, sizeof(filename0), "CFFs/%d-CFF(%ld,%ld).txt", d, t0, n0);
-    printf("Generating initial CFF in '%s'...\n", filename0);
+    printf("Generating initial CFF in '%s'...\n", job.filename);
 
     long fq_array[1] = { fq };
     long k_array[1] = { k };
     int num_steps = 1;
 
-    generated_cffs new_blocks = generate_new_cff_blocks(construction, block_size, d, fq_array, k_array, num_steps);
+    job.format = format;
+    job.construction = construction;
+    job.d = d;
+    job.Fq_steps = fq_array;
+    job.k_steps = k_array;
+    job.num_steps = 1;
+
+    if (tile_rows > 0 || num_shards > 0) {
+        generate_cff_tiled(&job, construction, block_size, d, tile_rows, shard, num_shards);
+        if (labels && shard == 0) write_step_labels(matrix_filename, construction, block_size, d, fq_array, k_array, num_steps, 0, 0);
+        return;
+    }
+
+    cff_row_sink sink = { stream_job_rows, &job };
+    int streamed = (format == 'b' || format == 't');
+    generated_cffs new_blocks = generate_new_cff_blocks(construction, block_size, d, fq_array, k_array, num_steps, streamed ? &sink : NULL);
+
+    if (format == 'a') {
+        if (new_blocks.cff_new != NULL && create_cff_archive(job.filename, d) &&
+            append_cff_archive_step(job.filename, construction, block_size, fq, k, &new_blocks, 1)) {
+            printf("Initial CFF matrix of %ldx%ld written to archive '%s'.\n", new_blocks.rows_new, new_blocks.cols_new, job.filename);
+        }
+        free_generated_cffs(&new_blocks);
+        return;
+    }
 
     uint64_t** final_cff = new_blocks.cff_new;
     long final_rows = new_blocks.rows_new;
@@ -119,7 +224,15 @@ void generate_cff(char construction, char block_size, int d, long fq, long k) {
     }
     printf("Initial CFF matrix of %ldx%ld generated.\n", final_rows, final_cols);
 
-    write_cff_to_file(filename0, construction, d, fq_array, 1, k_array, 1, final_cff, final_rows, final_cols);
+    if (streamed) {
+        close_cff_stream(job.stream);
+    } else {
+        job.matrix = final_cff;
+        job.rows = final_rows;
+        job.cols = final_cols;
+        write_cff_job(&job);
+    }
+    if (labels) write_step_labels(job.filename, construction, block_size, d, fq_array, k_array, num_steps, 0, 0);
 
     new_blocks.cff_old_new = NULL;
     new_blocks.cff_new_old = NULL;
@@ -131,26 +244,133 @@ void generate_cff(char construction, char block_size, int d, long fq, long k) {
  * @brief Performs embedding of an existing CFF to a larger field.
  * 
  * Reads an existing CFF from file and expands it to a larger finite field,
- * generating the necessary new blocks and saving the expanded CFF.
+ * generating the necessary new blocks and saving the expanded CFF. The file
+ * is opened once: binary inputs are mapped and used in place, text inputs
+ * are parsed in a single pass. When both input and output are binary, the
+ * output file is mapped too: the old matrix is copied into it and the new
+ * blocks are generated straight into its rows, so no full copy of either
+ * matrix lives on the heap. An output that is the input file itself (under
+ * any name) is written from the heap instead, since creating it truncates
+ * the mapping.
+ * An input file of "-" is read from stdin, and in out-of-core or streamed
+ * mode any input file is read as a stream too (see embed_cff_stream).
  * 
  * @param construction Construction type ('p' for embedding CFFs, 'm' for monotone CFFs).
  * @param block_size Define the size of CFF rows.
- * @param cff_file File name to CFF storage.
+ * @param cff_file File name to CFF storage ("-" for stdin).
  * @param d CFF parameter d.
  * @param Fq New CFF parameter Fq.
  * @param k New CFF parameter k.
+ * @param format Output file format ('b' binary, 't' text, 'c' CSC, 'e' Elias-Fano, 'm' Matrix Market, 's' CSR, 'r' recipe, 'a' archive).
+ * @param output Output file path ("-" for stdout), or NULL for the default name in CFFs/.
+ * @param labels 1 to also write the row/column label side file.
+ * @param tile_rows Rows per tile for out-of-core embedding (text or binary input and output), or 0 to keep the matrices in memory.
+ * @param shard Index of the shard to generate, from 0 to num_shards - 1.
+ * @param num_shards Number of shards the rows are split into (binary input), or 0 to generate the whole matrix.
+ * @param streamed 1 to stream the input file through as if it came from stdin, without tiles.
  */
-void embed_cff(char construction, char block_size, const char *cff_file, int d, long Fq, long k){
+void embed_cff(char construction, char block_size, const char *cff_file, int d, long Fq, long k, char format, const char* output, int labels, long tile_rows, int shard, int num_shards, int streamed){
+    if (!check_output_path(output)) return;
+    if (format == 'r') {
+        cff_recipe recipe;
+        if (!read_cff_recipe(cff_file, &recipe)) {
+            printf("Error: Recipe output needs a recipe input file ('%s' is not one).\n", cff_file);
+            return;
+        }
+        if (recipe.num_steps == CFF_RECIPE_MAX_STEPS) {
+            printf("Error: Recipes store at most %d steps.\n", CFF_RECIPE_MAX_STEPS);
+            return;
+        }
+        if (d != recipe.d) {
+            printf("Error: Recipe '%s' describes a %d-CFF, d = %d requested.\n", cff_file, recipe.d, d);
+            return;
+        }
+        recipe.steps[recipe.num_steps++] = (cff_recipe_step) { construction, block_size, Fq, k };
+        long Fq_steps[CFF_RECIPE_MAX_STEPS];
+        for (int i = 0; i < recipe.num_steps; i++) Fq_steps[i] = recipe.steps[i].q;
+        if (!check_cff_field_steps(construction, Fq_steps, recipe.num_steps)) return;
+
+        char filename[CFF_PATH_MAX];
+        embedded_cff_filename(filename, sizeof(filename), construction, block_size, d, Fq, k, format);
+        if (output != NULL) snprintf(filename, sizeof(filename), "%s", output);
+        if (write_cff_recipe(filename, &recipe)) printf("Embedded CFF recipe written to '%s'.\n", filename);
+        return;
+    }
+
+    if (format == 'a') {
+        // The step is appended to the input archive in place, so there is no output file to name
+        if (output != NULL) {
+            printf("Error: Archive output is appended to the input archive; --output cannot be used.\n");
+            return;
+        }
+        struct cff_archive_index index;
+        if (!read_cff_archive_index(cff_file, &index)) {
+            printf("Error: Archive output needs an archive input file ('%s' is not one).\n", cff_file);
+            return;
+        }
+        if (d != index.d) {
+            printf("Error: Archive '%s' holds a %d-CFF chain, d = %d requested.\n", cff_file, index.d, d);
+            free_cff_archive_index(&index);
+            return;
+        }
+
+        int num_steps = index.num_steps + 1;
+        long* Fq_steps = (long*) malloc(num_steps * sizeof(long));
+        long* k_steps = (long*) malloc(num_steps * sizeof(long));
+        if (Fq_steps == NULL || k_steps == NULL) exit(EXIT_FAILURE);
+        for (int i = 0; i < index.num_steps; i++) {
+            Fq_steps[i] = index.steps[i].q;
+            k_steps[i] = index.steps[i].k;
+        }
+        Fq_steps[index.num_steps] = Fq;
+        k_steps[index.num_steps] = k;
+        free_cff_archive_index(&index);
+        if (!check_cff_field_steps(construction, Fq_steps, num_steps)) {
+            free(Fq_steps);
+            free(k_steps);
+            return;
+        }
+
+        generated_cffs new_blocks = generate_new_cff_blocks(construction, block_size, d, Fq_steps, k_steps, num_steps, NULL);
+        if (append_cff_archive_step(cff_file, construction, block_size, Fq, k, &new_blocks, 0)) {
+            printf("Step %d appended to archive '%s'.\n", num_steps, cff_file);
+        }
+        free_generated_cffs(&new_blocks);
+        free(Fq_steps);
+        free(k_steps);
+        return;
+    }
+
+    if (strcmp(cff_file, "-") == 0 || streamed || tile_rows > 0 || num_shards > 0) {
+        FILE* input = stdin;
+        if (strcmp(cff_file, "-") != 0 && (input = fopen(cff_file, "rb")) == NULL) {
+            printf("Input file '%s' not found.\n", cff_file);
+            return;
+        }
+        char filename[CFF_PATH_MAX];
+        embedded_cff_filename(filename, sizeof(filename), construction, block_size, d, Fq, k, format);
+        if (output != NULL) snprintf(filename, sizeof(filename), "%s", output);
+        if (input != stdin && num_shards == 0 && is_same_cff_file(cff_file, filename)) {
+            printf("Error: Output file '%s' is the input file, which is read while the output is written.\n", filename);
+            fclose(input);
+            return;
+        }
+        embed_cff_stream(construction, block_size, input, d, Fq, k, format, filename, labels, tile_rows, shard, num_shards);
+        if (input != stdin) fclose(input);
+        return;
+    }
 
     long old_rows = 0, old_cols = 0;
-    struct cff_parameters* params = read_parameters(cff_file);
+    struct cff_parameters* params = NULL;
+    int mapped = 0;
+    uint64_t** cff_old_old = load_cff_file(cff_file, &old_rows, &old_cols, &params, &mapped);
     if (params == NULL) {
         printf("Error reading parameters from file %s\n", cff_file);
+        if (mapped) unmap_cff_matrix(cff_old_old, old_rows, old_cols);
+        else free_matrix(cff_old_old, old_rows);
         return;
     }
 
-    uint64_t** cff_old_old = read_cff_from_file(cff_file, &old_rows, &old_cols);
-
     int new_fqs_count = params->fqs_count + 1;
     int new_ks_count = params->ks_count + 1;
     long* new_Fq_steps = (long*) malloc(new_fqs_count * sizeof(long));
@@ -163,13 +383,14 @@ void embed_cff(char construction, char block_size, const char *cff_file, int d,
         free(params);
         free(new_Fq_steps); 
         free(new_k_steps);
-        free_matrix(cff_old_old, old_rows);
+        if (mapped) unmap_cff_matrix(cff_old_old, old_rows, old_cols);
+        else free_matrix(cff_old_old, old_rows);
         return;
     }
 
     for (int i = 0; i < new_fqs_count; i++) {
         if (i < params->fqs_count) { 
-            new_Fq_steps[i] = (long)params->Fqs[i];
+            new_Fq_steps[i] = params->Fqs[i];
         } else {
             new_Fq_steps[i] = Fq;
         }
@@ -177,89 +398,679 @@ void embed_cff(char construction, char block_size, const char *cff_file, int d,
 
     for (int i = 0; i < new_ks_count; i++) {
         if (i < params->ks_count) { 
-            new_k_steps[i] = (long)params->ks[i];
+            new_k_steps[i] = params->ks[i];
         } else {
             new_k_steps[i] = k;
         }
     }
 
-    generated_cffs new_blocks = generate_new_cff_blocks(construction, block_size, d, new_Fq_steps, new_k_steps, new_fqs_count);
-
-    long new_total_rows = old_rows + new_blocks.rows_new_old;
-
-    long width_top = old_cols + new_blocks.cols_old_new;
-    long width_bottom = new_blocks.cols_new_old + new_blocks.cols_new;
-    long new_total_cols = (width_top > width_bottom) ? width_top : width_bottom;
-    
-    long words_per_row = WORDS_FOR_BITS(new_total_cols);
-    uint64_t** final_cff = (uint64_t**) malloc(new_total_rows * sizeof(uint64_t*));
-    for (long i = 0; i < new_total_rows; i++) {
-        final_cff[i] = (uint64_t*) calloc(words_per_row, sizeof(uint64_t));
+    cff_write_job job = {0};
+    embedded_cff_filename(job.filename, sizeof(job.filename), construction, block_size, d, Fq, k, format);
+    if (output != NULL) snprintf(job.filename, sizeof(job.filename), "%s", output);
+
+    // The output is truncated when created, so it must not be the mapped input under any name
+    int to_stdout = (output != NULL && strcmp(output, "-") == 0);
+    if (format == 'b' && mapped && !to_stdout && !is_same_cff_file(cff_file, job.filename)) {
+        cff_block_tiles tiles;
+        if (open_block_tiles(&tiles, construction, block_size, d, new_Fq_steps, new_k_steps, new_fqs_count)) {
+            long new_total_rows = 0, new_total_cols = 0;
+            embedded_cff_size(old_rows, old_cols, &tiles.blocks, &new_total_rows, &new_total_cols);
+
+            uint64_t** final_cff = create_cff_binary_file(job.filename, construction, d, new_Fq_steps, new_fqs_count, new_k_steps, new_fqs_count, new_total_rows, new_total_cols);
+            if (final_cff != NULL) {
+                generate_blocks_into(&tiles, final_cff, cff_old_old, old_rows, old_cols);
+                unmap_cff_matrix(final_cff, new_total_rows, new_total_cols);
+                printf("CFF matrix of %ldx%ld embedded in place into '%s'.\n", new_total_rows, new_total_cols, job.filename);
+            }
+            close_block_tiles(&tiles);
+        }
+    } else {
+        long new_total_rows = 0, new_total_cols = 0;
+        uint64_t** final_cff = embed_cff_matrix(construction, block_size, d, cff_old_old, old_rows, old_cols, new_Fq_steps, new_k_steps, new_fqs_count, &new_total_rows, &new_total_cols);
+        if (final_cff == NULL) {
+            printf("Error: Failed to generate the new blocks of the embedded CFF.\n");
+        } else {
+            job.format = format;
+            job.construction = construction;
+            job.d = d;
+            job.Fq_steps = new_Fq_steps;
+            job.k_steps = new_k_steps;
+            job.num_steps = new_fqs_count;
+            job.matrix = final_cff;
+            job.rows = new_total_rows;
+            job.cols = new_total_cols;
+            write_cff_job(&job);
+            free_contiguous_matrix(final_cff);
+        }
     }
+    if (labels) write_step_labels(job.filename, construction, block_size, d, new_Fq_steps, new_k_steps, new_fqs_count, old_rows, old_cols);
+
+    if (mapped) unmap_cff_matrix(cff_old_old, old_rows, old_cols);
+    else free_matrix(cff_old_old, old_rows);
+    free(new_Fq_steps);
+    free(new_k_steps);
+    free(params->Fqs);
+    free(params->ks);
+    free(params);
+}
 
-    for(long i=0; i < old_rows; i++) {
-        for (long j = 0; j < old_cols; j++) {
-            if (GET_BIT(cff_old_old[i], j)) {
-                SET_BIT(final_cff[i], j);
+/**
+ * @brief Runs a whole chain of embeddings in a single process.
+ * 
+ * Generates the initial CFF for the first step and embeds it through every
+ * following step, keeping the matrix in memory between steps. The file of
+ * step i is written by a background thread while step i + 1 is computed.
+ * For monotone chains the first step uses the polynomial construction with
+ * minimum block size, as in "p f m" followed by "m g". The fields are
+ * checked up front (see check_cff_field_steps), so an invalid chain writes
+ * nothing.
+ * 
+ * @param construction Construction type ('p' for embedding CFFs, 'm' for monotone CFFs).
+ * @param block_size Define the size of CFF rows.
+ * @param d CFF parameter d.
+ * @param Fq_steps Array with the finite field size of every step.
+ * @param k_steps Array with the maximum polynomial degree of every step.
+ * @param num_steps Number of steps.
+ * @param format Output file format ('b' binary, 't' text, 'c' CSC, 'e' Elias-Fano, 'm' Matrix Market, 's' CSR, 'r' recipe, 'a' archive).
+ * @param labels 1 to also write the row/column label side file of every step.
+ */
+void chain_cff(char construction, char block_size, int d, long* Fq_steps, long* k_steps, int num_steps, char format, int labels) {
+    char initial_block_size = (construction == 'm') ? 'm' : block_size;
+    if (!check_cff_field_steps(construction, Fq_steps, num_steps)) return;
+
+    if (format == 'r') {
+        if (num_steps > CFF_RECIPE_MAX_STEPS) {
+            printf("Error: Recipes store at most %d steps.\n", CFF_RECIPE_MAX_STEPS);
+            return;
+        }
+        cff_recipe recipe = { .d = d, .num_steps = 0 };
+        for (int step = 0; step < num_steps; step++) {
+            char filename[CFF_PATH_MAX];
+            if (step == 0) {
+                recipe.steps[0] = (cff_recipe_step) { 'p', initial_block_size, Fq_steps[0], k_steps[0] };
+                initial_cff_filename(filename, sizeof(filename), initial_block_size, d, Fq_steps[0], k_steps[0], format);
+            } else {
+                recipe.steps[step] = (cff_recipe_step) { construction, block_size, Fq_steps[step], k_steps[step] };
+                embedded_cff_filename(filename, sizeof(filename), construction, block_size, d, Fq_steps[step], k_steps[step], format);
             }
+            recipe.num_steps = step + 1;
+            if (write_cff_recipe(filename, &recipe)) printf("Step %d/%d: recipe written to '%s'.\n", step + 1, num_steps, filename);
         }
+        return;
     }
 
-    for(long i=0; i < new_blocks.rows_old_new; i++) {
-        for (long j = 0; j < new_blocks.cols_old_new; j++) {
-            if (GET_BIT(new_blocks.cff_old_new[i], j)) {
-                SET_BIT(final_cff[i], old_cols + j);
-            }
+    if (format == 'a') {
+        char filename[CFF_PATH_MAX];
+        initial_cff_filename(filename, sizeof(filename), initial_block_size, d, Fq_steps[0], k_steps[0], format);
+        if (!create_cff_archive(filename, d)) return;
+
+        for (int step = 0; step < num_steps; step++) {
+            char step_construction = (step == 0) ? 'p' : construction;
+            char step_block_size = (step == 0) ? initial_block_size : block_size;
+            generated_cffs new_blocks = generate_new_cff_blocks(step_construction, step_block_size, d, Fq_steps, k_steps, step + 1, NULL);
+            int ok = append_cff_archive_step(filename, step_construction, step_block_size, Fq_steps[step], k_steps[step], &new_blocks, step == 0);
+            free_generated_cffs(&new_blocks);
+            if (!ok) return;
+            printf("Step %d/%d: blocks appended to archive '%s'.\n", step + 1, num_steps, filename);
         }
+        return;
     }
-    
-    for(long i=0; i < new_blocks.rows_new_old; i++) {
-        for (long j = 0; j < new_blocks.cols_new_old; j++) {
-            if (GET_BIT(new_blocks.cff_new_old[i], j)) {
-                SET_BIT(final_cff[old_rows + i], j);
-            }
+
+    generated_cffs initial_blocks = generate_new_cff_blocks('p', initial_block_size, d, Fq_steps, k_steps, 1, NULL);
+    uint64_t** current_cff = initial_blocks.cff_new;
+    long current_rows = initial_blocks.rows_new;
+    long current_cols = initial_blocks.cols_new;
+    initial_blocks.cff_new = NULL;
+    free_generated_cffs(&initial_blocks);
+
+    if (current_cff == NULL) {
+        printf("Error: Failed to generate initial CFF matrix.\n");
+        return;
+    }
+
+    cff_write_job job = {0};
+    initial_cff_filename(job.filename, sizeof(job.filename), initial_block_size, d, Fq_steps[0], k_steps[0], format);
+    job.format = format;
+    job.construction = 'p';
+    job.d = d;
+    job.Fq_steps = Fq_steps;
+    job.k_steps = k_steps;
+    job.num_steps = 1;
+    job.matrix = current_cff;
+    job.rows = current_rows;
+    job.cols = current_cols;
+
+    pthread_t writer;
+    long previous_rows = 0, previous_cols = 0;
+    for (int step = 1; ; step++) {
+        printf("Step %d/%d: CFF matrix of %ldx%ld generated, writing '%s'...\n", step, num_steps, job.rows, job.cols, job.filename);
+        int writer_started = (pthread_create(&writer, NULL, write_cff_job, &job) == 0);
+        if (!writer_started) write_cff_job(&job);
+        if (labels) {
+            char step_block_size = (step == 1) ? initial_block_size : block_size;
+            write_step_labels(job.filename, job.construction, step_block_size, d, Fq_steps, k_steps, step, previous_rows, previous_cols);
+        }
+
+        uint64_t** next_cff = NULL;
+        long next_rows = 0, next_cols = 0;
+        if (step < num_steps) {
+            next_cff = embed_cff_matrix(construction, block_size, d, current_cff, current_rows, current_cols, Fq_steps, k_steps, step + 1, &next_rows, &next_cols);
         }
+
+        if (writer_started) pthread_join(writer, NULL);
+        free_contiguous_matrix(current_cff);
+        if (step == num_steps) break;
+
+        previous_rows = current_rows;
+        previous_cols = current_cols;
+        current_cff = next_cff;
+        current_rows = next_rows;
+        current_cols = next_cols;
+
+        embedded_cff_filename(job.filename, sizeof(job.filename), construction, block_size, d, Fq_steps[step], k_steps[step], format);
+        job.construction = construction;
+        job.num_steps = step + 1;
+        job.matrix = current_cff;
+        job.rows = current_rows;
+        job.cols = current_cols;
     }
-    
-    for(long i=0; i < new_blocks.rows_new; i++) {
-        for (long j = 0; j < new_blocks.cols_new; j++) {
-            if (GET_BIT(new_blocks.cff_new[i], j)) {
-                SET_BIT(final_cff[old_rows + i], new_blocks.cols_new_old + j);
-            }
+}
+
+/**
+ * @brief Rebuilds one step of a chain archive and writes it to file.
+ * 
+ * The output file is named as if the step had been generated directly.
+ * 
+ * @param archive_file Chain archive file path.
+ * @param step Step number, starting at 1.
+ * @param format Output file format ('b' binary, 't' text, 'c' CSC, 'e' Elias-Fano, 'm' Matrix Market, 's' CSR, 'r' recipe).
+ * @param output Output file path ("-" for stdout), or NULL for the default name in CFFs/.
+ * @param labels 1 to also write the row/column label side file.
+ * @return 1 on success, 0 (with an error message) if the step cannot be read or written.
+ */
+int extract_cff(const char* archive_file, int step, char format, const char* output, int labels) {
+    if (!check_output_path(output)) return 0;
+    struct cff_archive_index index;
+    if (!read_cff_archive_index(archive_file, &index)) return 0;
+    if (step < 1 || step > index.num_steps) {
+        printf("Error: Archive '%s' has %d steps, step %d requested.\n", archive_file, index.num_steps, step);
+        free_cff_archive_index(&index);
+        return 0;
+    }
+
+    const struct cff_archive_step* last = &index.steps[step - 1];
+    long* Fq_steps = (long*) malloc(step * sizeof(long));
+    long* k_steps = (long*) malloc(step * sizeof(long));
+    if (Fq_steps == NULL || k_steps == NULL) exit(EXIT_FAILURE);
+    for (int i = 0; i < step; i++) {
+        Fq_steps[i] = index.steps[i].q;
+        k_steps[i] = index.steps[i].k;
+    }
+
+    cff_write_job job = {0};
+    if (step == 1) {
+        initial_cff_filename(job.filename, sizeof(job.filename), last->block_size, index.d, last->q, last->k, format);
+    } else {
+        embedded_cff_filename(job.filename, sizeof(job.filename), last->construction, last->block_size, index.d, last->q, last->k, format);
+    }
+    if (output != NULL) snprintf(job.filename, sizeof(job.filename), "%s", output);
+
+    if (format == 'r') {
+        cff_recipe recipe = { .d = index.d, .num_steps = step };
+        for (int i = 0; i < step; i++) {
+            recipe.steps[i] = (cff_recipe_step) { index.steps[i].construction, index.steps[i].block_size, index.steps[i].q, index.steps[i].k };
+        }
+        job.ok = write_cff_recipe(job.filename, &recipe);
+        if (job.ok) printf("Step %d recipe written to '%s'.\n", step, job.filename);
+    } else {
+        job.format = format;
+        job.construction = last->construction;
+        job.d = index.d;
+        job.Fq_steps = Fq_steps;
+        job.k_steps = k_steps;
+        job.num_steps = step;
+        job.matrix = extract_cff_archive_step(archive_file, step, &job.rows, &job.cols);
+        if (job.matrix != NULL) {
+            printf("Step %d: CFF matrix of %ldx%ld extracted, writing '%s'...\n", step, job.rows, job.cols, job.filename);
+            write_cff_job(&job);
+            free_matrix(job.matrix, job.rows);
+            if (labels) write_step_labels(job.filename, last->construction, last->block_size, index.d, Fq_steps, k_steps, step, last->old_rows, last->old_cols);
         }
     }
 
-    long t1 = 0, n1 = 0;
-    
-    if (construction == 'm') {
-        t1 = (d * k + 1) * Fq;
-        n1 = (long)pow(Fq, k + 1);
+    free(Fq_steps);
+    free(k_steps);
+    free_cff_archive_index(&index);
+    return job.ok;
+}
+
+/**
+ * @brief Merges the shard files of a CFF into the final file.
+ * 
+ * The shards may come from different processes or machines; they only
+ * need to be the num_shards shards of the same matrix.
+ * 
+ * @param output Output file path.
+ * @param shard_files Paths of the shard files, in any order.
+ * @param count Number of shard files.
+ * @return 1 on success, 0 (with an error message) if the shards cannot be merged.
+ */
+int merge_cff(const char* output, char* const* shard_files, int count) {
+    long rows = 0, cols = 0;
+    if (!merge_cff_shards(output, shard_files, count, &rows, &cols)) return 0;
+    printf("%d shards merged into '%s', CFF matrix of %ldx%ld.\n", count, output, rows, cols);
+    return 1;
+}
+
+/**
+ * @brief Answers a query on the CFF described by a recipe, without generating it.
+ * 
+ * Builds an oracle from the recipe (see create_cff_oracle) and prints the
+ * answer to stdout: a bit as "0" or "1", a row in the text format of the
+ * matrix ("1 0 0 1 ..."), or a column as the ascending indices of its
+ * rows that are set.
+ * 
+ * @param recipe_file Recipe file path.
+ * @param query 'b' for one bit, 'r' for one row, 'c' for one column.
+ * @param index Row of the bit or row query, column of the column query.
+ * @param col Column of the bit query (ignored otherwise).
+ * @return 1 on success, 0 on error.
+ */
+int query_cff(const char* recipe_file, char query, long index, long col) {
+    cff_recipe recipe;
+    if (!read_cff_recipe(recipe_file, &recipe)) {
+        printf("Error: '%s' is not a recipe file.\n", recipe_file);
+        return 0;
+    }
+    cff_oracle* oracle = create_cff_oracle(&recipe);
+    if (oracle == NULL) {
+        printf("Error: Failed to build the oracle of '%s'.\n", recipe_file);
+        return 0;
+    }
+
+    long limit = (query == 'c') ? oracle->cols : oracle->rows;
+    if (index < 0 || index >= limit || (query == 'b' && (col < 0 || col >= oracle->cols))) {
+        printf("Error: Query outside the %ldx%ld CFF of '%s'.\n", oracle->rows, oracle->cols, recipe_file);
+        free_cff_oracle(oracle);
+        return 0;
+    }
+
+    if (query == 'b') {
+        printf("%d\n", cff_get_bit(oracle, index, col));
+    } else if (query == 'r') {
+        uint64_t* row = (uint64_t*) malloc(WORDS_FOR_BITS(oracle->cols) * sizeof(uint64_t));
+        if (row == NULL) exit(EXIT_FAILURE);
+        cff_get_row(oracle, index, row);
+        for (long j = 0; j < oracle->cols; j++) {
+            printf(j + 1 < oracle->cols ? "%d " : "%d\n", GET_BIT(row, j) ? 1 : 0);
+        }
+        free(row);
     } else {
-        if(d < ((Fq-1)/k)){
-            t1 = (d*k+1)*Fq;
-        } else {
-            if(block_size == 'f'){
-                t1 = (Fq * Fq);
-            } else {
-                t1 = (d*k+1)*Fq;
-            }
+        long* rows = (long*) malloc((oracle->rows > 0 ? oracle->rows : 1) * sizeof(long));
+        if (rows == NULL) exit(EXIT_FAILURE);
+        long count = cff_get_column(oracle, index, rows);
+        for (long i = 0; i < count; i++) {
+            printf(i + 1 < count ? "%ld " : "%ld", rows[i]);
         }
-        n1 = (long)pow(Fq, k + 1);
+        printf("\n");
+        free(rows);
     }
-    
-    char filename1[100]; 
-    snprintf(filename1, sizeof(filename1), "CFFs/%d-CFF(%ld,%ld).txt", d, t1, n1);
 
-    write_cff_to_file(filename1, construction, d, new_Fq_steps, new_fqs_count, new_k_steps, new_ks_count, final_cff, new_total_rows, new_total_cols);
+    free_cff_oracle(oracle);
+    return 1;
+}
+
+/**
+ * @brief Embeds an in-memory CFF into the field of the last step.
+ * 
+ * The embedded matrix is first touched with the same static row split as
+ * the writers, so with --bind each range of rows lives on the NUMA node
+ * of the threads that write it out. The old matrix, which is left
+ * untouched, is then copied in and the three new blocks are generated
+ * straight into its rows (see generate_blocks_into), so no block is ever
+ * allocated on its own and read back from another node.
+ * 
+ * @param construction Construction type ('p' or 'm').
+ * @param block_size Define the size of CFF rows.
+ * @param d CFF parameter d.
+ * @param cff_old_old Matrix of the previous step.
+ * @param old_rows Number of rows of the previous matrix.
+ * @param old_cols Number of columns of the previous matrix.
+ * @param Fq_steps Array with finite field sizes, including the new step.
+ * @param k_steps Array with maximum polynomial degrees, including the new step.
+ * @param num_steps Number of steps.
+ * @param new_rows Pointer to store the number of rows of the embedded matrix.
+ * @param new_cols Pointer to store the number of columns of the embedded matrix.
+ * @return Embedded CFF matrix (freed with free_contiguous_matrix), or NULL if the last field size is not a prime power.
+ */
+uint64_t** embed_cff_matrix(char construction, char block_size, int d, uint64_t** cff_old_old, long old_rows, long old_cols, long* Fq_steps, long* k_steps, int num_steps, long* new_rows, long* new_cols) {
+    *new_rows = 0; *new_cols = 0;
+    cff_block_tiles tiles;
+    if (!open_block_tiles(&tiles, construction, block_size, d, Fq_steps, k_steps, num_steps)) return NULL;
+
+    long new_total_rows = 0, new_total_cols = 0;
+    embedded_cff_size(old_rows, old_cols, &tiles.blocks, &new_total_rows, &new_total_cols);
+    long words_per_row = WORDS_FOR_BITS(new_total_cols);
+
+    uint64_t** final_cff = alloc_contiguous_matrix(new_total_rows, new_total_cols);
+    #pragma omp parallel for schedule(static)
+    for (long i = 0; i < new_total_rows; i++) {
+        memset(final_cff[i], 0, words_per_row * sizeof(uint64_t));
+    }
+    generate_blocks_into(&tiles, final_cff, cff_old_old, old_rows, old_cols);
+    close_block_tiles(&tiles);
+
+    *new_rows = new_total_rows;
+    *new_cols = new_total_cols;
+    return final_cff;
+}
+
+/**
+ * @brief Builds a CFF matrix in memory, in one contiguous block.
+ * 
+ * Generates the first step when num_steps is 1; otherwise embeds cff_old
+ * into the field of the last step. The result lives in a single
+ * allocation of rows * WORDS_FOR_BITS(cols) words, so it can be handed to
+ * other libraries as one buffer without copying.
+ * 
+ * @param construction Construction type ('p' or 'm').
+ * @param block_size Define the size of CFF rows.
+ * @param d CFF parameter d.
+ * @param cff_old Matrix of the previous step (ignored when num_steps is 1).
+ * @param old_rows Number of rows of the previous matrix.
+ * @param old_cols Number of columns of the previous matrix.
+ * @param Fq_steps Array with finite field sizes, including the new step.
+ * @param k_steps Array with maximum polynomial degrees, including the new step.
+ * @param num_steps Number of steps.
+ * @param rows Pointer to store the number of rows.
+ * @param cols Pointer to store the number of columns.
+ * @return Matrix (freed with free_contiguous_matrix), or NULL on error.
+ */
+uint64_t** build_cff_matrix(char construction, char block_size, int d, uint64_t** cff_old, long old_rows, long old_cols, long* Fq_steps, long* k_steps, int num_steps, long* rows, long* cols) {
+    if (num_steps > 1) return embed_cff_matrix(construction, block_size, d, cff_old, old_rows, old_cols, Fq_steps, k_steps, num_steps, rows, cols);
+
+    *rows = 0; *cols = 0;
+    generated_cffs new_blocks = generate_new_cff_blocks(construction, block_size, d, Fq_steps, k_steps, num_steps, NULL);
+    if (new_blocks.cff_new == NULL) {
+        free_generated_cffs(&new_blocks);
+        return NULL;
+    }
 
-    free_matrix(cff_old_old, old_rows);
+    // The block is already one contiguous allocation: hand it over as is
+    *rows = new_blocks.rows_new;
+    *cols = new_blocks.cols_new;
+    uint64_t** matrix = new_blocks.cff_new;
+    new_blocks.cff_new = NULL;
     free_generated_cffs(&new_blocks);
-    free_matrix(final_cff, new_total_rows);
-    free(new_Fq_steps);
-    free(new_k_steps);
+    return matrix;
+}
+
+/**
+ * @brief Computes the size of the matrix produced by an embedding step.
+ * 
+ * @param old_rows Number of rows of the previous matrix.
+ * @param old_cols Number of columns of the previous matrix.
+ * @param blocks New blocks of the step.
+ * @param new_rows Pointer to store the number of rows of the embedded matrix.
+ * @param new_cols Pointer to store the number of columns of the embedded matrix.
+ */
+void embedded_cff_size(long old_rows, long old_cols, const generated_cffs* blocks, long* new_rows, long* new_cols) {
+    long width_top = old_cols + blocks->cols_old_new;
+    long width_bottom = blocks->cols_new_old + blocks->cols_new;
+    *new_rows = old_rows + blocks->rows_new_old;
+    *new_cols = (width_top > width_bottom) ? width_top : width_bottom;
+}
+
+/**
+ * @brief Places the old matrix and the new blocks of a step into a zeroed matrix.
+ * 
+ * Rows are independent (see embedded_cff_row), so they are built in
+ * parallel. The destination may equally be heap rows or rows of a mapped
+ * output file.
+ * 
+ * @param final_cff Zeroed destination matrix of the size given by embedded_cff_size.
+ * @param cff_old_old Matrix of the previous step.
+ * @param old_rows Number of rows of the previous matrix.
+ * @param old_cols Number of columns of the previous matrix.
+ * @param blocks New blocks of the step.
+ */
+void place_cff_blocks(uint64_t** final_cff, uint64_t** cff_old_old, long old_rows, long old_cols, const generated_cffs* blocks) {
+    long rows = old_rows + blocks->rows_new_old;
+
+    #pragma omp parallel for schedule(static)
+    for (long i = 0; i < rows; i++) {
+        embedded_cff_row(final_cff[i], i, (i < old_rows) ? cff_old_old[i] : NULL, old_rows, old_cols, blocks);
+    }
+}
+
+/**
+ * @brief Builds one row of the matrix produced by an embedding step.
+ * 
+ * The old matrix goes to the top-left corner, old_new to its right, and
+ * new_old followed by new_new below it. Rows are copied a word at a time,
+ * shifted when a block does not start on a word boundary.
+ * 
+ * @param out Zeroed destination row.
+ * @param row Index of the row in the embedded matrix.
+ * @param old_row Row of the previous matrix, or NULL if row >= old_rows.
+ * @param old_rows Number of rows of the previous matrix.
+ * @param old_cols Number of columns of the previous matrix.
+ * @param blocks New blocks of the step.
+ */
+void embedded_cff_row(uint64_t* out, long row, const uint64_t* old_row, long old_rows, long old_cols, const generated_cffs* blocks) {
+    if (old_row != NULL) {
+        long old_words = WORDS_FOR_BITS(old_cols);
+        memcpy(out, old_row, old_words * sizeof(uint64_t));
+        if (BIT_OFFSET(old_cols)) out[old_words - 1] &= (1ULL << BIT_OFFSET(old_cols)) - 1;
+    }
+
+    if (row < blocks->rows_old_new) {
+        or_shifted_row(out, old_cols, blocks->cff_old_new[row], blocks->cols_old_new);
+    }
+
+    long new_row = row - old_rows;
+    if (new_row >= 0 && new_row < blocks->rows_new_old) {
+        or_shifted_row(out, 0, blocks->cff_new_old[new_row], blocks->cols_new_old);
+    }
+    if (new_row >= 0 && new_row < blocks->rows_new) {
+        or_shifted_row(out, blocks->cols_new_old, blocks->cff_new[new_row], blocks->cols_new);
+    }
+}
+
+/**
+ * @brief Embeds a CFF read from a stream, writing rows as they are produced.
+ * 
+ * The new blocks are generated first; then every row of the previous CFF
+ * is read, combined with its blocks and handed to a streaming writer, so
+ * memory holds the new blocks and one buffer of rows instead of two whole
+ * matrices. Text output, and binary output from a binary input (whose
+ * header gives the number of rows), are streamed; other combinations read
+ * the whole input first. With tile_rows, the new blocks are not generated
+ * up front either: the rows of each tile are generated when the tile is
+ * reached and freed after it is written, so memory holds the evaluation
+ * tables of the step and one tile of rows. A shard is generated the same
+ * way, over its range of rows only: the input rows before the range are
+ * skipped and the rows are written to the shard file of filename.
+ * 
+ * @param construction Construction type ('p' or 'm').
+ * @param block_size Define the size of CFF rows.
+ * @param input Stream with the previous CFF in text or binary format.
+ * @param d CFF parameter d.
+ * @param Fq New CFF parameter Fq.
+ * @param k New CFF parameter k.
+ * @param format Output file format ('b' binary, 't' text, 'c' CSC, 'e' Elias-Fano, 'm' Matrix Market or 's' CSR).
+ * @param filename Output file path.
+ * @param labels 1 to also write the row/column label side file.
+ * @param tile_rows Rows per tile for out-of-core embedding, or 0 to generate the whole blocks first.
+ * @param shard Index of the shard to generate, from 0 to num_shards - 1.
+ * @param num_shards Number of shards the rows are split into, or 0 to generate the whole matrix.
+ */
+static void embed_cff_stream(char construction, char block_size, FILE* input, int d, long Fq, long k, char format, const char* filename, int labels, long tile_rows, int shard, int num_shards) {
+    cff_write_job job = {0};
+    snprintf(job.filename, sizeof(job.filename), "%s", filename);
+    if (num_shards > 0 && !shard_filename(job.filename, sizeof(job.filename), filename, shard, num_shards)) return;
+
+    struct cff_parameters* params = NULL;
+    struct cff_row_reader* reader = open_cff_row_reader(input, &params);
+    if (reader == NULL || params == NULL) {
+        printf("Error reading parameters from the input stream.\n");
+        close_cff_row_reader(reader);
+        if (params) { free(params->Fqs); free(params->ks); free(params); }
+        return;
+    }
+
+    int num_steps = params->fqs_count + 1;
+    long* Fq_steps = (long*) malloc(num_steps * sizeof(long));
+    long* k_steps = (long*) malloc(num_steps * sizeof(long));
+    if (Fq_steps == NULL || k_steps == NULL) exit(EXIT_FAILURE);
+    for (int i = 0; i < params->fqs_count; i++) {
+        Fq_steps[i] = params->Fqs[i];
+        k_steps[i] = (i < params->ks_count) ? params->ks[i] : k;
+    }
+    Fq_steps[num_steps - 1] = Fq;
+    k_steps[num_steps - 1] = k;
     free(params->Fqs);
     free(params->ks);
     free(params);
+
+    long old_rows = reader->rows, old_cols = reader->cols;
+    generated_cffs new_blocks = {0};
+    cff_block_tiles tiles;
+    const generated_cffs* blocks = &new_blocks;
+    int tiled = (tile_rows > 0 || num_shards > 0);
+    if (tiled) {
+        if (num_shards > 0 && old_rows < 0) {
+            printf("Error: Sharded embedding needs a binary input, whose header gives the number of rows.\n");
+            tiled = 0;
+        } else if (format != 't' && !(format == 'b' && old_rows >= 0)) {
+            printf("Error: Out-of-core embedding writes text, or binary from a binary input.\n");
+            tiled = 0;
+        } else if (!open_block_tiles(&tiles, construction, block_size, d, Fq_steps, k_steps, num_steps)) {
+            tiled = 0;
+        } else {
+            blocks = &tiles.blocks;
+        }
+        if (!tiled) {
+            close_cff_row_reader(reader);
+            free(Fq_steps);
+            free(k_steps);
+            return;
+        }
+    } else {
+        new_blocks = generate_new_cff_blocks(construction, block_size, d, Fq_steps, k_steps, num_steps, NULL);
+    }
+
+    long new_total_rows = 0, new_total_cols = 0;
+    uint64_t* old_row = (uint64_t*) calloc(WORDS_FOR_BITS(old_cols) + 1, sizeof(uint64_t));
+    if (old_row == NULL) exit(EXIT_FAILURE);
+
+    job.format = format;
+    job.construction = construction;
+    job.d = d;
+    job.Fq_steps = Fq_steps;
+    job.k_steps = k_steps;
+    job.num_steps = num_steps;
+
+    if (format == 't' || (format == 'b' && old_rows >= 0)) {
+        long expected_rows = (old_rows >= 0) ? old_rows : blocks->rows_old_new;
+        embedded_cff_size(expected_rows, old_cols, blocks, &new_total_rows, &new_total_cols);
+        long words_per_row = WORDS_FOR_BITS(new_total_cols);
+
+        long first_row = 0, end_row = -1;
+        struct cff_stream_writer* stream;
+        if (num_shards > 0) {
+            shard_row_range(new_total_rows, shard, num_shards, &first_row, &end_row);
+            stream = open_cff_shard_stream(job.filename, format, construction, d, Fq_steps, num_steps, k_steps, num_steps, new_total_rows, new_total_cols, shard, num_shards, first_row, end_row - first_row);
+            skip_cff_rows(reader, (first_row < old_rows) ? first_row : old_rows);
+            if (tile_rows <= 0) tile_rows = (end_row > first_row) ? end_row - first_row : 1;
+        } else {
+            stream = open_cff_stream(job.filename, format, construction, d, Fq_steps, num_steps, k_steps, num_steps, new_total_rows, new_total_cols);
+        }
+        if (stream != NULL) {
+            long batch_rows = stream->slot_rows;
+            uint64_t** batch = (uint64_t**) malloc(batch_rows * sizeof(uint64_t*));
+            if (batch == NULL) exit(EXIT_FAILURE);
+            for (long i = 0; i < batch_rows; i++) {
+                batch[i] = (uint64_t*) malloc((words_per_row + 1) * sizeof(uint64_t));
+                if (batch[i] == NULL) exit(EXIT_FAILURE);
+            }
+
+            long filled = 0, tile_end = first_row;
+            int written = 1;
+            for (long i = first_row; end_row < 0 || i < end_row; i++) {
+                int have_old = 0;
+                if (old_rows < 0 || i < old_rows) {
+                    memset(old_row, 0, WORDS_FOR_BITS(old_cols) * sizeof(uint64_t));
+                    have_old = read_cff_row(reader, old_row);
+                    if (!have_old) {
+                        // The new rows of the current tile were unknown until now: reload it.
+                        old_rows = i;
+                        tile_end = i;
+                    }
+                }
+                if (old_rows >= 0 && i >= old_rows + blocks->rows_new_old) break;
+                if (tiled && i == tile_end) {
+                    load_block_tiles(&tiles, i, tile_rows, old_rows);
+                    tile_end = i + tile_rows;
+                }
+
+                memset(batch[filled], 0, words_per_row * sizeof(uint64_t));
+                embedded_cff_row(batch[filled], i, have_old ? old_row : NULL, (old_rows < 0) ? i + 1 : old_rows, old_cols, blocks);
+                if (++filled == batch_rows) {
+                    filled = 0;
+                    if (!write_cff_stream_rows(stream, batch, batch_rows)) {
+                        written = 0;
+                        break;
+                    }
+                }
+            }
+            if (written) write_cff_stream_rows(stream, batch, filled);
+            new_total_rows = old_rows + blocks->rows_new_old;
+
+            free_matrix(batch, batch_rows);
+            if (close_cff_stream(stream)) {
+                if (num_shards > 0) {
+                    printf("Shard %d/%d (rows %ld to %ld of the %ldx%ld embedded CFF) written to '%s'.\n", shard, num_shards, first_row, end_row - 1, new_total_rows, new_total_cols, job.filename);
+                } else {
+                    printf("Embedded CFF matrix of %ldx%ld streamed to '%s'.\n", new_total_rows, new_total_cols, job.filename);
+                }
+            }
+        }
+    } else {
+        long capacity = 1024;
+        uint64_t** cff_old_old = (uint64_t**) malloc(capacity * sizeof(uint64_t*));
+        if (cff_old_old == NULL) exit(EXIT_FAILURE);
+        for (old_rows = 0; read_cff_row(reader, old_row); old_rows++) {
+            if (old_rows == capacity) {
+                capacity *= 2;
+                cff_old_old = (uint64_t**) realloc(cff_old_old, capacity * sizeof(uint64_t*));
+                if (cff_old_old == NULL) exit(EXIT_FAILURE);
+            }
+            cff_old_old[old_rows] = old_row;
+            old_row = (uint64_t*) calloc(WORDS_FOR_BITS(old_cols) + 1, sizeof(uint64_t));
+            if (old_row == NULL) exit(EXIT_FAILURE);
+        }
+
+        embedded_cff_size(old_rows, old_cols, &new_blocks, &new_total_rows, &new_total_cols);
+        uint64_t** final_cff = alloc_contiguous_matrix(new_total_rows, new_total_cols);
+        place_cff_blocks(final_cff, cff_old_old, old_rows, old_cols, &new_blocks);
+
+        job.matrix = final_cff;
+        job.rows = new_total_rows;
+        job.cols = new_total_cols;
+        write_cff_job(&job);
+
+        free_matrix(cff_old_old, old_rows);
+        free_contiguous_matrix(final_cff);
+    }
+    if (labels && shard == 0 && old_rows >= 0) write_step_labels(filename, construction, block_size, d, Fq_steps, k_steps, num_steps, old_rows, old_cols);
+
+    free(old_row);
+    if (tiled) close_block_tiles(&tiles);
+    else free_generated_cffs(&new_blocks);
+    close_cff_row_reader(reader);
+    free(Fq_steps);
+    free(k_steps);
 }
 
 /**
@@ -274,260 +1085,1271 @@ void embed_cff(char construction, char block_size, const char *cff_file, int d,
  * @param Fq_steps Array with finite field sizes.
  * @param k_steps Array with maximum polynomial degrees.
  * @param num_steps Number of steps.
+ * @param sink Receiver of the rows of the new_new block as they are generated, or NULL.
  * @return Structure containing the three generated blocks.
  */
-generated_cffs generate_new_cff_blocks(char construction, char block_size, int d, long* Fq_steps, long* k_steps, int num_steps) {
+generated_cffs generate_new_cff_blocks(char construction, char block_size, int d, long* Fq_steps, long* k_steps, int num_steps, const cff_row_sink* sink) {
     generated_cffs result = {0};
-    
-    long q_final = Fq_steps[num_steps - 1];  
-    long p, n;
-    
-    if (!decompose_prime_power(q_final, &p, &n)) {
-        fprintf(stderr, "Error: %ld is not a prime power!\n", q_final);
+
+    cff_step step;
+    if (!prepare_cff_step(&step, construction, block_size, d, Fq_steps, k_steps, num_steps)) {
         return result;
     }
 
-    fmpz_t pz;
-    fmpz_init(pz);
-    fmpz_set_ui(pz, (ulong)p);
+    long q_final = Fq_steps[num_steps - 1];
+    fq_nmod_ctx_struct* ctx = step.ctx;
+    subfield_partition* partitions = step.partitions;
+    polynomial_partition poly_part = step.poly_part;
+    combination_partitions combos = step.combos;
+    long num_new_rows = step.num_new_rows;
 
-    fq_nmod_ctx_t ctx;
-    fq_nmod_ctx_init_ui(ctx, (ulong)p, (slong)n, "a");
-    
-    subfield_partition* partitions = partition_by_subfields(Fq_steps, num_steps, ctx);
+    subfield_partition all_partition = partitions[num_steps - 1];
+    fq_nmod_t* points_for_eval = all_partition.all_elements;
+    long num_points = all_partition.count_all;
 
-    polynomial_partition poly_part = partition_polynomials(partitions, k_steps, num_steps, ctx);
+    /*
+     * Task graph: the two index builds are independent, cff_old_new and
+     * cff_new only need the new index and cff_new_old only the old one.
+     * The loops inside each phase are taskloops, so every phase shares
+     * the same team instead of opening its own fork/join.
+     */
+    evaluation_table table_old = {0}, table_new = {0};
+    inverted_index inverted_index_old = {0}, inverted_index_new = {0};
+    int use_table = (q_final <= EVAL_TABLE_MAX_Q);
 
-    long num_new_rows = 0;
-    int dk_size = 0;
-    if(construction == 'p'){
-        if (num_steps == 1) {
-            if(d < ((Fq_steps[0]-1)/k_steps[0])){
-                num_new_rows = (d*k_steps[0]+1)*Fq_steps[0];
-                dk_size = (d*k_steps[0])+1;
-            } else {
-                if(block_size == 'f'){
-                    num_new_rows = (Fq_steps[0] * Fq_steps[0]);
-                    dk_size = Fq_steps[0];
-                } else {
-                    num_new_rows = (d*k_steps[0]+1)*Fq_steps[0];
-                    dk_size = (d*k_steps[0])+1;
-                }
-            }
-        } else {
-            if(Fq_steps[num_steps-1] != Fq_steps[num_steps-2]){
+    #pragma omp parallel
+    #pragma omp single
+    {
+        if (use_table) {
+            #pragma omp task depend(out: table_old)
+            table_old = create_evaluation_table(num_points, poly_part.num_old_polys, points_for_eval, poly_part.old_polys, ctx);
+
+            #pragma omp task depend(out: table_new)
+            table_new = create_evaluation_table(num_points, poly_part.num_new_polys, points_for_eval, poly_part.new_polys, ctx);
+
+            #pragma omp task depend(in: table_new)
+            result.cff_old_new = generate_single_cff_from_table(&result.rows_old_new, combos.combos_old, combos.count_old, &table_new, ctx, NULL, NULL);
+
+            #pragma omp task depend(in: table_old)
+            result.cff_new_old = generate_single_cff_from_table(&result.rows_new_old, combos.combos_new, num_new_rows, &table_old, ctx, NULL, NULL);
+
+            #pragma omp task depend(in: table_new)
+            result.cff_new = generate_single_cff_from_table(&result.rows_new, combos.combos_new, num_new_rows, &table_new, ctx, sink, NULL);
+        } else {
+            #pragma omp task depend(out: inverted_index_old)
+            inverted_index_old = create_inverted_evaluation_index(num_points, poly_part.num_old_polys, points_for_eval, poly_part.old_polys, ctx);
+
+            #pragma omp task depend(out: inverted_index_new)
+            inverted_index_new = create_inverted_evaluation_index(num_points, poly_part.num_new_polys, points_for_eval, poly_part.new_polys, ctx);
+
+            #pragma omp task depend(in: inverted_index_new)
+            result.cff_old_new = generate_single_cff(&result.rows_old_new, combos.combos_old, combos.count_old, &inverted_index_new, ctx, NULL, NULL);
+
+            #pragma omp task depend(in: inverted_index_old)
+            result.cff_new_old = generate_single_cff(&result.rows_new_old, combos.combos_new, num_new_rows, &inverted_index_old, ctx, NULL, NULL);
+
+            #pragma omp task depend(in: inverted_index_new)
+            result.cff_new = generate_single_cff(&result.rows_new, combos.combos_new, num_new_rows, &inverted_index_new, ctx, sink, NULL);
+        }
+    }
+
+    result.cols_old_new = poly_part.num_new_polys;
+    result.cols_new_old = poly_part.num_old_polys;
+    result.cols_new = poly_part.num_new_polys;
+
+    free_evaluation_table(&table_old);
+    free_evaluation_table(&table_new);
+    free_inverted_index(&inverted_index_old);
+    free_inverted_index(&inverted_index_new);
+
+    free_cff_step(&step);
+
+    return result;
+}
+
+/**
+ * @brief Builds the field, points, polynomials and pairs of an embedding step.
+ * 
+ * Computes the number of new rows of the step from the construction and
+ * block size, and the old/new partitions of polynomials and (x, y) pairs
+ * that define its blocks.
+ * 
+ * @param step Pointer to the structure to be filled (freed with free_cff_step).
+ * @param construction Construction type ('p' or 'm').
+ * @param block_size Define the size of CFF rows.
+ * @param d CFF parameter d (used for monotone construction).
+ * @param Fq_steps Array with finite field sizes.
+ * @param k_steps Array with maximum polynomial degrees.
+ * @param num_steps Number of steps.
+ * @return 1 on success, 0 if the last field size is not a prime power.
+ */
+int prepare_cff_step(cff_step* step, char construction, char block_size, int d, const long* Fq_steps, const long* k_steps, int num_steps) {
+    long q_final = Fq_steps[num_steps - 1];  
+    long p, n;
+    
+    if (!decompose_prime_power(q_final, &p, &n)) {
+        fprintf(stderr, "Error: %ld is not a prime power!\n", q_final);
+        return 0;
+    }
+
+    fq_nmod_ctx_init_ui(step->ctx, (ulong)p, (slong)n, "a");
+    fq_nmod_ctx_struct* ctx = step->ctx;
+    
+    subfield_partition* partitions = partition_by_subfields(Fq_steps, num_steps, ctx);
+
+    polynomial_partition poly_part = partition_polynomials(partitions, k_steps, num_steps, ctx);
+
+    long dk_size = 0;
+    long num_new_rows = cff_step_new_rows(construction, block_size, d, Fq_steps, k_steps, num_steps, &dk_size);
+
+    combination_partitions combos = generate_combinations(construction, dk_size, partitions, num_steps, ctx);
+
+    step->p = (ulong)p;
+    step->num_steps = num_steps;
+    step->partitions = partitions;
+    step->poly_part = poly_part;
+    step->combos = combos;
+    step->num_new_rows = num_new_rows;
+    return 1;
+}
+
+/**
+ * @brief Computes the number of new rows of an embedding step.
+ * 
+ * Depends only on the construction, block size, d and the field sizes and
+ * degrees of the steps, so memory and time estimates use it without
+ * building the step.
+ * 
+ * @param construction Construction type ('p' or 'm').
+ * @param block_size Define the size of CFF rows.
+ * @param d CFF parameter d.
+ * @param Fq_steps Array with finite field sizes.
+ * @param k_steps Array with maximum polynomial degrees.
+ * @param num_steps Number of steps.
+ * @param dk_size Pointer to store the size of the dk block.
+ * @return Number of new rows.
+ */
+long cff_step_new_rows(char construction, char block_size, int d, const long* Fq_steps, const long* k_steps, int num_steps, long* dk_size) {
+    long num_new_rows = 0;
+    *dk_size = 0;
+    if(construction == 'p'){
+        if (num_steps == 1) {
+            if(d < ((Fq_steps[0]-1)/k_steps[0])){
+                *dk_size = checked_add(checked_mul(d, k_steps[0]), 1);
+                num_new_rows = checked_mul(*dk_size, Fq_steps[0]);
+            } else {
+                if(block_size == 'f'){
+                    num_new_rows = checked_mul(Fq_steps[0], Fq_steps[0]);
+                    *dk_size = Fq_steps[0];
+                } else {
+                    *dk_size = checked_add(checked_mul(d, k_steps[0]), 1);
+                    num_new_rows = checked_mul(*dk_size, Fq_steps[0]);
+                }
+            }
+        } else {
+            if(Fq_steps[num_steps-1] != Fq_steps[num_steps-2]){
+                long old_square = checked_mul(Fq_steps[num_steps-2], Fq_steps[num_steps-2]);
                 if(d < ((Fq_steps[num_steps-1]-1)/k_steps[num_steps-1])){
-                    num_new_rows = ((d*k_steps[num_steps-1]+1)*Fq_steps[num_steps-1]) - (Fq_steps[num_steps-2] * Fq_steps[num_steps-2]);
-                    dk_size = d*k_steps[num_steps-1]+1;
+                    *dk_size = checked_add(checked_mul(d, k_steps[num_steps-1]), 1);
+                    num_new_rows = checked_mul(*dk_size, Fq_steps[num_steps-1]) - old_square;
                 } else {
                     if(block_size == 'f'){
-                        num_new_rows = (Fq_steps[num_steps-1] * Fq_steps[num_steps-1]) - (Fq_steps[num_steps-2] * Fq_steps[num_steps-2]);
-                        dk_size = Fq_steps[num_steps-1];
+                        num_new_rows = checked_mul(Fq_steps[num_steps-1], Fq_steps[num_steps-1]) - old_square;
+                        *dk_size = Fq_steps[num_steps-1];
                     } else {
-                        num_new_rows = ((d*k_steps[num_steps-1]+1)*Fq_steps[num_steps-1]) - (Fq_steps[num_steps-2] * Fq_steps[num_steps-2]);
-                        dk_size = d*k_steps[num_steps-1]+1;
-                        printf("%ld, %d\n", num_new_rows, dk_size);
+                        *dk_size = checked_add(checked_mul(d, k_steps[num_steps-1]), 1);
+                        num_new_rows = checked_mul(*dk_size, Fq_steps[num_steps-1]) - old_square;
                     }
                 }
             } 
         }
     } else if (construction == 'm') {
-        num_new_rows = (d*k_steps[0]+1)*Fq_steps[num_steps-1] - (d*k_steps[num_steps-2]+1)*Fq_steps[num_steps-2];
-        dk_size = d*k_steps[0]+1;
-    }; 
+        *dk_size = checked_add(checked_mul(d, k_steps[0]), 1);
+        num_new_rows = checked_mul(*dk_size, Fq_steps[num_steps-1]) - checked_mul(checked_add(checked_mul(d, k_steps[num_steps-2]), 1), Fq_steps[num_steps-2]);
+    }
+    return num_new_rows;
+}
 
-    combination_partitions combos = generate_combinations(construction, dk_size, partitions, num_steps, ctx);
+/**
+ * @brief Frees the memory of an embedding step.
+ * 
+ * @param step Pointer to the step to be freed.
+ */
+void free_cff_step(cff_step* step) {
+    if (!step) return;
+    free_combination_partitions(&step->combos, step->ctx);
+    free_polynomial_partition(&step->poly_part, step->ctx);
+    free_subfield_partitions(step->partitions, step->num_steps, step->ctx);
+    fq_nmod_ctx_clear(step->ctx);
+}
+
+/*
+ *  OUTPUT HELPER FUNCTIONS
+ */
+
+/**
+ * @brief Builds the output file name of an initial CFF.
+ * 
+ * @param filename Buffer to store the file name.
+ * @param size Size of the buffer.
+ * @param block_size Define the size of CFF rows.
+ * @param d CFF parameter d.
+ * @param fq Finite field size.
+ * @param k Maximum polynomial degree.
+ * @param format Output file format ('b' binary, 't' text, 'c' CSC, 'e' Elias-Fano, 'm' Matrix Market, 's' CSR, 'r' recipe, 'a' archive).
+ */
+void initial_cff_filename(char* filename, size_t size, char block_size, int d, long fq, long k, char format) {
+    long t0, n0;
+    
+    if(block_size == 'f'){
+        t0 = checked_mul(fq, fq);
+    } else {
+        t0 = checked_mul(checked_add(checked_mul(d, k), 1), fq);
+    }
+    n0 = checked_pow(fq, k + 1);
+    
+    snprintf(filename, size, "CFFs/%d-CFF(%ld,%ld).%s", d, t0, n0, format_extension(format));
+}
+
+/**
+ * @brief Builds the output file name of an embedded CFF.
+ * 
+ * @param filename Buffer to store the file name.
+ * @param size Size of the buffer.
+ * @param construction Construction type ('p' or 'm').
+ * @param block_size Define the size of CFF rows.
+ * @param d CFF parameter d.
+ * @param Fq New CFF parameter Fq.
+ * @param k New CFF parameter k.
+ * @param format Output file format ('b' binary, 't' text, 'c' CSC, 'e' Elias-Fano, 'm' Matrix Market, 's' CSR, 'r' recipe, 'a' archive).
+ */
+void embedded_cff_filename(char* filename, size_t size, char construction, char block_size, int d, long Fq, long k, char format) {
+    long t1 = 0, n1 = 0;
+    
+    if (construction == 'm') {
+        t1 = checked_mul(checked_add(checked_mul(d, k), 1), Fq);
+        n1 = checked_pow(Fq, k + 1);
+    } else {
+        if(d < ((Fq-1)/k)){
+            t1 = checked_mul(checked_add(checked_mul(d, k), 1), Fq);
+        } else {
+            if(block_size == 'f'){
+                t1 = checked_mul(Fq, Fq);
+            } else {
+                t1 = checked_mul(checked_add(checked_mul(d, k), 1), Fq);
+            }
+        }
+        n1 = checked_pow(Fq, k + 1);
+    }
+    
+    snprintf(filename, size, "CFFs/%d-CFF(%ld,%ld).%s", d, t1, n1, format_extension(format));
+}
+
+/**
+ * @brief Writes a CFF matrix described by a job in the job's file format.
+ * 
+ * Also used as a thread entry point by chain_cff. Sets the job's ok field
+ * to the result of the write.
+ * 
+ * @param arg Pointer to the cff_write_job.
+ * @return Always NULL.
+ */
+static void* write_cff_job(void* arg) {
+    cff_write_job* job = (cff_write_job*) arg;
+    unbind_cff_thread();
+    if (job->format == 't') {
+        job->ok = write_cff_to_file(job->filename, job->construction, job->d, job->Fq_steps, job->num_steps, job->k_steps, job->num_steps, job->matrix, job->rows, job->cols);
+    } else if (job->format == 'c') {
+        job->ok = write_cff_to_csc_file(job->filename, job->construction, job->d, job->Fq_steps, job->num_steps, job->k_steps, job->num_steps, job->matrix, job->rows, job->cols);
+    } else if (job->format == 'e') {
+        job->ok = write_cff_to_ef_file(job->filename, job->construction, job->d, job->Fq_steps, job->num_steps, job->k_steps, job->num_steps, job->matrix, job->rows, job->cols);
+    } else if (job->format == 'm') {
+        job->ok = write_cff_to_mtx_file(job->filename, job->construction, job->d, job->Fq_steps, job->num_steps, job->k_steps, job->num_steps, job->matrix, job->rows, job->cols);
+    } else if (job->format == 's') {
+        job->ok = write_cff_to_csr_file(job->filename, job->construction, job->d, job->Fq_steps, job->num_steps, job->k_steps, job->num_steps, job->matrix, job->rows, job->cols);
+    } else {
+        job->ok = write_cff_to_binary_file(job->filename, job->construction, job->d, job->Fq_steps, job->num_steps, job->k_steps, job->num_steps, job->matrix, job->rows, job->cols);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Row sink that streams a generated block to the file of a job.
+ * 
+ * Opens the job's streaming writer with the first batch, once the size of
+ * the block is known, and appends every batch to it. After a failed write
+ * the writer is closed, which reports the error, and later batches are
+ * dropped.
+ * 
+ * @param arg Pointer to the cff_write_job.
+ * @param matrix Block being generated.
+ * @param first First finished row.
+ * @param count Number of finished rows.
+ * @param rows Number of rows of the block.
+ * @param cols Number of columns of the block.
+ */
+static void stream_job_rows(void* arg, uint64_t** matrix, long first, long count, long rows, long cols) {
+    cff_write_job* job = (cff_write_job*) arg;
+    if (first == 0) {
+        job->rows = rows;
+        job->cols = cols;
+        job->stream = open_cff_stream(job->filename, job->format, job->construction, job->d, job->Fq_steps, job->num_steps, job->k_steps, job->num_steps, rows, cols);
+    }
+    if (job->stream != NULL && !write_cff_stream_rows(job->stream, matrix + first, count)) {
+        close_cff_stream(job->stream);
+        job->stream = NULL;
+    }
+}
+
+/**
+ * @brief Returns the file extension of an output format.
+ * 
+ * @param format Output file format ('b' binary, 't' text, 'c' CSC, 'e' Elias-Fano, 'm' Matrix Market, 's' CSR, 'r' recipe, 'a' archive).
+ * @return Extension without the dot.
+ */
+static const char* format_extension(char format) {
+    if (format == 't') return "txt";
+    if (format == 'c') return "csc";
+    if (format == 'e') return "cef";
+    if (format == 'm') return "mtx";
+    if (format == 's') return "csr";
+    if (format == 'r') return "rcp";
+    if (format == 'a') return "cfa";
+    return "cff";
+}
+
+/**
+ * @brief Writes the row/column label side file of a step next to its matrix file.
+ * 
+ * The side file takes the name of the matrix file with the extension
+ * replaced by "lbl". The pairs and polynomials of the step are prepared
+ * again, which takes time proportional to the number of rows and columns,
+ * not to the size of the matrix.
+ * 
+ * @param matrix_filename Path of the matrix file of the step.
+ * @param construction Construction type of the step ('p' or 'm').
+ * @param block_size Block size of the step.
+ * @param d CFF parameter d.
+ * @param Fq_steps Array with finite field sizes, including the step.
+ * @param k_steps Array with maximum polynomial degrees, including the step.
+ * @param num_steps Number of steps.
+ * @param old_rows Number of rows before the step.
+ * @param old_cols Number of columns before the step.
+ */
+static void write_step_labels(const char* matrix_filename, char construction, char block_size, int d, long* Fq_steps, long* k_steps, int num_steps, long old_rows, long old_cols) {
+    char filename[CFF_PATH_MAX + 8];
+    snprintf(filename, sizeof(filename), "%s", matrix_filename);
+    char* dot = strrchr(filename, '.');
+    if (dot != NULL && strchr(dot, '/') == NULL) *dot = '\0';
+    strcat(filename, ".lbl");
+
+    cff_step step;
+    if (!prepare_cff_step(&step, construction, block_size, d, Fq_steps, k_steps, num_steps)) return;
+    if (write_cff_labels(filename, &step, old_rows, old_cols)) {
+        printf("Row and column labels written to '%s'.\n", filename);
+    }
+    free_cff_step(&step);
+}
+
+/*
+ *  CFF MATRIX GENERATION FUNCTION
+ */
+
+/**
+ * @brief Generates a CFF matrix (bitmap) from combinations and evaluations.
+ * 
+ * Creates a binary matrix where each row corresponds to a pair (x, y) and
+ * each column corresponds to a polynomial. Bit (i, j) is 1 if polynomial j
+ * evaluates to y at point x of pair i.
+ * 
+ * Rows are processed in groups sharing the same x (one outer lookup per
+ * group) and the columns are split into tiles, so each work unit only
+ * touches a slice of the output words and postings of its group. The work
+ * units are taskloop tasks of the calling team (see generate_new_cff_blocks).
+ * Rows share one zeroed allocation (alloc_contiguous_matrix, so huge pages
+ * apply) that is not touched up front: the pages of a slice are first
+ * touched (and placed on the NUMA node of) the thread that fills them.
+ * With a sink, the groups are processed in CFF_STREAM_BATCHES consecutive
+ * batches and each finished batch of rows is emitted before the next one.
+ * With a target, no rows are allocated: the bits are ORed into the target
+ * rows at its column offset.
+ * 
+ * @param num_rows Pointer to store the number of rows.
+ * @param combos Array of element pairs.
+ * @param num_combos Number of pairs.
+ * @param index Inverted evaluation index of the polynomials (columns).
+ * @param ctx Finite field context.
+ * @param sink Receiver of the rows as they are generated, or NULL.
+ * @param target Destination to OR the rows into, or NULL to allocate them.
+ * @return CFF matrix (freed with free_contiguous_matrix), or NULL when written to target.
+ */
+uint64_t** generate_single_cff(long* num_rows, const element_pair* combos, long num_combos, const inverted_index* index, const fq_nmod_ctx_t ctx, const cff_row_sink* sink, const cff_block_target* target) {
+    *num_rows = num_combos;
+    if (num_combos == 0) return NULL;
+
+    long words_per_row = WORDS_FOR_BITS(index->num_polys);
+    ulong p = fq_nmod_ctx_prime(ctx);
+
+    uint64_t** cff_matrix = (target == NULL) ? alloc_contiguous_matrix(num_combos, index->num_polys) : NULL;
+    long* row_begin = (long*) malloc(num_combos * sizeof(long));
+    long* row_end = (long*) malloc(num_combos * sizeof(long));
+    if (row_begin == NULL || row_end == NULL) exit(EXIT_FAILURE);
+
+    long num_groups = 0, max_group_rows = 0;
+    long* group_start = group_rows_by_x(combos, num_combos, &num_groups, &max_group_rows);
+
+    #pragma omp taskloop num_tasks(task_count(num_groups))
+    for (long g = 0; g < num_groups; g++) {
+        long slot = index->point_slots[element_index(combos[group_start[g]].x, p)];
+
+        for (long i = group_start[g]; i < group_start[g + 1]; i++) {
+            if (slot < 0) {
+                row_begin[i] = row_end[i] = 0;
+            } else {
+                const long* offsets = index->offsets + slot * (index->num_values + 1);
+                long y = element_index(combos[i].y, p);
+                row_begin[i] = offsets[y];
+                row_end[i] = offsets[y + 1];
+            }
+        }
+    }
+
+    long tile_words = tile_words_for_rows(max_group_rows, words_per_row);
+    long num_tiles = (words_per_row + tile_words - 1) / tile_words;
+
+    long batch_groups = (sink == NULL) ? num_groups : (num_groups + CFF_STREAM_BATCHES - 1) / CFF_STREAM_BATCHES;
+
+    for (long g_begin = 0; g_begin < num_groups; g_begin += batch_groups) {
+        long g_end = (g_begin + batch_groups < num_groups) ? g_begin + batch_groups : num_groups;
+
+        #pragma omp taskloop num_tasks(task_count((g_end - g_begin) * num_tiles))
+        for (long unit = g_begin * num_tiles; unit < g_end * num_tiles; unit++) {
+            long g = unit / num_tiles;
+            long word_begin = (unit % num_tiles) * tile_words;
+            long word_end = (word_begin + tile_words < words_per_row) ? word_begin + tile_words : words_per_row;
+            long col_begin = word_begin * BITS_PER_WORD;
+            long col_end = word_end * BITS_PER_WORD;
+
+            if (target != NULL) {
+                // Only the words holding the first and last column of the tile can be shared
+                long last_col = (col_end < index->num_polys) ? col_end : index->num_polys;
+                long first_word = WORD_OFFSET(target->col_offset + col_begin);
+                long last_word = WORD_OFFSET(target->col_offset + last_col - 1);
+
+                for (long i = group_start[g]; i < group_start[g + 1]; i++) {
+                    long count = row_end[i] - row_begin[i];
+                    uint64_t* row = target->rows[i];
+                    const uint32_t* postings32 = (index->postings32 != NULL) ? index->postings32 + row_begin[i] : NULL;
+                    const long* postings = (index->postings32 == NULL) ? index->postings + row_begin[i] : NULL;
+                    long k = (postings32 != NULL) ? first_posting32_from(postings32, count, col_begin) : first_posting_from(postings, count, col_begin);
+                    for (; k < count; k++) {
+                        long col = (postings32 != NULL) ? (long) postings32[k] : postings[k];
+                        if (col >= col_end) break;
+                        long bit = target->col_offset + col;
+                        long w = WORD_OFFSET(bit);
+                        or_target_word(row + w, 1ULL << BIT_OFFSET(bit), w == first_word || w == last_word);
+                    }
+                }
+                continue;
+            }
+
+            for (long i = group_start[g]; i < group_start[g + 1]; i++) {
+                long count = row_end[i] - row_begin[i];
+
+                if (index->postings32 != NULL) {
+                    const uint32_t* postings = index->postings32 + row_begin[i];
+                    for (long k = first_posting32_from(postings, count, col_begin); k < count && postings[k] < col_end; k++) {
+                        SET_BIT(cff_matrix[i], postings[k]);
+                    }
+                } else {
+                    const long* postings = index->postings + row_begin[i];
+                    for (long k = first_posting_from(postings, count, col_begin); k < count && postings[k] < col_end; k++) {
+                        SET_BIT(cff_matrix[i], postings[k]);
+                    }
+                }
+            }
+        }
+
+        if (sink != NULL) {
+            sink->emit(sink->arg, cff_matrix, group_start[g_begin], group_start[g_end] - group_start[g_begin], num_combos, index->num_polys);
+        }
+    }
+
+    free(group_start);
+    free(row_begin);
+    free(row_end);
+    return cff_matrix;
+}
+
+/**
+ * @brief Generates a CFF matrix (bitmap) from a byte evaluation table.
+ * 
+ * Row x of the table (E_x) is built once and shared by every pair (x, y),
+ * so each output word is the equality mask of 64 table bytes against y
+ * instead of a scatter of individual bits. Work is split in (x group,
+ * column tile) units so a tile of E_x stays in cache for all its rows.
+ * Every word is written by its unit, so rows are not zeroed up front.
+ * Runs as taskloops of the calling team, in batches of rows when a sink
+ * is given, and straight into the rows of a target when one is given
+ * (see generate_single_cff).
+ * 
+ * @param num_rows Pointer to store the number of rows.
+ * @param combos Array of element pairs.
+ * @param num_combos Number of pairs.
+ * @param table Evaluation table of the polynomials (columns).
+ * @param ctx Finite field context.
+ * @param sink Receiver of the rows as they are generated, or NULL.
+ * @param target Destination to OR the rows into, or NULL to allocate them.
+ * @return CFF matrix (freed with free_contiguous_matrix), or NULL when written to target.
+ */
+uint64_t** generate_single_cff_from_table(long* num_rows, const element_pair* combos, long num_combos, const evaluation_table* table, const fq_nmod_ctx_t ctx, const cff_row_sink* sink, const cff_block_target* target) {
+    *num_rows = num_combos;
+    if (num_combos == 0) return NULL;
+
+    long words_per_row = WORDS_FOR_BITS(table->num_polys);
+    uint64_t tail_mask = (BIT_OFFSET(table->num_polys) == 0) ? ~0ULL : ((1ULL << BIT_OFFSET(table->num_polys)) - 1);
+    ulong p = fq_nmod_ctx_prime(ctx);
+
+    uint64_t** cff_matrix = (target == NULL) ? alloc_contiguous_matrix(num_combos, table->num_polys) : NULL;
+    uint8_t* row_values = (uint8_t*) malloc(num_combos * sizeof(uint8_t));
+    if (row_values == NULL) exit(EXIT_FAILURE);
+
+    long num_groups = 0, max_group_rows = 0;
+    long* group_start = group_rows_by_x(combos, num_combos, &num_groups, &max_group_rows);
+    long* group_table_row = (long*) malloc(num_groups * sizeof(long));
+    if (group_table_row == NULL) exit(EXIT_FAILURE);
+
+    #pragma omp taskloop num_tasks(task_count(num_groups))
+    for (long g = 0; g < num_groups; g++) {
+        group_table_row[g] = table->point_rows[element_index(combos[group_start[g]].x, p)];
+
+        for (long i = group_start[g]; i < group_start[g + 1]; i++) {
+            row_values[i] = (uint8_t) element_index(combos[i].y, p);
+        }
+    }
+
+    long tile_words = tile_words_for_rows(max_group_rows, words_per_row);
+    long num_tiles = (words_per_row + tile_words - 1) / tile_words;
+
+    long batch_groups = (sink == NULL) ? num_groups : (num_groups + CFF_STREAM_BATCHES - 1) / CFF_STREAM_BATCHES;
+
+    for (long g_begin = 0; g_begin < num_groups; g_begin += batch_groups) {
+        long g_end = (g_begin + batch_groups < num_groups) ? g_begin + batch_groups : num_groups;
+
+        #pragma omp taskloop num_tasks(task_count((g_end - g_begin) * num_tiles))
+        for (long unit = g_begin * num_tiles; unit < g_end * num_tiles; unit++) {
+            long g = unit / num_tiles;
+            long word_begin = (unit % num_tiles) * tile_words;
+            long word_end = (word_begin + tile_words < words_per_row) ? word_begin + tile_words : words_per_row;
+
+            if (group_table_row[g] < 0) {
+                if (target != NULL) continue;
+                for (long i = group_start[g]; i < group_start[g + 1]; i++) {
+                    memset(cff_matrix[i] + word_begin, 0, (word_end - word_begin) * sizeof(uint64_t));
+                }
+                continue;
+            }
+            const uint8_t* evals = table->values + group_table_row[g] * table->stride;
+
+            if (target != NULL) {
+                // Shift the words of the tile to the column offset; the first and last
+                // destination words can be shared with a neighbouring tile or block
+                long base = WORD_OFFSET(target->col_offset);
+                int shift = (int) BIT_OFFSET(target->col_offset);
+
+                for (long i = group_start[g]; i < group_start[g + 1]; i++) {
+                    uint64_t* row = target->rows[i] + base;
+                    uint64_t carry = 0;
+                    for (long w = word_begin; w < word_end; w++) {
+                        uint64_t word = byte_equality_mask(evals + w * BITS_PER_WORD, row_values[i]);
+                        if (w == words_per_row - 1) word &= tail_mask;
+                        uint64_t out = (shift == 0) ? word : ((word << shift) | carry);
+                        carry = (shift == 0) ? 0 : (word >> (BITS_PER_WORD - shift));
+                        or_target_word(row + w, out, w == word_begin || w == word_end - 1);
+                    }
+                    if (carry != 0) or_target_word(row + word_end, carry, 1);
+                }
+                continue;
+            }
+
+            for (long i = group_start[g]; i < group_start[g + 1]; i++) {
+                uint64_t* row = cff_matrix[i];
+                for (long w = word_begin; w < word_end; w++) {
+                    row[w] = byte_equality_mask(evals + w * BITS_PER_WORD, row_values[i]);
+                }
+                if (word_end == words_per_row) row[words_per_row - 1] &= tail_mask;
+            }
+        }
+
+        if (sink != NULL) {
+            sink->emit(sink->arg, cff_matrix, group_start[g_begin], group_start[g_end] - group_start[g_begin], num_combos, table->num_polys);
+        }
+    }
+
+    free(group_start);
+    free(group_table_row);
+    free(row_values);
+    return cff_matrix;
+}
+
+/**
+ * @brief Splits the rows of a block into runs sharing the same point x.
+ * 
+ * generate_combinations emits pairs x-major, so equal x values are
+ * contiguous and a single linear scan finds every group.
+ * 
+ * @param combos Array of element pairs.
+ * @param num_combos Number of pairs.
+ * @param num_groups Pointer to store the number of groups.
+ * @param max_group_rows Pointer to store the size of the largest group.
+ * @return Array of num_groups + 1 offsets; group g is [start[g], start[g + 1]).
+ */
+long* group_rows_by_x(const element_pair* combos, long num_combos, long* num_groups, long* max_group_rows) {
+    long* group_start = (long*) malloc((num_combos + 1) * sizeof(long));
+    if (group_start == NULL) exit(EXIT_FAILURE);
+
+    *num_groups = 0;
+    *max_group_rows = 0;
+    for (long i = 0; i < num_combos; i++) {
+        if (i == 0 || !nmod_poly_equal(combos[i].x, combos[i - 1].x)) {
+            group_start[(*num_groups)++] = i;
+        }
+    }
+    group_start[*num_groups] = num_combos;
+
+    for (long g = 0; g < *num_groups; g++) {
+        long size = group_start[g + 1] - group_start[g];
+        if (size > *max_group_rows) *max_group_rows = size;
+    }
+    return group_start;
+}
+
+/**
+ * @brief Chooses the column tile width for a group of rows.
+ * 
+ * The tile is sized so the output words of all rows in a group fit in
+ * CFF_TILE_BYTES (about half of a typical L2 cache).
+ * 
+ * @param group_rows Number of rows processed together.
+ * @param words_per_row Number of words in a full row.
+ * @return Tile width in words (at least 1, at most words_per_row).
+ */
+long tile_words_for_rows(long group_rows, long words_per_row) {
+    long tile_words = CFF_TILE_BYTES / (sizeof(uint64_t) * (group_rows > 0 ? group_rows : 1));
+    if (tile_words < 1) tile_words = 1;
+    if (tile_words > words_per_row) tile_words = (words_per_row > 0) ? words_per_row : 1;
+    return tile_words;
+}
+
+/**
+ * @brief Chooses how many tasks a taskloop over a range should create.
+ * 
+ * @param total Number of loop iterations.
+ * @return About TASKS_PER_THREAD tasks per team thread, between 1 and total.
+ */
+long task_count(long total) {
+    long tasks = (long) omp_get_num_threads() * TASKS_PER_THREAD;
+    if (tasks > total) tasks = total;
+    return (tasks > 0) ? tasks : 1;
+}
+
+/**
+ * @brief Finds the first posting not smaller than a column.
+ * 
+ * @param postings Sorted array of polynomial indices.
+ * @param count Number of postings.
+ * @param col Column to search for.
+ * @return Position of the first posting >= col, or count if none.
+ */
+static inline long first_posting_from(const long* postings, long count, long col) {
+    long lo = 0, hi = count;
+    while (lo < hi) {
+        long mid = lo + (hi - lo) / 2;
+        if (postings[mid] < col) lo = mid + 1; else hi = mid;
+    }
+    return lo;
+}
+
+/**
+ * @brief Finds the first 32-bit posting not smaller than a column.
+ * 
+ * @param postings Sorted array of polynomial indices.
+ * @param count Number of postings.
+ * @param col Column to search for.
+ * @return Position of the first posting >= col, or count if none.
+ */
+static inline long first_posting32_from(const uint32_t* postings, long count, long col) {
+    long lo = 0, hi = count;
+    while (lo < hi) {
+        long mid = lo + (hi - lo) / 2;
+        if ((long) postings[mid] < col) lo = mid + 1; else hi = mid;
+    }
+    return lo;
+}
+
+/**
+ * @brief ORs a bitmap row into a destination row at a column offset.
+ * 
+ * Every source word lands in at most two destination words; bits of the
+ * source past cols are ignored.
+ * 
+ * @param dst Destination row.
+ * @param col_offset Destination column of the first source column.
+ * @param src Source row.
+ * @param cols Number of columns of the source row.
+ */
+static inline void or_shifted_row(uint64_t* dst, long col_offset, const uint64_t* src, long cols) {
+    long words = WORDS_FOR_BITS(cols);
+    uint64_t* out = dst + WORD_OFFSET(col_offset);
+    int shift = BIT_OFFSET(col_offset);
+
+    for (long w = 0; w < words; w++) {
+        uint64_t word = src[w];
+        if (w == words - 1 && BIT_OFFSET(cols)) word &= (1ULL << BIT_OFFSET(cols)) - 1;
+        if (word == 0) continue;
+        out[w] |= word << shift;
+        if (shift != 0) {
+            uint64_t carry = word >> (BITS_PER_WORD - shift);
+            if (carry) out[w + 1] |= carry;
+        }
+    }
+}
+
+/**
+ * @brief Compares 64 consecutive bytes against a value.
+ * 
+ * Uses AVX2 or SSE2 byte compares and movemask when available, with a
+ * portable scalar fallback.
+ * 
+ * @param bytes Pointer to 64 readable bytes.
+ * @param value Value to compare against.
+ * @return Word whose bit i is set if bytes[i] == value.
+ */
+static inline uint64_t byte_equality_mask(const uint8_t* bytes, uint8_t value) {
+#if defined(__AVX2__)
+    __m256i needle = _mm256_set1_epi8((char) value);
+    uint64_t lo = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*) bytes), needle));
+    uint64_t hi = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*) (bytes + 32)), needle));
+    return lo | (hi << 32);
+#elif defined(__SSE2__)
+    __m128i needle = _mm_set1_epi8((char) value);
+    uint64_t mask = 0;
+    for (int i = 0; i < 4; i++) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*) (bytes + 16 * i));
+        mask |= (uint64_t) (uint16_t) _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)) << (16 * i);
+    }
+    return mask;
+#else
+    uint64_t mask = 0;
+    for (int i = 0; i < BITS_PER_WORD; i++) {
+        mask |= (uint64_t) (bytes[i] == value) << i;
+    }
+    return mask;
+#endif
+}
+
+/**
+ * @brief ORs bits into a word of a block target.
+ * 
+ * @param word Destination word.
+ * @param bits Bits to set.
+ * @param shared 1 if another task may update the same word concurrently.
+ */
+static inline void or_target_word(uint64_t* word, uint64_t bits, int shared) {
+    if (bits == 0) return;
+    if (shared) __atomic_fetch_or(word, bits, __ATOMIC_RELAXED);
+    else *word |= bits;
+}
+
+/*
+ *  TILED GENERATION FUNCTIONS
+ */
+
+/**
+ * @brief Generates an initial CFF in row tiles, writing each tile as it is built.
+ * 
+ * Memory holds the evaluation tables of the step and one tile of rows, so
+ * the matrix may be larger than RAM. The job gives the file, format (text
+ * or binary) and header parameters. With num_shards, only the rows of the
+ * shard are generated, and they are written to a shard file.
+ * 
+ * @param job Output job; its matrix is not used.
+ * @param construction Construction type ('p').
+ * @param block_size Define the size of CFF rows.
+ * @param d CFF parameter d.
+ * @param tile_rows Number of rows per tile, or 0 for a single tile.
+ * @param shard Index of the shard to generate, from 0 to num_shards - 1.
+ * @param num_shards Number of shards the rows are split into, or 0 to generate the whole matrix.
+ */
+static void generate_cff_tiled(cff_write_job* job, char construction, char block_size, int d, long tile_rows, int shard, int num_shards) {
+    cff_block_tiles tiles;
+    if (!open_block_tiles(&tiles, construction, block_size, d, job->Fq_steps, job->k_steps, 1)) {
+        printf("Error: Failed to generate initial CFF matrix.\n");
+        return;
+    }
+
+    long rows = tiles.blocks.rows_new;
+    long cols = tiles.blocks.cols_new;
+    long first_row = 0, end_row = rows;
+    struct cff_stream_writer* stream;
+    if (num_shards > 0) {
+        shard_row_range(rows, shard, num_shards, &first_row, &end_row);
+        stream = open_cff_shard_stream(job->filename, job->format, job->construction, d, job->Fq_steps, 1, job->k_steps, 1, rows, cols, shard, num_shards, first_row, end_row - first_row);
+    } else {
+        stream = open_cff_stream(job->filename, job->format, job->construction, d, job->Fq_steps, 1, job->k_steps, 1, rows, cols);
+    }
+    if (tile_rows <= 0) tile_rows = (end_row > first_row) ? end_row - first_row : 1;
+
+    if (stream != NULL) {
+        for (long first = first_row; first < end_row; first += tile_rows) {
+            long count = (end_row - first < tile_rows) ? end_row - first : tile_rows;
+            load_block_tiles(&tiles, first, count, 0);
+            if (!write_cff_stream_rows(stream, tiles.blocks.cff_new + first, count)) break;
+        }
+        if (close_cff_stream(stream)) {
+            if (num_shards > 0) {
+                printf("Shard %d/%d (rows %ld to %ld of the %ldx%ld initial CFF) written to '%s'.\n", shard, num_shards, first_row, end_row - 1, rows, cols, job->filename);
+            } else {
+                printf("Initial CFF matrix of %ldx%ld written in tiles of %ld rows.\n", rows, cols, tile_rows);
+            }
+        }
+    }
+    close_block_tiles(&tiles);
+}
+
+/**
+ * @brief Computes the rows of one shard of a matrix.
+ * 
+ * Shard s holds rows floor(s * rows / num_shards) up to the start of
+ * shard s + 1, so the ranges depend only on the matrix and the number of
+ * shards, and every process can find its own without coordination.
+ * 
+ * @param rows Number of rows of the matrix.
+ * @param shard Index of the shard.
+ * @param num_shards Number of shards.
+ * @param first Pointer to store the first row of the shard.
+ * @param end Pointer to store the end of the rows of the shard.
+ */
+static void shard_row_range(long rows, int shard, int num_shards, long* first, long* end) {
+    // floor(rows * s / num_shards), without overflowing rows * s.
+    long quotient = rows / num_shards, remainder = rows % num_shards;
+    *first = quotient * shard + remainder * shard / num_shards;
+    *end = quotient * (shard + 1) + remainder * (shard + 1) / num_shards;
+}
+
+/**
+ * @brief Builds the file name of one shard of a matrix file.
+ * 
+ * A name that does not fit is rejected rather than cut, since cutting the
+ * suffix would send several shards to the same file.
+ * 
+ * @param out Buffer to store the name (distinct from filename).
+ * @param size Size of the buffer.
+ * @param filename Name of the merged file.
+ * @param shard Index of the shard.
+ * @param num_shards Number of shards.
+ * @return 1 on success, 0 (with an error message) if the name is too long.
+ */
+static int shard_filename(char* out, size_t size, const char* filename, int shard, int num_shards) {
+    int length = snprintf(out, size, "%s.shard%dof%d", filename, shard, num_shards);
+    if (length < 0 || (size_t) length >= size) {
+        printf("Error: Shard file name of '%s' is longer than %zu characters.\n", filename, size - 1);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Checks that an output path given with --output fits in a file name buffer.
+ * 
+ * A path that does not fit is rejected rather than cut, since the cut name
+ * could be another existing file.
+ * 
+ * @param output Output file path, or NULL for the default name.
+ * @return 1 if the path is NULL or fits, 0 (with an error message) otherwise.
+ */
+static int check_output_path(const char* output) {
+    if (output != NULL && strlen(output) >= CFF_PATH_MAX) {
+        printf("Error: Output path '%s' is longer than %d characters.\n", output, CFF_PATH_MAX - 1);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Prepares an embedding step for generation in row tiles.
+ * 
+ * Builds the step and the evaluation tables (or inverted indexes) of its
+ * old and new polynomials, as generate_new_cff_blocks does, and sets the
+ * sizes of the blocks without generating any row.
+ * 
+ * @param tiles Structure to be filled (freed with close_block_tiles).
+ * @param construction Construction type ('p' or 'm').
+ * @param block_size Define the size of CFF rows.
+ * @param d CFF parameter d.
+ * @param Fq_steps Array with finite field sizes.
+ * @param k_steps Array with maximum polynomial degrees.
+ * @param num_steps Number of steps.
+ * @return 1 on success, 0 if the last field size is not a prime power.
+ */
+static int open_block_tiles(cff_block_tiles* tiles, char construction, char block_size, int d, long* Fq_steps, long* k_steps, int num_steps) {
+    memset(tiles, 0, sizeof(*tiles));
+    if (!prepare_cff_step(&tiles->step, construction, block_size, d, Fq_steps, k_steps, num_steps)) {
+        return 0;
+    }
+
+    cff_step* step = &tiles->step;
+    fq_nmod_ctx_struct* ctx = step->ctx;
+    polynomial_partition* poly_part = &step->poly_part;
+    fq_nmod_t* points = step->partitions[num_steps - 1].all_elements;
+    long num_points = step->partitions[num_steps - 1].count_all;
+    tiles->use_table = (Fq_steps[num_steps - 1] <= EVAL_TABLE_MAX_Q);
+
+    #pragma omp parallel
+    #pragma omp single
+    {
+        #pragma omp task
+        {
+            if (tiles->use_table) tiles->table_old = create_evaluation_table(num_points, poly_part->num_old_polys, points, poly_part->old_polys, ctx);
+            else tiles->index_old = create_inverted_evaluation_index(num_points, poly_part->num_old_polys, points, poly_part->old_polys, ctx);
+        }
+
+        #pragma omp task
+        {
+            if (tiles->use_table) tiles->table_new = create_evaluation_table(num_points, poly_part->num_new_polys, points, poly_part->new_polys, ctx);
+            else tiles->index_new = create_inverted_evaluation_index(num_points, poly_part->num_new_polys, points, poly_part->new_polys, ctx);
+        }
+    }
+
+    generated_cffs* blocks = &tiles->blocks;
+    blocks->rows_old_new = step->combos.count_old;
+    blocks->cols_old_new = poly_part->num_new_polys;
+    blocks->rows_new_old = step->num_new_rows;
+    blocks->cols_new_old = poly_part->num_old_polys;
+    blocks->rows_new = step->num_new_rows;
+    blocks->cols_new = poly_part->num_new_polys;
+
+    blocks->cff_old_new = (uint64_t**) calloc(blocks->rows_old_new + 1, sizeof(uint64_t*));
+    blocks->cff_new_old = (uint64_t**) calloc(blocks->rows_new_old + 1, sizeof(uint64_t*));
+    blocks->cff_new = (uint64_t**) calloc(blocks->rows_new + 1, sizeof(uint64_t*));
+    if (blocks->cff_old_new == NULL || blocks->cff_new_old == NULL || blocks->cff_new == NULL) exit(EXIT_FAILURE);
+    return 1;
+}
+
+/**
+ * @brief Generates the rows of the blocks that fall in a tile of the embedded matrix.
+ * 
+ * Frees the rows of the previous tile first. Row i of the embedded matrix
+ * uses row i of old_new and row i - old_rows of new_old and new_new; while
+ * old_rows is unknown (a text stream not yet read to the end) only old_new
+ * rows are generated.
+ * 
+ * @param tiles Tiled step.
+ * @param first First row of the tile in the embedded matrix.
+ * @param count Number of rows of the tile.
+ * @param old_rows Number of rows of the previous matrix, or -1 if not known yet.
+ */
+static void load_block_tiles(cff_block_tiles* tiles, long first, long count, long old_rows) {
+    release_block_tile(tiles);
+    generated_cffs* blocks = &tiles->blocks;
+    const combination_partitions* combos = &tiles->step.combos;
+
+    long old_new_begin = first;
+    long old_new_end = (first + count < blocks->rows_old_new) ? first + count : blocks->rows_old_new;
+    long new_begin = 0, new_end = 0;
+    if (old_rows >= 0) {
+        new_begin = ((first > old_rows) ? first : old_rows) - old_rows;
+        new_end = (first + count - old_rows < blocks->rows_new) ? first + count - old_rows : blocks->rows_new;
+    }
+
+    uint64_t** old_new = NULL;
+    uint64_t** new_old = NULL;
+    uint64_t** new_new = NULL;
+
+    #pragma omp parallel
+    #pragma omp single
+    {
+        if (old_new_end > old_new_begin) {
+            #pragma omp task
+            old_new = generate_block_rows(tiles, combos->combos_old + old_new_begin, old_new_end - old_new_begin, 1, NULL);
+        }
+        if (new_end > new_begin) {
+            #pragma omp task
+            new_old = generate_block_rows(tiles, combos->combos_new + new_begin, new_end - new_begin, 0, NULL);
+
+            #pragma omp task
+            new_new = generate_block_rows(tiles, combos->combos_new + new_begin, new_end - new_begin, 1, NULL);
+        }
+    }
+
+    if (old_new != NULL) {
+        memcpy(blocks->cff_old_new + old_new_begin, old_new, (old_new_end - old_new_begin) * sizeof(uint64_t*));
+        tiles->old_new_begin = old_new_begin;
+        tiles->old_new_end = old_new_end;
+    }
+    if (new_old != NULL && new_new != NULL) {
+        memcpy(blocks->cff_new_old + new_begin, new_old, (new_end - new_begin) * sizeof(uint64_t*));
+        memcpy(blocks->cff_new + new_begin, new_new, (new_end - new_begin) * sizeof(uint64_t*));
+        tiles->new_begin = new_begin;
+        tiles->new_end = new_end;
+    }
+    tiles->tile_old_new = old_new;
+    tiles->tile_new_old = new_old;
+    tiles->tile_new = new_new;
+}
 
-    subfield_partition all_partition = partitions[num_steps - 1];
-    fq_nmod_t* points_for_eval = all_partition.all_elements;
-    long num_points = all_partition.count_all;
-    GHashTable* inverted_index_old = create_inverted_evaluation_index(num_points, poly_part.num_old_polys, points_for_eval, poly_part.old_polys, ctx);
-    GHashTable* inverted_index_new = create_inverted_evaluation_index(num_points, poly_part.num_new_polys, points_for_eval, poly_part.new_polys, ctx);
+/**
+ * @brief Generates the rows of consecutive pairs against the old or new polynomials.
+ * 
+ * @param tiles Tiled step.
+ * @param combos First pair.
+ * @param count Number of pairs.
+ * @param new_polys 1 for the new polynomials, 0 for the old ones.
+ * @param target Destination to OR the rows into, or NULL to allocate them.
+ * @return Rows in bitmap format, or NULL when written to target.
+ */
+static uint64_t** generate_block_rows(const cff_block_tiles* tiles, const element_pair* combos, long count, int new_polys, const cff_block_target* target) {
+    long rows = 0;
+    if (tiles->use_table) {
+        return generate_single_cff_from_table(&rows, combos, count, new_polys ? &tiles->table_new : &tiles->table_old, tiles->step.ctx, NULL, target);
+    }
+    return generate_single_cff(&rows, combos, count, new_polys ? &tiles->index_new : &tiles->index_old, tiles->step.ctx, NULL, target);
+}
 
-    if (!global_ctx_initialized) {
-        fq_nmod_ctx_init_modulus(global_ctx, fq_nmod_ctx_modulus(ctx), "a");
-        global_ctx_initialized = 1;
+/**
+ * @brief Builds an embedded matrix in place, generating the new blocks straight into its rows.
+ * 
+ * The old matrix is copied first; the three blocks are then generated
+ * concurrently and ORed into the destination (see cff_block_target), so
+ * none of them is ever allocated on the heap.
+ * 
+ * @param tiles Tiled step, with no tile loaded.
+ * @param final_cff Zeroed destination matrix of the size given by embedded_cff_size.
+ * @param cff_old_old Matrix of the previous step.
+ * @param old_rows Number of rows of the previous matrix.
+ * @param old_cols Number of columns of the previous matrix.
+ */
+static void generate_blocks_into(const cff_block_tiles* tiles, uint64_t** final_cff, uint64_t** cff_old_old, long old_rows, long old_cols) {
+    const generated_cffs* blocks = &tiles->blocks;
+    const combination_partitions* combos = &tiles->step.combos;
+    long old_words = WORDS_FOR_BITS(old_cols);
+
+    #pragma omp parallel for schedule(static)
+    for (long i = 0; i < old_rows; i++) {
+        memcpy(final_cff[i], cff_old_old[i], old_words * sizeof(uint64_t));
+        if (BIT_OFFSET(old_cols)) final_cff[i][old_words - 1] &= (1ULL << BIT_OFFSET(old_cols)) - 1;
     }
-        
-    result.cff_old_new = generate_single_cff(&result.rows_old_new, combos.combos_old, combos.count_old, inverted_index_new, poly_part.num_new_polys);
-    result.cols_old_new = poly_part.num_new_polys;
-    
-    result.cff_new_old = generate_single_cff(&result.rows_new_old, combos.combos_new, num_new_rows, inverted_index_old, poly_part.num_old_polys);
-    result.cols_new_old = poly_part.num_old_polys;
 
-    result.cff_new = generate_single_cff(&result.rows_new, combos.combos_new, num_new_rows, inverted_index_new, poly_part.num_new_polys);
-    result.cols_new = poly_part.num_new_polys;
-    
-    g_hash_table_destroy(inverted_index_old);
-    g_hash_table_destroy(inverted_index_new);
-    free_combination_partitions(&combos, ctx);
-    free_polynomial_partition(&poly_part, ctx);
-    free_subfield_partitions(partitions, num_steps, ctx);
-    fq_nmod_ctx_clear(ctx);
-    fq_nmod_ctx_clear(global_ctx);
-    global_ctx_initialized = 0;
+    cff_block_target old_new = { final_cff, old_cols };
+    cff_block_target new_old = { final_cff + old_rows, 0 };
+    cff_block_target new_new = { final_cff + old_rows, blocks->cols_new_old };
 
-    return result;
+    // Blocks can be taller than the rows they land in (old_new when the field
+    // is kept); rows past the end are dropped, as in embedded_cff_row
+    long total_rows = old_rows + blocks->rows_new_old;
+    long old_new_rows = (blocks->rows_old_new < total_rows) ? blocks->rows_old_new : total_rows;
+    long new_new_rows = (blocks->rows_new < blocks->rows_new_old) ? blocks->rows_new : blocks->rows_new_old;
+
+    #pragma omp parallel
+    #pragma omp single
+    {
+        #pragma omp task
+        generate_block_rows(tiles, combos->combos_old, old_new_rows, 1, &old_new);
+
+        #pragma omp task
+        generate_block_rows(tiles, combos->combos_new, blocks->rows_new_old, 0, &new_old);
+
+        #pragma omp task
+        generate_block_rows(tiles, combos->combos_new, new_new_rows, 1, &new_new);
+    }
 }
 
-/*
- *  CFF MATRIX GENERATION FUNCTION
+/**
+ * @brief Frees the rows of the current tile.
+ * 
+ * @param tiles Tiled step.
  */
+static void release_block_tile(cff_block_tiles* tiles) {
+    generated_cffs* blocks = &tiles->blocks;
+    for (long i = tiles->old_new_begin; i < tiles->old_new_end; i++) blocks->cff_old_new[i] = NULL;
+    for (long i = tiles->new_begin; i < tiles->new_end; i++) {
+        blocks->cff_new_old[i] = NULL;
+        blocks->cff_new[i] = NULL;
+    }
+    free_contiguous_matrix(tiles->tile_old_new);
+    free_contiguous_matrix(tiles->tile_new_old);
+    free_contiguous_matrix(tiles->tile_new);
+    tiles->tile_old_new = tiles->tile_new_old = tiles->tile_new = NULL;
+    tiles->old_new_begin = tiles->old_new_end = 0;
+    tiles->new_begin = tiles->new_end = 0;
+}
 
 /**
- * @brief Generates a CFF matrix (bitmap) from combinations and evaluations.
- * 
- * Creates a binary matrix where each row corresponds to a pair (x, y) and
- * each column corresponds to a polynomial. Bit (i, j) is 1 if polynomial j
- * evaluates to y at point x of pair i.
+ * @brief Frees a tiled step.
  * 
- * @param num_rows Pointer to store the number of rows.
- * @param combos Array of element pairs.
- * @param num_combos Number of pairs.
- * @param inverted_evals Inverted evaluation index.
- * @param num_polys Number of polynomials (columns).
- * @return CFF matrix in bitmap format.
+ * @param tiles Tiled step.
  */
-uint64_t** generate_single_cff(long* num_rows, const element_pair* combos, long num_combos, GHashTable* inverted_evals, long num_polys) {
-    *num_rows = num_combos;
-    if (num_combos == 0) return NULL;
+static void close_block_tiles(cff_block_tiles* tiles) {
+    release_block_tile(tiles);
+    free(tiles->blocks.cff_old_new);
+    free(tiles->blocks.cff_new_old);
+    free(tiles->blocks.cff_new);
+    free_evaluation_table(&tiles->table_old);
+    free_evaluation_table(&tiles->table_new);
+    free_inverted_index(&tiles->index_old);
+    free_inverted_index(&tiles->index_new);
+    free_cff_step(&tiles->step);
+}
 
-    long words_per_row = WORDS_FOR_BITS(num_polys);
+/* 
+ *  EVALUATION TABLE FUNCTIONS
+ */
 
-    uint64_t** cff_matrix = (uint64_t**) malloc(num_combos * sizeof(uint64_t*));
-    if (cff_matrix == NULL) exit(EXIT_FAILURE);
+/**
+ * @brief Creates a byte table with the evaluation of every polynomial at every point.
+ * 
+ * Entry (i, j) is the element index of P_j(x_i). Rows are padded to a
+ * whole number of words so the row generator can read them 64 bytes at a time.
+ * Polynomials are evaluated by taskloop tasks of the calling team.
+ * 
+ * @param num_points Number of evaluation points.
+ * @param num_polys Number of polynomials.
+ * @param points Array of evaluation points.
+ * @param polys Array of polynomials.
+ * @param ctx Finite field context (at most EVAL_TABLE_MAX_Q elements).
+ * @return Evaluation table.
+ */
+evaluation_table create_evaluation_table(long num_points, long num_polys, const fq_nmod_t* points, const fq_nmod_poly_t* polys, const fq_nmod_ctx_t ctx) {
+    evaluation_table table = {0};
+    ulong p = fq_nmod_ctx_prime(ctx);
 
-    #pragma omp parallel for schedule(dynamic)
-    for (long i = 0; i < num_combos; i++) {
+    fmpz_t order_z;
+    fmpz_init(order_z);
+    fq_nmod_ctx_order(order_z, ctx);
+    table.field_size = fmpz_get_si(order_z);
+    fmpz_clear(order_z);
 
-        const fq_nmod_t* x = &combos[i].x;
-        const fq_nmod_t* y = &combos[i].y;
+    table.num_points = num_points;
+    table.num_polys = num_polys;
+    table.stride = WORDS_FOR_BITS(num_polys) * BITS_PER_WORD;
+    table.values = (uint8_t*) alloc_cff_buffer(checked_add(checked_mul(num_points, table.stride), 1));
+    table.point_rows = (long*) malloc(table.field_size * sizeof(long));
+    if (table.values == NULL || table.point_rows == NULL) exit(EXIT_FAILURE);
 
-        cff_matrix[i] = (uint64_t*) calloc(words_per_row, sizeof(uint64_t));
+    for (long e = 0; e < table.field_size; e++) table.point_rows[e] = -1;
+    for (long i = 0; i < num_points; i++) table.point_rows[element_index(points[i], p)] = i;
 
-        GHashTable* inner_hash = g_hash_table_lookup(inverted_evals, x);
+    long num_chunks = task_count(num_polys);
 
-        if (inner_hash != NULL) {
-            GArray* indices = g_hash_table_lookup(inner_hash, y);
+    #pragma omp taskloop grainsize(1)
+    for (long c = 0; c < num_chunks; c++) {
+        fq_nmod_t y_eval_local;
+        fq_nmod_init(y_eval_local, ctx);
 
-            if (indices != NULL) {
-                for (guint k = 0; k < indices->len; k++) {
-                    long j = g_array_index(indices, long, k);
-                    SET_BIT(cff_matrix[i], j);
-                }
+        for (long j = c * num_polys / num_chunks; j < (c + 1) * num_polys / num_chunks; j++) {
+            for (long i = 0; i < num_points; i++) {
+                fq_nmod_poly_evaluate_fq_nmod(y_eval_local, polys[j], points[i], ctx);
+                table.values[i * table.stride + j] = (uint8_t) element_index(y_eval_local, p);
             }
         }
+        fq_nmod_clear(y_eval_local, ctx);
     }
 
-    return cff_matrix;
+    return table;
 }
 
 /* 
- *  HASH TABLE FUNCTIONS
+ *  INVERTED INDEX FUNCTIONS
  */
 
 /**
  * @brief Creates an inverted index of polynomial evaluations.
  * 
- * For each point x, creates a mapping y -> list of polynomial indices
- * where p(x) = y. This enables fast queries of which polynomials evaluate
- * to a given pair (x, y).
+ * For each point x, stores the list of polynomial indices where p(x) = y,
+ * for every y. Each point owns a preallocated slot of exactly num_polys
+ * postings (every polynomial has one value per point), so threads fill
+ * their slots without locks: evaluations go to a thread-local buffer,
+ * a prefix sum of the per-value counts gives the offsets, and the
+ * postings are scattered into the slot in ascending polynomial order.
+ * Postings are stored in 32 bits unless a polynomial index needs more.
+ * Points are processed in chunks by taskloop tasks of the calling team.
  * 
  * @param num_points Number of evaluation points.
  * @param num_polys Number of polynomials.
  * @param points Array of evaluation points.
  * @param polys Array of polynomials.
  * @param ctx Finite field context.
- * @return Hash table with the inverted index.
+ * @return Inverted index.
  */
-GHashTable* create_inverted_evaluation_index(long num_points, long num_polys, const fq_nmod_t* points, const fq_nmod_poly_t* polys, const fq_nmod_ctx_t ctx) {
-    GHashTable* inverted_index = g_hash_table_new_full(fq_nmod_hash_func, fq_nmod_equal_func, g_free, g_hash_table_destroy_wrapper);
+inverted_index create_inverted_evaluation_index(long num_points, long num_polys, const fq_nmod_t* points, const fq_nmod_poly_t* polys, const fq_nmod_ctx_t ctx) {
+    inverted_index index = {0};
+    ulong p = fq_nmod_ctx_prime(ctx);
 
-    #pragma omp parallel
-    {
+    fmpz_t order_z;
+    fmpz_init(order_z);
+    fq_nmod_ctx_order(order_z, ctx);
+    index.num_values = fmpz_get_si(order_z);
+    fmpz_clear(order_z);
+
+    index.num_points = num_points;
+    index.num_polys = num_polys;
+    long num_postings = checked_add(checked_mul(num_points, num_polys), 1);
+    if (num_polys <= (long) UINT32_MAX) {
+        index.postings32 = (uint32_t*) alloc_cff_buffer(checked_mul(num_postings, sizeof(uint32_t)));
+    } else {
+        index.postings = (long*) alloc_cff_buffer(checked_mul(num_postings, sizeof(long)));
+    }
+    index.offsets = (long*) alloc_cff_buffer(checked_mul(checked_mul(num_points, checked_add(index.num_values, 1)), sizeof(long)));
+    index.point_slots = (long*) malloc(index.num_values * sizeof(long));
+    if ((index.postings == NULL && index.postings32 == NULL) || index.offsets == NULL || index.point_slots == NULL) exit(EXIT_FAILURE);
+
+    for (long e = 0; e < index.num_values; e++) index.point_slots[e] = -1;
+    for (long i = 0; i < num_points; i++) index.point_slots[element_index(points[i], p)] = i;
+
+    long num_chunks = task_count(num_points);
+
+    #pragma omp taskloop grainsize(1)
+    for (long c = 0; c < num_chunks; c++) {
         fq_nmod_t y_eval_local;
         fq_nmod_init(y_eval_local, ctx);
 
-        fq_nmod_t* x_key_copy; 
-        fq_nmod_t* y_key_copy;
-
-        #pragma omp for schedule(dynamic)
-        for (long i = 0; i < num_points; i++) {
-            const fq_nmod_t* x = &points[i];
+        long* values_local = (long*) malloc((num_polys + 1) * sizeof(long));
+        long* cursor_local = (long*) malloc(index.num_values * sizeof(long));
+        if (values_local == NULL || cursor_local == NULL) exit(EXIT_FAILURE);
 
-            GHashTable* inner_hash_local = g_hash_table_new_full(fq_nmod_hash_func, fq_nmod_equal_func, g_free, g_array_destroy_wrapper);
+        for (long i = c * num_points / num_chunks; i < (c + 1) * num_points / num_chunks; i++) {
+            long* offsets = index.offsets + i * (index.num_values + 1);
+            memset(offsets, 0, (index.num_values + 1) * sizeof(long));
 
             for (long j = 0; j < num_polys; j++) {
-                fq_nmod_poly_evaluate_fq_nmod(y_eval_local, polys[j], *x, ctx);
-
-                GArray* indices = g_hash_table_lookup(inner_hash_local, y_eval_local);
-                if (indices == NULL) {
-                    indices = g_array_new(FALSE, FALSE, sizeof(long));
-                    y_key_copy = (fq_nmod_t*) malloc(sizeof(fq_nmod_t));
-                    fq_nmod_init(*y_key_copy, ctx);
-                    fq_nmod_set(*y_key_copy, y_eval_local, ctx);
-                    g_hash_table_insert(inner_hash_local, y_key_copy, indices);
-                }
-                g_array_append_val(indices, j);
+                fq_nmod_poly_evaluate_fq_nmod(y_eval_local, polys[j], points[i], ctx);
+                values_local[j] = element_index(y_eval_local, p);
+                offsets[values_local[j] + 1]++;
             }
 
-            x_key_copy = (fq_nmod_t*) malloc(sizeof(fq_nmod_t));
-            fq_nmod_init(*x_key_copy, ctx);
-            fq_nmod_set(*x_key_copy, *x, ctx);
+            offsets[0] = i * num_polys;
+            for (long y = 0; y < index.num_values; y++) {
+                offsets[y + 1] += offsets[y];
+                cursor_local[y] = offsets[y];
+            }
 
-            #pragma omp critical
-            g_hash_table_insert(inverted_index, x_key_copy, inner_hash_local);
+            if (index.postings32 != NULL) {
+                for (long j = 0; j < num_polys; j++) {
+                    index.postings32[cursor_local[values_local[j]]++] = (uint32_t) j;
+                }
+            } else {
+                for (long j = 0; j < num_polys; j++) {
+                    index.postings[cursor_local[values_local[j]]++] = j;
+                }
+            }
         }
+
+        free(values_local);
+        free(cursor_local);
         fq_nmod_clear(y_eval_local, ctx);
     }
 
-    return inverted_index;
-}
-
-/**
- * @brief Hash function for fq_nmod_t elements.
- * 
- * Computes a hash value based on the degree-zero coefficient of the element.
- * 
- * @param key Pointer to the fq_nmod_t element.
- * @return Computed hash value.
- */
-guint fq_nmod_hash_func(gconstpointer key) {
-    const fq_nmod_t* element = (const fq_nmod_t*)key;
-    return nmod_poly_get_coeff_ui(*element, 0);
-}
-
-/**
- * @brief Equality comparison function for fq_nmod_t elements.
- * 
- * Compares two finite field elements using the global context.
- * 
- * @param a Pointer to the first element.
- * @param b Pointer to the second element.
- * @return TRUE if elements are equal, FALSE otherwise.
- */
-gboolean fq_nmod_equal_func(gconstpointer a, gconstpointer b) {
-    const fq_nmod_t* elem1 = (const fq_nmod_t*)a;
-    const fq_nmod_t* elem2 = (const fq_nmod_t*)b;
-    return fq_nmod_equal(*elem1, *elem2, global_ctx);
-}
-
-/**
- * @brief Wrapper to destroy a GArray inside a hash table.
- * 
- * @param data Pointer to the GArray to be destroyed.
- */
-void g_array_destroy_wrapper(gpointer data) {
-    g_array_free((GArray*)data, TRUE);
-}
-
-/**
- * @brief Wrapper to destroy an inner hash table.
- * 
- * @param data Pointer to the GHashTable to be destroyed.
- */
-void g_hash_table_destroy_wrapper(gpointer data) {
-    g_hash_table_destroy((GHashTable*)data);
+    return index;
 }
 
 /* 
@@ -547,7 +2369,7 @@ void g_hash_table_destroy_wrapper(gpointer data) {
  * @param ctx Finite field context.
  * @return Structure containing the partitioned combinations.
  */
-combination_partitions generate_combinations(char construction, int dk_size, const subfield_partition* partitions, int num_partitions, const fq_nmod_ctx_t ctx) {
+combination_partitions generate_combinations(char construction, long dk_size, const subfield_partition* partitions, int num_partitions, const fq_nmod_ctx_t ctx) {
     combination_partitions result = {0};
 
     fq_nmod_t* all_accumulated_elements = NULL;
@@ -556,11 +2378,12 @@ combination_partitions generate_combinations(char construction, int dk_size, con
     fq_nmod_t* dk_block_elements = NULL; 
 
     if(construction == 'm'){
-        dk_block_elements = malloc(dk_size * sizeof(fq_nmod_t));
-        int start_index = 0; 
+        dk_block_elements = malloc(checked_mul(dk_size, sizeof(fq_nmod_t)));
+        if (dk_block_elements == NULL) exit(EXIT_FAILURE);
+        long start_index = 0; 
         
         fq_nmod_t* current_only_elements = partitions[0].only_elements;
-        for(int i=0; i<dk_size; i++){
+        for(long i=0; i<dk_size; i++){
             fq_nmod_init(dk_block_elements[i], ctx);
             fq_nmod_set(dk_block_elements[i], current_only_elements[start_index + i], ctx);
         }
@@ -758,15 +2581,10 @@ polynomial_partition partition_polynomials(const subfield_partition* partitions,
  * @return Array of generated polynomials.
  */
 fq_nmod_poly_t* generate_polynomials_from_coeffs(long* poly_count, long max_degree, const fq_nmod_t* coeffs, long num_coeffs, const fq_nmod_ctx_t ctx) {
-    fmpz_t num_coeffs_z, total_polys_z;
-    fmpz_init(num_coeffs_z);
-    fmpz_init(total_polys_z);
-    fmpz_set_si(num_coeffs_z, num_coeffs);
-
-    fmpz_pow_ui(total_polys_z, num_coeffs_z, max_degree + 1);
-    *poly_count = fmpz_get_si(total_polys_z);
+    *poly_count = checked_pow(num_coeffs, max_degree + 1);
 
-    fq_nmod_poly_t* poly_list = (fq_nmod_poly_t*) malloc((*poly_count) * sizeof(fq_nmod_poly_t));
+    fq_nmod_poly_t* poly_list = (fq_nmod_poly_t*) malloc(checked_mul(*poly_count, sizeof(fq_nmod_poly_t)));
+    if (poly_list == NULL) exit(EXIT_FAILURE);
     for(long i=0; i < (*poly_count); i++) {
         fq_nmod_poly_init(poly_list[i], ctx);
     }
@@ -778,8 +2596,6 @@ fq_nmod_poly_t* generate_polynomials_from_coeffs(long* poly_count, long max_degr
     generate_recursive_sorted(poly_list, &start_index, temp_poly, max_degree, coeffs, num_coeffs, ctx);
 
     fq_nmod_poly_clear(temp_poly, ctx);
-    fmpz_clear(num_coeffs_z);
-    fmpz_clear(total_polys_z);
     
     return poly_list;
 }
@@ -981,6 +2797,24 @@ long find_element_index(const fq_nmod_t element, const fq_nmod_t* list, long lis
     return -1;
 }
 
+/**
+ * @brief Computes the arithmetic index of a finite field element.
+ * 
+ * Inverse of get_element_by_arithmetic: reads the coefficients of the
+ * element as base-p digits.
+ * 
+ * @param element Element to convert.
+ * @param p Characteristic of the field.
+ * @return Element index (0 to q-1).
+ */
+long element_index(const fq_nmod_t element, ulong p) {
+    long index = 0;
+    for (slong i = nmod_poly_length(element) - 1; i >= 0; i--) {
+        index = index * (long)p + (long)nmod_poly_get_coeff_ui(element, i);
+    }
+    return index;
+}
+
 /**
  * @brief Adds a fq_nmod_t element to a dynamic array.
  * 
@@ -1005,6 +2839,139 @@ void add_element_to_list(fq_nmod_t** list, long* count, long* capacity, const fq
     (*count)++;
 }
 
+/*
+ * THREAD PLACEMENT FUNCTIONS
+ */
+
+/**
+ * @brief Requests the standard OpenMP thread placement for --bind.
+ * 
+ * Sets OMP_PROC_BIND to the policy and, unless it is already set,
+ * OMP_PLACES to one place per allowed CPU, listed node by node (from
+ * sysfs), so consecutive threads share a NUMA node and the contiguous row
+ * ranges of the schedule(static) loops (first touch of the final matrix,
+ * block placement and writers) stay on one node. 'c' (close) packs the
+ * threads onto the first places; 's' (spread) spaces them evenly over
+ * all places, and so over all nodes. The runtime reads these variables
+ * only when it starts, so the caller must run the program again (see
+ * main) for them to take effect.
+ * 
+ * @param policy 'c' (close) or 's' (spread).
+ * @return 1 on success, 0 if the variables cannot be set.
+ */
+int bind_cff_threads(char policy) {
+#if defined(__linux__)
+    cpu_set_t allowed;
+    int cpus[CPU_SETSIZE];
+    long num_cpus = (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) ? node_ordered_cpus(cpus, &allowed) : 0;
+    if (num_cpus > 0) {
+        char* places = (char*) malloc(num_cpus * 16 + 1);
+        if (places == NULL) exit(EXIT_FAILURE);
+        long length = 0;
+        for (long i = 0; i < num_cpus; i++) {
+            length += sprintf(places + length, (i == 0) ? "{%d}" : ",{%d}", cpus[i]);
+        }
+        int failed = (setenv("OMP_PLACES", places, 0) != 0);
+        free(places);
+        if (failed) return 0;
+    }
+#endif
+    // Without a CPU list, one place per core
+    if (setenv("OMP_PLACES", "cores", 0) != 0) return 0;
+    return setenv("OMP_PROC_BIND", (policy == 's') ? "spread" : "close", 1) == 0;
+}
+
+/**
+ * @brief Lets the calling helper thread run on any CPU of the OpenMP places again.
+ * 
+ * With OMP_PROC_BIND, threads created by the initial thread inherit its
+ * single place; the writer threads call this first so they do not compete
+ * with the thread that started them.
+ */
+void unbind_cff_thread(void) {
+#if defined(__linux__)
+    if (omp_get_proc_bind() == omp_proc_bind_false || omp_get_num_places() == 0) return;
+
+    cpu_set_t all;
+    CPU_ZERO(&all);
+    int ids[CPU_SETSIZE];
+    for (int place = 0; place < omp_get_num_places(); place++) {
+        if (omp_get_place_num_procs(place) > CPU_SETSIZE) continue;
+        omp_get_place_proc_ids(place, ids);
+        for (int i = 0; i < omp_get_place_num_procs(place); i++) {
+            if (ids[i] >= 0 && ids[i] < CPU_SETSIZE) CPU_SET(ids[i], &all);
+        }
+    }
+    if (CPU_COUNT(&all) > 0) sched_setaffinity(0, sizeof(all), &all);
+#endif
+}
+
+#if defined(__linux__)
+/**
+ * @brief Lists the allowed CPUs grouped by NUMA node.
+ * 
+ * CPUs sysfs does not assign to an online node come last, in index order.
+ * 
+ * @param cpus Array of CPU_SETSIZE entries to be filled.
+ * @param allowed CPUs the process may run on.
+ * @return Number of CPUs listed.
+ */
+static long node_ordered_cpus(int* cpus, const cpu_set_t* allowed) {
+    long count = 0;
+    cpu_set_t listed, nodes, node_cpus;
+    CPU_ZERO(&listed);
+
+    if (read_cpu_list("/sys/devices/system/node/online", &nodes)) {
+        for (int node = 0; node < CPU_SETSIZE; node++) {
+            if (!CPU_ISSET(node, &nodes)) continue;
+            char path[64];
+            snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+            if (!read_cpu_list(path, &node_cpus)) continue;
+            for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+                if (CPU_ISSET(cpu, &node_cpus) && CPU_ISSET(cpu, allowed) && !CPU_ISSET(cpu, &listed)) {
+                    CPU_SET(cpu, &listed);
+                    cpus[count++] = cpu;
+                }
+            }
+        }
+    }
+
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, allowed) && !CPU_ISSET(cpu, &listed)) cpus[count++] = cpu;
+    }
+    return count;
+}
+
+/**
+ * @brief Reads a sysfs range list such as "0-3,8-11" into a set.
+ * 
+ * @param path File holding the list.
+ * @param set Set to be filled.
+ * @return 1 on success, 0 if the file cannot be read.
+ */
+static int read_cpu_list(const char* path, cpu_set_t* set) {
+    CPU_ZERO(set);
+    FILE* file = fopen(path, "r");
+    if (file == NULL) return 0;
+
+    long first, last;
+    while (fscanf(file, "%ld", &first) == 1) {
+        last = first;
+        int next = fgetc(file);
+        if (next == '-') {
+            if (fscanf(file, "%ld", &last) != 1) break;
+            next = fgetc(file);
+        }
+        for (long i = first; i <= last && i < CPU_SETSIZE; i++) {
+            if (i >= 0) CPU_SET(i, set);
+        }
+        if (next != ',') break;
+    }
+    fclose(file);
+    return 1;
+}
+#endif
+
 /*
  * MATHEMATICAL UTILITY FUNCTIONS
  */
@@ -1033,7 +3000,7 @@ static int is_prime(long n) {
  * @param n_out Pointer to store the exponent.
  * @return 1 on success, 0 if q is not a prime power.
  */
-static int decompose_prime_power(long q, long* p_out, long* n_out) {
+int decompose_prime_power(long q, long* p_out, long* n_out) {
     if (q <= 1) return 0;
     
     if (is_prime(q)) {
@@ -1063,6 +3030,224 @@ static int decompose_prime_power(long q, long* p_out, long* n_out) {
     return 0;
 }
 
+/**
+ * @brief Checks that the fields of a chain of steps form a tower of extensions.
+ * 
+ * Every field must be a prime power of the same prime as the first one.
+ * For the polynomial construction F_q(i-1) must be a subfield of F_q(i),
+ * i.e. the degree of each field must be a multiple of the degree of the
+ * previous one. Monotone steps only evaluate at points of the first field
+ * (the base set B), so for them each degree must be a multiple of the
+ * first degree. Prints the first violation found.
+ * 
+ * @param construction Construction type of the steps after the first ('p' or 'm').
+ * @param Fq_steps Array with finite field sizes.
+ * @param num_steps Number of steps.
+ * @return 1 if the fields are valid, 0 otherwise.
+ */
+int check_cff_field_steps(char construction, const long* Fq_steps, int num_steps) {
+    long first_p = 0, first_n = 0, prev_n = 0;
+    for (int i = 0; i < num_steps; i++) {
+        long p, n;
+        if (!decompose_prime_power(Fq_steps[i], &p, &n)) {
+            printf("Error: q = %ld of step %d is not a prime power.\n", Fq_steps[i], i + 1);
+            return 0;
+        }
+        if (i > 0 && p != first_p) {
+            printf("Error: q = %ld of step %d is not a power of %ld, the characteristic of the previous steps.\n", Fq_steps[i], i + 1, first_p);
+            return 0;
+        }
+        if (i > 0 && construction == 'p' && n % prev_n != 0) {
+            printf("Error: F_%ld of step %d does not contain F_%ld of step %d (degree %ld is not a multiple of %ld).\n", Fq_steps[i], i + 1, Fq_steps[i - 1], i, n, prev_n);
+            return 0;
+        }
+        if (i > 0 && construction == 'm' && n % first_n != 0) {
+            printf("Error: F_%ld of step %d does not contain the base field F_%ld of step 1 (degree %ld is not a multiple of %ld).\n", Fq_steps[i], i + 1, Fq_steps[0], n, first_n);
+            return 0;
+        }
+        if (i == 0) {
+            first_p = p;
+            first_n = n;
+        }
+        prev_n = n;
+    }
+    return 1;
+}
+
+/**
+ * @brief Multiplies two non-negative counts, exiting if the product overflows.
+ * 
+ * Sizes of rows, columns, polynomials and buffers go through these
+ * helpers, so an instance too large for 64-bit counts stops with a
+ * message instead of wrapping around.
+ * 
+ * @param a First factor.
+ * @param b Second factor.
+ * @return a * b.
+ */
+long checked_mul(long a, long b) {
+    long result;
+    if (__builtin_mul_overflow(a, b, &result)) {
+        fprintf(stderr, "Error: Size overflow, %ld * %ld does not fit in 64 bits.\n", a, b);
+        exit(EXIT_FAILURE);
+    }
+    return result;
+}
+
+/**
+ * @brief Adds two non-negative counts, exiting if the sum overflows.
+ * 
+ * @param a First term.
+ * @param b Second term.
+ * @return a + b.
+ */
+long checked_add(long a, long b) {
+    long result;
+    if (__builtin_add_overflow(a, b, &result)) {
+        fprintf(stderr, "Error: Size overflow, %ld + %ld does not fit in 64 bits.\n", a, b);
+        exit(EXIT_FAILURE);
+    }
+    return result;
+}
+
+/**
+ * @brief Raises a non-negative count to a power, exiting if the result overflows.
+ * 
+ * @param base Base.
+ * @param exponent Non-negative exponent.
+ * @return base^exponent.
+ */
+long checked_pow(long base, long exponent) {
+    long result = 1;
+    for (long i = 0; i < exponent; i++) result = checked_mul(result, base);
+    return result;
+}
+
+/*
+ *  BUFFER ALLOCATION FUNCTIONS
+ */
+
+/** @brief Huge page mode of alloc_cff_buffer: 0 (off), 't' (transparent) or 'h' (hugetlb). */
+static char huge_page_mode = 0;
+
+/** @brief Bytes in front of every buffer of alloc_cff_buffer, holding its mapped length (0 if from the heap). */
+#define CFF_BUFFER_HEADER 64
+
+/**
+ * @brief Sets how alloc_cff_buffer backs large buffers.
+ * 
+ * @param mode 0 for normal pages, 't' for transparent huge pages, 'h' for
+ *             explicit hugetlb pages (falling back to transparent ones).
+ */
+void set_cff_huge_pages(char mode) {
+    huge_page_mode = mode;
+}
+
+/**
+ * @brief Allocates a zeroed buffer for a matrix, table or index.
+ * 
+ * With huge pages enabled (Linux), buffers of at least
+ * CFF_HUGE_PAGE_MIN_BYTES are mapped on their own, aligned to
+ * CFF_HUGE_PAGE_BYTES, backed by hugetlb pages or advised for transparent
+ * huge pages, and prefaulted in parallel so neither TLB misses nor page
+ * faults land in the loops that fill them. Otherwise, or if mapping fails,
+ * the buffer comes from the heap.
+ * 
+ * @param bytes Size of the buffer.
+ * @return Buffer (freed with free_cff_buffer).
+ */
+void* alloc_cff_buffer(size_t bytes) {
+    char* base = NULL;
+    size_t mapped = 0;
+#if defined(__linux__)
+    if (huge_page_mode != 0 && bytes >= CFF_HUGE_PAGE_MIN_BYTES) {
+        size_t length = (bytes + CFF_BUFFER_HEADER + CFF_HUGE_PAGE_BYTES - 1) / CFF_HUGE_PAGE_BYTES * CFF_HUGE_PAGE_BYTES;
+        if (huge_page_mode == 'h') {
+            void* map = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (map != MAP_FAILED) base = (char*) map;
+        }
+        if (base == NULL) base = map_huge_buffer(length);
+        if (base != NULL) {
+            mapped = length;
+            prefault_buffer(base, length);
+        }
+    }
+#endif
+    if (base == NULL) {
+        base = (char*) calloc(bytes + CFF_BUFFER_HEADER, 1);
+        if (base == NULL) exit(EXIT_FAILURE);
+    }
+    *(size_t*) base = mapped;
+    return base + CFF_BUFFER_HEADER;
+}
+
+/**
+ * @brief Frees a buffer allocated with alloc_cff_buffer.
+ * 
+ * @param buffer Buffer to be freed, or NULL.
+ */
+void free_cff_buffer(void* buffer) {
+    if (buffer == NULL) return;
+    char* base = (char*) buffer - CFF_BUFFER_HEADER;
+#if defined(__linux__)
+    size_t mapped = *(size_t*) base;
+    if (mapped > 0) {
+        munmap(base, mapped);
+        return;
+    }
+#endif
+    free(base);
+}
+
+#if defined(__linux__)
+/**
+ * @brief Maps anonymous memory aligned to a huge page and advises transparent huge pages.
+ * 
+ * One extra huge page is mapped and the unaligned ends are unmapped, so
+ * every huge page of the buffer can be backed by the kernel.
+ * 
+ * @param length Size to map, a multiple of CFF_HUGE_PAGE_BYTES.
+ * @return Aligned base of the mapping, or NULL if mapping fails.
+ */
+static char* map_huge_buffer(size_t length) {
+    size_t padded = length + CFF_HUGE_PAGE_BYTES;
+    void* map = mmap(NULL, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED) return NULL;
+
+    uintptr_t start = (uintptr_t) map;
+    uintptr_t aligned = (start + CFF_HUGE_PAGE_BYTES - 1) / CFF_HUGE_PAGE_BYTES * CFF_HUGE_PAGE_BYTES;
+    if (aligned > start) munmap(map, aligned - start);
+    if (start + padded > aligned + length) munmap((void*) (aligned + length), start + padded - aligned - length);
+
+    madvise((void*) aligned, length, MADV_HUGEPAGE);
+    return (char*) aligned;
+}
+
+/**
+ * @brief Touches every page of a new mapping, in parallel.
+ * 
+ * Inside a parallel region (a table built by a task) the pages are
+ * split into taskloop tasks of the team; otherwise a static loop of a new
+ * team does it, matching the row split of the loops that use the buffer.
+ * 
+ * @param base Start of the mapping.
+ * @param length Size of the mapping.
+ */
+static void prefault_buffer(char* base, size_t length) {
+    long page = sysconf(_SC_PAGESIZE);
+    if (page <= 0) page = 4096;
+    long pages = (long) (length / page);
+
+    if (omp_in_parallel()) {
+        #pragma omp taskloop num_tasks(task_count(pages))
+        for (long i = 0; i < pages; i++) base[i * page] = 0;
+    } else {
+        #pragma omp parallel for schedule(static)
+        for (long i = 0; i < pages; i++) base[i * page] = 0;
+    }
+}
+#endif
+
 /* 
  *  MEMORY DEALLOCATION FUNCTIONS
  */
@@ -1079,6 +3264,35 @@ void free_matrix(uint64_t** matrix, long rows) {
     free(matrix);
 }
 
+/**
+ * @brief Allocates a zeroed matrix whose rows share one contiguous block.
+ * 
+ * @param rows Number of rows.
+ * @param cols Number of columns.
+ * @return Matrix (freed with free_contiguous_matrix); rows are WORDS_FOR_BITS(cols) words apart.
+ */
+uint64_t** alloc_contiguous_matrix(long rows, long cols) {
+    long words_per_row = WORDS_FOR_BITS(cols);
+    uint64_t** matrix = (uint64_t**) malloc((rows + 1) * sizeof(uint64_t*));
+    uint64_t* words = (uint64_t*) alloc_cff_buffer(checked_mul(checked_add(checked_mul(rows, words_per_row), 1), sizeof(uint64_t)));
+    if (matrix == NULL || words == NULL) exit(EXIT_FAILURE);
+
+    matrix[0] = words;
+    for (long i = 0; i < rows; i++) matrix[i] = words + i * words_per_row;
+    return matrix;
+}
+
+/**
+ * @brief Frees a matrix allocated with alloc_contiguous_matrix.
+ * 
+ * @param matrix Matrix to be freed.
+ */
+void free_contiguous_matrix(uint64_t** matrix) {
+    if (!matrix) return;
+    free_cff_buffer(matrix[0]);
+    free(matrix);
+}
+
 /**
  * @brief Frees the memory of a subfield partition array.
  * 
@@ -1118,9 +3332,9 @@ void free_combination_partitions(combination_partitions* combos, const fq_nmod_c
  */
 static void free_generated_cffs(generated_cffs* cffs) {
     if (!cffs) return;
-    if (cffs->cff_old_new) { for (long i = 0; i < cffs->rows_old_new; i++) free(cffs->cff_old_new[i]); free(cffs->cff_old_new); }
-    if (cffs->cff_new_old) { for (long i = 0; i < cffs->rows_new_old; i++) free(cffs->cff_new_old[i]); free(cffs->cff_new_old); }
-    if (cffs->cff_new) { for (long i = 0; i < cffs->rows_new; i++) free(cffs->cff_new[i]); free(cffs->cff_new); }
+    free_contiguous_matrix(cffs->cff_old_new);
+    free_contiguous_matrix(cffs->cff_new_old);
+    free_contiguous_matrix(cffs->cff_new);
 }
 
 /**
@@ -1144,3 +3358,33 @@ static void free_polynomial_partition(polynomial_partition* poly_part, const fq_
         free(poly_part->all_polys); 
     }
 }
+
+/**
+ * @brief Frees the memory of an evaluation table.
+ * 
+ * @param table Pointer to the table to be freed.
+ */
+void free_evaluation_table(evaluation_table* table) {
+    if (!table) return;
+    free_cff_buffer(table->values);
+    free(table->point_rows);
+    table->values = NULL;
+    table->point_rows = NULL;
+}
+
+/**
+ * @brief Frees the memory of an inverted index.
+ * 
+ * @param index Pointer to the index to be freed.
+ */
+void free_inverted_index(inverted_index* index) {
+    if (!index) return;
+    free_cff_buffer(index->postings);
+    free_cff_buffer(index->postings32);
+    free_cff_buffer(index->offsets);
+    free(index->point_slots);
+    index->postings = NULL;
+    index->postings32 = NULL;
+    index->offsets = NULL;
+    index->point_slots = NULL;
+}
@@ -10,6 +10,7 @@
 #define CFF_BUILDER_H
 
 #include <stdint.h> 
+#include <limits.h>
 #include "flint/fq_nmod.h"
 #include "flint/fq_nmod_poly.h"
 
@@ -35,6 +36,45 @@
 /** @brief Calculates the number of words needed to store bits. */
 #define WORDS_FOR_BITS(bits) (((bits) + BITS_PER_WORD - 1) / BITS_PER_WORD)
 
+/** @brief Size of the buffers that hold a file path, including the terminating null. */
+#ifndef CFF_PATH_MAX
+#ifdef PATH_MAX
+#define CFF_PATH_MAX PATH_MAX
+#else
+#define CFF_PATH_MAX 4096
+#endif
+#endif
+
+/** @brief Target size in bytes of the output words of one column tile (about half of L2). */
+#ifndef CFF_TILE_BYTES
+#define CFF_TILE_BYTES (256 * 1024)
+#endif
+
+/** @brief Number of taskloop tasks created per thread, for load balancing. */
+#ifndef TASKS_PER_THREAD
+#define TASKS_PER_THREAD 4
+#endif
+
+/** @brief Largest field size whose elements fit in one byte of an evaluation table. */
+#ifndef EVAL_TABLE_MAX_Q
+#define EVAL_TABLE_MAX_Q 256
+#endif
+
+/** @brief Number of row batches a block is generated in when its rows are streamed to a sink. */
+#ifndef CFF_STREAM_BATCHES
+#define CFF_STREAM_BATCHES 16
+#endif
+
+/** @brief Smallest buffer, in bytes, that alloc_cff_buffer backs with huge pages. */
+#ifndef CFF_HUGE_PAGE_MIN_BYTES
+#define CFF_HUGE_PAGE_MIN_BYTES (4L * 1024 * 1024)
+#endif
+
+/** @brief Size of a huge page, and alignment of huge page buffers (2 MiB on x86-64 and most arm64 kernels). */
+#ifndef CFF_HUGE_PAGE_BYTES
+#define CFF_HUGE_PAGE_BYTES (2L * 1024 * 1024)
+#endif
+
 /* 
  *  DATA STRUCTURES
  */
@@ -99,6 +139,30 @@ typedef struct {
     long cols_new;              /**< Number of columns in cff_new. */
 } generated_cffs;
 
+/**
+ * @brief Receiver of the rows of a block as soon as they are generated.
+ * 
+ * emit is called with consecutive row ranges, in order, from inside the
+ * parallel region that generates the block.
+ */
+typedef struct {
+    void (*emit)(void* arg, uint64_t** matrix, long first, long count, long rows, long cols); /**< Called for rows [first, first + count) of a rows x cols block. */
+    void* arg;                  /**< Argument passed to emit. */
+} cff_row_sink;
+
+/**
+ * @brief Destination of a block generated straight into the rows of a larger matrix.
+ * 
+ * The bits of the block are ORed into the destination, which must be zero
+ * where the block goes. Words a block shares with a neighbouring block or
+ * column tile are updated atomically, so adjacent blocks may be generated
+ * concurrently.
+ */
+typedef struct {
+    uint64_t** rows;            /**< Destination rows; row i of the block goes to rows[i]. */
+    long col_offset;            /**< Destination column of the first column of the block. */
+} cff_block_target;
+
 /**
  * @brief Structure to store polynomial partition.
  * 
@@ -114,6 +178,103 @@ typedef struct {
     long num_all_polys;         /**< Total number of polynomials. */
 } polynomial_partition;
 
+/**
+ * @brief Structure to store the field, points, polynomials and pairs of an embedding step.
+ * 
+ * Everything that defines the blocks of one step: column j of a block is
+ * a polynomial and row i a pair (x, y), with bit (i, j) set if P_j(x) = y.
+ */
+typedef struct {
+    fq_nmod_ctx_t ctx;                  /**< Finite field of the step. */
+    ulong p;                            /**< Characteristic of the field. */
+    int num_steps;                      /**< Number of steps up to this one. */
+    subfield_partition* partitions;     /**< Subfield partitions, one per step. */
+    polynomial_partition poly_part;     /**< Old and new polynomials (columns). */
+    combination_partitions combos;      /**< Old and new pairs (rows). */
+    long num_new_rows;                  /**< Number of new rows added by the step. */
+} cff_step;
+
+/**
+ * @brief Structure to store a byte evaluation table.
+ * 
+ * Row i holds the element index of P_j(x_i) for every polynomial j, so the
+ * bitmap row of a pair (x, y) is the set of positions of row x equal to y.
+ * Only used when the field has at most EVAL_TABLE_MAX_Q elements.
+ */
+typedef struct {
+    uint8_t* values;            /**< Evaluations, num_points rows of stride bytes. */
+    long stride;                /**< Bytes per row (num_polys rounded up to a word). */
+    long num_points;            /**< Number of evaluation points. */
+    long num_polys;             /**< Number of polynomials. */
+    long* point_rows;           /**< Table row of each element index, -1 if absent. */
+    long field_size;            /**< Number of entries in point_rows. */
+} evaluation_table;
+
+/**
+ * @brief Structure to store an inverted index of polynomial evaluations.
+ * 
+ * Point x_s owns the slot postings[s * num_polys .. (s + 1) * num_polys).
+ * The polynomials with P(x_s) = y are postings[offsets[o + y] .. offsets[o + y + 1]),
+ * with o = s * (num_values + 1), in ascending order. Postings take 32 bits
+ * when every polynomial index fits, halving the size of the index; offsets
+ * are always 64-bit.
+ */
+typedef struct {
+    long* postings;             /**< Polynomial indices, num_polys per point slot (NULL if postings32 is used). */
+    uint32_t* postings32;       /**< The same postings in 32 bits, used instead when num_polys fits (NULL otherwise). */
+    long* offsets;              /**< Absolute start of each (point, value) list, num_values + 1 per slot. */
+    long* point_slots;          /**< Slot of each element index, -1 if absent. */
+    long num_points;            /**< Number of evaluation points. */
+    long num_values;            /**< Number of field elements (possible values y). */
+    long num_polys;             /**< Number of polynomials. */
+} inverted_index;
+
+/**
+ * @brief Structure to generate the blocks of an embedding step in row tiles.
+ * 
+ * Keeps the step and the evaluation tables (or inverted indexes) of its old
+ * and new polynomials, so any range of rows of old_new, new_old and new_new
+ * can be generated on demand. The row arrays of blocks have the full block
+ * sizes, but only the rows of the current tile are allocated, which lets
+ * embedded_cff_row assemble the rows of a tile unchanged.
+ */
+typedef struct {
+    cff_step step;              /**< Field, points, polynomials and pairs of the step. */
+    int use_table;              /**< 1 if evaluation tables are used, 0 for inverted indexes. */
+    evaluation_table table_old; /**< Evaluation table of the old polynomials. */
+    evaluation_table table_new; /**< Evaluation table of the new polynomials. */
+    inverted_index index_old;   /**< Inverted index of the old polynomials. */
+    inverted_index index_new;   /**< Inverted index of the new polynomials. */
+    generated_cffs blocks;      /**< Full-size blocks holding only the rows of the current tile. */
+    uint64_t** tile_old_new;    /**< Rows of old_new in the current tile, in one contiguous allocation. */
+    uint64_t** tile_new_old;    /**< Rows of new_old in the current tile, in one contiguous allocation. */
+    uint64_t** tile_new;        /**< Rows of new_new in the current tile, in one contiguous allocation. */
+    long old_new_begin;         /**< First row of old_new in the current tile. */
+    long old_new_end;           /**< End of the rows of old_new in the current tile. */
+    long new_begin;             /**< First row of new_old and new_new in the current tile. */
+    long new_end;               /**< End of the rows of new_old and new_new in the current tile. */
+} cff_block_tiles;
+
+/**
+ * @brief Structure describing a CFF matrix to be written to file.
+ * 
+ * Used to hand a finished matrix to a background writer thread.
+ */
+typedef struct {
+    char filename[CFF_PATH_MAX]; /**< Output file path. */
+    char format;                /**< File format ('b' binary, 't' text, 'c' CSC, 'e' Elias-Fano, 'm' Matrix Market, 's' CSR, 'r' recipe). */
+    char construction;          /**< Construction type written in the header. */
+    int d;                      /**< CFF parameter d. */
+    long* Fq_steps;             /**< Array with finite field sizes. */
+    long* k_steps;              /**< Array with maximum polynomial degrees. */
+    int num_steps;              /**< Number of steps written in the header. */
+    uint64_t** matrix;          /**< CFF matrix in bitmap format. */
+    long rows;                  /**< Number of rows in the matrix. */
+    long cols;                  /**< Number of columns in the matrix. */
+    struct cff_stream_writer* stream; /**< Streaming writer, when rows are written while being generated. */
+    int ok;                     /**< Set by write_cff_job: 1 if the file was written, 0 on error. */
+} cff_write_job;
+
 /*
  * PUBLIC FUNCTION PROTOTYPES
  */
@@ -123,12 +284,19 @@ typedef struct {
  * 
  * @param construction Construction type ('p' for embedding CFFs, 'm' for monotone CFFs).
  * @param block_size Define the size of CFF rows.
- * @param cff_file File name to CFF storage.
+ * @param cff_file File name to CFF storage ("-" for stdin).
  * @param d CFF parameter d.
  * @param Fq New CFF parameter Fq.
  * @param k New CFF parameter k.
+ * @param format Output file format ('b' binary, 't' text, 'c' CSC, 'e' Elias-Fano, 'm' Matrix Market, 's' CSR, 'r' recipe, 'a' archive).
+ * @param output Output file path ("-" for stdout), or NULL for the default name in CFFs/.
+ * @param labels 1 to also write the row/column label side file.
+ * @param tile_rows Rows per tile for out-of-core embedding (text or binary input and output), or 0 to keep the matrices in memory.
+ * @param shard Index of the shard to generate, from 0 to num_shards - 1.
+ * @param num_shards Number of shards the rows are split into (binary input), or 0 to generate the whole matrix.
+ * @param streamed 1 to stream the input file through as if it came from stdin, without tiles.
  */
-void embed_cff(char construction, char block_size, const char *cff_file, int d, long Fq, long k);
+void embed_cff(char construction, char block_size, const char *cff_file, int d, long Fq, long k, char format, const char* output, int labels, long tile_rows, int shard, int num_shards, int streamed);
 
 /**
  * @brief Generates an initial CFF from basic parameters.
@@ -138,7 +306,222 @@ void embed_cff(char construction, char block_size, const char *cff_file, int d,
  * @param d CFF parameter d.
  * @param fq CFF parameter Fq.
  * @param k CFF parameter k.
+ * @param format Output file format ('b' binary, 't' text, 'c' CSC, 'e' Elias-Fano, 'm' Matrix Market, 's' CSR, 'r' recipe, 'a' archive).
+ * @param output Output file path ("-" for stdout), or NULL for the default name in CFFs/.
+ * @param labels 1 to also write the row/column label side file.
+ * @param tile_rows Rows per tile for out-of-core generation (text or binary output), or 0 to keep the matrix in memory.
+ * @param shard Index of the shard to generate, from 0 to num_shards - 1.
+ * @param num_shards Number of shards the rows are split into, or 0 to generate the whole matrix.
+ */
+void generate_cff(char construction, char block_size, int d, long fq, long k, char format, const char* output, int labels, long tile_rows, int shard, int num_shards);
+
+/**
+ * @brief Runs a chain of embeddings in a single process.
+ * 
+ * @param construction Construction type ('p' for embedding CFFs, 'm' for monotone CFFs).
+ * @param block_size Define the size of CFF rows.
+ * @param d CFF parameter d.
+ * @param Fq_steps Array with the finite field size of every step.
+ * @param k_steps Array with the maximum polynomial degree of every step.
+ * @param num_steps Number of steps.
+ * @param format Output file format ('b' binary, 't' text, 'c' CSC, 'e' Elias-Fano, 'm' Matrix Market, 's' CSR, 'r' recipe, 'a' archive).
+ * @param labels 1 to also write the row/column label side file of every step.
+ */
+void chain_cff(char construction, char block_size, int d, long* Fq_steps, long* k_steps, int num_steps, char format, int labels);
+
+/**
+ * @brief Rebuilds one step of a chain archive and writes it to file.
+ * 
+ * @param archive_file Chain archive file path.
+ * @param step Step number, starting at 1.
+ * @param format Output file format ('b' binary, 't' text, 'c' CSC, 'e' Elias-Fano, 'm' Matrix Market, 's' CSR, 'r' recipe).
+ * @param output Output file path ("-" for stdout), or NULL for the default name in CFFs/.
+ * @param labels 1 to also write the row/column label side file.
+ * @return 1 on success, 0 (with an error message) if the step cannot be read or written.
+ */
+int extract_cff(const char* archive_file, int step, char format, const char* output, int labels);
+
+/**
+ * @brief Merges the shard files of a CFF into the final file.
+ * 
+ * @param output Output file path.
+ * @param shard_files Paths of the shard files, in any order.
+ * @param count Number of shard files.
+ * @return 1 on success, 0 (with an error message) if the shards cannot be merged.
+ */
+int merge_cff(const char* output, char* const* shard_files, int count);
+
+/**
+ * @brief Answers a bit, row or column query on the CFF described by a recipe.
+ * 
+ * @param recipe_file Recipe file path.
+ * @param query 'b' for one bit, 'r' for one row, 'c' for one column.
+ * @param index Row of the bit or row query, column of the column query.
+ * @param col Column of the bit query (ignored otherwise).
+ * @return 1 on success, 0 on error.
+ */
+int query_cff(const char* recipe_file, char query, long index, long col);
+
+/**
+ * @brief Builds a CFF matrix in memory, in one contiguous block.
+ * 
+ * @param construction Construction type ('p' or 'm').
+ * @param block_size Define the size of CFF rows.
+ * @param d CFF parameter d.
+ * @param cff_old Matrix of the previous step (ignored when num_steps is 1).
+ * @param old_rows Number of rows of the previous matrix.
+ * @param old_cols Number of columns of the previous matrix.
+ * @param Fq_steps Array with finite field sizes, including the new step.
+ * @param k_steps Array with maximum polynomial degrees, including the new step.
+ * @param num_steps Number of steps.
+ * @param rows Pointer to store the number of rows.
+ * @param cols Pointer to store the number of columns.
+ * @return Matrix (freed with free_contiguous_matrix), or NULL on error.
+ */
+uint64_t** build_cff_matrix(char construction, char block_size, int d, uint64_t** cff_old, long old_rows, long old_cols, long* Fq_steps, long* k_steps, int num_steps, long* rows, long* cols);
+
+/**
+ * @brief Allocates a zeroed matrix whose rows share one contiguous block.
+ * 
+ * @param rows Number of rows.
+ * @param cols Number of columns.
+ * @return Matrix (freed with free_contiguous_matrix); rows are WORDS_FOR_BITS(cols) words apart.
+ */
+uint64_t** alloc_contiguous_matrix(long rows, long cols);
+
+/**
+ * @brief Frees a matrix allocated with alloc_contiguous_matrix.
+ * 
+ * @param matrix Matrix to be freed.
+ */
+void free_contiguous_matrix(uint64_t** matrix);
+
+/**
+ * @brief Sets how alloc_cff_buffer backs large buffers.
+ * 
+ * @param mode 0 for normal pages, 't' for transparent huge pages, 'h' for hugetlb pages (falling back to transparent ones).
+ */
+void set_cff_huge_pages(char mode);
+
+/**
+ * @brief Allocates a zeroed buffer for a matrix, table or index, on prefaulted huge pages when enabled.
+ * 
+ * @param bytes Size of the buffer.
+ * @return Buffer (freed with free_cff_buffer).
+ */
+void* alloc_cff_buffer(size_t bytes);
+
+/**
+ * @brief Frees a buffer allocated with alloc_cff_buffer.
+ * 
+ * @param buffer Buffer to be freed, or NULL.
+ */
+void free_cff_buffer(void* buffer);
+
+/**
+ * @brief Builds the field, points, polynomials and pairs of an embedding step.
+ * 
+ * @param step Pointer to the structure to be filled (freed with free_cff_step).
+ * @param construction Construction type ('p' or 'm').
+ * @param block_size Define the size of CFF rows.
+ * @param d CFF parameter d.
+ * @param Fq_steps Array with finite field sizes.
+ * @param k_steps Array with maximum polynomial degrees.
+ * @param num_steps Number of steps.
+ * @return 1 on success, 0 if the last field size is not a prime power.
+ */
+int prepare_cff_step(cff_step* step, char construction, char block_size, int d, const long* Fq_steps, const long* k_steps, int num_steps);
+
+/**
+ * @brief Computes the number of new rows of an embedding step.
+ * 
+ * @param construction Construction type ('p' or 'm').
+ * @param block_size Define the size of CFF rows.
+ * @param d CFF parameter d.
+ * @param Fq_steps Array with finite field sizes.
+ * @param k_steps Array with maximum polynomial degrees.
+ * @param num_steps Number of steps.
+ * @param dk_size Pointer to store the size of the dk block.
+ * @return Number of new rows.
+ */
+long cff_step_new_rows(char construction, char block_size, int d, const long* Fq_steps, const long* k_steps, int num_steps, long* dk_size);
+
+/**
+ * @brief Computes the arithmetic index of a finite field element.
+ * 
+ * @param element Element to convert.
+ * @param p Characteristic of the field.
+ * @return Element index (0 to q-1).
+ */
+long element_index(const fq_nmod_t element, ulong p);
+
+/**
+ * @brief Frees the memory of an embedding step.
+ * 
+ * @param step Pointer to the step to be freed.
+ */
+void free_cff_step(cff_step* step);
+
+/**
+ * @brief Multiplies two non-negative counts, exiting if the product overflows.
+ * 
+ * @param a First factor.
+ * @param b Second factor.
+ * @return a * b.
+ */
+long checked_mul(long a, long b);
+
+/**
+ * @brief Adds two non-negative counts, exiting if the sum overflows.
+ * 
+ * @param a First term.
+ * @param b Second term.
+ * @return a + b.
+ */
+long checked_add(long a, long b);
+
+/**
+ * @brief Raises a non-negative count to a power, exiting if the result overflows.
+ * 
+ * @param base Base.
+ * @param exponent Non-negative exponent.
+ * @return base^exponent.
+ */
+long checked_pow(long base, long exponent);
+
+/**
+ * @brief Decomposes q into p^n where p is prime.
+ * 
+ * @param q Finite field size (must be a prime power).
+ * @param p_out Pointer to store the prime characteristic.
+ * @param n_out Pointer to store the exponent.
+ * @return 1 on success, 0 if q is not a prime power.
+ */
+int decompose_prime_power(long q, long* p_out, long* n_out);
+
+/**
+ * @brief Checks that the fields of a chain of steps form a tower of extensions.
+ * 
+ * @param construction Construction type of the steps after the first ('p' or 'm').
+ * @param Fq_steps Array with finite field sizes.
+ * @param num_steps Number of steps.
+ * @return 1 if every q is a power of the same prime and each field contains the previous one ('p') or the first one ('m'), 0 otherwise (with an error message).
+ */
+int check_cff_field_steps(char construction, const long* Fq_steps, int num_steps);
+
+/**
+ * @brief Sets OMP_PROC_BIND and OMP_PLACES (one place per CPU, ordered node by node) for --bind.
+ * 
+ * The OpenMP runtime reads them when it starts, so the program must be run again to apply them.
+ * 
+ * @param policy 'c' (close: thread t on place t) or 's' (spread: threads spaced over all places).
+ * @return 1 on success, 0 if the variables cannot be set.
+ */
+int bind_cff_threads(char policy);
+
+/**
+ * @brief Lets the calling helper thread run on any CPU of the OpenMP places again.
  */
-void generate_cff(char construction, char block_size, int d, long fq, long k);
+void unbind_cff_thread(void);
 
 #endif /* CFF_BUILDER_H */
@@ -3,15 +3,26 @@
  * @brief Implementation of CFF file reading and writing functions.
  * 
  * This file contains the functions responsible for reading and writing
- * CFF matrices and their parameters to text files.
+ * CFF matrices and their parameters to text and binary files.
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <omp.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
 #include "cff_file_generator.h"
 #include "cff_builder.h"
+#include "cff_recipe.h"
 
 /* 
  *  HELPER FUNCTION PROTOTYPES
@@ -24,34 +35,2728 @@
  * @param count Pointer to store the number of integers.
  * @return Dynamically allocated integer array.
  */
-int* parse_int_list(char* str, int* count);
+long* parse_long_list(char* str, int* count);
+
+/**
+ * @brief Reads and validates the header of a binary CFF file.
+ * 
+ * @param file Open file positioned at its start.
+ * @param header Pointer to store the header.
+ * @return 1 if a valid binary header was read, 0 otherwise.
+ */
+static int read_binary_header(FILE* file, struct cff_binary_header* header);
+
+/**
+ * @brief Reads and validates the header of a CSC CFF file.
+ * 
+ * @param file Open file positioned at its start.
+ * @param header Pointer to store the header.
+ * @return 1 if a valid CSC header was read, 0 otherwise.
+ */
+static int read_csc_header(FILE* file, struct cff_csc_header* header);
+
+/**
+ * @brief Builds a parameters structure from the steps stored in a file header.
+ * 
+ * @param construction Construction type.
+ * @param d CFF parameter d.
+ * @param num_steps Number of steps.
+ * @param Fq_steps Finite field size of every step.
+ * @param k_steps Maximum polynomial degree of every step.
+ * @return Pointer to structure with parameters, or NULL on error.
+ */
+static struct cff_parameters* parameters_from_steps(char construction, int d, int num_steps, const int64_t* Fq_steps, const int64_t* k_steps);
+
+/**
+ * @brief Builds a parameters structure from a recipe.
+ * 
+ * @param recipe CFF recipe.
+ * @return Pointer to structure with parameters, or NULL on error.
+ */
+static struct cff_parameters* parameters_from_recipe(const cff_recipe* recipe);
+
+/**
+ * @brief Builds a parameters structure from an archive index.
+ * 
+ * @param index Archive index.
+ * @param num_steps Number of steps to include.
+ * @return Pointer to structure with parameters, or NULL on error.
+ */
+static struct cff_parameters* parameters_from_archive(const struct cff_archive_index* index, int num_steps);
+
+/**
+ * @brief Writes the rows of a block as raw words.
+ * 
+ * @param file Open output file.
+ * @param block Block in bitmap format (may be NULL if rows is 0).
+ * @param rows Number of rows.
+ * @param cols Number of columns.
+ * @return 1 on success, 0 on a write error.
+ */
+static int write_block_words(FILE* file, uint64_t** block, long rows, long cols);
+
+/**
+ * @brief ORs a block stored as raw words into a matrix at a bit offset.
+ * 
+ * @param matrix Destination matrix.
+ * @param matrix_rows Number of rows of the destination.
+ * @param row_offset First destination row.
+ * @param col_offset First destination column.
+ * @param words Block rows, WORDS_FOR_BITS(cols) words each.
+ * @param rows Number of rows of the block.
+ * @param cols Number of columns of the block.
+ */
+static void or_block_words(uint64_t** matrix, long matrix_rows, long row_offset, long col_offset, const uint64_t* words, long rows, long cols);
+
+/**
+ * @brief Reads the column runs and row indices of an open CSC file.
+ * 
+ * @param file Open CSC file positioned after its header.
+ * @param header Header of the file.
+ * @param filename Path of the file, for error messages.
+ * @return CSC matrix, or NULL on error.
+ */
+static struct cff_csc_matrix* read_csc_matrix(FILE* file, const struct cff_csc_header* header, const char* filename);
+
+/**
+ * @brief Reads and validates the header of an Elias-Fano CFF file.
+ * 
+ * @param file Open file positioned at its start.
+ * @param header Pointer to store the header.
+ * @return 1 if a valid Elias-Fano header was read, 0 otherwise.
+ */
+static int read_ef_header(FILE* file, struct cff_ef_header* header);
+
+/**
+ * @brief Computes the number of ones and the sparse-format size of every row.
+ * 
+ * @param matrix CFF matrix in bitmap format.
+ * @param rows Number of rows in the matrix.
+ * @param cols Number of columns in the matrix.
+ * @param mtx 1 to measure Matrix Market lines in bytes, 0 to count ones.
+ * @return Array of rows + 1 prefix sums (entry i is the total of rows before i).
+ */
+static int64_t* sparse_row_offsets(uint64_t** matrix, long rows, long cols, int mtx);
+
+/**
+ * @brief Finds the end of a batch of rows that fits in a byte budget.
+ * 
+ * @param offsets Prefix sums of the row sizes.
+ * @param first First row of the batch.
+ * @param rows Number of rows in the matrix.
+ * @param budget Maximum size of the batch (always at least one row).
+ * @return One past the last row of the batch.
+ */
+static long sparse_batch_end(const int64_t* offsets, long first, long rows, int64_t budget);
+
+/**
+ * @brief Writes the decimal digits of a number.
+ * 
+ * @param out Output buffer.
+ * @param value Number to be written.
+ * @return Pointer past the last digit.
+ */
+static inline char* append_decimal(char* out, uint64_t value);
+
+/**
+ * @brief Returns the number of decimal digits of a number.
+ * 
+ * @param value Number.
+ * @return Number of digits (1 for 0).
+ */
+static inline int decimal_digits(uint64_t value);
+
+/**
+ * @brief Reads the column runs and encoded columns of an open Elias-Fano file.
+ * 
+ * @param file Open Elias-Fano file positioned after its header.
+ * @param header Header of the file.
+ * @param filename Path of the file, for error messages.
+ * @return Encoded matrix, or NULL on error.
+ */
+static struct cff_ef_matrix* read_ef_matrix(FILE* file, const struct cff_ef_header* header, const char* filename);
+
+/**
+ * @brief Computes the encoding of every run from its weight and the number of rows.
+ * 
+ * @param ef Matrix whose runs have first_col, count and weight set; sets the rest and num_words.
+ */
+static void layout_ef_runs(struct cff_ef_matrix* ef);
+
+/**
+ * @brief Finds the run that contains a column.
+ * 
+ * @param ef Encoded matrix.
+ * @param col Column index.
+ * @return Index of the run.
+ */
+static long find_ef_run(const struct cff_ef_matrix* ef, long col);
+
+/**
+ * @brief Reads up to 64 bits starting at any bit position.
+ * 
+ * @param bits Bit array, with one readable word past the last used bit.
+ * @param pos First bit.
+ * @param len Number of bits (0 to 64).
+ * @return The bits, least significant first.
+ */
+static inline uint64_t read_ef_bits(const uint64_t* bits, int64_t pos, int len);
+
+/**
+ * @brief ORs up to 64 bits into any bit position.
+ * 
+ * Neighbouring columns may share a word, so the update is atomic.
+ * 
+ * @param bits Bit array.
+ * @param pos First bit.
+ * @param value Bits to set, least significant first.
+ * @param len Number of bits (0 to 64).
+ */
+static inline void or_ef_bits(uint64_t* bits, int64_t pos, uint64_t value, int len);
+
+/**
+ * @brief Parses the parameter line of a text CFF file.
+ * 
+ * @param line First line of the file (not necessarily NUL-terminated).
+ * @param length Length of the line.
+ * @return Pointer to structure with parameters, or NULL on error.
+ */
+static struct cff_parameters* parse_parameters_line(const char* line, size_t length);
+
+/**
+ * @brief Maps the matrix words of an open binary CFF file.
+ * 
+ * @param file Open binary CFF file.
+ * @param header Header of the file.
+ * @param filename Path of the file, for error messages.
+ * @param rows Pointer to store the number of rows.
+ * @param cols Pointer to store the number of columns.
+ * @return Read-only CFF matrix whose rows point into the mapping, or NULL on error.
+ */
+static uint64_t** map_binary_matrix(FILE* file, const struct cff_binary_header* header, const char* filename, long* rows, long* cols);
+
+/**
+ * @brief Parses the matrix of an open text CFF file in a single pass.
+ * 
+ * @param file Open text CFF file.
+ * @param filename Path of the file, for error messages.
+ * @param rows Pointer to store the number of rows.
+ * @param cols Pointer to store the number of columns.
+ * @param params Pointer to store the parameters of the first line, or NULL to skip them.
+ * @return CFF matrix in bitmap format, or NULL if there is no data.
+ */
+static uint64_t** read_text_matrix(FILE* file, const char* filename, long* rows, long* cols, struct cff_parameters** params);
+
+/**
+ * @brief Finds the start of every line of a text body using all threads.
+ * 
+ * @param body Start of the first line.
+ * @param end End of the text.
+ * @param count Pointer to store the number of lines.
+ * @return Array of count + 1 line starts, the last one being end.
+ */
+static const char** index_text_lines(const char* body, const char* end, long* count);
+
+/**
+ * @brief Parses one line of whitespace-separated integers into a bitmap row.
+ * 
+ * @param row Zeroed bitmap row.
+ * @param line Start of the line.
+ * @param length Length of the line, without the newline.
+ * @param cols Number of columns of the matrix.
+ * @return Number of integers on the line.
+ */
+static long parse_text_row(uint64_t* row, const char* line, size_t length, long cols);
+
+/**
+ * @brief Converts 64 "b " column pairs of a text row into a bitmap word.
+ * 
+ * @param text Pointer to 128 readable characters.
+ * @return Word whose bit i is set if text[2 * i] == '1'.
+ */
+static inline uint64_t text_bit_mask(const char* text);
+
+/**
+ * @brief Formats one bitmap row as "b0 b1 ... bn\n" text.
+ * 
+ * @param out Output buffer of 2 * cols bytes (1 byte if cols is 0).
+ * @param row Row of the bitmap.
+ * @param cols Number of columns.
+ * @param lut Text of every byte value, 16 characters per entry.
+ */
+static void format_text_row(char* out, const uint64_t* row, long cols, const char (*lut)[16]);
+
+/**
+ * @brief Writes the parameter line of a text CFF file.
+ * 
+ * @param file Open output file.
+ * @param construction Construction type ('p' or 'm').
+ * @param d CFF parameter d (used for monotone construction).
+ * @param Fq_steps Array with finite field sizes.
+ * @param fqs_count Number of elements in Fq_steps.
+ * @param K_steps Array with maximum polynomial degrees.
+ * @param ks_count Number of elements in K_steps.
+ */
+static void write_text_header(FILE* file, char construction, int d, const long* Fq_steps, int fqs_count, const long* K_steps, int ks_count);
+
+/**
+ * @brief Fills the header of a binary CFF file.
+ * 
+ * @param header Header to be filled.
+ * @param construction Construction type ('p' or 'm').
+ * @param d CFF parameter d.
+ * @param Fq_steps Array with finite field sizes.
+ * @param K_steps Array with maximum polynomial degrees.
+ * @param num_steps Number of steps (at most CFF_BINARY_MAX_STEPS).
+ * @param rows Number of rows in the matrix.
+ * @param cols Number of columns in the matrix.
+ */
+static void fill_binary_header(struct cff_binary_header* header, char construction, int d, const long* Fq_steps, const long* K_steps, int num_steps, long rows, long cols);
+
+/**
+ * @brief Formats a batch of rows into a ring buffer of a streaming writer.
+ * 
+ * @param stream Streaming writer.
+ * @param out Ring buffer.
+ * @param rows Rows in bitmap format.
+ * @param count Number of rows (at most stream->slot_rows).
+ */
+static void format_stream_rows(struct cff_stream_writer* stream, char* out, uint64_t** rows, long count);
+
+/**
+ * @brief Body of the writer thread of a streaming writer.
+ * 
+ * @param arg Streaming writer.
+ * @return NULL.
+ */
+static void* stream_writer_thread(void* arg);
+
+/**
+ * @brief Stores one element index as an element_bytes-wide label entry.
+ * 
+ * @param out Buffer of label entries.
+ * @param entry Position of the entry in the buffer.
+ * @param value Element index.
+ * @param bytes Width of each entry (1, 2 or 4 bytes).
+ */
+static inline void store_label_entry(uint8_t* out, long entry, long value, int bytes);
+
+/**
+ * @brief Packs (x, y) pairs into label entries.
+ * 
+ * @param out Output buffer of count * 2 * bytes bytes.
+ * @param pairs Pairs to be packed.
+ * @param count Number of pairs.
+ * @param p Characteristic of the field.
+ * @param bytes Width of each entry (1, 2 or 4 bytes).
+ */
+static void pack_label_pairs(uint8_t* out, const element_pair* pairs, long count, ulong p, int bytes);
+
+/**
+ * @brief Packs the coefficients of polynomials into label entries.
+ * 
+ * @param out Output buffer of count * coeffs * bytes bytes.
+ * @param polys Polynomials to be packed.
+ * @param count Number of polynomials.
+ * @param coeffs Number of coefficients stored per polynomial.
+ * @param bytes Width of each entry (1, 2 or 4 bytes).
+ * @param step Step whose field the polynomials belong to.
+ */
+static void pack_label_polys(uint8_t* out, const fq_nmod_poly_t* polys, long count, long coeffs, int bytes, const cff_step* step);
+
+/**
+ * @brief Reads packed label entries and widens them to 32 bits.
+ * 
+ * @param file Open label file.
+ * @param count Number of entries.
+ * @param bytes Width of each entry (1, 2 or 4 bytes).
+ * @return Array of count entries, or NULL on a short read.
+ */
+static uint32_t* read_label_elements(FILE* file, long count, int bytes);
+
+/**
+ * @brief Opens a streaming writer, optionally for one shard of the file.
+ * 
+ * @param filename Output file path.
+ * @param format File format ('b' binary or 't' text).
+ * @param construction Construction type.
+ * @param d CFF parameter d.
+ * @param Fq_steps Array with finite field sizes.
+ * @param fqs_count Number of elements in Fq_steps.
+ * @param K_steps Array with maximum polynomial degrees.
+ * @param ks_count Number of elements in K_steps.
+ * @param rows Number of rows in the (merged) matrix.
+ * @param cols Number of columns in the matrix.
+ * @param shard Header of the shard to be written, or NULL for a whole file.
+ * @return Writer (released with close_cff_stream), or NULL on error.
+ */
+static struct cff_stream_writer* open_stream_writer(const char* filename, char format, char construction, int d, long* Fq_steps, int fqs_count, long* K_steps, int ks_count, long rows, long cols, const struct cff_shard_header* shard);
+
+/**
+ * @brief Copies a byte range of one file to the end of another.
+ * 
+ * @param in_fd Source file descriptor.
+ * @param offset Offset of the range in the source file.
+ * @param out_fd Destination file descriptor, positioned where the range goes.
+ * @param length Number of bytes to copy.
+ * @return 1 on success, 0 on a read or write error.
+ */
+static int copy_file_bytes(int in_fd, off_t offset, int out_fd, off_t length);
 
 /* 
  *  FILE READING FUNCTIONS
  */
 
 /**
- * @brief Reads CFF parameters from a file.
+ * @brief Reads CFF parameters from a file.
+ * 
+ * Extracts the construction type, d parameter (if applicable), and the
+ * arrays of field sizes (Fqs) and degrees (ks) from the file's first line,
+ * or from the header alone for binary files.
+ * 
+ * @param filename Path to the file to be read.
+ * @return Pointer to structure with parameters, or NULL on error.
+ */
+struct cff_parameters* read_parameters(const char* filename) {
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL) {
+        printf("Input file '%s' not found.\n", filename);
+        return NULL;
+    }
+
+    struct cff_binary_header header;
+    if (read_binary_header(file, &header)) {
+        fclose(file);
+        return parameters_from_steps(header.construction, header.d, header.num_steps, header.Fq_steps, header.k_steps);
+    }
+    rewind(file);
+
+    struct cff_csc_header csc_header;
+    if (read_csc_header(file, &csc_header)) {
+        fclose(file);
+        return parameters_from_steps(csc_header.construction, csc_header.d, csc_header.num_steps, csc_header.Fq_steps, csc_header.k_steps);
+    }
+    rewind(file);
+
+    struct cff_ef_header ef_header;
+    if (read_ef_header(file, &ef_header)) {
+        fclose(file);
+        return parameters_from_steps(ef_header.construction, ef_header.d, ef_header.num_steps, ef_header.Fq_steps, ef_header.k_steps);
+    }
+    rewind(file);
+
+    cff_recipe recipe;
+    if (read_cff_recipe_stream(file, &recipe)) {
+        fclose(file);
+        return parameters_from_recipe(&recipe);
+    }
+    rewind(file);
+
+    char magic[sizeof(CFF_ARCHIVE_MAGIC)];
+    if (fread(magic, 1, sizeof(magic), file) == sizeof(magic) && memcmp(magic, CFF_ARCHIVE_MAGIC, sizeof(magic)) == 0) {
+        fclose(file);
+        struct cff_archive_index index;
+        if (!read_cff_archive_index(filename, &index)) return NULL;
+        struct cff_parameters* params = parameters_from_archive(&index, index.num_steps);
+        free_cff_archive_index(&index);
+        return params;
+    }
+    rewind(file);
+
+    char* line = NULL;
+    size_t len = 0;
+    ssize_t line_length = getline(&line, &len, file);
+    fclose(file);
+
+    if (line_length == -1) {
+        printf("Error: File is empty or could not read the line.\n");
+        if (line) free(line);
+        return NULL;
+    }
+
+    struct cff_parameters* params = parse_parameters_line(line, line_length);
+    free(line);
+    return params;
+}
+
+/**
+ * @brief Reads a CFF matrix from a text file.
+ * 
+ * The file is mapped and parsed in a single pass, skipping the first
+ * parameter line (see parse_text_matrix).
+ * The matrix is stored in 64-bit bitmap format for efficiency.
+ * 
+ * @param filename Path to the file to be read.
+ * @param rows Pointer to store the number of rows.
+ * @param cols Pointer to store the number of columns.
+ * @return CFF matrix in bitmap format, or NULL if file doesn't exist.
+ */
+uint64_t** read_cff_from_file(const char* filename, long* rows, long* cols) {
+    *rows = 0; *cols = 0;
+
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL) {
+        printf("Input file '%s' not found. Starting from scratch.\n", filename);
+        return NULL;
+    }
+
+    uint64_t** matrix = read_text_matrix(file, filename, rows, cols, NULL);
+    fclose(file);
+    return matrix;
+}
+
+/**
+ * @brief Loads a CFF file of either format with a single open.
+ * 
+ * Binary files are mapped and used in place, CSC and Elias-Fano files are
+ * expanded to the bitmap format, recipes are regenerated through an oracle, archives
+ * are rebuilt at their last step and text files are mapped and parsed in
+ * a single pass.
+ * The parameters come from the same open file, so the caller does not
+ * need read_parameters.
+ * 
+ * @param filename Path to the file to be read (binary, CSC, Elias-Fano, recipe, archive or text).
+ * @param rows Pointer to store the number of rows.
+ * @param cols Pointer to store the number of columns.
+ * @param params Pointer to store the parameters (freed by the caller).
+ * @param mapped Pointer to store 1 if the matrix must be released with unmap_cff_matrix.
+ * @return CFF matrix in bitmap format, or NULL on error.
+ */
+uint64_t** load_cff_file(const char* filename, long* rows, long* cols, struct cff_parameters** params, int* mapped) {
+    *rows = 0; *cols = 0;
+    *params = NULL;
+    *mapped = 0;
+
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL) {
+        printf("Input file '%s' not found.\n", filename);
+        return NULL;
+    }
+
+    uint64_t** matrix = NULL;
+    struct cff_binary_header header;
+    struct cff_csc_header csc_header;
+    struct cff_ef_header ef_header;
+    cff_recipe recipe;
+    char magic[sizeof(CFF_ARCHIVE_MAGIC)];
+    if (read_binary_header(file, &header)) {
+        *params = parameters_from_steps(header.construction, header.d, header.num_steps, header.Fq_steps, header.k_steps);
+        matrix = map_binary_matrix(file, &header, filename, rows, cols);
+        *mapped = 1;
+    } else if (rewind(file), read_csc_header(file, &csc_header)) {
+        *params = parameters_from_steps(csc_header.construction, csc_header.d, csc_header.num_steps, csc_header.Fq_steps, csc_header.k_steps);
+        struct cff_csc_matrix* csc = read_csc_matrix(file, &csc_header, filename);
+        if (csc != NULL) {
+            matrix = csc_to_bitmap(csc);
+            *rows = csc->rows;
+            *cols = csc->cols;
+            free_cff_csc(csc);
+        }
+    } else if (rewind(file), read_ef_header(file, &ef_header)) {
+        *params = parameters_from_steps(ef_header.construction, ef_header.d, ef_header.num_steps, ef_header.Fq_steps, ef_header.k_steps);
+        struct cff_ef_matrix* ef = read_ef_matrix(file, &ef_header, filename);
+        if (ef != NULL) {
+            matrix = ef_to_bitmap(ef);
+            *rows = ef->rows;
+            *cols = ef->cols;
+            free_cff_ef(ef);
+        }
+    } else if (rewind(file), read_cff_recipe_stream(file, &recipe)) {
+        *params = parameters_from_recipe(&recipe);
+        cff_oracle* oracle = create_cff_oracle(&recipe);
+        if (oracle != NULL) {
+            matrix = materialize_cff(oracle);
+            *rows = oracle->rows;
+            *cols = oracle->cols;
+            free_cff_oracle(oracle);
+        }
+    } else if (rewind(file), fread(magic, 1, sizeof(magic), file) == sizeof(magic) && memcmp(magic, CFF_ARCHIVE_MAGIC, sizeof(magic)) == 0) {
+        struct cff_archive_index index;
+        if (read_cff_archive_index(filename, &index)) {
+            *params = parameters_from_archive(&index, index.num_steps);
+            matrix = extract_cff_archive_step(filename, index.num_steps, rows, cols);
+            free_cff_archive_index(&index);
+        }
+    } else if (memcmp(magic, CFF_CSR_MAGIC, sizeof(magic)) == 0 || memcmp(magic, "%%Matrix", sizeof(magic)) == 0) {
+        printf("Error: '%s' is a CSR or Matrix Market export and cannot be used as input.\n", filename);
+    } else {
+        rewind(file);
+        matrix = read_text_matrix(file, filename, rows, cols, params);
+    }
+
+    fclose(file);
+    return matrix;
+}
+
+/**
+ * @brief Maps the matrix of a binary CFF file into memory.
+ * 
+ * The file is mapped read-only and the returned row pointers point straight
+ * into the mapping, so no bit is parsed or copied. The matrix must be
+ * released with unmap_cff_matrix.
+ * 
+ * @param filename Path to the file to be read.
+ * @param rows Pointer to store the number of rows.
+ * @param cols Pointer to store the number of columns.
+ * @return Read-only CFF matrix whose rows point into the mapping, or NULL on error.
+ */
+uint64_t** map_cff_binary_file(const char* filename, long* rows, long* cols) {
+    *rows = 0; *cols = 0;
+
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL) {
+        printf("Input file '%s' not found.\n", filename);
+        return NULL;
+    }
+
+    struct cff_binary_header header;
+    if (!read_binary_header(file, &header)) {
+        printf("Error: '%s' is not a binary CFF file.\n", filename);
+        fclose(file);
+        return NULL;
+    }
+
+    uint64_t** matrix = map_binary_matrix(file, &header, filename, rows, cols);
+    fclose(file);
+    return matrix;
+}
+
+/**
+ * @brief Reads a compressed sparse column (CSC) CFF file.
+ * 
+ * @param filename Path to the file to be read.
+ * @param params Pointer to store the parameters, or NULL to skip them.
+ * @return CSC matrix (freed with free_cff_csc), or NULL on error.
+ */
+struct cff_csc_matrix* read_cff_csc_file(const char* filename, struct cff_parameters** params) {
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL) {
+        printf("Input file '%s' not found.\n", filename);
+        return NULL;
+    }
+
+    struct cff_csc_header header;
+    if (!read_csc_header(file, &header)) {
+        printf("Error: '%s' is not a CSC CFF file.\n", filename);
+        fclose(file);
+        return NULL;
+    }
+    if (params != NULL) {
+        *params = parameters_from_steps(header.construction, header.d, header.num_steps, header.Fq_steps, header.k_steps);
+    }
+
+    struct cff_csc_matrix* csc = read_csc_matrix(file, &header, filename);
+    fclose(file);
+    return csc;
+}
+
+/**
+ * @brief Converts a CFF matrix from the bitmap format to CSC.
+ * 
+ * The bitmap is transposed in two parallel passes (count, then fill) over
+ * 64-column word slices, so each column is owned by a single thread and
+ * its indices come out sorted.
+ * 
+ * @param matrix CFF matrix in bitmap format.
+ * @param rows Number of rows in the matrix.
+ * @param cols Number of columns in the matrix.
+ * @return CSC matrix (freed with free_cff_csc).
+ */
+struct cff_csc_matrix* bitmap_to_csc(uint64_t** matrix, long rows, long cols) {
+    long words_per_row = WORDS_FOR_BITS(cols);
+    struct cff_csc_matrix* csc = (struct cff_csc_matrix*) calloc(1, sizeof(struct cff_csc_matrix));
+    if (csc == NULL) exit(EXIT_FAILURE);
+    csc->rows = rows;
+    csc->cols = cols;
+    csc->col_offsets = (int64_t*) calloc(cols + 1, sizeof(int64_t));
+    if (csc->col_offsets == NULL) exit(EXIT_FAILURE);
+
+    #pragma omp parallel for schedule(static)
+    for (long w = 0; w < words_per_row; w++) {
+        for (long i = 0; i < rows; i++) {
+            for (uint64_t word = matrix[i][w]; word != 0; word &= word - 1) {
+                long j = w * BITS_PER_WORD + __builtin_ctzll(word);
+                if (j < cols) csc->col_offsets[j + 1]++;
+            }
+        }
+    }
+    for (long j = 0; j < cols; j++) csc->col_offsets[j + 1] += csc->col_offsets[j];
+
+    csc->index_bytes = ((uint64_t) rows > UINT32_MAX) ? 8 : 4;
+    csc->row_indices = malloc((csc->col_offsets[cols] + 1) * csc->index_bytes);
+    if (csc->row_indices == NULL) exit(EXIT_FAILURE);
+
+    #pragma omp parallel for schedule(static)
+    for (long w = 0; w < words_per_row; w++) {
+        int64_t cursor[BITS_PER_WORD];
+        for (int b = 0; b < BITS_PER_WORD && w * BITS_PER_WORD + b < cols; b++) {
+            cursor[b] = csc->col_offsets[w * BITS_PER_WORD + b];
+        }
+        for (long i = 0; i < rows; i++) {
+            for (uint64_t word = matrix[i][w]; word != 0; word &= word - 1) {
+                int b = __builtin_ctzll(word);
+                if (w * BITS_PER_WORD + b >= cols) continue;
+                if (csc->index_bytes == 8) ((uint64_t*) csc->row_indices)[cursor[b]++] = (uint64_t) i;
+                else ((uint32_t*) csc->row_indices)[cursor[b]++] = (uint32_t) i;
+            }
+        }
+    }
+    return csc;
+}
+
+/**
+ * @brief Expands a CSC matrix into the bitmap format.
+ * 
+ * Columns are processed 64 at a time, so every bitmap word is written by
+ * a single thread.
+ * 
+ * @param csc CSC matrix.
+ * @return CFF matrix in bitmap format.
+ */
+uint64_t** csc_to_bitmap(const struct cff_csc_matrix* csc) {
+    if (csc->rows == 0) return NULL;
+
+    long words_per_row = WORDS_FOR_BITS(csc->cols);
+    uint64_t** matrix = (uint64_t**) malloc(csc->rows * sizeof(uint64_t*));
+    if (matrix == NULL) exit(EXIT_FAILURE);
+    for (long i = 0; i < csc->rows; i++) {
+        matrix[i] = (uint64_t*) calloc(words_per_row, sizeof(uint64_t));
+        if (matrix[i] == NULL) exit(EXIT_FAILURE);
+    }
+
+    #pragma omp parallel for schedule(static)
+    for (long w = 0; w < words_per_row; w++) {
+        long col_end = (w + 1) * BITS_PER_WORD < csc->cols ? (w + 1) * BITS_PER_WORD : csc->cols;
+        for (long j = w * BITS_PER_WORD; j < col_end; j++) {
+            for (int64_t k = csc->col_offsets[j]; k < csc->col_offsets[j + 1]; k++) {
+                SET_BIT(matrix[csc_row_index(csc, k)], j);
+            }
+        }
+    }
+    return matrix;
+}
+
+/**
+ * @brief Returns one row index of a CSC matrix, whatever its width.
+ * 
+ * @param csc CSC matrix.
+ * @param k Position in row_indices.
+ * @return Row index.
+ */
+uint64_t csc_row_index(const struct cff_csc_matrix* csc, int64_t k) {
+    if (csc->index_bytes == 8) return ((const uint64_t*) csc->row_indices)[k];
+    return ((const uint32_t*) csc->row_indices)[k];
+}
+
+/**
+ * @brief Frees a CSC matrix.
+ * 
+ * @param csc CSC matrix to be freed.
+ */
+void free_cff_csc(struct cff_csc_matrix* csc) {
+    if (!csc) return;
+    free(csc->col_offsets);
+    free(csc->row_indices);
+    free(csc);
+}
+
+/**
+ * @brief Encodes a CFF matrix as Elias-Fano columns.
+ * 
+ * Column weights are counted first and grouped into runs, which fixes the
+ * position of every column. The columns are then encoded in one parallel
+ * pass over 64-column word slices, as in write_cff_to_csc_file, so the
+ * ones of each column arrive in row order.
+ * 
+ * @param matrix CFF matrix in bitmap format.
+ * @param rows Number of rows in the matrix.
+ * @param cols Number of columns in the matrix.
+ * @return Encoded matrix (freed with free_cff_ef).
+ */
+struct cff_ef_matrix* bitmap_to_ef(uint64_t** matrix, long rows, long cols) {
+    long words_per_row = WORDS_FOR_BITS(cols);
+    int64_t* weights = (int64_t*) calloc(cols + 1, sizeof(int64_t));
+    struct cff_ef_matrix* ef = (struct cff_ef_matrix*) calloc(1, sizeof(struct cff_ef_matrix));
+    if (weights == NULL || ef == NULL) exit(EXIT_FAILURE);
+
+    #pragma omp parallel for schedule(static)
+    for (long w = 0; w < words_per_row; w++) {
+        for (long i = 0; i < rows; i++) {
+            for (uint64_t word = matrix[i][w]; word != 0; word &= word - 1) {
+                long j = w * BITS_PER_WORD + __builtin_ctzll(word);
+                if (j < cols) weights[j]++;
+            }
+        }
+    }
+
+    ef->rows = rows;
+    ef->cols = cols;
+    long capacity = 16;
+    ef->runs = (struct cff_ef_run*) malloc(capacity * sizeof(struct cff_ef_run));
+    if (ef->runs == NULL) exit(EXIT_FAILURE);
+    for (long j = 0; j < cols; j++) {
+        if (ef->num_runs > 0 && ef->runs[ef->num_runs - 1].weight == weights[j]) {
+            ef->runs[ef->num_runs - 1].count++;
+        } else {
+            if (ef->num_runs == capacity) {
+                capacity *= 2;
+                ef->runs = (struct cff_ef_run*) realloc(ef->runs, capacity * sizeof(struct cff_ef_run));
+                if (ef->runs == NULL) exit(EXIT_FAILURE);
+            }
+            ef->runs[ef->num_runs].first_col = j;
+            ef->runs[ef->num_runs].count = 1;
+            ef->runs[ef->num_runs].weight = weights[j];
+            ef->num_runs++;
+        }
+    }
+    free(weights);
+    layout_ef_runs(ef);
+
+    #pragma omp parallel for schedule(static)
+    for (long w = 0; w < words_per_row; w++) {
+        int64_t cursor[BITS_PER_WORD] = {0};
+        int64_t base[BITS_PER_WORD];
+        const struct cff_ef_run* run_of[BITS_PER_WORD];
+        for (int b = 0; b < BITS_PER_WORD && w * BITS_PER_WORD + b < cols; b++) {
+            long j = w * BITS_PER_WORD + b;
+            run_of[b] = &ef->runs[find_ef_run(ef, j)];
+            base[b] = run_of[b]->first_bit + (j - run_of[b]->first_col) * run_of[b]->col_bits;
+        }
+        for (long i = 0; i < rows; i++) {
+            for (uint64_t word = matrix[i][w]; word != 0; word &= word - 1) {
+                int b = __builtin_ctzll(word);
+                if (w * BITS_PER_WORD + b >= cols) continue;
+                const struct cff_ef_run* run = run_of[b];
+                int64_t n = cursor[b]++;
+                or_ef_bits(ef->bits, base[b] + n * run->low_bits, (uint64_t) i, (int) run->low_bits);
+                int64_t high = base[b] + run->weight * run->low_bits + ((uint64_t) i >> run->low_bits) + n;
+                or_ef_bits(ef->bits, high, 1, 1);
+            }
+        }
+    }
+    return ef;
+}
+
+/**
+ * @brief Decodes one column of an Elias-Fano matrix.
+ * 
+ * The column is located from its run alone, so access is random and costs
+ * a search over the runs plus a scan of the column's own bits.
+ * 
+ * @param ef Encoded matrix.
+ * @param col Column index.
+ * @param rows_out Buffer of at least the column weight entries to store the row indices, ascending.
+ * @return Number of rows stored.
+ */
+long ef_get_column(const struct cff_ef_matrix* ef, long col, long* rows_out) {
+    if (col < 0 || col >= ef->cols) return 0;
+
+    const struct cff_ef_run* run = &ef->runs[find_ef_run(ef, col)];
+    int low_bits = (int) run->low_bits;
+    int64_t base = run->first_bit + (col - run->first_col) * run->col_bits;
+    int64_t high_base = base + run->weight * low_bits;
+
+    long found = 0;
+    for (int64_t pos = 0; found < run->weight && pos < run->col_bits; pos += BITS_PER_WORD) {
+        for (uint64_t word = read_ef_bits(ef->bits, high_base + pos, BITS_PER_WORD); word != 0 && found < run->weight; word &= word - 1) {
+            int64_t high = pos + __builtin_ctzll(word) - found;
+            uint64_t low = read_ef_bits(ef->bits, base + found * low_bits, low_bits);
+            rows_out[found] = (long) (((uint64_t) high << low_bits) | low);
+            found++;
+        }
+    }
+    return found;
+}
+
+/**
+ * @brief Expands an Elias-Fano matrix into the bitmap format.
+ * 
+ * Columns are decoded sequentially, 64 at a time, so every bitmap word is
+ * written by a single thread.
+ * 
+ * @param ef Encoded matrix.
+ * @return CFF matrix in bitmap format.
+ */
+uint64_t** ef_to_bitmap(const struct cff_ef_matrix* ef) {
+    if (ef->rows == 0) return NULL;
+
+    long words_per_row = WORDS_FOR_BITS(ef->cols);
+    uint64_t** matrix = (uint64_t**) malloc(ef->rows * sizeof(uint64_t*));
+    if (matrix == NULL) exit(EXIT_FAILURE);
+    for (long i = 0; i < ef->rows; i++) {
+        matrix[i] = (uint64_t*) calloc(words_per_row, sizeof(uint64_t));
+        if (matrix[i] == NULL) exit(EXIT_FAILURE);
+    }
+
+    int64_t max_weight = 0;
+    for (long r = 0; r < ef->num_runs; r++) {
+        if (ef->runs[r].weight > max_weight) max_weight = ef->runs[r].weight;
+    }
+
+    #pragma omp parallel
+    {
+        long* column = (long*) malloc((max_weight + 1) * sizeof(long));
+        if (column == NULL) exit(EXIT_FAILURE);
+
+        #pragma omp for schedule(static)
+        for (long w = 0; w < words_per_row; w++) {
+            long col_end = (w + 1) * BITS_PER_WORD < ef->cols ? (w + 1) * BITS_PER_WORD : ef->cols;
+            for (long j = w * BITS_PER_WORD; j < col_end; j++) {
+                long count = ef_get_column(ef, j, column);
+                for (long k = 0; k < count; k++) SET_BIT(matrix[column[k]], j);
+            }
+        }
+        free(column);
+    }
+    return matrix;
+}
+
+/**
+ * @brief Reads an Elias-Fano compressed CFF file.
+ * 
+ * @param filename Path to the file to be read.
+ * @param params Pointer to store the parameters, or NULL to skip them.
+ * @return Encoded matrix (freed with free_cff_ef), or NULL on error.
+ */
+struct cff_ef_matrix* read_cff_ef_file(const char* filename, struct cff_parameters** params) {
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL) {
+        printf("Input file '%s' not found.\n", filename);
+        return NULL;
+    }
+
+    struct cff_ef_header header;
+    if (!read_ef_header(file, &header)) {
+        printf("Error: '%s' is not an Elias-Fano CFF file.\n", filename);
+        fclose(file);
+        return NULL;
+    }
+    if (params != NULL) {
+        *params = parameters_from_steps(header.construction, header.d, header.num_steps, header.Fq_steps, header.k_steps);
+    }
+
+    struct cff_ef_matrix* ef = read_ef_matrix(file, &header, filename);
+    fclose(file);
+    return ef;
+}
+
+/**
+ * @brief Frees an Elias-Fano matrix.
+ * 
+ * @param ef Encoded matrix to be freed.
+ */
+void free_cff_ef(struct cff_ef_matrix* ef) {
+    if (!ef) return;
+    free(ef->runs);
+    free(ef->bits);
+    free(ef);
+}
+
+/**
+ * @brief Releases a matrix returned by map_cff_binary_file.
+ * 
+ * @param matrix Mapped CFF matrix.
+ * @param rows Number of rows in the matrix.
+ * @param cols Number of columns in the matrix.
+ */
+void unmap_cff_matrix(uint64_t** matrix, long rows, long cols) {
+    if (matrix == NULL) return;
+    size_t length = CFF_BINARY_DATA_OFFSET + (size_t) rows * WORDS_FOR_BITS(cols) * sizeof(uint64_t);
+    munmap((char*) matrix[0] - CFF_BINARY_DATA_OFFSET, length);
+    free(matrix);
+}
+
+/**
+ * @brief Checks whether a file is in the binary CFF format.
+ * 
+ * @param filename Path to the file.
+ * @return 1 if the file starts with CFF_BINARY_MAGIC, 0 otherwise.
+ */
+int is_cff_binary_file(const char* filename) {
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL) return 0;
+
+    char magic[sizeof(CFF_BINARY_MAGIC)];
+    int binary = (fread(magic, 1, sizeof(magic), file) == sizeof(magic) && memcmp(magic, CFF_BINARY_MAGIC, sizeof(magic)) == 0);
+    fclose(file);
+    return binary;
+}
+
+/**
+ * @brief Checks whether two paths name the same file.
+ * 
+ * @param a First path.
+ * @param b Second path.
+ * @return 1 if both paths exist and have the same device and inode, 0 otherwise.
+ */
+int is_same_cff_file(const char* a, const char* b) {
+    struct stat st_a, st_b;
+    if (stat(a, &st_a) != 0 || stat(b, &st_b) != 0) return 0;
+    return st_a.st_dev == st_b.st_dev && st_a.st_ino == st_b.st_ino;
+}
+
+/**
+ * @brief Opens a sequential row reader on a text or binary CFF stream.
+ * 
+ * Binary streams are recognised by their first byte (text files start
+ * with the construction letter). For text streams the first row is read
+ * ahead to count the columns; the number of rows is only known at the end.
+ * 
+ * @param file Input stream, positioned at the start of the CFF.
+ * @param params Pointer to store the parameters of the CFF.
+ * @return Reader (released with close_cff_row_reader), or NULL on error.
+ */
+struct cff_row_reader* open_cff_row_reader(FILE* file, struct cff_parameters** params) {
+    *params = NULL;
+
+    struct cff_row_reader* reader = (struct cff_row_reader*) calloc(1, sizeof(struct cff_row_reader));
+    if (reader == NULL) exit(EXIT_FAILURE);
+    reader->file = file;
+    reader->pending = -1;
+
+    int first = getc(file);
+    if (first == EOF) {
+        printf("Error: Input stream is empty.\n");
+        free(reader);
+        return NULL;
+    }
+    ungetc(first, file);
+
+    if (first == CFF_BINARY_MAGIC[0]) {
+        struct cff_binary_header header;
+        char padding[CFF_BINARY_DATA_OFFSET];
+        if (!read_binary_header(file, &header) || fread(padding, 1, CFF_BINARY_DATA_OFFSET - sizeof(header), file) != CFF_BINARY_DATA_OFFSET - sizeof(header)) {
+            printf("Error: Input stream is not a text or binary CFF.\n");
+            free(reader);
+            return NULL;
+        }
+        reader->format = 'b';
+        reader->rows = header.rows;
+        reader->cols = header.cols;
+        *params = parameters_from_steps(header.construction, header.d, header.num_steps, header.Fq_steps, header.k_steps);
+        return reader;
+    }
+
+    reader->format = 't';
+    reader->rows = -1;
+    ssize_t length = getline(&reader->line, &reader->line_capacity, file);
+    if (length > 0) *params = parse_parameters_line(reader->line, (size_t) length);
+
+    reader->pending = getline(&reader->line, &reader->line_capacity, file);
+    for (ssize_t c = 0; c < reader->pending; ) {
+        const char* line = reader->line;
+        while (c < reader->pending && (line[c] == ' ' || line[c] == '\t' || line[c] == '\r' || line[c] == '\n')) c++;
+        if (c == reader->pending) break;
+        reader->cols++;
+        while (c < reader->pending && line[c] != ' ' && line[c] != '\t' && line[c] != '\r' && line[c] != '\n') c++;
+    }
+    return reader;
+}
+
+/**
+ * @brief Reads the next row of a CFF stream.
+ * 
+ * @param reader Row reader.
+ * @param row Zeroed buffer of WORDS_FOR_BITS(reader->cols) words.
+ * @return 1 if a row was read, 0 at the end of the matrix.
+ */
+int read_cff_row(struct cff_row_reader* reader, uint64_t* row) {
+    if (reader->format == 'b') {
+        if (reader->rows_read == reader->rows) return 0;
+        size_t words = (size_t) WORDS_FOR_BITS(reader->cols);
+        if (fread(row, sizeof(uint64_t), words, reader->file) != words) {
+            printf("Error: Binary input stream ended after %ld of %ld rows.\n", reader->rows_read, reader->rows);
+            reader->rows = reader->rows_read;
+            return 0;
+        }
+    } else {
+        ssize_t length = reader->pending;
+        if (length < 0) length = getline(&reader->line, &reader->line_capacity, reader->file);
+        reader->pending = -1;
+        if (length < 0) return 0;
+        long count = parse_text_row(row, reader->line, (size_t) length, reader->cols);
+        if (count != reader->cols) {
+            printf("Error: Row %ld of the input stream has %ld columns, expected %ld.\n", reader->rows_read, count, reader->cols);
+            reader->rows = reader->rows_read;
+            return 0;
+        }
+    }
+    reader->rows_read++;
+    return 1;
+}
+
+/**
+ * @brief Skips rows of a CFF stream.
+ * 
+ * Binary streams seek over the rows when the stream allows it; pipes and
+ * text streams read and discard them.
+ * 
+ * @param reader Row reader.
+ * @param count Number of rows to skip.
+ * @return Number of rows skipped (fewer at the end of the matrix).
+ */
+long skip_cff_rows(struct cff_row_reader* reader, long count) {
+    if (count <= 0) return 0;
+    if (reader->format == 'b') {
+        if (count > reader->rows - reader->rows_read) count = reader->rows - reader->rows_read;
+        off_t bytes = (off_t) count * WORDS_FOR_BITS(reader->cols) * (off_t) sizeof(uint64_t);
+        if (fseeko(reader->file, bytes, SEEK_CUR) == 0) {
+            reader->rows_read += count;
+            return count;
+        }
+    }
+
+    uint64_t* row = (uint64_t*) calloc(WORDS_FOR_BITS(reader->cols) + 1, sizeof(uint64_t));
+    if (row == NULL) exit(EXIT_FAILURE);
+    long skipped = 0;
+    while (skipped < count && read_cff_row(reader, row)) skipped++;
+    free(row);
+    return skipped;
+}
+
+/**
+ * @brief Releases a row reader (the stream itself is not closed).
+ * 
+ * @param reader Row reader.
+ */
+void close_cff_row_reader(struct cff_row_reader* reader) {
+    if (!reader) return;
+    free(reader->line);
+    free(reader);
+}
+
+/*
+ * FILE WRITING FUNCTIONS
+ */
+
+/**
+ * @brief Writes a CFF matrix to a file.
+ * 
+ * Saves the parameters on the first line and the binary matrix on subsequent lines.
+ * Every text row has the same length, so rows are formatted in parallel into
+ * the buffers of a streaming writer, expanding whole bytes of the bitmap
+ * through a lookup table, while its writer thread writes the previous buffer.
+ * 
+ * @param filename Output file path.
+ * @param construction Construction type ('p' or 'm').
+ * @param d CFF parameter d (used for monotone construction).
+ * @param Fq_steps Array with finite field sizes.
+ * @param fqs_count Number of elements in Fq_steps.
+ * @param K_steps Array with maximum polynomial degrees.
+ * @param ks_count Number of elements in K_steps.
+ * @param matrix CFF matrix in bitmap format.
+ * @param rows Number of rows in the matrix.
+ * @param cols Number of columns in the matrix.
+ * @return 1 on success, 0 (with an error message) on error.
+ */
+int write_cff_to_file(const char* filename, char construction, int d, long* Fq_steps, int fqs_count, long* K_steps, int ks_count, uint64_t** matrix, long rows, long cols){
+    struct cff_stream_writer* stream = open_cff_stream(filename, 't', construction, d, Fq_steps, fqs_count, K_steps, ks_count, rows, cols);
+    if (stream == NULL) return 0;
+    write_cff_stream_rows(stream, matrix, rows);
+    return close_cff_stream(stream);
+}
+
+/**
+ * @brief Writes a CFF matrix to a binary file.
+ * 
+ * Saves a fixed-size header, padded to CFF_BINARY_DATA_OFFSET, followed by
+ * the raw 64-bit words of every row, so the file can be mapped and used
+ * in place by map_cff_binary_file. Rows are written through a streaming
+ * writer in large buffers.
+ * 
+ * @param filename Output file path.
+ * @param construction Construction type ('p' or 'm').
+ * @param d CFF parameter d (used for monotone construction).
+ * @param Fq_steps Array with finite field sizes.
+ * @param fqs_count Number of elements in Fq_steps.
+ * @param K_steps Array with maximum polynomial degrees.
+ * @param ks_count Number of elements in K_steps.
+ * @param matrix CFF matrix in bitmap format.
+ * @param rows Number of rows in the matrix.
+ * @param cols Number of columns in the matrix.
+ * @return 1 on success, 0 (with an error message) on error.
+ */
+int write_cff_to_binary_file(const char* filename, char construction, int d, long* Fq_steps, int fqs_count, long* K_steps, int ks_count, uint64_t** matrix, long rows, long cols) {
+    struct cff_stream_writer* stream = open_cff_stream(filename, 'b', construction, d, Fq_steps, fqs_count, K_steps, ks_count, rows, cols);
+    if (stream == NULL) return 0;
+    write_cff_stream_rows(stream, matrix, rows);
+    return close_cff_stream(stream);
+}
+
+/**
+ * @brief Opens a streaming writer for a text or binary CFF file.
+ * 
+ * Writes the header and starts the writer thread. The ring holds
+ * CFF_WRITE_RING_SLOTS buffers of CFF_TEXT_BUFFER_BYTES in total (at least
+ * one row each): while the writer thread writes one buffer, the calling
+ * threads format the next ones, and they wait only when every buffer is
+ * full.
+ * 
+ * @param filename Output file path.
+ * @param format File format ('b' binary or 't' text).
+ * @param construction Construction type ('p' or 'm').
+ * @param d CFF parameter d (used for monotone construction).
+ * @param Fq_steps Array with finite field sizes.
+ * @param fqs_count Number of elements in Fq_steps.
+ * @param K_steps Array with maximum polynomial degrees.
+ * @param ks_count Number of elements in K_steps.
+ * @param rows Number of rows that will be written.
+ * @param cols Number of columns in the matrix.
+ * @return Writer (released with close_cff_stream), or NULL on error.
+ */
+struct cff_stream_writer* open_cff_stream(const char* filename, char format, char construction, int d, long* Fq_steps, int fqs_count, long* K_steps, int ks_count, long rows, long cols) {
+    return open_stream_writer(filename, format, construction, d, Fq_steps, fqs_count, K_steps, ks_count, rows, cols, NULL);
+}
+
+/**
+ * @brief Opens a streaming writer for one shard of a text or binary CFF file.
+ * 
+ * The shard header takes the first page of the file; the rows follow in
+ * the format of the merged file, and shard 0 also writes its header, so
+ * merge_cff_shards only has to concatenate the shards.
+ * 
+ * @param filename Shard file path.
+ * @param format Format of the merged file ('b' binary or 't' text).
+ * @param construction Construction type ('p' or 'm').
+ * @param d CFF parameter d (used for monotone construction).
+ * @param Fq_steps Array with finite field sizes.
+ * @param fqs_count Number of elements in Fq_steps.
+ * @param K_steps Array with maximum polynomial degrees.
+ * @param ks_count Number of elements in K_steps.
+ * @param rows Number of rows in the merged matrix.
+ * @param cols Number of columns in the matrix.
+ * @param shard Index of the shard.
+ * @param num_shards Number of shards.
+ * @param first_row First row of the shard.
+ * @param shard_rows Number of rows that will be written to the shard.
+ * @return Writer (released with close_cff_stream), or NULL on error.
+ */
+struct cff_stream_writer* open_cff_shard_stream(const char* filename, char format, char construction, int d, long* Fq_steps, int fqs_count, long* K_steps, int ks_count, long rows, long cols, int shard, int num_shards, long first_row, long shard_rows) {
+    if (fqs_count > CFF_BINARY_MAX_STEPS || ks_count > CFF_BINARY_MAX_STEPS) {
+        printf("Error: Shard files store at most %d steps.\n", CFF_BINARY_MAX_STEPS);
+        return NULL;
+    }
+
+    struct cff_shard_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CFF_SHARD_MAGIC, sizeof(header.magic));
+    header.format = format;
+    header.construction = construction;
+    header.d = d;
+    header.num_steps = fqs_count;
+    header.shard = shard;
+    header.num_shards = num_shards;
+    header.first_row = first_row;
+    header.rows = shard_rows;
+    header.total_rows = rows;
+    header.cols = cols;
+    for (int i = 0; i < fqs_count; i++) header.Fq_steps[i] = Fq_steps[i];
+    for (int i = 0; i < ks_count; i++) header.k_steps[i] = K_steps[i];
+
+    return open_stream_writer(filename, format, construction, d, Fq_steps, fqs_count, K_steps, ks_count, rows, cols, &header);
+}
+
+/**
+ * @brief Concatenates the shards of a CFF into the merged file.
+ * 
+ * Checks that the shards belong to the same matrix and cover its rows
+ * exactly once, then appends their data in row order. On Linux the data
+ * is copied with copy_file_range, so it moves inside the kernel (or the
+ * file system, which may share the extents) instead of through user
+ * space.
+ * 
+ * @param filename Output file path.
+ * @param shard_files Paths of the shard files, in any order.
+ * @param count Number of shard files.
+ * @param rows Pointer to store the number of rows of the merged matrix.
+ * @param cols Pointer to store the number of columns of the merged matrix.
+ * @return 1 on success, 0 if the shards are missing, inconsistent or unreadable.
+ */
+int merge_cff_shards(const char* filename, char* const* shard_files, int count, long* rows, long* cols) {
+    if (count < 1) {
+        printf("Error: No shard files to merge.\n");
+        return 0;
+    }
+    struct cff_shard_header* headers = (struct cff_shard_header*) calloc(count, sizeof(struct cff_shard_header));
+    int* fds = (int*) malloc(count * sizeof(int));
+    int* order = (int*) malloc(count * sizeof(int));
+    off_t* sizes = (off_t*) malloc(count * sizeof(off_t));
+    if (headers == NULL || fds == NULL || order == NULL || sizes == NULL) exit(EXIT_FAILURE);
+    for (int i = 0; i < count; i++) {
+        fds[i] = -1;
+        order[i] = -1;
+    }
+
+    int ok = 1;
+    for (int i = 0; i < count && ok; i++) {
+        struct stat st;
+        fds[i] = open(shard_files[i], O_RDONLY);
+        if (fds[i] < 0) {
+            printf("Input file '%s' not found.\n", shard_files[i]);
+            ok = 0;
+        } else if (pread(fds[i], &headers[i], sizeof(headers[i]), 0) != (ssize_t) sizeof(headers[i]) ||
+                   memcmp(headers[i].magic, CFF_SHARD_MAGIC, sizeof(headers[i].magic)) != 0 ||
+                   fstat(fds[i], &st) != 0 || st.st_size < CFF_SHARD_DATA_OFFSET) {
+            printf("Error: '%s' is not a shard file.\n", shard_files[i]);
+            ok = 0;
+        } else if (headers[i].num_shards != count || headers[i].shard < 0 || headers[i].shard >= count || order[headers[i].shard] >= 0) {
+            printf("Error: '%s' is shard %d of %d, but %d distinct shards were given.\n", shard_files[i], headers[i].shard, headers[i].num_shards, count);
+            ok = 0;
+        } else {
+            order[headers[i].shard] = i;
+            sizes[i] = st.st_size - CFF_SHARD_DATA_OFFSET;
+        }
+    }
+
+    struct cff_shard_header first;
+    memset(&first, 0, sizeof(first));
+    if (ok) {
+        first = headers[order[0]];
+        first.shard = 0;
+        first.first_row = 0;
+        first.rows = 0;
+    }
+    long next_row = 0;
+    for (int s = 0; s < count && ok; s++) {
+        int i = order[s];
+        struct cff_shard_header same = headers[i];
+        same.shard = 0;
+        same.first_row = 0;
+        same.rows = 0;
+
+        long row_bytes = (same.format == 'b') ? WORDS_FOR_BITS(same.cols) * (long) sizeof(uint64_t) : ((same.cols > 0) ? 2 * same.cols : 1);
+        off_t data_bytes = (off_t) headers[i].rows * row_bytes;
+        if (same.format == 'b' && s == 0) data_bytes += CFF_BINARY_DATA_OFFSET;
+
+        if (memcmp(&same, &first, sizeof(first)) != 0) {
+            printf("Error: '%s' belongs to a different matrix than '%s'.\n", shard_files[i], shard_files[order[0]]);
+            ok = 0;
+        } else if (headers[i].first_row != next_row) {
+            printf("Error: Shard '%s' starts at row %ld, expected %ld.\n", shard_files[i], (long) headers[i].first_row, next_row);
+            ok = 0;
+        } else if ((s > 0 || same.format == 'b') ? sizes[i] != data_bytes : sizes[i] < data_bytes) {
+            printf("Error: Shard '%s' is incomplete.\n", shard_files[i]);
+            ok = 0;
+        }
+        next_row += headers[i].rows;
+    }
+    if (ok && next_row != first.total_rows) {
+        printf("Error: The shards hold %ld of %ld rows.\n", next_row, (long) first.total_rows);
+        ok = 0;
+    }
+
+    if (ok) {
+        int out_fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (out_fd < 0) {
+            printf("Error opening file '%s' for writing.\n", filename);
+            ok = 0;
+        }
+        for (int s = 0; s < count && ok; s++) {
+            ok = copy_file_bytes(fds[order[s]], CFF_SHARD_DATA_OFFSET, out_fd, sizes[order[s]]);
+        }
+        if (out_fd >= 0 && close(out_fd) != 0) ok = 0;
+        if (out_fd >= 0 && !ok) printf("Error writing file '%s'.\n", filename);
+        *rows = first.total_rows;
+        *cols = first.cols;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (fds[i] >= 0) close(fds[i]);
+    }
+    free(headers);
+    free(fds);
+    free(order);
+    free(sizes);
+    return ok;
+}
+
+/**
+ * @brief Opens a streaming writer, optionally for one shard of the file.
+ * 
+ * Writes the header and starts the writer thread; see open_cff_stream and
+ * open_cff_shard_stream.
+ * 
+ * @param filename Output file path.
+ * @param format File format ('b' binary or 't' text).
+ * @param construction Construction type ('p' or 'm').
+ * @param d CFF parameter d (used for monotone construction).
+ * @param Fq_steps Array with finite field sizes.
+ * @param fqs_count Number of elements in Fq_steps.
+ * @param K_steps Array with maximum polynomial degrees.
+ * @param ks_count Number of elements in K_steps.
+ * @param rows Number of rows in the (merged) matrix.
+ * @param cols Number of columns in the matrix.
+ * @param shard Header of the shard to be written, or NULL for a whole file.
+ * @return Writer (released with close_cff_stream), or NULL on error.
+ */
+static struct cff_stream_writer* open_stream_writer(const char* filename, char format, char construction, int d, long* Fq_steps, int fqs_count, long* K_steps, int ks_count, long rows, long cols, const struct cff_shard_header* shard) {
+    if (format == 'b' && (fqs_count != ks_count || fqs_count > CFF_BINARY_MAX_STEPS)) {
+        printf("Error: Binary CFF files store at most %d steps with one k per field.\n", CFF_BINARY_MAX_STEPS);
+        return NULL;
+    }
+
+    FILE* file = fopen(filename, (format == 'b') ? "wb" : "w");
+    if (file == NULL) {
+        printf("Error opening file '%s' for writing.\n", filename);
+        return NULL;
+    }
+
+    struct cff_stream_writer* stream = (struct cff_stream_writer*) calloc(1, sizeof(struct cff_stream_writer));
+    if (stream == NULL) exit(EXIT_FAILURE);
+    stream->file = file;
+    snprintf(stream->filename, sizeof(stream->filename), "%s", filename);
+    stream->format = format;
+    stream->cols = cols;
+
+    if (shard != NULL) {
+        char page[CFF_SHARD_DATA_OFFSET] = {0};
+        memcpy(page, shard, sizeof(*shard));
+        if (fwrite(page, 1, CFF_SHARD_DATA_OFFSET, file) != CFF_SHARD_DATA_OFFSET) stream->error = 1;
+    }
+    int with_header = (shard == NULL || shard->shard == 0);
+
+    if (format == 'b') {
+        if (with_header) {
+            struct cff_binary_header header;
+            char padding[CFF_BINARY_DATA_OFFSET] = {0};
+            fill_binary_header(&header, construction, d, Fq_steps, K_steps, fqs_count, rows, cols);
+            memcpy(padding, &header, sizeof(header));
+            if (fwrite(padding, 1, CFF_BINARY_DATA_OFFSET, file) != CFF_BINARY_DATA_OFFSET) stream->error = 1;
+        }
+        stream->row_bytes = WORDS_FOR_BITS(cols) * (long) sizeof(uint64_t);
+    } else {
+        if (with_header) write_text_header(file, construction, d, Fq_steps, fqs_count, K_steps, ks_count);
+        for (int b = 0; b < 256; b++) {
+            for (int t = 0; t < 8; t++) {
+                stream->lut[b][2 * t] = ((b >> t) & 1) ? '1' : '0';
+                stream->lut[b][2 * t + 1] = ' ';
+            }
+        }
+        stream->row_bytes = (cols > 0) ? 2 * cols : 1;
+    }
+
+    if (shard != NULL) rows = shard->rows;
+    long slot_bytes = CFF_TEXT_BUFFER_BYTES / CFF_WRITE_RING_SLOTS;
+    stream->slot_rows = (stream->row_bytes > 0) ? slot_bytes / stream->row_bytes : rows;
+    if (stream->slot_rows > rows) stream->slot_rows = rows;
+    if (stream->slot_rows < 1) stream->slot_rows = 1;
+
+    for (int i = 0; i < CFF_WRITE_RING_SLOTS; i++) {
+        stream->slots[i] = (char*) malloc(stream->slot_rows * stream->row_bytes + 1);
+        if (stream->slots[i] == NULL) exit(EXIT_FAILURE);
+    }
+
+    pthread_mutex_init(&stream->lock, NULL);
+    pthread_cond_init(&stream->not_empty, NULL);
+    pthread_cond_init(&stream->not_full, NULL);
+    if (pthread_create(&stream->writer, NULL, stream_writer_thread, stream) != 0) {
+        printf("Error: Failed to start the writer thread for '%s'.\n", filename);
+        stream->closing = 1;
+        close_cff_stream(stream);
+        return NULL;
+    }
+    return stream;
+}
+
+/**
+ * @brief Appends rows to a streaming writer.
+ * 
+ * Rows are formatted in parallel, one buffer at a time, and handed to the
+ * writer thread. Blocks only while every buffer of the ring is full. Stops
+ * as soon as the writer thread has reported a failed write, so callers can
+ * abandon the rest of the matrix instead of formatting rows into a dead file.
+ * 
+ * @param stream Streaming writer.
+ * @param rows Rows in bitmap format, in file order.
+ * @param count Number of rows.
+ * @return 1 on success, 0 if a write has failed.
+ */
+int write_cff_stream_rows(struct cff_stream_writer* stream, uint64_t** rows, long count) {
+    for (long first = 0; first < count; first += stream->slot_rows) {
+        long batch = (count - first < stream->slot_rows) ? count - first : stream->slot_rows;
+
+        pthread_mutex_lock(&stream->lock);
+        while (stream->filled == CFF_WRITE_RING_SLOTS && !stream->error) pthread_cond_wait(&stream->not_full, &stream->lock);
+        int failed = stream->error;
+        int slot = stream->head;
+        pthread_mutex_unlock(&stream->lock);
+        if (failed) return 0;
+
+        format_stream_rows(stream, stream->slots[slot], rows + first, batch);
+
+        pthread_mutex_lock(&stream->lock);
+        stream->lengths[slot] = (size_t) (batch * stream->row_bytes);
+        stream->head = (slot + 1) % CFF_WRITE_RING_SLOTS;
+        stream->filled++;
+        pthread_cond_signal(&stream->not_empty);
+        pthread_mutex_unlock(&stream->lock);
+    }
+
+    pthread_mutex_lock(&stream->lock);
+    int ok = !stream->error;
+    pthread_mutex_unlock(&stream->lock);
+    return ok;
+}
+
+/**
+ * @brief Flushes and closes a streaming writer.
+ * 
+ * Waits for the writer thread to drain the ring, then closes the file and
+ * frees the writer.
+ * 
+ * @param stream Streaming writer.
+ * @return 1 on success, 0 if a write failed.
+ */
+int close_cff_stream(struct cff_stream_writer* stream) {
+    if (stream == NULL) return 0;
+
+    int started = !stream->closing;
+    pthread_mutex_lock(&stream->lock);
+    stream->closing = 1;
+    pthread_cond_signal(&stream->not_empty);
+    pthread_mutex_unlock(&stream->lock);
+    if (started) pthread_join(stream->writer, NULL);
+
+    if (fclose(stream->file) != 0) stream->error = 1;
+    int ok = !stream->error;
+    if (!ok) printf("Error writing file '%s'.\n", stream->filename);
+
+    pthread_mutex_destroy(&stream->lock);
+    pthread_cond_destroy(&stream->not_empty);
+    pthread_cond_destroy(&stream->not_full);
+    for (int i = 0; i < CFF_WRITE_RING_SLOTS; i++) free(stream->slots[i]);
+    free(stream);
+    return ok;
+}
+
+/**
+ * @brief Creates a zeroed binary CFF file of the given size and maps it for writing.
+ * 
+ * The file is sized with ftruncate, so untouched pages stay holes, and
+ * mapped shared: stores into the returned rows go to the page cache and
+ * reach the file when it is unmapped, without a heap copy of the matrix.
+ * 
+ * @param filename Output file path.
+ * @param construction Construction type ('p' or 'm').
+ * @param d CFF parameter d (used for monotone construction).
+ * @param Fq_steps Array with finite field sizes.
+ * @param fqs_count Number of elements in Fq_steps.
+ * @param K_steps Array with maximum polynomial degrees.
+ * @param ks_count Number of elements in K_steps.
+ * @param rows Number of rows in the matrix.
+ * @param cols Number of columns in the matrix.
+ * @return Writable CFF matrix whose rows point into the file (released with unmap_cff_matrix), or NULL on error.
+ */
+uint64_t** create_cff_binary_file(const char* filename, char construction, int d, long* Fq_steps, int fqs_count, long* K_steps, int ks_count, long rows, long cols) {
+    if (fqs_count != ks_count || fqs_count > CFF_BINARY_MAX_STEPS) {
+        printf("Error: Binary CFF files store at most %d steps with one k per field.\n", CFF_BINARY_MAX_STEPS);
+        return NULL;
+    }
+    if (rows == 0) return NULL;
+
+    struct cff_binary_header header;
+    fill_binary_header(&header, construction, d, Fq_steps, K_steps, fqs_count, rows, cols);
+
+    int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+        printf("Error opening file '%s' for writing.\n", filename);
+        return NULL;
+    }
+
+    size_t length = CFF_BINARY_DATA_OFFSET + (size_t) rows * header.words_per_row * sizeof(uint64_t);
+    if (ftruncate(fd, (off_t) length) != 0 || pwrite(fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header)) {
+        printf("Error writing file '%s'.\n", filename);
+        close(fd);
+        return NULL;
+    }
+
+    void* base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        printf("Error: Failed to map '%s'.\n", filename);
+        return NULL;
+    }
+
+    uint64_t** matrix = (uint64_t**) malloc(rows * sizeof(uint64_t*));
+    if (matrix == NULL) exit(EXIT_FAILURE);
+
+    uint64_t* words = (uint64_t*) ((char*) base + CFF_BINARY_DATA_OFFSET);
+    for (long i = 0; i < rows; i++) {
+        matrix[i] = words + i * header.words_per_row;
+    }
+    return matrix;
+}
+
+/**
+ * @brief Writes a CFF matrix to a compressed sparse column (CSC) file.
+ * 
+ * Every column stores the row indices of its ones (2 bytes each when the
+ * matrix has at most 65536 rows, 4 otherwise). Column weights are stored
+ * as runs of equal weight, so for the polynomial construction, where every
+ * column of a block has one 1 per evaluation point, the column offsets
+ * cost a few bytes per block. The bitmap is transposed by bitmap_to_csc.
+ * 
+ * @param filename Output file path.
+ * @param construction Construction type ('p' or 'm').
+ * @param d CFF parameter d (used for monotone construction).
+ * @param Fq_steps Array with finite field sizes.
+ * @param fqs_count Number of elements in Fq_steps.
+ * @param K_steps Array with maximum polynomial degrees.
+ * @param ks_count Number of elements in K_steps.
+ * @param matrix CFF matrix in bitmap format.
+ * @param rows Number of rows in the matrix.
+ * @param cols Number of columns in the matrix.
+ * @return 1 on success, 0 (with an error message) on error.
+ */
+int write_cff_to_csc_file(const char* filename, char construction, int d, long* Fq_steps, int fqs_count, long* K_steps, int ks_count, uint64_t** matrix, long rows, long cols) {
+    if (fqs_count != ks_count || fqs_count > CFF_BINARY_MAX_STEPS) {
+        printf("Error: CSC CFF files store at most %d steps with one k per field.\n", CFF_BINARY_MAX_STEPS);
+        return 0;
+    }
+
+    FILE* file = fopen(filename, "wb");
+    if (file == NULL) {
+        printf("Error opening file '%s' for writing.\n", filename);
+        return 0;
+    }
+
+    struct cff_csc_matrix* csc = bitmap_to_csc(matrix, rows, cols);
+
+    int64_t num_runs = 0;
+    int64_t* runs = (int64_t*) malloc(2 * (cols + 1) * sizeof(int64_t));
+    if (runs == NULL) exit(EXIT_FAILURE);
+    for (long j = 0; j < cols; j++) {
+        int64_t weight = csc->col_offsets[j + 1] - csc->col_offsets[j];
+        if (num_runs > 0 && runs[2 * (num_runs - 1) + 1] == weight) {
+            runs[2 * (num_runs - 1)]++;
+        } else {
+            runs[2 * num_runs] = 1;
+            runs[2 * num_runs + 1] = weight;
+            num_runs++;
+        }
+    }
+
+    int index_bytes = (rows <= 65536) ? 2 : csc->index_bytes;
+    int64_t num_ones = csc->col_offsets[cols];
+
+    struct cff_csc_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CFF_CSC_MAGIC, sizeof(CFF_CSC_MAGIC));
+    header.construction = construction;
+    header.d = d;
+    header.num_steps = fqs_count;
+    header.index_bytes = index_bytes;
+    header.rows = rows;
+    header.cols = cols;
+    header.num_ones = num_ones;
+    header.num_runs = num_runs;
+    for (int i = 0; i < fqs_count; i++) {
+        header.Fq_steps[i] = Fq_steps[i];
+        header.k_steps[i] = K_steps[i];
+    }
+
+    int error = (fwrite(&header, sizeof(header), 1, file) != 1 ||
+                 fwrite(runs, 2 * sizeof(int64_t), num_runs, file) != (size_t) num_runs);
+    if (!error && index_bytes == csc->index_bytes) {
+        error = (fwrite(csc->row_indices, index_bytes, num_ones, file) != (size_t) num_ones);
+    } else if (!error) {
+        int64_t chunk = CFF_TEXT_BUFFER_BYTES / sizeof(uint16_t);
+        uint16_t* narrow = (uint16_t*) malloc(chunk * sizeof(uint16_t));
+        if (narrow == NULL) exit(EXIT_FAILURE);
+        for (int64_t first = 0; first < num_ones && !error; first += chunk) {
+            int64_t count = (num_ones - first < chunk) ? num_ones - first : chunk;
+            for (int64_t k = 0; k < count; k++) narrow[k] = (uint16_t) ((const uint32_t*) csc->row_indices)[first + k];
+            error = (fwrite(narrow, sizeof(uint16_t), count, file) != (size_t) count);
+        }
+        free(narrow);
+    }
+    free(runs);
+    free_cff_csc(csc);
+    // Buffered data only reaches the disk on fclose, which may fail as well
+    if (fclose(file) != 0) error = 1;
+    if (error) printf("Error writing file '%s'.\n", filename);
+    return !error;
+}
+
+/**
+ * @brief Writes a CFF matrix to an Elias-Fano compressed file.
+ * 
+ * Stores the column runs as (column count, weight) pairs, like the CSC
+ * format, followed by the encoded columns exactly as they are kept in
+ * memory, so reading the file back is a single read of the bit array.
+ * 
+ * @param filename Output file path.
+ * @param construction Construction type ('p' or 'm').
+ * @param d CFF parameter d (used for monotone construction).
+ * @param Fq_steps Array with finite field sizes.
+ * @param fqs_count Number of elements in Fq_steps.
+ * @param K_steps Array with maximum polynomial degrees.
+ * @param ks_count Number of elements in K_steps.
+ * @param matrix CFF matrix in bitmap format.
+ * @param rows Number of rows in the matrix.
+ * @param cols Number of columns in the matrix.
+ * @return 1 on success, 0 (with an error message) on error.
+ */
+int write_cff_to_ef_file(const char* filename, char construction, int d, long* Fq_steps, int fqs_count, long* K_steps, int ks_count, uint64_t** matrix, long rows, long cols) {
+    if (fqs_count != ks_count || fqs_count > CFF_BINARY_MAX_STEPS) {
+        printf("Error: Elias-Fano CFF files store at most %d steps with one k per field.\n", CFF_BINARY_MAX_STEPS);
+        return 0;
+    }
+
+    FILE* file = fopen(filename, "wb");
+    if (file == NULL) {
+        printf("Error opening file '%s' for writing.\n", filename);
+        return 0;
+    }
+
+    struct cff_ef_matrix* ef = bitmap_to_ef(matrix, rows, cols);
+
+    int64_t* runs = (int64_t*) malloc((2 * ef->num_runs + 1) * sizeof(int64_t));
+    if (runs == NULL) exit(EXIT_FAILURE);
+    for (long r = 0; r < ef->num_runs; r++) {
+        runs[2 * r] = ef->runs[r].count;
+        runs[2 * r + 1] = ef->runs[r].weight;
+    }
+
+    struct cff_ef_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CFF_EF_MAGIC, sizeof(CFF_EF_MAGIC));
+    header.construction = construction;
+    header.d = d;
+    header.num_steps = fqs_count;
+    header.rows = rows;
+    header.cols = cols;
+    header.num_runs = ef->num_runs;
+    header.num_words = ef->num_words;
+    for (int i = 0; i < fqs_count; i++) {
+        header.Fq_steps[i] = Fq_steps[i];
+        header.k_steps[i] = K_steps[i];
+    }
+
+    int error = (fwrite(&header, sizeof(header), 1, file) != 1 ||
+                 fwrite(runs, 2 * sizeof(int64_t), ef->num_runs, file) != (size_t) ef->num_runs ||
+                 fwrite(ef->bits, sizeof(uint64_t), ef->num_words, file) != (size_t) ef->num_words);
+    free(runs);
+    free_cff_ef(ef);
+    // Buffered data only reaches the disk on fclose, which may fail as well
+    if (fclose(file) != 0) error = 1;
+    if (error) printf("Error writing file '%s'.\n", filename);
+    return !error;
+}
+
+/**
+ * @brief Writes a CFF matrix in Matrix Market coordinate pattern format.
+ * 
+ * Writes "%%MatrixMarket matrix coordinate pattern general", the parameter
+ * line of the text format as a comment, the size line and one 1-based
+ * "row column" line per one, in row order. The length of every row's
+ * lines is measured first, so batches of rows are then formatted in
+ * parallel straight into their place in the output buffer.
+ * 
+ * @param filename Output file path.
+ * @param construction Construction type ('p' or 'm').
+ * @param d CFF parameter d (used for monotone construction).
+ * @param Fq_steps Array with finite field sizes.
+ * @param fqs_count Number of elements in Fq_steps.
+ * @param K_steps Array with maximum polynomial degrees.
+ * @param ks_count Number of elements in K_steps.
+ * @param matrix CFF matrix in bitmap format.
+ * @param rows Number of rows in the matrix.
+ * @param cols Number of columns in the matrix.
+ * @return 1 on success, 0 (with an error message) on error.
+ */
+int write_cff_to_mtx_file(const char* filename, char construction, int d, long* Fq_steps, int fqs_count, long* K_steps, int ks_count, uint64_t** matrix, long rows, long cols) {
+    FILE* file = fopen(filename, "w");
+    if (file == NULL) {
+        printf("Error opening file '%s' for writing.\n", filename);
+        return 0;
+    }
+
+    int64_t* counts = sparse_row_offsets(matrix, rows, cols, 0);
+    int64_t* offsets = sparse_row_offsets(matrix, rows, cols, 1);
+
+    fprintf(file, "%%%%MatrixMarket matrix coordinate pattern general\n%% ");
+    write_text_header(file, construction, d, Fq_steps, fqs_count, K_steps, ks_count);
+    fprintf(file, "%ld %ld %lld\n", rows, cols, (long long) counts[rows]);
+
+    int64_t largest_row = 0;
+    for (long i = 0; i < rows; i++) {
+        if (offsets[i + 1] - offsets[i] > largest_row) largest_row = offsets[i + 1] - offsets[i];
+    }
+    int64_t budget = (largest_row > CFF_TEXT_BUFFER_BYTES) ? largest_row : CFF_TEXT_BUFFER_BYTES;
+    char* buffer = (char*) malloc(budget + 1);
+    if (buffer == NULL) exit(EXIT_FAILURE);
+
+    int error = 0;
+    long words_per_row = WORDS_FOR_BITS(cols);
+    for (long first = 0; first < rows && !error; ) {
+        long end = sparse_batch_end(offsets, first, rows, budget);
+
+        #pragma omp parallel for schedule(dynamic, 64)
+        for (long i = first; i < end; i++) {
+            char* out = buffer + (offsets[i] - offsets[first]);
+            for (long w = 0; w < words_per_row; w++) {
+                for (uint64_t word = matrix[i][w]; word != 0; word &= word - 1) {
+                    long j = w * BITS_PER_WORD + __builtin_ctzll(word);
+                    if (j >= cols) break;
+                    out = append_decimal(out, (uint64_t) i + 1);
+                    *out++ = ' ';
+                    out = append_decimal(out, (uint64_t) j + 1);
+                    *out++ = '\n';
+                }
+            }
+        }
+
+        size_t length = (size_t) (offsets[end] - offsets[first]);
+        if (fwrite(buffer, 1, length, file) != length) error = 1;
+        first = end;
+    }
+    free(buffer);
+    free(offsets);
+    free(counts);
+    // Buffered data only reaches the disk on fclose, which may fail as well
+    if (fclose(file) != 0) error = 1;
+    if (error) printf("Error writing file '%s'.\n", filename);
+    return !error;
+}
+
+/**
+ * @brief Writes a CFF matrix to a binary compressed sparse row (CSR) file.
+ * 
+ * Row pointers come from a parallel count of the ones of every row; the
+ * column indices (4 bytes each, 8 beyond 2^32 columns) are then filled in
+ * parallel, one batch of rows at a time, and written in order.
+ * 
+ * @param filename Output file path.
+ * @param construction Construction type ('p' or 'm').
+ * @param d CFF parameter d (used for monotone construction).
+ * @param Fq_steps Array with finite field sizes.
+ * @param fqs_count Number of elements in Fq_steps.
+ * @param K_steps Array with maximum polynomial degrees.
+ * @param ks_count Number of elements in K_steps.
+ * @param matrix CFF matrix in bitmap format.
+ * @param rows Number of rows in the matrix.
+ * @param cols Number of columns in the matrix.
+ * @return 1 on success, 0 (with an error message) on error.
+ */
+int write_cff_to_csr_file(const char* filename, char construction, int d, long* Fq_steps, int fqs_count, long* K_steps, int ks_count, uint64_t** matrix, long rows, long cols) {
+    if (fqs_count != ks_count || fqs_count > CFF_BINARY_MAX_STEPS) {
+        printf("Error: CSR CFF files store at most %d steps with one k per field.\n", CFF_BINARY_MAX_STEPS);
+        return 0;
+    }
+
+    FILE* file = fopen(filename, "wb");
+    if (file == NULL) {
+        printf("Error opening file '%s' for writing.\n", filename);
+        return 0;
+    }
+
+    int64_t* row_ptr = sparse_row_offsets(matrix, rows, cols, 0);
+    int index_bytes = (cols <= 4294967296L) ? 4 : 8;
+
+    struct cff_csr_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CFF_CSR_MAGIC, sizeof(CFF_CSR_MAGIC));
+    header.construction = construction;
+    header.d = d;
+    header.num_steps = fqs_count;
+    header.index_bytes = index_bytes;
+    header.rows = rows;
+    header.cols = cols;
+    header.num_ones = row_ptr[rows];
+    for (int i = 0; i < fqs_count; i++) {
+        header.Fq_steps[i] = Fq_steps[i];
+        header.k_steps[i] = K_steps[i];
+    }
+
+    int error = (fwrite(&header, sizeof(header), 1, file) != 1 ||
+                 fwrite(row_ptr, sizeof(int64_t), rows + 1, file) != (size_t) (rows + 1));
+
+    int64_t largest_row = 0;
+    for (long i = 0; i < rows; i++) {
+        if (row_ptr[i + 1] - row_ptr[i] > largest_row) largest_row = row_ptr[i + 1] - row_ptr[i];
+    }
+    int64_t budget = CFF_TEXT_BUFFER_BYTES / index_bytes;
+    if (budget < largest_row) budget = largest_row;
+    void* indices = malloc(budget * index_bytes + 1);
+    if (indices == NULL) exit(EXIT_FAILURE);
+
+    long words_per_row = WORDS_FOR_BITS(cols);
+    for (long first = 0; first < rows && !error; ) {
+        long end = sparse_batch_end(row_ptr, first, rows, budget);
+
+        #pragma omp parallel for schedule(dynamic, 64)
+        for (long i = first; i < end; i++) {
+            int64_t k = row_ptr[i] - row_ptr[first];
+            for (long w = 0; w < words_per_row; w++) {
+                for (uint64_t word = matrix[i][w]; word != 0; word &= word - 1) {
+                    long j = w * BITS_PER_WORD + __builtin_ctzll(word);
+                    if (j >= cols) break;
+                    if (index_bytes == 4) ((uint32_t*) indices)[k++] = (uint32_t) j;
+                    else ((uint64_t*) indices)[k++] = (uint64_t) j;
+                }
+            }
+        }
+
+        size_t count = (size_t) (row_ptr[end] - row_ptr[first]);
+        if (fwrite(indices, index_bytes, count, file) != count) error = 1;
+        first = end;
+    }
+    free(indices);
+    free(row_ptr);
+    // Buffered data only reaches the disk on fclose, which may fail as well
+    if (fclose(file) != 0) error = 1;
+    if (error) printf("Error writing file '%s'.\n", filename);
+    return !error;
+}
+
+/*
+ * CHAIN ARCHIVE FUNCTIONS
+ */
+
+/**
+ * @brief Creates an empty chain archive.
+ * 
+ * @param filename Output file path.
+ * @param d CFF parameter d.
+ * @return 1 on success, 0 on error.
+ */
+int create_cff_archive(const char* filename, int d) {
+    FILE* file = fopen(filename, "wb");
+    if (file == NULL) {
+        printf("Error opening file '%s' for writing.\n", filename);
+        return 0;
+    }
+
+    struct cff_archive_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CFF_ARCHIVE_MAGIC, sizeof(CFF_ARCHIVE_MAGIC));
+    header.d = d;
+
+    int ok = (fwrite(&header, sizeof(header), 1, file) == 1);
+    if (fclose(file) != 0) ok = 0;
+    if (!ok) printf("Error writing file '%s'.\n", filename);
+    return ok;
+}
+
+/**
+ * @brief Appends the blocks of one embedding step to a chain archive.
+ * 
+ * Only the new blocks are written, at the end of the file; the CFF of the
+ * previous steps is never rewritten. The sizes before and after the step
+ * follow embed_cff_matrix.
+ * 
+ * @param filename Archive file path.
+ * @param construction Construction type of the step.
+ * @param block_size Block size of the step.
+ * @param q Finite field size of the step.
+ * @param k Maximum polynomial degree of the step.
+ * @param blocks Blocks generated for the step.
+ * @param first_step 1 if this is the first step (only new_new is stored).
+ * @return 1 on success, 0 on error.
+ */
+int append_cff_archive_step(const char* filename, char construction, char block_size, long q, long k, const generated_cffs* blocks, int first_step) {
+    struct cff_archive_index index;
+    if (!read_cff_archive_index(filename, &index)) return 0;
+    if (first_step != (index.num_steps == 0)) {
+        printf("Error: Archive '%s' already has %d steps.\n", filename, index.num_steps);
+        free_cff_archive_index(&index);
+        return 0;
+    }
+
+    struct cff_archive_step step;
+    memset(&step, 0, sizeof(step));
+    memcpy(step.magic, CFF_ARCHIVE_STEP_MAGIC, sizeof(CFF_ARCHIVE_STEP_MAGIC));
+    step.construction = construction;
+    step.block_size = block_size;
+    step.q = q;
+    step.k = k;
+    step.rows_new = blocks->rows_new;
+    step.cols_new = blocks->cols_new;
+
+    if (first_step) {
+        step.rows = blocks->rows_new;
+        step.cols = blocks->cols_new;
+    } else {
+        step.old_rows = index.steps[index.num_steps - 1].rows;
+        step.old_cols = index.steps[index.num_steps - 1].cols;
+        step.rows_old_new = blocks->rows_old_new;
+        step.cols_old_new = blocks->cols_old_new;
+        step.rows_new_old = blocks->rows_new_old;
+        step.cols_new_old = blocks->cols_new_old;
+
+        long width_top = step.old_cols + step.cols_old_new;
+        long width_bottom = step.cols_new_old + step.cols_new;
+        step.rows = step.old_rows + step.rows_new_old;
+        step.cols = (width_top > width_bottom) ? width_top : width_bottom;
+    }
+    free_cff_archive_index(&index);
+
+    step.segment_bytes = (step.rows_old_new * WORDS_FOR_BITS(step.cols_old_new) +
+                          step.rows_new_old * WORDS_FOR_BITS(step.cols_new_old) +
+                          step.rows_new * WORDS_FOR_BITS(step.cols_new)) * (int64_t) sizeof(uint64_t);
+
+    FILE* file = fopen(filename, "ab");
+    if (file == NULL) {
+        printf("Error opening file '%s' for writing.\n", filename);
+        return 0;
+    }
+
+    int ok = (fwrite(&step, sizeof(step), 1, file) == 1);
+    if (!first_step) {
+        ok = ok && write_block_words(file, blocks->cff_old_new, step.rows_old_new, step.cols_old_new);
+        ok = ok && write_block_words(file, blocks->cff_new_old, step.rows_new_old, step.cols_new_old);
+    }
+    ok = ok && write_block_words(file, blocks->cff_new, step.rows_new, step.cols_new);
+    if (fclose(file) != 0) ok = 0;
+
+    if (!ok) printf("Error writing file '%s'.\n", filename);
+    return ok;
+}
+
+/**
+ * @brief Reads the index of a chain archive.
+ * 
+ * Walks the step records, skipping the blocks of each one, so the cost
+ * does not depend on the size of the matrices.
+ * 
+ * @param filename Archive file path.
+ * @param index Pointer to store the index (freed with free_cff_archive_index).
+ * @return 1 on success, 0 on error.
+ */
+int read_cff_archive_index(const char* filename, struct cff_archive_index* index) {
+    memset(index, 0, sizeof(*index));
+
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL) {
+        printf("Input file '%s' not found.\n", filename);
+        return 0;
+    }
+
+    struct cff_archive_header header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, CFF_ARCHIVE_MAGIC, sizeof(CFF_ARCHIVE_MAGIC)) != 0) {
+        printf("Error: '%s' is not a CFF chain archive.\n", filename);
+        fclose(file);
+        return 0;
+    }
+    index->d = header.d;
+
+    int capacity = 0;
+    struct cff_archive_step step;
+    while (fread(&step, sizeof(step), 1, file) == 1) {
+        if (memcmp(step.magic, CFF_ARCHIVE_STEP_MAGIC, sizeof(CFF_ARCHIVE_STEP_MAGIC)) != 0 || step.segment_bytes < 0) {
+            printf("Error: Corrupted step %d in archive '%s'.\n", index->num_steps + 1, filename);
+            break;
+        }
+        if (index->num_steps == capacity) {
+            capacity = (capacity == 0) ? 8 : 2 * capacity;
+            index->steps = (struct cff_archive_step*) realloc(index->steps, capacity * sizeof(struct cff_archive_step));
+            index->offsets = (int64_t*) realloc(index->offsets, capacity * sizeof(int64_t));
+            if (index->steps == NULL || index->offsets == NULL) exit(EXIT_FAILURE);
+        }
+        index->steps[index->num_steps] = step;
+        index->offsets[index->num_steps] = (int64_t) ftello(file);
+        index->num_steps++;
+
+        if (fseeko(file, (off_t) step.segment_bytes, SEEK_CUR) != 0) break;
+    }
+
+    fclose(file);
+    return 1;
+}
+
+/**
+ * @brief Rebuilds the CFF of one step of a chain archive.
+ * 
+ * The archive is mapped and the blocks of steps 1..step are ORed into
+ * place, so the cost is proportional to the size of the extracted CFF.
+ * 
+ * @param filename Archive file path.
+ * @param step Step number, starting at 1.
+ * @param rows Pointer to store the number of rows.
+ * @param cols Pointer to store the number of columns.
+ * @return CFF matrix in bitmap format, or NULL on error.
+ */
+uint64_t** extract_cff_archive_step(const char* filename, int step, long* rows, long* cols) {
+    *rows = 0; *cols = 0;
+
+    struct cff_archive_index index;
+    if (!read_cff_archive_index(filename, &index)) return NULL;
+    if (step < 1 || step > index.num_steps) {
+        printf("Error: Archive '%s' has %d steps, step %d requested.\n", filename, index.num_steps, step);
+        free_cff_archive_index(&index);
+        return NULL;
+    }
+
+    const struct cff_archive_step* last = &index.steps[step - 1];
+    size_t length = (size_t) (index.offsets[step - 1] + last->segment_bytes);
+
+    FILE* file = fopen(filename, "rb");
+    struct stat st;
+    if (file == NULL || fstat(fileno(file), &st) != 0 || (size_t) st.st_size < length) {
+        printf("Error: Archive '%s' is truncated.\n", filename);
+        if (file) fclose(file);
+        free_cff_archive_index(&index);
+        return NULL;
+    }
+
+    const char* base = (const char*) mmap(NULL, length, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+    fclose(file);
+    if (base == (const char*) MAP_FAILED) {
+        printf("Error: Failed to map '%s'.\n", filename);
+        free_cff_archive_index(&index);
+        return NULL;
+    }
+
+    *rows = last->rows;
+    *cols = last->cols;
+    long words_per_row = WORDS_FOR_BITS(*cols);
+    uint64_t** matrix = (uint64_t**) malloc(*rows * sizeof(uint64_t*));
+    if (matrix == NULL) exit(EXIT_FAILURE);
+    for (long i = 0; i < *rows; i++) {
+        matrix[i] = (uint64_t*) calloc(words_per_row, sizeof(uint64_t));
+        if (matrix[i] == NULL) exit(EXIT_FAILURE);
+    }
+
+    for (int s = 0; s < step; s++) {
+        const struct cff_archive_step* rec = &index.steps[s];
+        const uint64_t* words = (const uint64_t*) (base + index.offsets[s]);
+
+        or_block_words(matrix, *rows, 0, rec->old_cols, words, rec->rows_old_new, rec->cols_old_new);
+        words += rec->rows_old_new * WORDS_FOR_BITS(rec->cols_old_new);
+        or_block_words(matrix, *rows, rec->old_rows, 0, words, rec->rows_new_old, rec->cols_new_old);
+        words += rec->rows_new_old * WORDS_FOR_BITS(rec->cols_new_old);
+        or_block_words(matrix, *rows, rec->old_rows, rec->cols_new_old, words, rec->rows_new, rec->cols_new);
+    }
+
+    munmap((void*) base, length);
+    free_cff_archive_index(&index);
+    return matrix;
+}
+
+/**
+ * @brief Frees the memory of an archive index.
+ * 
+ * @param index Pointer to the index to be freed.
+ */
+void free_cff_archive_index(struct cff_archive_index* index) {
+    if (!index) return;
+    free(index->steps);
+    free(index->offsets);
+    index->steps = NULL;
+    index->offsets = NULL;
+}
+
+/*
+ * ROW/COLUMN LABEL FUNCTIONS
+ */
+
+/**
+ * @brief Writes the row/column label side file of an embedding step.
+ * 
+ * Pairs are stored as the two element indices of x and y, and polynomials
+ * as the indices of their coefficients, padded with zeros up to the
+ * longest polynomial of the step. Entries take 1, 2 or 4 bytes depending
+ * on the field size, so the file is a few bytes per row and column.
+ * 
+ * @param filename Output file path.
+ * @param step Field, pairs and polynomials of the step.
+ * @param old_rows Number of rows before the step.
+ * @param old_cols Number of columns before the step.
+ * @return 1 on success, 0 on error.
+ */
+int write_cff_labels(const char* filename, const cff_step* step, long old_rows, long old_cols) {
+    const combination_partitions* combos = &step->combos;
+    const polynomial_partition* polys = &step->poly_part;
+    long q = step->partitions[step->num_steps - 1].q;
+
+    long coeffs = 1;
+    #pragma omp parallel for schedule(static) reduction(max:coeffs)
+    for (long j = 0; j < polys->num_old_polys + polys->num_new_polys; j++) {
+        const fq_nmod_poly_struct* poly = (j < polys->num_old_polys) ? polys->old_polys[j] : polys->new_polys[j - polys->num_old_polys];
+        long length = (long) fq_nmod_poly_length(poly, step->ctx);
+        if (length > coeffs) coeffs = length;
+    }
+
+    struct cff_labels_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CFF_LABELS_MAGIC, sizeof(CFF_LABELS_MAGIC));
+    header.step = step->num_steps;
+    header.element_bytes = (q <= 256) ? 1 : (q <= 65536) ? 2 : 4;
+    header.q = q;
+    header.p = (int64_t) step->p;
+    header.old_rows = old_rows;
+    header.old_cols = old_cols;
+    header.num_old_pairs = (combos->count_old < old_rows + step->num_new_rows) ? combos->count_old : old_rows + step->num_new_rows;
+    header.num_new_pairs = step->num_new_rows;
+    header.num_old_polys = polys->num_old_polys;
+    header.num_new_polys = polys->num_new_polys;
+    header.coeffs_per_poly = coeffs;
+
+    int bytes = header.element_bytes;
+    long num_pairs = header.num_old_pairs + header.num_new_pairs;
+    long num_polys = header.num_old_polys + header.num_new_polys;
+    size_t pair_bytes = (size_t) num_pairs * 2 * bytes;
+    size_t poly_bytes = (size_t) num_polys * coeffs * bytes;
+    uint8_t* data = (uint8_t*) malloc(pair_bytes + poly_bytes + 1);
+    if (data == NULL) exit(EXIT_FAILURE);
+
+    pack_label_pairs(data, combos->combos_old, header.num_old_pairs, step->p, bytes);
+    pack_label_pairs(data + (size_t) header.num_old_pairs * 2 * bytes, combos->combos_new, header.num_new_pairs, step->p, bytes);
+
+    uint8_t* poly_data = data + pair_bytes;
+    pack_label_polys(poly_data, (const fq_nmod_poly_t*) polys->old_polys, header.num_old_polys, coeffs, bytes, step);
+    pack_label_polys(poly_data + (size_t) header.num_old_polys * coeffs * bytes, (const fq_nmod_poly_t*) polys->new_polys, header.num_new_polys, coeffs, bytes, step);
+
+    FILE* file = fopen(filename, "wb");
+    if (file == NULL) {
+        printf("Error opening file '%s' for writing.\n", filename);
+        free(data);
+        return 0;
+    }
+    int ok = (fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(data, 1, pair_bytes + poly_bytes, file) == pair_bytes + poly_bytes);
+    if (fclose(file) != 0) ok = 0;
+    if (!ok) printf("Error writing file '%s'.\n", filename);
+    free(data);
+    return ok;
+}
+
+/**
+ * @brief Reads a row/column label side file.
+ * 
+ * @param filename Path to the file to be read.
+ * @param labels Pointer to store the labels (freed with free_cff_labels).
+ * @return 1 on success, 0 if the file is missing or not a label file.
+ */
+int read_cff_labels(const char* filename, struct cff_labels* labels) {
+    memset(labels, 0, sizeof(*labels));
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL) {
+        printf("Input file '%s' not found.\n", filename);
+        return 0;
+    }
+
+    struct cff_labels_header* header = &labels->header;
+    if (fread(header, sizeof(*header), 1, file) != 1 || memcmp(header->magic, CFF_LABELS_MAGIC, sizeof(CFF_LABELS_MAGIC)) != 0 ||
+        (header->element_bytes != 1 && header->element_bytes != 2 && header->element_bytes != 4) ||
+        header->num_old_pairs < 0 || header->num_new_pairs < 0 || header->num_old_polys < 0 || header->num_new_polys < 0 || header->coeffs_per_poly < 1) {
+        printf("Error: '%s' is not a CFF label file.\n", filename);
+        fclose(file);
+        return 0;
+    }
+
+    int bytes = header->element_bytes;
+    labels->old_pairs = read_label_elements(file, 2 * header->num_old_pairs, bytes);
+    labels->new_pairs = labels->old_pairs ? read_label_elements(file, 2 * header->num_new_pairs, bytes) : NULL;
+    labels->old_polys = labels->new_pairs ? read_label_elements(file, header->num_old_polys * header->coeffs_per_poly, bytes) : NULL;
+    labels->new_polys = labels->old_polys ? read_label_elements(file, header->num_new_polys * header->coeffs_per_poly, bytes) : NULL;
+    fclose(file);
+
+    if (labels->new_polys == NULL) {
+        printf("Error: Label file '%s' is truncated.\n", filename);
+        free_cff_labels(labels);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Frees the arrays of a label structure.
+ * 
+ * @param labels Labels to be freed.
+ */
+void free_cff_labels(struct cff_labels* labels) {
+    if (!labels) return;
+    free(labels->old_pairs);
+    free(labels->new_pairs);
+    free(labels->old_polys);
+    free(labels->new_polys);
+    labels->old_pairs = labels->new_pairs = NULL;
+    labels->old_polys = labels->new_polys = NULL;
+}
+
+/* 
+ * HELPER FUNCTIONS
+ */
+
+/**
+ * @brief Converts a comma-separated integer string to an array.
+ * 
+ * @param str String containing comma-separated integers (e.g., "2,4,16").
+ * @param count Pointer to store the number of integers in the array.
+ * @return Dynamically allocated integer array, or NULL if string is empty.
+ */
+long* parse_long_list(char* str, int* count) {
+    *count = 0;
+    
+    if (str == NULL || strlen(str) == 0) {
+        return NULL;
+    }
+
+    int commas = 0;
+    for (int i = 0; str[i] != '\0'; i++) {
+        if (str[i] == ',') {
+            commas++;
+        }
+    }
+    *count = commas + 1;
+
+    long* list = (long*) malloc(*count * sizeof(long));
+    if (list == NULL) {
+        *count = 0;
+        return NULL; 
+    }
+
+    int i = 0;
+    char* token = strtok(str, ",");
+    
+    while (token != NULL) {
+        list[i] = strtol(token, NULL, 10);
+        i++;
+        token = strtok(NULL, ",");
+    }
+
+    return list;
+}
+
+/**
+ * @brief Reads and validates the header of a binary CFF file.
+ * 
+ * @param file Open file positioned at its start.
+ * @param header Pointer to store the header.
+ * @return 1 if a valid binary header was read, 0 otherwise.
+ */
+static int read_binary_header(FILE* file, struct cff_binary_header* header) {
+    if (fread(header, sizeof(*header), 1, file) != 1) return 0;
+    if (memcmp(header->magic, CFF_BINARY_MAGIC, sizeof(CFF_BINARY_MAGIC)) != 0) return 0;
+
+    if (header->byte_order != CFF_BINARY_BYTE_ORDER && header->byte_order != 0) {
+        printf("Error: Binary CFF written on a machine of a different byte order.\n");
+        return 0;
+    }
+    if (header->num_steps < 0 || header->num_steps > CFF_BINARY_MAX_STEPS ||
+        header->rows < 0 || header->cols < 0 || header->words_per_row != WORDS_FOR_BITS(header->cols)) {
+        printf("Error: Corrupted binary CFF header.\n");
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Formats one bitmap row as "b0 b1 ... bn\n" text.
+ * 
+ * Whole bytes of the row are copied from the lookup table 16 characters at
+ * a time; the last partial byte only contributes its valid columns.
+ * 
+ * @param out Output buffer of 2 * cols bytes (1 byte if cols is 0).
+ * @param row Row of the bitmap.
+ * @param cols Number of columns.
+ * @param lut Text of every byte value, 16 characters per entry.
+ */
+static void format_text_row(char* out, const uint64_t* row, long cols, const char (*lut)[16]) {
+    long full_bytes = cols / 8;
+    for (long b = 0; b < full_bytes; b++) {
+        uint8_t byte = (uint8_t) (row[b / 8] >> (8 * (b % 8)));
+        memcpy(out + 16 * b, lut[byte], 16);
+    }
+    for (long j = full_bytes * 8; j < cols; j++) {
+        out[2 * j] = GET_BIT(row, j) ? '1' : '0';
+        out[2 * j + 1] = ' ';
+    }
+    out[(cols > 0) ? 2 * cols - 1 : 0] = '\n';
+}
+
+/**
+ * @brief Reads and validates the header of a CSC CFF file.
+ * 
+ * @param file Open file positioned at its start.
+ * @param header Pointer to store the header.
+ * @return 1 if a valid CSC header was read, 0 otherwise.
+ */
+static int read_csc_header(FILE* file, struct cff_csc_header* header) {
+    if (fread(header, sizeof(*header), 1, file) != 1) return 0;
+    if (memcmp(header->magic, CFF_CSC_MAGIC, sizeof(CFF_CSC_MAGIC)) != 0) return 0;
+
+    if (header->num_steps < 0 || header->num_steps > CFF_BINARY_MAX_STEPS ||
+        (header->index_bytes != 2 && header->index_bytes != 4 && header->index_bytes != 8) ||
+        header->rows < 0 || header->cols < 0 || header->num_ones < 0 ||
+        header->num_runs < 0 || header->num_runs > header->cols) {
+        printf("Error: Corrupted CSC CFF header.\n");
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Builds a parameters structure from the steps stored in a file header.
+ * 
+ * @param construction Construction type.
+ * @param d CFF parameter d.
+ * @param num_steps Number of steps.
+ * @param Fq_steps Finite field size of every step.
+ * @param k_steps Maximum polynomial degree of every step.
+ * @return Pointer to structure with parameters, or NULL on error.
+ */
+static struct cff_parameters* parameters_from_steps(char construction, int d, int num_steps, const int64_t* Fq_steps, const int64_t* k_steps) {
+    struct cff_parameters* params = (struct cff_parameters*) malloc(sizeof(struct cff_parameters));
+    if (params == NULL) {
+        printf("Error: Failed to allocate memory for parameters.\n");
+        return NULL;
+    }
+
+    params->construction = construction;
+    params->d = d;
+    params->fqs_count = num_steps;
+    params->ks_count = num_steps;
+    params->Fqs = (long*) malloc(num_steps * sizeof(long));
+    params->ks = (long*) malloc(num_steps * sizeof(long));
+    if (params->Fqs == NULL || params->ks == NULL) {
+        printf("Error: Failed to allocate memory for Fqs/ks lists.\n");
+        free(params->Fqs);
+        free(params->ks);
+        free(params);
+        return NULL;
+    }
+
+    for (int i = 0; i < num_steps; i++) {
+        params->Fqs[i] = (long) Fq_steps[i];
+        params->ks[i] = (long) k_steps[i];
+    }
+    return params;
+}
+
+/**
+ * @brief Builds a parameters structure from a recipe.
+ * 
+ * The construction is the one of the last step.
+ * 
+ * @param recipe CFF recipe.
+ * @return Pointer to structure with parameters, or NULL on error.
+ */
+static struct cff_parameters* parameters_from_recipe(const cff_recipe* recipe) {
+    int64_t Fq_steps[CFF_RECIPE_MAX_STEPS], k_steps[CFF_RECIPE_MAX_STEPS];
+    for (int i = 0; i < recipe->num_steps; i++) {
+        Fq_steps[i] = recipe->steps[i].q;
+        k_steps[i] = recipe->steps[i].k;
+    }
+    return parameters_from_steps(recipe->steps[recipe->num_steps - 1].construction, recipe->d, recipe->num_steps, Fq_steps, k_steps);
+}
+
+/**
+ * @brief Reads the column runs and row indices of an open CSC file.
+ * 
+ * Rebuilds the explicit column offsets from the (column count, weight)
+ * runs and widens 2-byte indices to 32 bits; 8-byte indices, written for
+ * matrices beyond 2^32 rows, are kept as they are.
+ * 
+ * @param file Open CSC file positioned after its header.
+ * @param header Header of the file.
+ * @param filename Path of the file, for error messages.
+ * @return CSC matrix, or NULL on error.
+ */
+static struct cff_csc_matrix* read_csc_matrix(FILE* file, const struct cff_csc_header* header, const char* filename) {
+    struct cff_csc_matrix* csc = (struct cff_csc_matrix*) calloc(1, sizeof(struct cff_csc_matrix));
+    int64_t* runs = (int64_t*) malloc((2 * header->num_runs + 1) * sizeof(int64_t));
+    if (csc == NULL || runs == NULL) exit(EXIT_FAILURE);
+
+    csc->rows = header->rows;
+    csc->cols = header->cols;
+    csc->col_offsets = (int64_t*) malloc((header->cols + 1) * sizeof(int64_t));
+    csc->index_bytes = (header->index_bytes == 8) ? 8 : 4;
+    csc->row_indices = malloc((header->num_ones + 1) * csc->index_bytes);
+    if (csc->col_offsets == NULL || csc->row_indices == NULL) exit(EXIT_FAILURE);
+
+    int valid = (fread(runs, 2 * sizeof(int64_t), header->num_runs, file) == (size_t) header->num_runs);
+
+    long j = 0;
+    csc->col_offsets[0] = 0;
+    for (int64_t r = 0; valid && r < header->num_runs; r++) {
+        if (runs[2 * r] < 0 || runs[2 * r + 1] < 0 || runs[2 * r] > header->cols - j) { valid = 0; break; }
+        for (int64_t c = 0; c < runs[2 * r]; c++, j++) {
+            csc->col_offsets[j + 1] = csc->col_offsets[j] + runs[2 * r + 1];
+        }
+    }
+    valid = valid && j == header->cols && csc->col_offsets[header->cols] == header->num_ones;
+
+    if (valid && header->index_bytes == csc->index_bytes) {
+        valid = (fread(csc->row_indices, csc->index_bytes, header->num_ones, file) == (size_t) header->num_ones);
+    } else if (valid) {
+        uint16_t* narrow = (uint16_t*) malloc((header->num_ones + 1) * sizeof(uint16_t));
+        if (narrow == NULL) exit(EXIT_FAILURE);
+        valid = (fread(narrow, sizeof(uint16_t), header->num_ones, file) == (size_t) header->num_ones);
+        for (int64_t k = 0; valid && k < header->num_ones; k++) ((uint32_t*) csc->row_indices)[k] = narrow[k];
+        free(narrow);
+    }
+    for (int64_t k = 0; valid && k < header->num_ones; k++) {
+        if (csc_row_index(csc, k) >= (uint64_t) header->rows) valid = 0;
+    }
+
+    free(runs);
+    if (!valid) {
+        printf("Error: CSC CFF file '%s' is truncated or corrupted.\n", filename);
+        free_cff_csc(csc);
+        return NULL;
+    }
+    return csc;
+}
+
+/**
+ * @brief Reads and validates the header of an Elias-Fano CFF file.
+ * 
+ * @param file Open file positioned at its start.
+ * @param header Pointer to store the header.
+ * @return 1 if a valid Elias-Fano header was read, 0 otherwise.
+ */
+static int read_ef_header(FILE* file, struct cff_ef_header* header) {
+    if (fread(header, sizeof(*header), 1, file) != 1) return 0;
+    if (memcmp(header->magic, CFF_EF_MAGIC, sizeof(CFF_EF_MAGIC)) != 0) return 0;
+
+    if (header->num_steps < 0 || header->num_steps > CFF_BINARY_MAX_STEPS ||
+        header->rows < 0 || header->cols < 0 || header->num_words < 0 ||
+        header->num_runs < 0 || header->num_runs > header->cols) {
+        printf("Error: Corrupted Elias-Fano CFF header.\n");
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Computes the number of ones and the sparse-format size of every row.
+ * 
+ * Bits past the last column are ignored.
+ * 
+ * @param matrix CFF matrix in bitmap format.
+ * @param rows Number of rows in the matrix.
+ * @param cols Number of columns in the matrix.
+ * @param mtx 1 to measure Matrix Market lines in bytes, 0 to count ones.
+ * @return Array of rows + 1 prefix sums (entry i is the total of rows before i).
+ */
+static int64_t* sparse_row_offsets(uint64_t** matrix, long rows, long cols, int mtx) {
+    int64_t* offsets = (int64_t*) malloc((rows + 1) * sizeof(int64_t));
+    if (offsets == NULL) exit(EXIT_FAILURE);
+    long words_per_row = WORDS_FOR_BITS(cols);
+
+    offsets[0] = 0;
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (long i = 0; i < rows; i++) {
+        int row_digits = decimal_digits((uint64_t) i + 1);
+        int64_t size = 0;
+        for (long w = 0; w < words_per_row; w++) {
+            for (uint64_t word = matrix[i][w]; word != 0; word &= word - 1) {
+                long j = w * BITS_PER_WORD + __builtin_ctzll(word);
+                if (j >= cols) break;
+                size += mtx ? row_digits + decimal_digits((uint64_t) j + 1) + 2 : 1;
+            }
+        }
+        offsets[i + 1] = size;
+    }
+
+    for (long i = 0; i < rows; i++) offsets[i + 1] += offsets[i];
+    return offsets;
+}
+
+/**
+ * @brief Finds the end of a batch of rows that fits in a byte budget.
+ * 
+ * @param offsets Prefix sums of the row sizes.
+ * @param first First row of the batch.
+ * @param rows Number of rows in the matrix.
+ * @param budget Maximum size of the batch (always at least one row).
+ * @return One past the last row of the batch.
+ */
+static long sparse_batch_end(const int64_t* offsets, long first, long rows, int64_t budget) {
+    long low = first + 1, high = rows;
+    while (low < high) {
+        long mid = low + (high - low + 1) / 2;
+        if (offsets[mid] - offsets[first] <= budget) low = mid;
+        else high = mid - 1;
+    }
+    return low;
+}
+
+/**
+ * @brief Writes the decimal digits of a number.
+ * 
+ * @param out Output buffer.
+ * @param value Number to be written.
+ * @return Pointer past the last digit.
+ */
+static inline char* append_decimal(char* out, uint64_t value) {
+    int digits = decimal_digits(value);
+    for (int i = digits - 1; i >= 0; i--) {
+        out[i] = (char) ('0' + value % 10);
+        value /= 10;
+    }
+    return out + digits;
+}
+
+/**
+ * @brief Returns the number of decimal digits of a number.
+ * 
+ * @param value Number.
+ * @return Number of digits (1 for 0).
+ */
+static inline int decimal_digits(uint64_t value) {
+    int digits = 1;
+    while (value >= 10) {
+        value /= 10;
+        digits++;
+    }
+    return digits;
+}
+
+/**
+ * @brief Reads the column runs and encoded columns of an open Elias-Fano file.
+ * 
+ * The layout of the runs is recomputed from their weights and must match
+ * the number of words stored in the header.
+ * 
+ * @param file Open Elias-Fano file positioned after its header.
+ * @param header Header of the file.
+ * @param filename Path of the file, for error messages.
+ * @return Encoded matrix, or NULL on error.
+ */
+static struct cff_ef_matrix* read_ef_matrix(FILE* file, const struct cff_ef_header* header, const char* filename) {
+    struct cff_ef_matrix* ef = (struct cff_ef_matrix*) calloc(1, sizeof(struct cff_ef_matrix));
+    int64_t* runs = (int64_t*) malloc((2 * header->num_runs + 1) * sizeof(int64_t));
+    if (ef == NULL || runs == NULL) exit(EXIT_FAILURE);
+
+    ef->rows = header->rows;
+    ef->cols = header->cols;
+    ef->num_runs = header->num_runs;
+    ef->runs = (struct cff_ef_run*) calloc(header->num_runs + 1, sizeof(struct cff_ef_run));
+    if (ef->runs == NULL) exit(EXIT_FAILURE);
+
+    int valid = (fread(runs, 2 * sizeof(int64_t), header->num_runs, file) == (size_t) header->num_runs);
+
+    long j = 0;
+    for (int64_t r = 0; valid && r < header->num_runs; r++) {
+        if (runs[2 * r] < 0 || runs[2 * r] > header->cols - j || runs[2 * r + 1] < 0 || runs[2 * r + 1] > header->rows) { valid = 0; break; }
+        ef->runs[r].first_col = j;
+        ef->runs[r].count = runs[2 * r];
+        ef->runs[r].weight = runs[2 * r + 1];
+        j += runs[2 * r];
+    }
+    valid = valid && j == header->cols;
+
+    if (valid) {
+        layout_ef_runs(ef);
+        valid = (ef->num_words == header->num_words) &&
+                (fread(ef->bits, sizeof(uint64_t), ef->num_words, file) == (size_t) ef->num_words);
+    }
+
+    free(runs);
+    if (!valid) {
+        printf("Error: Elias-Fano CFF file '%s' is truncated or corrupted.\n", filename);
+        free_cff_ef(ef);
+        return NULL;
+    }
+    return ef;
+}
+
+/**
+ * @brief Computes the encoding of every run from its weight and the number of rows.
+ * 
+ * A column of weight w keeps L = floor(log2(rows / w)) low bits per one
+ * and ((rows - 1) >> L) + w bits of unary high parts. The bit array gets
+ * one spare word so any 64-bit window inside it can be read.
+ * 
+ * @param ef Matrix whose runs have first_col, count and weight set; sets the rest and num_words.
+ */
+static void layout_ef_runs(struct cff_ef_matrix* ef) {
+    int64_t total_bits = 0;
+    for (long r = 0; r < ef->num_runs; r++) {
+        struct cff_ef_run* run = &ef->runs[r];
+        run->low_bits = 0;
+        run->col_bits = 0;
+        if (run->weight > 0) {
+            while (run->low_bits < 62 && (run->weight << (run->low_bits + 1)) <= ef->rows) run->low_bits++;
+            run->col_bits = run->weight * run->low_bits + ((ef->rows - 1) >> run->low_bits) + run->weight;
+        }
+        run->first_bit = total_bits;
+        total_bits += run->count * run->col_bits;
+    }
+
+    free(ef->bits);
+    ef->num_words = WORDS_FOR_BITS(total_bits) + 1;
+    ef->bits = (uint64_t*) calloc(ef->num_words, sizeof(uint64_t));
+    if (ef->bits == NULL) exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Finds the run that contains a column.
+ * 
+ * @param ef Encoded matrix.
+ * @param col Column index.
+ * @return Index of the run.
+ */
+static long find_ef_run(const struct cff_ef_matrix* ef, long col) {
+    long low = 0, high = ef->num_runs - 1;
+    while (low < high) {
+        long mid = (low + high + 1) / 2;
+        if (ef->runs[mid].first_col <= col) low = mid;
+        else high = mid - 1;
+    }
+    return low;
+}
+
+/**
+ * @brief Reads up to 64 bits starting at any bit position.
+ * 
+ * @param bits Bit array, with one readable word past the last used bit.
+ * @param pos First bit.
+ * @param len Number of bits (0 to 64).
+ * @return The bits, least significant first.
+ */
+static inline uint64_t read_ef_bits(const uint64_t* bits, int64_t pos, int len) {
+    if (len == 0) return 0;
+    int64_t w = pos / BITS_PER_WORD;
+    int offset = (int) (pos % BITS_PER_WORD);
+    uint64_t value = bits[w] >> offset;
+    if (offset + len > BITS_PER_WORD) value |= bits[w + 1] << (BITS_PER_WORD - offset);
+    return (len < BITS_PER_WORD) ? value & ((1ULL << len) - 1) : value;
+}
+
+/**
+ * @brief ORs up to 64 bits into any bit position.
  * 
- * Extracts the construction type, d parameter (if applicable), and the
- * arrays of field sizes (Fqs) and degrees (ks) from the file's first line.
+ * Neighbouring columns may share a word, so the update is atomic.
  * 
- * @param filename Path to the file to be read.
- * @return Pointer to structure with parameters, or NULL on error.
+ * @param bits Bit array.
+ * @param pos First bit.
+ * @param value Bits to set, least significant first.
+ * @param len Number of bits (0 to 64).
  */
-struct cff_parameters* read_parameters(const char* filename) {
-    FILE* file = fopen(filename, "r");
-    if (file == NULL) {
-        printf("Input file '%s' not found.\n", filename);
-        return NULL;
-    }
+static inline void or_ef_bits(uint64_t* bits, int64_t pos, uint64_t value, int len) {
+    if (len == 0) return;
+    if (len < BITS_PER_WORD) value &= (1ULL << len) - 1;
+    int64_t w = pos / BITS_PER_WORD;
+    int offset = (int) (pos % BITS_PER_WORD);
+    __atomic_fetch_or(&bits[w], value << offset, __ATOMIC_RELAXED);
+    if (offset + len > BITS_PER_WORD) __atomic_fetch_or(&bits[w + 1], value >> (BITS_PER_WORD - offset), __ATOMIC_RELAXED);
+}
 
+/**
+ * @brief Parses the parameter line of a text CFF file.
+ * 
+ * Expects "c [q0,q1,...] [k0,k1,...]", or "m d [...] [...]" for the
+ * monotone construction.
+ * 
+ * @param line First line of the file (not necessarily NUL-terminated).
+ * @param length Length of the line.
+ * @return Pointer to structure with parameters, or NULL on error.
+ */
+static struct cff_parameters* parse_parameters_line(const char* line, size_t length) {
     struct cff_parameters* params = (struct cff_parameters*) malloc(sizeof(struct cff_parameters));
-    if (params == NULL) {
+    char* text = (char*) malloc(length + 1);
+    if (params == NULL || text == NULL) {
         printf("Error: Failed to allocate memory for parameters.\n");
-        fclose(file);
+        free(params);
+        free(text);
         return NULL;
     }
+    memcpy(text, line, length);
+    text[length] = '\0';
 
     params->Fqs = NULL;
     params->ks = NULL;
@@ -59,56 +2764,40 @@ struct cff_parameters* read_parameters(const char* filename) {
     params->ks_count = 0;
     params->d = 0;
 
-    char* line = NULL;
-    size_t len = 0;
-
-    if (getline(&line, &len, file) == -1) {
-        printf("Error: File is empty or could not read the line.\n");
-        free(params);
-        fclose(file);
-        if (line) free(line);
-        return NULL;
-    }
-
     char fqs_str[256]; 
     char ks_str[256];
     int items_scanned;
 
-    if (sscanf(line, "%c", &params->construction) != 1) {
+    if (sscanf(text, "%c", &params->construction) != 1) {
         printf("Error: Could not read construction type.\n");
         free(params);
-        fclose(file);
-        free(line);
+        free(text);
         return NULL;
     }
 
     if (params->construction == 'm') {
-        items_scanned = sscanf(line, "%c %d [%[^]]] [%[^]]]", 
+        items_scanned = sscanf(text, "%c %d [%255[^]]] [%255[^]]]", 
                                &params->construction, &params->d, fqs_str, ks_str);
         if (items_scanned != 4) {
             printf("Error: Invalid first line format for 'm' construction.\n");
             free(params);
-            fclose(file);
-            free(line);
+            free(text);
             return NULL;
         }
     } else {
-        items_scanned = sscanf(line, "%c [%[^]]] [%[^]]]", 
+        items_scanned = sscanf(text, "%c [%255[^]]] [%255[^]]]", 
                                &params->construction, fqs_str, ks_str);
         if (items_scanned != 3) {
             printf("Error: Invalid first line format.\n");
             free(params);
-            fclose(file);
-            free(line);
+            free(text);
             return NULL;
         }
     }
+    free(text);
 
-    params->Fqs = parse_int_list(fqs_str, &params->fqs_count);
-    params->ks  = parse_int_list(ks_str,  &params->ks_count);
-
-    fclose(file);
-    free(line);
+    params->Fqs = parse_long_list(fqs_str, &params->fqs_count);
+    params->ks  = parse_long_list(ks_str,  &params->ks_count);
 
     if ((params->fqs_count > 0 && params->Fqs == NULL) || 
         (params->ks_count > 0 && params->ks == NULL)) {
@@ -123,95 +2812,399 @@ struct cff_parameters* read_parameters(const char* filename) {
 }
 
 /**
- * @brief Reads a CFF matrix from a file.
+ * @brief Maps the matrix words of an open binary CFF file.
  * 
- * Reads the binary matrix from the file, skipping the first parameter line.
- * The matrix is stored in 64-bit bitmap format for efficiency.
- * 
- * @param filename Path to the file to be read.
+ * @param file Open binary CFF file.
+ * @param header Header of the file.
+ * @param filename Path of the file, for error messages.
  * @param rows Pointer to store the number of rows.
  * @param cols Pointer to store the number of columns.
- * @return CFF matrix in bitmap format, or NULL if file doesn't exist.
+ * @return Read-only CFF matrix whose rows point into the mapping, or NULL on error.
  */
-uint64_t** read_cff_from_file(const char* filename, long* rows, long* cols) {
-    FILE* file = fopen(filename, "r");
-    if (file == NULL) {
-        printf("Input file '%s' not found. Starting from scratch.\n", filename);
-        *rows = 0; *cols = 0;
+static uint64_t** map_binary_matrix(FILE* file, const struct cff_binary_header* header, const char* filename, long* rows, long* cols) {
+    struct stat st;
+    size_t length = CFF_BINARY_DATA_OFFSET + (size_t) header->rows * header->words_per_row * sizeof(uint64_t);
+    if (fstat(fileno(file), &st) != 0 || (size_t) st.st_size < length) {
+        printf("Error: Binary CFF file '%s' is truncated.\n", filename);
+        return NULL;
+    }
+    if (header->rows == 0) return NULL;
+
+    void* base = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+    if (base == MAP_FAILED) {
+        printf("Error: Failed to map '%s'.\n", filename);
         return NULL;
     }
+    madvise(base, length, MADV_SEQUENTIAL);
+
+    uint64_t** matrix = (uint64_t**) malloc(header->rows * sizeof(uint64_t*));
+    if (matrix == NULL) exit(EXIT_FAILURE);
+
+    uint64_t* words = (uint64_t*) ((char*) base + CFF_BINARY_DATA_OFFSET);
+    for (long i = 0; i < header->rows; i++) {
+        matrix[i] = words + i * header->words_per_row;
+    }
+
+    *rows = header->rows;
+    *cols = header->cols;
+    return matrix;
+}
 
+/**
+ * @brief Parses the matrix of an open text CFF file in a single pass.
+ * 
+ * The file is mapped and the column count is inferred from the first row.
+ * Files written by write_cff_to_file have rows of exactly 2 * cols bytes,
+ * so row i starts at a known offset and rows are converted in parallel,
+ * 64 columns at a time with text_bit_mask. Any other layout (extra
+ * spaces, missing final newline, ...) falls back to locating every line
+ * with memchr and tokenising each one.
+ * 
+ * @param file Open text CFF file.
+ * @param filename Path of the file, for error messages.
+ * @param rows Pointer to store the number of rows.
+ * @param cols Pointer to store the number of columns.
+ * @param params Pointer to store the parameters of the first line, or NULL to skip them.
+ * @return CFF matrix in bitmap format, or NULL if there is no data.
+ */
+static uint64_t** read_text_matrix(FILE* file, const char* filename, long* rows, long* cols, struct cff_parameters** params) {
     *rows = 0; *cols = 0;
-    char* line = NULL;
-    size_t len = 0;
 
-    if (getline(&line, &len, file) == -1) {
-        fclose(file);
-        if(line) free(line);
+    struct stat st;
+    if (fstat(fileno(file), &st) != 0 || st.st_size == 0) {
         printf("File '%s' is empty or has no data after the first line.\n", filename);
         return NULL;
     }
-    
-    if (getline(&line, &len, file) != -1) {
-        (*rows)++;
-        char* token = strtok(line, " \t\n");
-        while (token != NULL) {
-            if (strlen(token) > 0) (*cols)++;
-            token = strtok(NULL, " \t\n");
-        }
+
+    size_t size = (size_t) st.st_size;
+    const char* data = (const char*) mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+    if (data == (const char*) MAP_FAILED) {
+        printf("Error: Failed to map '%s'.\n", filename);
+        return NULL;
     }
-    while (getline(&line, &len, file) != -1) {
-        (*rows)++;
+    madvise((void*) data, size, MADV_SEQUENTIAL);
+
+    const char* end = data + size;
+    const char* header_end = (const char*) memchr(data, '\n', size);
+    if (params != NULL) {
+        *params = parse_parameters_line(data, (header_end != NULL) ? (size_t) (header_end - data) : size);
     }
-    
-    rewind(file);
-    getline(&line, &len, file);
-    
+    if (header_end == NULL || header_end + 1 == end) {
+        munmap((void*) data, size);
+        printf("File '%s' is empty or has no data after the first line.\n", filename);
+        return NULL;
+    }
+
+    const char* body = header_end + 1;
+    size_t body_size = (size_t) (end - body);
+    const char* first_end = (const char*) memchr(body, '\n', body_size);
+    if (first_end == NULL) first_end = end;
+
+    for (const char* c = body; c < first_end; ) {
+        while (c < first_end && (*c == ' ' || *c == '\t' || *c == '\r')) c++;
+        if (c == first_end) break;
+        (*cols)++;
+        while (c < first_end && *c != ' ' && *c != '\t' && *c != '\r') c++;
+    }
+
     long words_per_row = WORDS_FOR_BITS(*cols);
-    uint64_t** matrix = (uint64_t**) malloc(*rows * sizeof(uint64_t*));
-    
-    for (long i = 0; i < *rows; i++) {
-        matrix[i] = (uint64_t*) calloc(words_per_row, sizeof(uint64_t));
-        for (long j = 0; j < *cols; j++) {
-            int bit;
-            if (fscanf(file, "%d", &bit) == 1 && bit == 1) {
-                SET_BIT(matrix[i], j);
+    size_t row_bytes = (size_t) 2 * (*cols);
+    int fixed = (*cols > 0 && (size_t) (first_end - body) == row_bytes - 1 && body_size % row_bytes == 0);
+
+    uint64_t** matrix = NULL;
+    if (fixed) {
+        *rows = (long) (body_size / row_bytes);
+        matrix = (uint64_t**) malloc(*rows * sizeof(uint64_t*));
+        if (matrix == NULL) exit(EXIT_FAILURE);
+
+        long full_words = *cols / BITS_PER_WORD;
+        int misaligned = 0;
+        #pragma omp parallel for schedule(static) reduction(|:misaligned)
+        for (long i = 0; i < *rows; i++) {
+            const char* line = body + i * row_bytes;
+            uint64_t* row = (uint64_t*) calloc(words_per_row, sizeof(uint64_t));
+            if (row == NULL) exit(EXIT_FAILURE);
+
+            if (line[row_bytes - 1] != '\n') misaligned = 1;
+            for (long w = 0; w < full_words; w++) {
+                row[w] = text_bit_mask(line + 2 * BITS_PER_WORD * w);
+            }
+            for (long j = full_words * BITS_PER_WORD; j < *cols; j++) {
+                if (line[2 * j] == '1') SET_BIT(row, j);
             }
+            matrix[i] = row;
+        }
+
+        // Same size as a fixed layout but with rows of other lengths: parse token by token.
+        if (misaligned) {
+            for (long i = 0; i < *rows; i++) free(matrix[i]);
+            free(matrix);
+            matrix = NULL;
         }
     }
 
-    fclose(file);
-    if(line) free(line);
+    if (matrix == NULL) {
+        const char** line_start = index_text_lines(body, end, rows);
+        matrix = (uint64_t**) malloc(*rows * sizeof(uint64_t*));
+        if (matrix == NULL) exit(EXIT_FAILURE);
+
+        long bad_row = *rows, bad_count = 0;
+        #pragma omp parallel for schedule(static)
+        for (long i = 0; i < *rows; i++) {
+            uint64_t* row = (uint64_t*) calloc(words_per_row, sizeof(uint64_t));
+            if (row == NULL) exit(EXIT_FAILURE);
+            long count = parse_text_row(row, line_start[i], (size_t) (line_start[i + 1] - line_start[i]), *cols);
+            if (count != *cols) {
+                #pragma omp critical(text_row_length)
+                if (i < bad_row) { bad_row = i; bad_count = count; }
+            }
+            matrix[i] = row;
+        }
+        free(line_start);
+
+        if (bad_row < *rows) {
+            printf("Error: Row %ld of '%s' has %ld columns, expected %ld.\n", bad_row, filename, bad_count, *cols);
+            for (long i = 0; i < *rows; i++) free(matrix[i]);
+            free(matrix);
+            matrix = NULL;
+            *rows = 0; *cols = 0;
+        }
+    }
+
+    munmap((void*) data, size);
     return matrix;
 }
 
-/*
- * FILE WRITING FUNCTIONS
+/**
+ * @brief Finds the start of every line of a text body using all threads.
+ * 
+ * The body is cut into one byte range per thread, each moved forward to
+ * the next line start. Every thread counts the lines of its range, a prefix
+ * sum gives the index of its first line, and the threads then fill their
+ * part of the array, so the file is scanned twice in parallel instead of
+ * once serially.
+ * 
+ * @param body Start of the first line.
+ * @param end End of the text.
+ * @param count Pointer to store the number of lines.
+ * @return Array of count + 1 line starts, the last one being end.
+ */
+static const char** index_text_lines(const char* body, const char* end, long* count) {
+    size_t size = (size_t) (end - body);
+    int chunks = (size < ((size_t) 1 << 20)) ? 1 : omp_get_max_threads();
+
+    const char** chunk_start = (const char**) malloc((chunks + 1) * sizeof(const char*));
+    long* chunk_lines = (long*) calloc(chunks + 1, sizeof(long));
+    if (chunk_start == NULL || chunk_lines == NULL) exit(EXIT_FAILURE);
+
+    chunk_start[0] = body;
+    chunk_start[chunks] = end;
+    for (int t = 1; t < chunks; t++) {
+        const char* c = body + size / chunks * t;
+        if (c < chunk_start[t - 1]) c = chunk_start[t - 1];
+        if (c > body && c[-1] != '\n') {
+            const char* newline = (const char*) memchr(c, '\n', (size_t) (end - c));
+            c = (newline != NULL) ? newline + 1 : end;
+        }
+        chunk_start[t] = c;
+    }
+
+    #pragma omp parallel for schedule(static, 1)
+    for (int t = 0; t < chunks; t++) {
+        long lines = 0;
+        for (const char* c = chunk_start[t]; c < chunk_start[t + 1]; lines++) {
+            const char* newline = (const char*) memchr(c, '\n', (size_t) (chunk_start[t + 1] - c));
+            c = (newline != NULL) ? newline + 1 : chunk_start[t + 1];
+        }
+        chunk_lines[t + 1] = lines;
+    }
+    for (int t = 0; t < chunks; t++) chunk_lines[t + 1] += chunk_lines[t];
+
+    *count = chunk_lines[chunks];
+    const char** line_start = (const char**) malloc((*count + 1) * sizeof(const char*));
+    if (line_start == NULL) exit(EXIT_FAILURE);
+
+    #pragma omp parallel for schedule(static, 1)
+    for (int t = 0; t < chunks; t++) {
+        long i = chunk_lines[t];
+        for (const char* c = chunk_start[t]; c < chunk_start[t + 1]; ) {
+            line_start[i++] = c;
+            const char* newline = (const char*) memchr(c, '\n', (size_t) (chunk_start[t + 1] - c));
+            c = (newline != NULL) ? newline + 1 : chunk_start[t + 1];
+        }
+    }
+    line_start[*count] = end;
+
+    free(chunk_start);
+    free(chunk_lines);
+    return line_start;
+}
+
+/**
+ * @brief Parses one line of whitespace-separated integers into a bitmap row.
+ * 
+ * A column is set when its token is the integer 1; tokens past the last
+ * column are counted but not stored, so the caller can reject the row.
+ * 
+ * @param row Zeroed bitmap row.
+ * @param line Start of the line.
+ * @param length Length of the line, with or without the newline.
+ * @param cols Number of columns of the matrix.
+ * @return Number of integers on the line.
  */
+static long parse_text_row(uint64_t* row, const char* line, size_t length, long cols) {
+    const char* end = line + length;
+    long j = 0;
+    for (const char* c = line; c < end; j++) {
+        while (c < end && (*c == ' ' || *c == '\t' || *c == '\r' || *c == '\n')) c++;
+        if (c == end) break;
+
+        long value = 0;
+        int negative = (*c == '-');
+        if (*c == '-' || *c == '+') c++;
+        while (c < end && *c >= '0' && *c <= '9') value = value * 10 + (*c++ - '0');
+        while (c < end && *c != ' ' && *c != '\t' && *c != '\r' && *c != '\n') c++;
+
+        if (!negative && value == 1 && j < cols) SET_BIT(row, j);
+    }
+    return j;
+}
 
 /**
- * @brief Writes a CFF matrix to a file.
+ * @brief Converts 64 "b " column pairs of a text row into a bitmap word.
  * 
- * Saves the parameters on the first line and the binary matrix on subsequent lines.
+ * The even characters (the digits) are packed into bytes with a 16-bit
+ * saturating pack, compared against '1' and collected with movemask.
+ * Uses AVX2 or SSE2 when available, with a portable scalar fallback.
  * 
- * @param filename Output file path.
+ * @param text Pointer to 128 readable characters.
+ * @return Word whose bit i is set if text[2 * i] == '1'.
+ */
+static inline uint64_t text_bit_mask(const char* text) {
+#if defined(__AVX2__)
+    const __m256i low_bytes = _mm256_set1_epi16(0x00FF);
+    const __m256i one = _mm256_set1_epi8('1');
+    uint64_t mask = 0;
+    for (int i = 0; i < 2; i++) {
+        __m256i a = _mm256_and_si256(_mm256_loadu_si256((const __m256i*) (text + 64 * i)), low_bytes);
+        __m256i b = _mm256_and_si256(_mm256_loadu_si256((const __m256i*) (text + 64 * i + 32)), low_bytes);
+        __m256i digits = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+        mask |= (uint64_t) (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(digits, one)) << (32 * i);
+    }
+    return mask;
+#elif defined(__SSE2__)
+    const __m128i low_bytes = _mm_set1_epi16(0x00FF);
+    const __m128i one = _mm_set1_epi8('1');
+    uint64_t mask = 0;
+    for (int i = 0; i < 4; i++) {
+        __m128i a = _mm_and_si128(_mm_loadu_si128((const __m128i*) (text + 32 * i)), low_bytes);
+        __m128i b = _mm_and_si128(_mm_loadu_si128((const __m128i*) (text + 32 * i + 16)), low_bytes);
+        __m128i digits = _mm_packus_epi16(a, b);
+        mask |= (uint64_t) (uint16_t) _mm_movemask_epi8(_mm_cmpeq_epi8(digits, one)) << (16 * i);
+    }
+    return mask;
+#else
+    uint64_t mask = 0;
+    for (int i = 0; i < BITS_PER_WORD; i++) {
+        mask |= (uint64_t) (text[2 * i] == '1') << i;
+    }
+    return mask;
+#endif
+}
+
+/**
+ * @brief Builds a parameters structure from an archive index.
+ * 
+ * The construction is the one of the last included step.
+ * 
+ * @param index Archive index.
+ * @param num_steps Number of steps to include.
+ * @return Pointer to structure with parameters, or NULL on error.
+ */
+static struct cff_parameters* parameters_from_archive(const struct cff_archive_index* index, int num_steps) {
+    if (num_steps < 1) {
+        printf("Error: Archive has no steps.\n");
+        return NULL;
+    }
+
+    int64_t* Fq_steps = (int64_t*) malloc(num_steps * sizeof(int64_t));
+    int64_t* k_steps = (int64_t*) malloc(num_steps * sizeof(int64_t));
+    if (Fq_steps == NULL || k_steps == NULL) exit(EXIT_FAILURE);
+    for (int i = 0; i < num_steps; i++) {
+        Fq_steps[i] = index->steps[i].q;
+        k_steps[i] = index->steps[i].k;
+    }
+
+    struct cff_parameters* params = parameters_from_steps(index->steps[num_steps - 1].construction, index->d, num_steps, Fq_steps, k_steps);
+    free(Fq_steps);
+    free(k_steps);
+    return params;
+}
+
+/**
+ * @brief Writes the rows of a block as raw words.
+ * 
+ * @param file Open output file.
+ * @param block Block in bitmap format (may be NULL if rows is 0).
+ * @param rows Number of rows.
+ * @param cols Number of columns.
+ * @return 1 on success, 0 on a write error.
+ */
+static int write_block_words(FILE* file, uint64_t** block, long rows, long cols) {
+    long words_per_row = WORDS_FOR_BITS(cols);
+    for (long i = 0; i < rows; i++) {
+        if (fwrite(block[i], sizeof(uint64_t), words_per_row, file) != (size_t) words_per_row) return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief ORs a block stored as raw words into a matrix at a bit offset.
+ * 
+ * Each source word is shifted into at most two destination words, so a
+ * block is placed in time proportional to its size. Rows past the end of
+ * the destination are ignored.
+ * 
+ * @param matrix Destination matrix.
+ * @param matrix_rows Number of rows of the destination.
+ * @param row_offset First destination row.
+ * @param col_offset First destination column.
+ * @param words Block rows, WORDS_FOR_BITS(cols) words each.
+ * @param rows Number of rows of the block.
+ * @param cols Number of columns of the block.
+ */
+static void or_block_words(uint64_t** matrix, long matrix_rows, long row_offset, long col_offset, const uint64_t* words, long rows, long cols) {
+    long words_per_row = WORDS_FOR_BITS(cols);
+    long first_word = WORD_OFFSET(col_offset);
+    int shift = BIT_OFFSET(col_offset);
+
+    #pragma omp parallel for schedule(static)
+    for (long i = 0; i < rows; i++) {
+        if (row_offset + i >= matrix_rows) continue;
+        uint64_t* dst = matrix[row_offset + i] + first_word;
+        const uint64_t* src = words + i * words_per_row;
+        for (long w = 0; w < words_per_row; w++) {
+            if (src[w] == 0) continue;
+            dst[w] |= src[w] << shift;
+            if (shift != 0 && (w * BITS_PER_WORD + (BITS_PER_WORD - shift)) < cols) {
+                dst[w + 1] |= src[w] >> (BITS_PER_WORD - shift);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Writes the parameter line of a text CFF file.
+ * 
+ * @param file Open output file.
  * @param construction Construction type ('p' or 'm').
  * @param d CFF parameter d (used for monotone construction).
  * @param Fq_steps Array with finite field sizes.
  * @param fqs_count Number of elements in Fq_steps.
  * @param K_steps Array with maximum polynomial degrees.
  * @param ks_count Number of elements in K_steps.
- * @param matrix CFF matrix in bitmap format.
- * @param rows Number of rows in the matrix.
- * @param cols Number of columns in the matrix.
  */
-void write_cff_to_file(const char* filename, char construction, int d, long* Fq_steps, int fqs_count, long* K_steps, int ks_count, uint64_t** matrix, long rows, long cols){
-    FILE* file = fopen(filename, "w"); 
-    if (file == NULL) {
-        printf("Error opening file '%s' for writing.\n", filename);
-        return;
-    }
-
+static void write_text_header(FILE* file, char construction, int d, const long* Fq_steps, int fqs_count, const long* K_steps, int ks_count) {
     fprintf(file, "%c ", construction);
     
     if (construction == 'm') {
@@ -235,60 +3228,231 @@ void write_cff_to_file(const char* filename, char construction, int d, long* Fq_
         }
     }
     fprintf(file, "]\n"); 
+}
 
-    for (long i = 0; i < rows; i++) {
-        for (long j = 0; j < cols; j++) {
-            fprintf(file, "%d", GET_BIT(matrix[i], j) ? 1 : 0);
-            if (j < cols - 1) {
-                fprintf(file, " "); 
-            }
+/**
+ * @brief Fills the header of a binary CFF file.
+ * 
+ * @param header Header to be filled.
+ * @param construction Construction type ('p' or 'm').
+ * @param d CFF parameter d.
+ * @param Fq_steps Array with finite field sizes.
+ * @param K_steps Array with maximum polynomial degrees.
+ * @param num_steps Number of steps (at most CFF_BINARY_MAX_STEPS).
+ * @param rows Number of rows in the matrix.
+ * @param cols Number of columns in the matrix.
+ */
+static void fill_binary_header(struct cff_binary_header* header, char construction, int d, const long* Fq_steps, const long* K_steps, int num_steps, long rows, long cols) {
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, CFF_BINARY_MAGIC, sizeof(CFF_BINARY_MAGIC));
+    header->construction = construction;
+    header->byte_order = CFF_BINARY_BYTE_ORDER;
+    header->d = d;
+    header->num_steps = num_steps;
+    header->rows = rows;
+    header->cols = cols;
+    header->words_per_row = WORDS_FOR_BITS(cols);
+    for (int i = 0; i < num_steps; i++) {
+        header->Fq_steps[i] = Fq_steps[i];
+        header->k_steps[i] = K_steps[i];
+    }
+}
+
+/**
+ * @brief Formats a batch of rows into a ring buffer of a streaming writer.
+ * 
+ * Rows are independent, so they are formatted in parallel: by a new team
+ * when called serially, or as tasks of the current team when called from
+ * inside a parallel region (e.g. while a block is being generated).
+ * 
+ * @param stream Streaming writer.
+ * @param out Ring buffer.
+ * @param rows Rows in bitmap format.
+ * @param count Number of rows (at most stream->slot_rows).
+ */
+static void format_stream_rows(struct cff_stream_writer* stream, char* out, uint64_t** rows, long count) {
+    if (stream->format == 'b') {
+        for (long i = 0; i < count; i++) {
+            memcpy(out + i * stream->row_bytes, rows[i], stream->row_bytes);
         }
-        fprintf(file, "\n"); 
+        return;
     }
 
-    fclose(file);
+    const char (*lut)[16] = (const char (*)[16]) stream->lut;
+    if (omp_in_parallel()) {
+        #pragma omp taskloop
+        for (long i = 0; i < count; i++) {
+            format_text_row(out + i * stream->row_bytes, rows[i], stream->cols, lut);
+        }
+    } else {
+        #pragma omp parallel for schedule(static)
+        for (long i = 0; i < count; i++) {
+            format_text_row(out + i * stream->row_bytes, rows[i], stream->cols, lut);
+        }
+    }
 }
 
-/* 
- * HELPER FUNCTIONS
+/**
+ * @brief Body of the writer thread of a streaming writer.
+ * 
+ * Writes the filled buffers in ring order until the writer is closed and
+ * the ring is empty. After a failed write the remaining buffers are
+ * dropped so the producers never wait on a dead writer.
+ * 
+ * @param arg Streaming writer.
+ * @return NULL.
  */
+static void* stream_writer_thread(void* arg) {
+    struct cff_stream_writer* stream = (struct cff_stream_writer*) arg;
+    unbind_cff_thread();
+
+    pthread_mutex_lock(&stream->lock);
+    for (;;) {
+        while (stream->filled == 0 && !stream->closing) pthread_cond_wait(&stream->not_empty, &stream->lock);
+        if (stream->filled == 0) break;
+
+        int slot = stream->tail;
+        int failed = stream->error;
+        pthread_mutex_unlock(&stream->lock);
+
+        if (!failed && fwrite(stream->slots[slot], 1, stream->lengths[slot], stream->file) != stream->lengths[slot]) failed = 1;
+
+        pthread_mutex_lock(&stream->lock);
+        stream->error = failed;
+        stream->tail = (slot + 1) % CFF_WRITE_RING_SLOTS;
+        stream->filled--;
+        pthread_cond_signal(&stream->not_full);
+    }
+    pthread_mutex_unlock(&stream->lock);
+    return NULL;
+}
 
 /**
- * @brief Converts a comma-separated integer string to an array.
+ * @brief Stores one element index as an element_bytes-wide label entry.
  * 
- * @param str String containing comma-separated integers (e.g., "2,4,16").
- * @param count Pointer to store the number of integers in the array.
- * @return Dynamically allocated integer array, or NULL if string is empty.
+ * @param out Buffer of label entries.
+ * @param entry Position of the entry in the buffer.
+ * @param value Element index.
+ * @param bytes Width of each entry (1, 2 or 4 bytes).
  */
-int* parse_int_list(char* str, int* count) {
-    *count = 0;
-    
-    if (str == NULL || strlen(str) == 0) {
-        return NULL;
+static inline void store_label_entry(uint8_t* out, long entry, long value, int bytes) {
+    if (bytes == 1) out[entry] = (uint8_t) value;
+    else if (bytes == 2) ((uint16_t*) out)[entry] = (uint16_t) value;
+    else ((uint32_t*) out)[entry] = (uint32_t) value;
+}
+
+/**
+ * @brief Packs (x, y) pairs into label entries.
+ * 
+ * @param out Output buffer of count * 2 * bytes bytes.
+ * @param pairs Pairs to be packed.
+ * @param count Number of pairs.
+ * @param p Characteristic of the field.
+ * @param bytes Width of each entry (1, 2 or 4 bytes).
+ */
+static void pack_label_pairs(uint8_t* out, const element_pair* pairs, long count, ulong p, int bytes) {
+    #pragma omp parallel for schedule(static)
+    for (long i = 0; i < count; i++) {
+        store_label_entry(out, 2 * i, element_index(pairs[i].x, p), bytes);
+        store_label_entry(out, 2 * i + 1, element_index(pairs[i].y, p), bytes);
     }
+}
 
-    int commas = 0;
-    for (int i = 0; str[i] != '\0'; i++) {
-        if (str[i] == ',') {
-            commas++;
+/**
+ * @brief Packs the coefficients of polynomials into label entries.
+ * 
+ * Each thread keeps its own coefficient buffer; coefficients past the
+ * length of a polynomial are stored as zero.
+ * 
+ * @param out Output buffer of count * coeffs * bytes bytes.
+ * @param polys Polynomials to be packed.
+ * @param count Number of polynomials.
+ * @param coeffs Number of coefficients stored per polynomial.
+ * @param bytes Width of each entry (1, 2 or 4 bytes).
+ * @param step Step whose field the polynomials belong to.
+ */
+static void pack_label_polys(uint8_t* out, const fq_nmod_poly_t* polys, long count, long coeffs, int bytes, const cff_step* step) {
+    #pragma omp parallel
+    {
+        fq_nmod_t coeff;
+        fq_nmod_init(coeff, step->ctx);
+
+        #pragma omp for schedule(static)
+        for (long j = 0; j < count; j++) {
+            long length = (long) fq_nmod_poly_length(polys[j], step->ctx);
+            for (long c = 0; c < coeffs; c++) {
+                long value = 0;
+                if (c < length) {
+                    fq_nmod_poly_get_coeff(coeff, polys[j], c, step->ctx);
+                    value = element_index(coeff, step->p);
+                }
+                store_label_entry(out, j * coeffs + c, value, bytes);
+            }
         }
+
+        fq_nmod_clear(coeff, step->ctx);
     }
-    *count = commas + 1;
+}
 
-    int* list = (int*) malloc(*count * sizeof(int));
-    if (list == NULL) {
-        *count = 0;
-        return NULL; 
+/**
+ * @brief Reads packed label entries and widens them to 32 bits.
+ * 
+ * @param file Open label file.
+ * @param count Number of entries.
+ * @param bytes Width of each entry (1, 2 or 4 bytes).
+ * @return Array of count entries, or NULL on a short read.
+ */
+static uint32_t* read_label_elements(FILE* file, long count, int bytes) {
+    uint32_t* values = (uint32_t*) malloc(count * sizeof(uint32_t) + 1);
+    if (values == NULL) exit(EXIT_FAILURE);
+    if (fread(values, bytes, count, file) != (size_t) count) {
+        free(values);
+        return NULL;
     }
 
-    int i = 0;
-    char* token = strtok(str, ",");
-    
-    while (token != NULL) {
-        list[i] = atoi(token);
-        i++;
-        token = strtok(NULL, ",");
+    for (long i = count - 1; i >= 0 && bytes < 4; i--) {
+        values[i] = (bytes == 1) ? ((uint8_t*) values)[i] : ((uint16_t*) values)[i];
     }
+    return values;
+}
 
-    return list;
+/**
+ * @brief Copies a byte range of one file to the end of another.
+ * 
+ * Uses copy_file_range where available and falls back to reading and
+ * writing through a buffer (other systems, or file systems that refuse
+ * the copy).
+ * 
+ * @param in_fd Source file descriptor.
+ * @param offset Offset of the range in the source file.
+ * @param out_fd Destination file descriptor, positioned where the range goes.
+ * @param length Number of bytes to copy.
+ * @return 1 on success, 0 on a read or write error.
+ */
+static int copy_file_bytes(int in_fd, off_t offset, int out_fd, off_t length) {
+#if defined(__linux__)
+    while (length > 0) {
+        ssize_t copied = copy_file_range(in_fd, &offset, out_fd, NULL, (size_t) length, 0);
+        if (copied <= 0) break;
+        length -= copied;
+    }
+    if (length == 0) return 1;
+#endif
+
+    size_t capacity = (size_t) CFF_TEXT_BUFFER_BYTES / CFF_WRITE_RING_SLOTS;
+    char* buffer = (char*) malloc(capacity);
+    if (buffer == NULL) exit(EXIT_FAILURE);
+    int ok = 1;
+    while (length > 0 && ok) {
+        size_t chunk = ((off_t) capacity < length) ? capacity : (size_t) length;
+        ssize_t got = pread(in_fd, buffer, chunk, offset);
+        if (got <= 0 || write(out_fd, buffer, (size_t) got) != got) {
+            ok = 0;
+        } else {
+            offset += got;
+            length -= got;
+        }
+    }
+    free(buffer);
+    return ok;
 }
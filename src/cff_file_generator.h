@@ -9,7 +9,60 @@
 #ifndef CFF_FILE_GENERATOR_H
 #define CFF_FILE_GENERATOR_H
 
+#include <stdio.h>
 #include <stdint.h>
+#include <pthread.h>
+#include "cff_builder.h"
+
+/*
+ * BINARY FORMAT CONSTANTS
+ */
+
+/** @brief Magic bytes at the start of a binary CFF file. */
+#define CFF_BINARY_MAGIC "CFFBIN1"
+
+/** @brief Byte order marker of a binary CFF header, written in native order (reads back byte-swapped on a machine of the other byte order). */
+#define CFF_BINARY_BYTE_ORDER 0x01020304
+
+/** @brief Maximum number of embedding steps recorded in a binary header. */
+#define CFF_BINARY_MAX_STEPS 32
+
+/** @brief Offset of the matrix words in a binary file (one page, so mapped rows are aligned). */
+#define CFF_BINARY_DATA_OFFSET 4096
+
+/** @brief Magic bytes at the start of a compressed sparse column (CSC) CFF file. */
+#define CFF_CSC_MAGIC "CFFCSC1"
+
+/** @brief Magic bytes at the start of an Elias-Fano compressed CFF file. */
+#define CFF_EF_MAGIC "CFFEF1"
+
+/** @brief Magic bytes at the start of a binary CSR CFF file. */
+#define CFF_CSR_MAGIC "CFFCSR1"
+
+/** @brief Magic bytes at the start of a chain archive. */
+#define CFF_ARCHIVE_MAGIC "CFFARC1"
+
+/** @brief Magic bytes at the start of every step record of a chain archive. */
+#define CFF_ARCHIVE_STEP_MAGIC "CFFSTP1"
+
+/** @brief Magic bytes at the start of a row/column label side file. */
+#define CFF_LABELS_MAGIC "CFFLBL1"
+
+/** @brief Magic bytes at the start of a shard file. */
+#define CFF_SHARD_MAGIC "CFFSHD1"
+
+/** @brief Offset of the file data in a shard file (one page, so the copied ranges are aligned). */
+#define CFF_SHARD_DATA_OFFSET 4096
+
+/** @brief Total size of the buffers the writers format rows into before each write. */
+#ifndef CFF_TEXT_BUFFER_BYTES
+#define CFF_TEXT_BUFFER_BYTES (32L * 1024 * 1024)
+#endif
+
+/** @brief Number of buffers in the ring between the formatting threads and the writer thread. */
+#ifndef CFF_WRITE_RING_SLOTS
+#define CFF_WRITE_RING_SLOTS 4
+#endif
 
 /*
  * DATA STRUCTURES
@@ -24,12 +77,319 @@
 struct cff_parameters {
     char construction;  /**< Construction type ('p' or 'm'). */
     int d;              /**< CFF parameter d (for monotone construction). */
-    int* Fqs;           /**< Array of finite field sizes. */
+    long* Fqs;          /**< Array of finite field sizes. */
     int fqs_count;      /**< Number of elements in Fqs. */
-    int* ks;            /**< Array of maximum polynomial degrees. */
+    long* ks;           /**< Array of maximum polynomial degrees. */
     int ks_count;       /**< Number of elements in ks. */
 };
 
+/**
+ * @brief Header of a binary CFF file.
+ * 
+ * Followed, at CFF_BINARY_DATA_OFFSET, by rows * words_per_row 64-bit
+ * words in native byte order: the rows of the bitmap, one after another.
+ */
+struct cff_binary_header {
+    char magic[8];                              /**< CFF_BINARY_MAGIC. */
+    char construction;                          /**< Construction type ('p' or 'm'). */
+    char reserved[3];                           /**< Padding, always zero. */
+    int32_t d;                                  /**< CFF parameter d. */
+    int32_t num_steps;                          /**< Number of entries in Fq_steps and k_steps. */
+    int32_t byte_order;                         /**< CFF_BINARY_BYTE_ORDER (0 in files written before the marker). */
+    int64_t rows;                               /**< Number of rows in the matrix. */
+    int64_t cols;                               /**< Number of columns in the matrix. */
+    int64_t words_per_row;                      /**< Row stride in 64-bit words. */
+    int64_t Fq_steps[CFF_BINARY_MAX_STEPS];     /**< Finite field size of every step. */
+    int64_t k_steps[CFF_BINARY_MAX_STEPS];      /**< Maximum polynomial degree of every step. */
+};
+
+/**
+ * @brief Header of a compressed sparse column (CSC) CFF file.
+ * 
+ * Followed by num_runs pairs of int64 (column count, column weight), giving
+ * the weight of every column in order, and then by the row indices of the
+ * ones of every column, ascending, as index_bytes-wide unsigned integers
+ * in native byte order. Column offsets are implicit: the weight is constant
+ * over each run (one run per block for the polynomial construction).
+ */
+struct cff_csc_header {
+    char magic[8];                              /**< CFF_CSC_MAGIC. */
+    char construction;                          /**< Construction type ('p' or 'm'). */
+    char reserved[3];                           /**< Padding, always zero. */
+    int32_t d;                                  /**< CFF parameter d. */
+    int32_t num_steps;                          /**< Number of entries in Fq_steps and k_steps. */
+    int32_t index_bytes;                        /**< Width of each row index (2, 4 or 8 bytes). */
+    int64_t rows;                               /**< Number of rows in the matrix. */
+    int64_t cols;                               /**< Number of columns in the matrix. */
+    int64_t num_ones;                           /**< Total number of row indices. */
+    int64_t num_runs;                           /**< Number of (column count, weight) runs. */
+    int64_t Fq_steps[CFF_BINARY_MAX_STEPS];     /**< Finite field size of every step. */
+    int64_t k_steps[CFF_BINARY_MAX_STEPS];      /**< Maximum polynomial degree of every step. */
+};
+
+/**
+ * @brief CFF matrix in compressed sparse column form.
+ * 
+ * The ones of column j are row_indices[col_offsets[j] .. col_offsets[j + 1]),
+ * stored as uint32_t, or as uint64_t when the rows do not fit in 32 bits
+ * (read them with csc_row_index).
+ */
+struct cff_csc_matrix {
+    long rows;                  /**< Number of rows in the matrix. */
+    long cols;                  /**< Number of columns in the matrix. */
+    int index_bytes;            /**< Width of each row index (4, or 8 beyond 2^32 rows). */
+    int64_t* col_offsets;       /**< Start of every column, cols + 1 entries. */
+    void* row_indices;          /**< Row indices of the ones, ascending per column. */
+};
+
+/**
+ * @brief Header of an Elias-Fano compressed CFF file.
+ * 
+ * Followed by num_runs pairs of int64 (column count, column weight), as in
+ * the CSC format, and then by the num_words 64-bit words of the encoded
+ * columns (see cff_ef_matrix).
+ */
+struct cff_ef_header {
+    char magic[8];                              /**< CFF_EF_MAGIC. */
+    char construction;                          /**< Construction type ('p' or 'm'). */
+    char reserved[3];                           /**< Padding, always zero. */
+    int32_t d;                                  /**< CFF parameter d. */
+    int32_t num_steps;                          /**< Number of entries in Fq_steps and k_steps. */
+    int32_t byte_order;                         /**< CFF_BINARY_BYTE_ORDER (0 in files written before the marker). */
+    int64_t rows;                               /**< Number of rows in the matrix. */
+    int64_t cols;                               /**< Number of columns in the matrix. */
+    int64_t num_runs;                           /**< Number of (column count, weight) runs. */
+    int64_t num_words;                          /**< Number of words of encoded columns. */
+    int64_t Fq_steps[CFF_BINARY_MAX_STEPS];     /**< Finite field size of every step. */
+    int64_t k_steps[CFF_BINARY_MAX_STEPS];      /**< Maximum polynomial degree of every step. */
+};
+
+/**
+ * @brief Header of a binary compressed sparse row (CSR) CFF file.
+ * 
+ * Followed by rows + 1 int64 row pointers and then by the num_ones column
+ * indices of the ones of every row, ascending, as index_bytes-wide
+ * unsigned integers in native byte order. The ones of row i are indices
+ * row_ptr[i] .. row_ptr[i + 1] - 1.
+ */
+struct cff_csr_header {
+    char magic[8];                              /**< CFF_CSR_MAGIC. */
+    char construction;                          /**< Construction type ('p' or 'm'). */
+    char reserved[3];                           /**< Padding, always zero. */
+    int32_t d;                                  /**< CFF parameter d. */
+    int32_t num_steps;                          /**< Number of entries in Fq_steps and k_steps. */
+    int32_t index_bytes;                        /**< Width of each column index (4 or 8 bytes). */
+    int64_t rows;                               /**< Number of rows in the matrix. */
+    int64_t cols;                               /**< Number of columns in the matrix. */
+    int64_t num_ones;                           /**< Total number of column indices. */
+    int64_t Fq_steps[CFF_BINARY_MAX_STEPS];     /**< Finite field size of every step. */
+    int64_t k_steps[CFF_BINARY_MAX_STEPS];      /**< Maximum polynomial degree of every step. */
+};
+
+/**
+ * @brief Run of consecutive columns of equal weight in an Elias-Fano matrix.
+ * 
+ * All columns of a run have the same weight over the same universe, so
+ * they are encoded with the same number of bits and the start of any
+ * column is first_bit + (col - first_col) * col_bits.
+ */
+struct cff_ef_run {
+    int64_t first_col;          /**< First column of the run. */
+    int64_t count;              /**< Number of columns in the run. */
+    int64_t weight;             /**< Number of ones of every column. */
+    int64_t low_bits;           /**< Low bits stored per row index. */
+    int64_t col_bits;           /**< Encoded size of every column, in bits. */
+    int64_t first_bit;          /**< Position of the first column in the bit array. */
+};
+
+/**
+ * @brief CFF matrix with every column stored as an Elias-Fano sequence.
+ * 
+ * A column of weight w over r rows keeps the low L = floor(log2(r / w))
+ * bits of each row index in w * L bits, followed by the high parts in
+ * unary (bit (index >> L) + i is set for the i-th one), about 2 + L bits
+ * per one in total. Columns are packed back to back without offsets.
+ */
+struct cff_ef_matrix {
+    long rows;                  /**< Number of rows in the matrix. */
+    long cols;                  /**< Number of columns in the matrix. */
+    long num_runs;              /**< Number of runs of equal-weight columns. */
+    struct cff_ef_run* runs;    /**< Column runs, in column order. */
+    long num_words;             /**< Number of words in bits. */
+    uint64_t* bits;             /**< Encoded columns. */
+};
+
+/**
+ * @brief Header of a chain archive.
+ * 
+ * Followed by one record per embedding step, appended in order. Each
+ * record is a cff_archive_step followed by the rows of its old_new,
+ * new_old and new_new blocks, each row as WORDS_FOR_BITS(cols) 64-bit
+ * words in native byte order.
+ */
+struct cff_archive_header {
+    char magic[8];              /**< CFF_ARCHIVE_MAGIC. */
+    int32_t d;                  /**< CFF parameter d. */
+    int32_t reserved;           /**< Padding, always zero. */
+};
+
+/**
+ * @brief Record describing one step of a chain archive.
+ * 
+ * The CFF after the step is the CFF of the previous step in the top-left
+ * corner, old_new to its right, and new_old followed by new_new below it.
+ * The first step stores only its new_new block, which is the initial CFF.
+ */
+struct cff_archive_step {
+    char magic[8];              /**< CFF_ARCHIVE_STEP_MAGIC. */
+    char construction;          /**< Construction type of the step ('p' or 'm'). */
+    char block_size;            /**< Block size of the step ('m', 'f' or 0). */
+    char reserved[6];           /**< Padding, always zero. */
+    int64_t q;                  /**< Finite field size of the step. */
+    int64_t k;                  /**< Maximum polynomial degree of the step. */
+    int64_t old_rows;           /**< Number of rows before the step. */
+    int64_t old_cols;           /**< Number of columns before the step. */
+    int64_t rows;               /**< Number of rows after the step. */
+    int64_t cols;               /**< Number of columns after the step. */
+    int64_t rows_old_new;       /**< Number of rows of the old_new block. */
+    int64_t cols_old_new;       /**< Number of columns of the old_new block. */
+    int64_t rows_new_old;       /**< Number of rows of the new_old block. */
+    int64_t cols_new_old;       /**< Number of columns of the new_old block. */
+    int64_t rows_new;           /**< Number of rows of the new_new block. */
+    int64_t cols_new;           /**< Number of columns of the new_new block. */
+    int64_t segment_bytes;      /**< Size of the three blocks following the record. */
+};
+
+/**
+ * @brief Index of the steps of a chain archive.
+ */
+struct cff_archive_index {
+    int d;                              /**< CFF parameter d. */
+    int num_steps;                      /**< Number of steps. */
+    struct cff_archive_step* steps;     /**< Record of every step. */
+    int64_t* offsets;                   /**< File offset of the blocks of every step. */
+};
+
+/**
+ * @brief Header of a row/column label side file (.lbl).
+ * 
+ * Labels the rows and columns of one embedding step with the pairs (x, y)
+ * and polynomials of its blocks, all over the field F_q of the step. Every
+ * field element is stored as its index (its coefficients read as base-p
+ * digits) in an element_bytes-wide unsigned integer in native byte order.
+ * The header is followed by:
+ *   - num_old_pairs (x, y) pairs, labelling rows 0, 1, ... of old_new;
+ *   - num_new_pairs (x, y) pairs, labelling rows old_rows, old_rows + 1, ...
+ *     of new_old and new_new;
+ *   - num_old_polys polynomials, labelling columns 0, 1, ... of new_old;
+ *   - num_new_polys polynomials, labelling columns old_cols, old_cols + 1, ...
+ *     of old_new and num_old_polys, num_old_polys + 1, ... of new_new;
+ * every polynomial as coeffs_per_poly coefficients, constant term first.
+ * A bit of these blocks is set if and only if P(x) = y for its row pair and
+ * column polynomial. The top-left corner holds the CFF of the previous step,
+ * labelled by the side file of that step.
+ */
+struct cff_labels_header {
+    char magic[8];              /**< CFF_LABELS_MAGIC. */
+    int32_t step;               /**< Number of the step, starting at 1. */
+    int32_t element_bytes;      /**< Width of each stored element (1, 2 or 4 bytes). */
+    int64_t q;                  /**< Finite field size of the step. */
+    int64_t p;                  /**< Characteristic of the field. */
+    int64_t old_rows;           /**< Number of rows before the step. */
+    int64_t old_cols;           /**< Number of columns before the step. */
+    int64_t num_old_pairs;      /**< Number of rows labelled by old pairs. */
+    int64_t num_new_pairs;      /**< Number of rows labelled by new pairs. */
+    int64_t num_old_polys;      /**< Number of old polynomials. */
+    int64_t num_new_polys;      /**< Number of new polynomials. */
+    int64_t coeffs_per_poly;    /**< Number of coefficients stored per polynomial. */
+};
+
+/**
+ * @brief Row and column labels of one embedding step.
+ * 
+ * Elements are widened to 32 bits in memory; the layout is that of the
+ * side file (see cff_labels_header).
+ */
+struct cff_labels {
+    struct cff_labels_header header;    /**< Header of the side file. */
+    uint32_t* old_pairs;                /**< num_old_pairs (x, y) pairs. */
+    uint32_t* new_pairs;                /**< num_new_pairs (x, y) pairs. */
+    uint32_t* old_polys;                /**< num_old_polys * coeffs_per_poly coefficients. */
+    uint32_t* new_polys;                /**< num_new_polys * coeffs_per_poly coefficients. */
+};
+
+/**
+ * @brief Header of a shard file.
+ * 
+ * A shard holds the rows first_row .. first_row + rows - 1 of a text or
+ * binary CFF of total_rows rows. From CFF_SHARD_DATA_OFFSET on, the file
+ * holds exactly the bytes these rows take in the merged file, preceded in
+ * shard 0 by the header of the merged file, so merging the shards of a
+ * matrix is a plain concatenation of their data.
+ */
+struct cff_shard_header {
+    char magic[8];                              /**< CFF_SHARD_MAGIC. */
+    char format;                                /**< Format of the merged file ('b' binary or 't' text). */
+    char construction;                          /**< Construction type ('p' or 'm'). */
+    char reserved[2];                           /**< Padding, always zero. */
+    int32_t d;                                  /**< CFF parameter d. */
+    int32_t num_steps;                          /**< Number of entries in Fq_steps and k_steps. */
+    int32_t shard;                              /**< Index of the shard, starting at 0. */
+    int32_t num_shards;                         /**< Number of shards of the matrix. */
+    int32_t byte_order;                         /**< CFF_BINARY_BYTE_ORDER (0 in files written before the marker). */
+    int64_t first_row;                          /**< First row of the shard. */
+    int64_t rows;                               /**< Number of rows in the shard. */
+    int64_t total_rows;                         /**< Number of rows in the merged matrix. */
+    int64_t cols;                               /**< Number of columns in the matrix. */
+    int64_t Fq_steps[CFF_BINARY_MAX_STEPS];     /**< Finite field size of every step. */
+    int64_t k_steps[CFF_BINARY_MAX_STEPS];      /**< Maximum polynomial degree of every step. */
+};
+
+/**
+ * @brief Streaming writer for text and binary CFF files.
+ * 
+ * Rows are formatted into a bounded ring of buffers and a dedicated
+ * thread writes the filled buffers to disk, so formatting (and the
+ * generation feeding it) overlaps the output I/O.
+ */
+struct cff_stream_writer {
+    FILE* file;                                 /**< Output file. */
+    char filename[CFF_PATH_MAX];                /**< Output file path, for error messages. */
+    char format;                                /**< File format ('b' binary or 't' text). */
+    long cols;                                  /**< Number of columns of the matrix. */
+    long row_bytes;                             /**< Bytes of one formatted row. */
+    long slot_rows;                             /**< Rows that fit in one buffer. */
+    char* slots[CFF_WRITE_RING_SLOTS];          /**< Ring of buffers. */
+    size_t lengths[CFF_WRITE_RING_SLOTS];       /**< Bytes used in every filled buffer. */
+    int head;                                   /**< Next buffer to fill. */
+    int tail;                                   /**< Next buffer to write. */
+    int filled;                                 /**< Number of filled buffers waiting to be written. */
+    int closing;                                /**< Set when no more rows will be added. */
+    int error;                                  /**< Set if a write failed. */
+    pthread_mutex_t lock;                       /**< Protects the ring state. */
+    pthread_cond_t not_empty;                   /**< Signalled when a buffer is filled. */
+    pthread_cond_t not_full;                    /**< Signalled when a buffer is written. */
+    pthread_t writer;                           /**< Writer thread. */
+    char lut[256][16];                          /**< Text of every byte value, for the text format. */
+};
+
+/**
+ * @brief Sequential row reader for text and binary CFFs on a pipe.
+ * 
+ * Reads one row at a time without seeking or mapping, so the input may be
+ * stdin or any other stream.
+ */
+struct cff_row_reader {
+    FILE* file;                 /**< Input stream. */
+    char format;                /**< Input format ('b' binary or 't' text). */
+    long rows;                  /**< Number of rows, or -1 if only known at the end (text). */
+    long cols;                  /**< Number of columns. */
+    long rows_read;             /**< Number of rows returned so far. */
+    char* line;                 /**< Line buffer of the text format. */
+    size_t line_capacity;       /**< Capacity of the line buffer. */
+    ssize_t pending;            /**< Length of a row already read into line, or -1. */
+};
+
 /*
  * FUNCTION PROTOTYPES
  */
@@ -57,8 +417,427 @@ uint64_t** read_cff_from_file(const char* filename, long* rows, long* cols);
  * @param matrix CFF matrix in bitmap format.
  * @param rows Number of rows in the matrix.
  * @param cols Number of columns in the matrix.
+ * @return 1 on success, 0 (with an error message) on error.
+ */
+int write_cff_to_file(const char* filename, char construction, int d, long* Fq_steps, int fqs_count, long* K_steps, int ks_count, uint64_t** matrix, long rows, long cols);
+
+/**
+ * @brief Writes a CFF matrix to a binary file.
+ * 
+ * @param filename Output file path.
+ * @param construction Construction type.
+ * @param d CFF parameter d.
+ * @param Fq_steps Array with finite field sizes.
+ * @param fqs_count Number of elements in Fq_steps.
+ * @param K_steps Array with maximum polynomial degrees.
+ * @param ks_count Number of elements in K_steps.
+ * @param matrix CFF matrix in bitmap format.
+ * @param rows Number of rows in the matrix.
+ * @param cols Number of columns in the matrix.
+ * @return 1 on success, 0 (with an error message) on error.
+ */
+int write_cff_to_binary_file(const char* filename, char construction, int d, long* Fq_steps, int fqs_count, long* K_steps, int ks_count, uint64_t** matrix, long rows, long cols);
+
+/**
+ * @brief Creates a zeroed binary CFF file of the given size and maps it for writing.
+ * 
+ * @param filename Output file path.
+ * @param construction Construction type.
+ * @param d CFF parameter d.
+ * @param Fq_steps Array with finite field sizes.
+ * @param fqs_count Number of elements in Fq_steps.
+ * @param K_steps Array with maximum polynomial degrees.
+ * @param ks_count Number of elements in K_steps.
+ * @param rows Number of rows in the matrix.
+ * @param cols Number of columns in the matrix.
+ * @return Writable CFF matrix whose rows point into the file (released with unmap_cff_matrix), or NULL on error.
+ */
+uint64_t** create_cff_binary_file(const char* filename, char construction, int d, long* Fq_steps, int fqs_count, long* K_steps, int ks_count, long rows, long cols);
+
+/**
+ * @brief Opens a streaming writer for a text or binary CFF file.
+ * 
+ * @param filename Output file path.
+ * @param format File format ('b' binary or 't' text).
+ * @param construction Construction type.
+ * @param d CFF parameter d.
+ * @param Fq_steps Array with finite field sizes.
+ * @param fqs_count Number of elements in Fq_steps.
+ * @param K_steps Array with maximum polynomial degrees.
+ * @param ks_count Number of elements in K_steps.
+ * @param rows Number of rows that will be written.
+ * @param cols Number of columns in the matrix.
+ * @return Writer (released with close_cff_stream), or NULL on error.
+ */
+struct cff_stream_writer* open_cff_stream(const char* filename, char format, char construction, int d, long* Fq_steps, int fqs_count, long* K_steps, int ks_count, long rows, long cols);
+
+/**
+ * @brief Opens a streaming writer for one shard of a text or binary CFF file.
+ * 
+ * @param filename Shard file path.
+ * @param format Format of the merged file ('b' binary or 't' text).
+ * @param construction Construction type.
+ * @param d CFF parameter d.
+ * @param Fq_steps Array with finite field sizes.
+ * @param fqs_count Number of elements in Fq_steps.
+ * @param K_steps Array with maximum polynomial degrees.
+ * @param ks_count Number of elements in K_steps.
+ * @param rows Number of rows in the merged matrix.
+ * @param cols Number of columns in the matrix.
+ * @param shard Index of the shard.
+ * @param num_shards Number of shards.
+ * @param first_row First row of the shard.
+ * @param shard_rows Number of rows that will be written to the shard.
+ * @return Writer (released with close_cff_stream), or NULL on error.
+ */
+struct cff_stream_writer* open_cff_shard_stream(const char* filename, char format, char construction, int d, long* Fq_steps, int fqs_count, long* K_steps, int ks_count, long rows, long cols, int shard, int num_shards, long first_row, long shard_rows);
+
+/**
+ * @brief Concatenates the shards of a CFF into the merged file.
+ * 
+ * @param filename Output file path.
+ * @param shard_files Paths of the shard files, in any order.
+ * @param count Number of shard files.
+ * @param rows Pointer to store the number of rows of the merged matrix.
+ * @param cols Pointer to store the number of columns of the merged matrix.
+ * @return 1 on success, 0 if the shards are missing, inconsistent or unreadable.
+ */
+int merge_cff_shards(const char* filename, char* const* shard_files, int count, long* rows, long* cols);
+
+/**
+ * @brief Appends rows to a streaming writer.
+ * 
+ * @param stream Streaming writer.
+ * @param rows Rows in bitmap format, in file order.
+ * @param count Number of rows.
+ * @return 1 on success, 0 if a write has failed.
+ */
+int write_cff_stream_rows(struct cff_stream_writer* stream, uint64_t** rows, long count);
+
+/**
+ * @brief Flushes and closes a streaming writer.
+ * 
+ * @param stream Streaming writer.
+ * @return 1 on success, 0 if a write failed.
+ */
+int close_cff_stream(struct cff_stream_writer* stream);
+
+/**
+ * @brief Writes a CFF matrix to a compressed sparse column (CSC) file.
+ * 
+ * @param filename Output file path.
+ * @param construction Construction type.
+ * @param d CFF parameter d.
+ * @param Fq_steps Array with finite field sizes.
+ * @param fqs_count Number of elements in Fq_steps.
+ * @param K_steps Array with maximum polynomial degrees.
+ * @param ks_count Number of elements in K_steps.
+ * @param matrix CFF matrix in bitmap format.
+ * @param rows Number of rows in the matrix.
+ * @param cols Number of columns in the matrix.
+ * @return 1 on success, 0 (with an error message) on error.
+ */
+int write_cff_to_csc_file(const char* filename, char construction, int d, long* Fq_steps, int fqs_count, long* K_steps, int ks_count, uint64_t** matrix, long rows, long cols);
+
+/**
+ * @brief Reads a compressed sparse column (CSC) CFF file.
+ * 
+ * @param filename Path to the file to be read.
+ * @param params Pointer to store the parameters, or NULL to skip them.
+ * @return CSC matrix (freed with free_cff_csc), or NULL on error.
+ */
+struct cff_csc_matrix* read_cff_csc_file(const char* filename, struct cff_parameters** params);
+
+/**
+ * @brief Converts a CFF matrix from the bitmap format to CSC.
+ * 
+ * @param matrix CFF matrix in bitmap format.
+ * @param rows Number of rows in the matrix.
+ * @param cols Number of columns in the matrix.
+ * @return CSC matrix (freed with free_cff_csc).
+ */
+struct cff_csc_matrix* bitmap_to_csc(uint64_t** matrix, long rows, long cols);
+
+/**
+ * @brief Expands a CSC matrix into the bitmap format.
+ * 
+ * @param csc CSC matrix.
+ * @return CFF matrix in bitmap format.
+ */
+uint64_t** csc_to_bitmap(const struct cff_csc_matrix* csc);
+
+/**
+ * @brief Returns one row index of a CSC matrix, whatever its width.
+ * 
+ * @param csc CSC matrix.
+ * @param k Position in row_indices.
+ * @return Row index.
+ */
+uint64_t csc_row_index(const struct cff_csc_matrix* csc, int64_t k);
+
+/**
+ * @brief Frees a CSC matrix.
+ * 
+ * @param csc CSC matrix to be freed.
+ */
+void free_cff_csc(struct cff_csc_matrix* csc);
+
+/**
+ * @brief Encodes a CFF matrix as Elias-Fano columns.
+ * 
+ * @param matrix CFF matrix in bitmap format.
+ * @param rows Number of rows in the matrix.
+ * @param cols Number of columns in the matrix.
+ * @return Encoded matrix (freed with free_cff_ef).
+ */
+struct cff_ef_matrix* bitmap_to_ef(uint64_t** matrix, long rows, long cols);
+
+/**
+ * @brief Decodes one column of an Elias-Fano matrix.
+ * 
+ * @param ef Encoded matrix.
+ * @param col Column index.
+ * @param rows_out Buffer of at least the column weight entries to store the row indices, ascending.
+ * @return Number of rows stored.
+ */
+long ef_get_column(const struct cff_ef_matrix* ef, long col, long* rows_out);
+
+/**
+ * @brief Expands an Elias-Fano matrix into the bitmap format.
+ * 
+ * @param ef Encoded matrix.
+ * @return CFF matrix in bitmap format.
+ */
+uint64_t** ef_to_bitmap(const struct cff_ef_matrix* ef);
+
+/**
+ * @brief Writes a CFF matrix to an Elias-Fano compressed file.
+ * 
+ * @param filename Output file path.
+ * @param construction Construction type.
+ * @param d CFF parameter d.
+ * @param Fq_steps Array with finite field sizes.
+ * @param fqs_count Number of elements in Fq_steps.
+ * @param K_steps Array with maximum polynomial degrees.
+ * @param ks_count Number of elements in K_steps.
+ * @param matrix CFF matrix in bitmap format.
+ * @param rows Number of rows in the matrix.
+ * @param cols Number of columns in the matrix.
+ * @return 1 on success, 0 (with an error message) on error.
+ */
+int write_cff_to_ef_file(const char* filename, char construction, int d, long* Fq_steps, int fqs_count, long* K_steps, int ks_count, uint64_t** matrix, long rows, long cols);
+
+/**
+ * @brief Writes a CFF matrix in Matrix Market coordinate pattern format.
+ * 
+ * @param filename Output file path.
+ * @param construction Construction type.
+ * @param d CFF parameter d.
+ * @param Fq_steps Array with finite field sizes.
+ * @param fqs_count Number of elements in Fq_steps.
+ * @param K_steps Array with maximum polynomial degrees.
+ * @param ks_count Number of elements in K_steps.
+ * @param matrix CFF matrix in bitmap format.
+ * @param rows Number of rows in the matrix.
+ * @param cols Number of columns in the matrix.
+ * @return 1 on success, 0 (with an error message) on error.
+ */
+int write_cff_to_mtx_file(const char* filename, char construction, int d, long* Fq_steps, int fqs_count, long* K_steps, int ks_count, uint64_t** matrix, long rows, long cols);
+
+/**
+ * @brief Writes a CFF matrix to a binary compressed sparse row (CSR) file.
+ * 
+ * @param filename Output file path.
+ * @param construction Construction type.
+ * @param d CFF parameter d.
+ * @param Fq_steps Array with finite field sizes.
+ * @param fqs_count Number of elements in Fq_steps.
+ * @param K_steps Array with maximum polynomial degrees.
+ * @param ks_count Number of elements in K_steps.
+ * @param matrix CFF matrix in bitmap format.
+ * @param rows Number of rows in the matrix.
+ * @param cols Number of columns in the matrix.
+ * @return 1 on success, 0 (with an error message) on error.
+ */
+int write_cff_to_csr_file(const char* filename, char construction, int d, long* Fq_steps, int fqs_count, long* K_steps, int ks_count, uint64_t** matrix, long rows, long cols);
+
+/**
+ * @brief Reads an Elias-Fano compressed CFF file.
+ * 
+ * @param filename Path to the file to be read.
+ * @param params Pointer to store the parameters, or NULL to skip them.
+ * @return Encoded matrix (freed with free_cff_ef), or NULL on error.
+ */
+struct cff_ef_matrix* read_cff_ef_file(const char* filename, struct cff_parameters** params);
+
+/**
+ * @brief Frees an Elias-Fano matrix.
+ * 
+ * @param ef Encoded matrix to be freed.
+ */
+void free_cff_ef(struct cff_ef_matrix* ef);
+
+/**
+ * @brief Creates an empty chain archive.
+ * 
+ * @param filename Output file path.
+ * @param d CFF parameter d.
+ * @return 1 on success, 0 on error.
+ */
+int create_cff_archive(const char* filename, int d);
+
+/**
+ * @brief Appends the blocks of one embedding step to a chain archive.
+ * 
+ * @param filename Archive file path.
+ * @param construction Construction type of the step.
+ * @param block_size Block size of the step.
+ * @param q Finite field size of the step.
+ * @param k Maximum polynomial degree of the step.
+ * @param blocks Blocks generated for the step.
+ * @param first_step 1 if this is the first step (only new_new is stored).
+ * @return 1 on success, 0 on error.
+ */
+int append_cff_archive_step(const char* filename, char construction, char block_size, long q, long k, const generated_cffs* blocks, int first_step);
+
+/**
+ * @brief Reads the index of a chain archive.
+ * 
+ * @param filename Archive file path.
+ * @param index Pointer to store the index (freed with free_cff_archive_index).
+ * @return 1 on success, 0 on error.
+ */
+int read_cff_archive_index(const char* filename, struct cff_archive_index* index);
+
+/**
+ * @brief Rebuilds the CFF of one step of a chain archive.
+ * 
+ * @param filename Archive file path.
+ * @param step Step number, starting at 1.
+ * @param rows Pointer to store the number of rows.
+ * @param cols Pointer to store the number of columns.
+ * @return CFF matrix in bitmap format, or NULL on error.
+ */
+uint64_t** extract_cff_archive_step(const char* filename, int step, long* rows, long* cols);
+
+/**
+ * @brief Frees the memory of an archive index.
+ * 
+ * @param index Pointer to the index to be freed.
+ */
+void free_cff_archive_index(struct cff_archive_index* index);
+
+/**
+ * @brief Writes the row/column label side file of an embedding step.
+ * 
+ * @param filename Output file path.
+ * @param step Field, pairs and polynomials of the step.
+ * @param old_rows Number of rows before the step.
+ * @param old_cols Number of columns before the step.
+ * @return 1 on success, 0 on error.
+ */
+int write_cff_labels(const char* filename, const cff_step* step, long old_rows, long old_cols);
+
+/**
+ * @brief Reads a row/column label side file.
+ * 
+ * @param filename Path to the file to be read.
+ * @param labels Pointer to store the labels (freed with free_cff_labels).
+ * @return 1 on success, 0 if the file is missing or not a label file.
+ */
+int read_cff_labels(const char* filename, struct cff_labels* labels);
+
+/**
+ * @brief Frees the arrays of a label structure.
+ * 
+ * @param labels Labels to be freed.
+ */
+void free_cff_labels(struct cff_labels* labels);
+
+/**
+ * @brief Loads a CFF file of any format with a single open.
+ * 
+ * @param filename Path to the file to be read (binary, CSC, Elias-Fano, recipe, archive or text).
+ * @param rows Pointer to store the number of rows.
+ * @param cols Pointer to store the number of columns.
+ * @param params Pointer to store the parameters (freed by the caller).
+ * @param mapped Pointer to store 1 if the matrix must be released with unmap_cff_matrix.
+ * @return CFF matrix in bitmap format, or NULL on error.
+ */
+uint64_t** load_cff_file(const char* filename, long* rows, long* cols, struct cff_parameters** params, int* mapped);
+
+/**
+ * @brief Maps the matrix of a binary CFF file into memory.
+ * 
+ * @param filename Path to the file to be read.
+ * @param rows Pointer to store the number of rows.
+ * @param cols Pointer to store the number of columns.
+ * @return Read-only CFF matrix whose rows point into the mapping, or NULL on error.
+ */
+uint64_t** map_cff_binary_file(const char* filename, long* rows, long* cols);
+
+/**
+ * @brief Releases a matrix returned by map_cff_binary_file or create_cff_binary_file.
+ * 
+ * @param matrix Mapped CFF matrix.
+ * @param rows Number of rows in the matrix.
+ * @param cols Number of columns in the matrix.
+ */
+void unmap_cff_matrix(uint64_t** matrix, long rows, long cols);
+
+/**
+ * @brief Checks whether a file is in the binary CFF format.
+ * 
+ * @param filename Path to the file.
+ * @return 1 if the file starts with CFF_BINARY_MAGIC, 0 otherwise.
+ */
+int is_cff_binary_file(const char* filename);
+
+/**
+ * @brief Checks whether two paths name the same file.
+ * 
+ * Compares device and inode, so aliases such as "./x", symbolic links and
+ * hard links are recognised as well as identical paths.
+ * 
+ * @param a First path.
+ * @param b Second path.
+ * @return 1 if both paths exist and are the same file, 0 otherwise.
+ */
+int is_same_cff_file(const char* a, const char* b);
+
+/**
+ * @brief Opens a sequential row reader on a text or binary CFF stream.
+ * 
+ * @param file Input stream, positioned at the start of the CFF.
+ * @param params Pointer to store the parameters of the CFF.
+ * @return Reader (released with close_cff_row_reader), or NULL on error.
+ */
+struct cff_row_reader* open_cff_row_reader(FILE* file, struct cff_parameters** params);
+
+/**
+ * @brief Reads the next row of a CFF stream.
+ * 
+ * @param reader Row reader.
+ * @param row Zeroed buffer of WORDS_FOR_BITS(reader->cols) words.
+ * @return 1 if a row was read, 0 at the end of the matrix.
+ */
+int read_cff_row(struct cff_row_reader* reader, uint64_t* row);
+
+/**
+ * @brief Skips rows of a CFF stream.
+ * 
+ * @param reader Row reader.
+ * @param count Number of rows to skip.
+ * @return Number of rows skipped (fewer at the end of the matrix).
+ */
+long skip_cff_rows(struct cff_row_reader* reader, long count);
+
+/**
+ * @brief Releases a row reader (the stream itself is not closed).
+ * 
+ * @param reader Row reader.
  */
-void write_cff_to_file(const char* filename, char construction, int d, long* Fq_steps, int fqs_count, long* K_steps, int ks_count, uint64_t** matrix, long rows, long cols);
+void close_cff_row_reader(struct cff_row_reader* reader);
 
 /**
  * @brief Reads CFF parameters from a file.
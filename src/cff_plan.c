@@ -0,0 +1,654 @@
+/**
+ * @file cff_plan.c
+ * @brief Implementation of memory and time estimates of a generation step.
+ * 
+ * This file contains the functions that predict the sizes and phase times
+ * of a step from its parameters, choose between in-memory, streamed and
+ * tiled generation under a memory limit, and print the resulting plan.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <omp.h>
+#include <sys/stat.h>
+#include "cff_plan.h"
+#include "cff_file_generator.h"
+
+/*
+ *  HELPER FUNCTION PROTOTYPES
+ */
+
+/**
+ * @brief Counts the polynomials of the union of the first steps, up to a degree.
+ * 
+ * @param sizes Array with the subfield size of every step.
+ * @param k_steps Array with maximum polynomial degrees.
+ * @param count Number of steps in the union.
+ * @param max_degree Largest degree counted.
+ * @return Number of distinct polynomials.
+ */
+static long count_union_polys(const long* sizes, const long* k_steps, int count, long max_degree);
+
+/**
+ * @brief Returns the number of elements of a field of size q with x^q_step = x.
+ * 
+ * @param q_step Field size of a step.
+ * @param q Field size of the last step.
+ * @return Size of the subfield partition_by_subfields finds for the step.
+ */
+static long subfield_size(long q_step, long q);
+
+/**
+ * @brief Returns the capacity a dynamic list reaches for a number of entries.
+ * 
+ * @param count Number of entries.
+ * @return Capacity, as grown by add_pair_to_list and add_element_to_list.
+ */
+static double list_capacity(long count);
+
+/**
+ * @brief Returns the heap memory of a bitmap block.
+ * 
+ * @param rows Number of rows.
+ * @param cols Number of columns.
+ * @return Memory in bytes, with one allocation per row.
+ */
+static double bitmap_bytes(long rows, long cols);
+
+/**
+ * @brief Returns the size of a file holding a matrix.
+ * 
+ * @param format File format.
+ * @param rows Number of rows.
+ * @param cols Number of columns.
+ * @return Size in bytes (the bitmap size for formats other than text and binary).
+ */
+static double file_bytes(char format, long rows, long cols);
+
+/**
+ * @brief Returns the number of rows one process generates.
+ * 
+ * @param plan Plan of the step.
+ * @return Rows of the largest shard, or all rows.
+ */
+static long shard_rows(const cff_plan* plan);
+
+/**
+ * @brief Appends a phase to a plan.
+ * 
+ * @param plan Plan of the step.
+ * @param name Name of the phase.
+ * @param bytes Memory of the structure the phase builds.
+ * @param seconds Predicted time of the phase.
+ */
+static void add_plan_phase(cff_plan* plan, const char* name, double bytes, double seconds);
+
+/**
+ * @brief Formats a size in bytes with a binary unit.
+ * 
+ * @param out Buffer to store the text.
+ * @param size Size of the buffer.
+ * @param bytes Size in bytes.
+ */
+static void format_bytes(char* out, size_t size, double bytes);
+
+/**
+ * @brief Returns the name of a strategy.
+ * 
+ * @param strategy Strategy.
+ * @return Name of the strategy.
+ */
+static const char* strategy_name(char strategy);
+
+/*
+ *  ESTIMATE FUNCTIONS
+ */
+
+/**
+ * @brief Estimates the memory and time of a step without generating it.
+ * 
+ * The counts follow prepare_cff_step for a chain of nested subfields:
+ * step i contributes the q_i^(k_i + 1) polynomials over its field, and the
+ * pairs of the steps before the last are the old rows. Sizes use the
+ * structures of the FLINT build the program is compiled against.
+ * 
+ * @param plan Structure to be filled.
+ * @param construction Construction type ('p' or 'm').
+ * @param block_size Define the size of CFF rows.
+ * @param d CFF parameter d.
+ * @param Fq_steps Array with finite field sizes, including the new step.
+ * @param k_steps Array with maximum polynomial degrees, including the new step.
+ * @param num_steps Number of steps (1 for an initial CFF).
+ * @param old_rows Number of rows of the input CFF (0 for an initial CFF).
+ * @param old_cols Number of columns of the input CFF (0 for an initial CFF).
+ * @param input_format Format of the input CFF ('b' or 't'), or 0 if none is read.
+ * @param format Output file format.
+ * @param in_place 1 if a binary embedding is written in place into a mapped file.
+ * @param num_shards Number of shards the rows are split into, or 0.
+ * @return 1 on success, 0 if the last field size is not a prime power.
+ */
+int estimate_cff_plan(cff_plan* plan, char construction, char block_size, int d, const long* Fq_steps, const long* k_steps, int num_steps, long old_rows, long old_cols, char input_format, char format, int in_place, int num_shards) {
+    memset(plan, 0, sizeof(*plan));
+    long q = Fq_steps[num_steps - 1];
+    long k = k_steps[num_steps - 1];
+    long p, n;
+    if (!decompose_prime_power(q, &p, &n)) {
+        fprintf(stderr, "Error: %ld is not a prime power!\n", q);
+        return 0;
+    }
+
+    plan->action = (num_steps == 1) ? 'f' : 'g';
+    plan->format = format;
+    plan->input_format = input_format;
+    plan->in_place = in_place;
+    plan->num_shards = num_shards;
+    plan->threads = omp_get_max_threads();
+    plan->old_rows = old_rows;
+    plan->old_cols = old_cols;
+    plan->use_table = (q <= EVAL_TABLE_MAX_Q);
+
+    // Step i uses the elements with x^q_i = x of the last field, a subfield of 1 + gcd(q_i - 1, q - 1) elements.
+    long* sizes = (long*) malloc(num_steps * sizeof(long));
+    if (sizes == NULL) exit(EXIT_FAILURE);
+    for (int i = 0; i < num_steps; i++) sizes[i] = subfield_size(Fq_steps[i], q);
+
+    // Polynomials: the old ones are the union of the earlier steps, the new ones those of the last step outside it.
+    long prev_size = 0, prev_k = 0, created_polys = 0;
+    for (int i = 0; i < num_steps - 1; i++) {
+        if (sizes[i] > prev_size) prev_size = sizes[i];
+        if (k_steps[i] > prev_k) prev_k = k_steps[i];
+        created_polys = checked_add(created_polys, checked_pow(sizes[i], k_steps[i] + 1));
+    }
+    long num_all_polys = checked_pow(q, k + 1);
+    plan->num_old_polys = count_union_polys(sizes, k_steps, num_steps - 1, prev_k);
+    plan->num_new_polys = num_all_polys - count_union_polys(sizes, k_steps, num_steps - 1, k);
+
+    // Pairs: every step adds the pairs of its own elements (monotone: against the dk block).
+    long dk_size = 0;
+    plan->num_new_rows = cff_step_new_rows(construction, block_size, d, Fq_steps, k_steps, num_steps, &dk_size);
+    long num_new_pairs = 0;
+    if (num_steps == 1) {
+        num_new_pairs = checked_mul(q, q);
+    } else if (construction == 'm') {
+        plan->num_old_pairs = checked_add(checked_mul(sizes[0], sizes[0]), checked_mul(dk_size, prev_size - sizes[0]));
+        num_new_pairs = (q > prev_size) ? checked_mul(dk_size, q - prev_size) : 0;
+    } else {
+        plan->num_old_pairs = checked_mul(prev_size, prev_size);
+        num_new_pairs = (q > prev_size) ? checked_mul(q, q) - plan->num_old_pairs : 0;
+    }
+
+    if (plan->action == 'f') {
+        plan->rows = plan->num_new_rows;
+        plan->cols = plan->num_new_polys;
+    } else {
+        long width_top = old_cols + plan->num_new_polys;
+        long width_bottom = plan->num_old_polys + plan->num_new_polys;
+        plan->rows = checked_add(old_rows, plan->num_new_rows);
+        plan->cols = (width_top > width_bottom) ? width_top : width_bottom;
+    }
+
+    // Field elements own n limbs each; polynomials own up to k + 1 elements.
+    double element_bytes = sizeof(fq_nmod_struct) + n * sizeof(ulong) + CFF_PLAN_ALLOC_OVERHEAD;
+    double new_poly_bytes = sizeof(fq_nmod_poly_struct) + CFF_PLAN_ALLOC_OVERHEAD + (k + 1) * element_bytes;
+    double old_poly_bytes = sizeof(fq_nmod_poly_struct) + CFF_PLAN_ALLOC_OVERHEAD + (prev_k + 1) * element_bytes;
+    double pair_bytes = sizeof(element_pair) + 2.0 * (element_bytes - sizeof(fq_nmod_struct));
+
+    double elements = 0;
+    long seen = 0;
+    for (int i = 0; i < num_steps; i++) {
+        elements += list_capacity(sizes[i]);
+        if (sizes[i] > seen) elements += list_capacity(sizes[i] - seen);
+        if (sizes[i] > seen) seen = sizes[i];
+    }
+    free(sizes);
+    plan->step_bytes = elements * element_bytes +
+        plan->num_old_polys * old_poly_bytes + (double) (num_all_polys + plan->num_new_polys) * new_poly_bytes +
+        (list_capacity(plan->num_old_pairs) + list_capacity(num_new_pairs)) * pair_bytes;
+
+    if (plan->use_table) {
+        plan->index_bytes = (double) q * (WORDS_FOR_BITS(plan->num_old_polys) + WORDS_FOR_BITS(plan->num_new_polys)) * BITS_PER_WORD + 2.0 * q * sizeof(long);
+    } else {
+        double posting_bytes = (plan->num_old_polys <= (long) UINT32_MAX && plan->num_new_polys <= (long) UINT32_MAX) ? sizeof(uint32_t) : sizeof(long);
+        plan->index_bytes = (double) q * (plan->num_old_polys + plan->num_new_polys) * posting_bytes + 2.0 * q * (q + 1) * sizeof(long) + 2.0 * q * sizeof(long);
+    }
+
+    plan->blocks_bytes = bitmap_bytes(plan->num_old_pairs, plan->num_new_polys) +
+        bitmap_bytes(plan->num_new_rows, plan->num_old_polys) + bitmap_bytes(plan->num_new_rows, plan->num_new_polys);
+    plan->pointer_bytes = (plan->num_old_pairs + 2.0 * plan->num_new_rows + 3) * sizeof(uint64_t*);
+    plan->tile_row_bytes = (bitmap_bytes(1, plan->num_new_polys) * 2 + bitmap_bytes(1, plan->num_old_polys));
+    if (plan->action == 'g' && !in_place && format != 'a') plan->matrix_bytes = bitmap_bytes(plan->rows, plan->cols);
+    if (input_format == 't') plan->input_bytes = bitmap_bytes(old_rows, old_cols);
+    if ((format == 'b' || format == 't') && !in_place) {
+        // The writer ring holds CFF_WRITE_RING_SLOTS slots of rows, and a batch of bitmap rows feeds it.
+        double row_bytes = (format == 'b') ? WORDS_FOR_BITS(plan->cols) * sizeof(uint64_t) : 2.0 * plan->cols;
+        double slot_rows = (row_bytes > 0) ? (double) (CFF_TEXT_BUFFER_BYTES / CFF_WRITE_RING_SLOTS) / row_bytes : plan->rows;
+        if (slot_rows > plan->rows) slot_rows = plan->rows;
+        if (slot_rows < 1) slot_rows = 1;
+        plan->stream_bytes = CFF_WRITE_RING_SLOTS * slot_rows * row_bytes + bitmap_bytes((long) slot_rows, plan->cols);
+    }
+    plan->output_bytes = (format == 'a') ? plan->blocks_bytes : file_bytes(format, plan->rows, plan->cols);
+
+    // Times: the partition of the polynomials scans the old list once per polynomial, on one thread.
+    double share = (num_shards > 0) ? 1.0 / num_shards : 1.0;
+    double poly_ops = (double) (num_all_polys + created_polys) * (plan->num_old_polys + k + 1) +
+        (double) q * num_steps + (double) plan->num_old_pairs + num_new_pairs;
+    add_plan_phase(plan, "field, polynomials and pairs", plan->step_bytes, poly_ops / CFF_PLAN_POLY_OPS_PER_SECOND);
+
+    double evals = (double) q * (plan->num_old_polys + plan->num_new_polys) * (k + 1);
+    add_plan_phase(plan, plan->use_table ? "evaluation tables" : "inverted indexes", plan->index_bytes, evals / (CFF_PLAN_EVALS_PER_SECOND * plan->threads));
+
+    double cells = (double) plan->num_old_pairs * plan->num_new_polys + (double) plan->num_new_rows * (plan->num_old_polys + plan->num_new_polys);
+    double cell_seconds = plan->use_table ? cells / CFF_PLAN_CELLS_PER_SECOND : cells / q / CFF_PLAN_POSTINGS_PER_SECOND;
+    add_plan_phase(plan, "new blocks", plan->blocks_bytes, share * (cell_seconds / plan->threads + plan->blocks_bytes / CFF_PLAN_COPY_BYTES_PER_SECOND));
+
+    if (plan->action == 'g' && format != 'a') {
+        double read_bytes = (input_format == 't') ? file_bytes('t', old_rows, old_cols) : file_bytes('b', old_rows, old_cols);
+        add_plan_phase(plan, "read input", plan->input_bytes, share * read_bytes / CFF_PLAN_IO_BYTES_PER_SECOND);
+        add_plan_phase(plan, "embedding", plan->matrix_bytes, share * bitmap_bytes(plan->rows, plan->cols) / CFF_PLAN_COPY_BYTES_PER_SECOND);
+    }
+    add_plan_phase(plan, "write", plan->stream_bytes, share * plan->output_bytes / CFF_PLAN_IO_BYTES_PER_SECOND);
+    return 1;
+}
+
+/**
+ * @brief Returns the predicted peak memory of a strategy.
+ * 
+ * The structures of the step and the indexes live until the blocks are
+ * generated; in memory the blocks then meet the embedded matrix (and a
+ * parsed text input), streamed they meet only the writer buffers, and
+ * tiled only one tile of each block is held next to the indexes.
+ * 
+ * @param plan Plan of the step.
+ * @param strategy CFF_STRATEGY_MEMORY, CFF_STRATEGY_STREAMED or CFF_STRATEGY_TILED.
+ * @param tile_rows Rows per tile for CFF_STRATEGY_TILED, or 0 for one tile per shard.
+ * @return Peak memory in bytes, or -1 if the strategy does not apply to the step.
+ */
+double cff_plan_peak(const cff_plan* plan, char strategy, long tile_rows) {
+    double generation = plan->step_bytes + plan->index_bytes + plan->blocks_bytes;
+    int text_or_binary = (plan->format == 't' || (plan->format == 'b' && (plan->action == 'f' || plan->input_format == 'b')));
+
+    if (strategy == CFF_STRATEGY_MEMORY) {
+        if (plan->action == 'f') return generation + plan->stream_bytes;
+        double assembly = plan->blocks_bytes + plan->matrix_bytes + plan->stream_bytes;
+        return plan->input_bytes + ((generation > assembly) ? generation : assembly);
+    }
+    if (strategy == CFF_STRATEGY_STREAMED) {
+        if (plan->action != 'g' || !text_or_binary) return -1;
+        double assembly = plan->blocks_bytes + plan->stream_bytes;
+        return (generation > assembly) ? generation : assembly;
+    }
+    if (strategy == CFF_STRATEGY_TILED) {
+        if (!text_or_binary) return -1;
+        long rows = shard_rows(plan);
+        if (tile_rows <= 0 || tile_rows > rows) tile_rows = rows;
+        return plan->step_bytes + plan->index_bytes + plan->pointer_bytes + plan->stream_bytes + tile_rows * plan->tile_row_bytes;
+    }
+    return -1;
+}
+
+/**
+ * @brief Chooses the fastest strategy whose peak memory fits in a limit.
+ * 
+ * In memory comes first, then streamed, then tiled with the largest tile
+ * that fits. Tiles or shards requested by the caller fix the strategy to
+ * tiled; shards without a tile size still get one chosen for them.
+ * 
+ * @param plan Plan of the step.
+ * @param mem_limit Memory limit in bytes, or 0 for no limit.
+ * @param tile_rows Rows per tile fixed by the caller (0 if free); set to the chosen tile size.
+ * @return The chosen strategy, or 0 if none fits.
+ */
+char choose_cff_strategy(const cff_plan* plan, double mem_limit, long* tile_rows) {
+    if (*tile_rows > 0) {
+        double peak = cff_plan_peak(plan, CFF_STRATEGY_TILED, *tile_rows);
+        return (peak >= 0 && (mem_limit <= 0 || peak <= mem_limit)) ? CFF_STRATEGY_TILED : 0;
+    }
+
+    if (plan->num_shards == 0) {
+        if (mem_limit <= 0 || cff_plan_peak(plan, CFF_STRATEGY_MEMORY, 0) <= mem_limit) return CFF_STRATEGY_MEMORY;
+        double peak = cff_plan_peak(plan, CFF_STRATEGY_STREAMED, 0);
+        if (peak >= 0 && peak <= mem_limit) return CFF_STRATEGY_STREAMED;
+    }
+
+    long rows = shard_rows(plan);
+    double fixed = cff_plan_peak(plan, CFF_STRATEGY_TILED, 1) - plan->tile_row_bytes;
+    if (fixed < 0) return 0;
+    if (mem_limit <= 0) {
+        *tile_rows = 0;
+        return CFF_STRATEGY_TILED;
+    }
+    double fit = (mem_limit - fixed) / plan->tile_row_bytes;
+    if (fit < 1) return 0;
+    *tile_rows = (fit >= rows) ? ((rows > 0) ? rows : 1) : (long) fit;
+    return CFF_STRATEGY_TILED;
+}
+
+/**
+ * @brief Prints a plan with its phases and the peak memory of every strategy.
+ * 
+ * @param plan Plan of the step.
+ * @param strategy Chosen strategy, or 0 if none fits.
+ * @param tile_rows Rows per tile of the chosen strategy.
+ * @param mem_limit Memory limit in bytes, or 0 for no limit.
+ */
+void print_cff_plan(const cff_plan* plan, char strategy, long tile_rows, double mem_limit) {
+    char size[32], extra[32];
+
+    if (plan->action == 'f') {
+        printf("Plan of the initial CFF: %ldx%ld matrix.\n", plan->rows, plan->cols);
+    } else {
+        printf("Plan of the embedding of a %ldx%ld CFF: %ldx%ld matrix.\n", plan->old_rows, plan->old_cols, plan->rows, plan->cols);
+    }
+    printf("  %ld old and %ld new polynomials, %ld old pairs, %ld new rows, %s.\n", plan->num_old_polys, plan->num_new_polys,
+           plan->num_old_pairs, plan->num_new_rows, plan->use_table ? "evaluation tables" : "inverted indexes");
+    if (plan->num_shards > 0) printf("  Each of the %d shards generates up to %ld rows.\n", plan->num_shards, shard_rows(plan));
+
+    double total = 0;
+    printf("  %-30s %12s %12s\n", "Phase", "Memory", "Time (s)");
+    for (int i = 0; i < plan->num_phases; i++) {
+        format_bytes(size, sizeof(size), plan->phases[i].bytes);
+        printf("  %-30s %12s %12.2f\n", plan->phases[i].name, size, plan->phases[i].seconds);
+        total += plan->phases[i].seconds;
+    }
+    format_bytes(size, sizeof(size), plan->output_bytes);
+    printf("  Output of %s; about %.2f s on %d thread%s.\n", size, total, plan->threads, (plan->threads == 1) ? "" : "s");
+
+    const char strategies[] = { CFF_STRATEGY_MEMORY, CFF_STRATEGY_STREAMED, CFF_STRATEGY_TILED };
+    printf("  %-30s %12s\n", "Strategy", "Peak memory");
+    for (int i = 0; i < 3; i++) {
+        double peak = cff_plan_peak(plan, strategies[i], 1);
+        if (peak < 0) continue;
+        if (strategies[i] == CFF_STRATEGY_TILED) {
+            format_bytes(size, sizeof(size), peak - plan->tile_row_bytes);
+            format_bytes(extra, sizeof(extra), plan->tile_row_bytes);
+            printf("  %-30s %12s + %s per tile row\n", strategy_name(strategies[i]), size, extra);
+        } else {
+            format_bytes(size, sizeof(size), peak);
+            printf("  %-30s %12s\n", strategy_name(strategies[i]), size);
+        }
+    }
+
+    format_bytes(extra, sizeof(extra), mem_limit);
+    if (strategy == 0) {
+        printf("  No strategy fits in %s.\n", extra);
+        return;
+    }
+    format_bytes(size, sizeof(size), cff_plan_peak(plan, strategy, tile_rows));
+    printf("  Chosen: %s", strategy_name(strategy));
+    if (strategy == CFF_STRATEGY_TILED && tile_rows > 0) printf(" in tiles of %ld rows", tile_rows);
+    printf(", peak %s", size);
+    if (mem_limit > 0) printf(" of the %s limit", extra);
+    printf(".\n");
+}
+
+/**
+ * @brief Plans a 'f' or 'g' step and chooses how to generate it.
+ * 
+ * The input of 'g' is opened only to read its header: a binary header
+ * gives the number of rows, and for a text file it follows from the file
+ * size, since all rows have the same length. The embedding is in place
+ * when embed_cff would map a binary input and output.
+ * 
+ * @param construction Construction type ('p' or 'm').
+ * @param block_size Define the size of CFF rows.
+ * @param cff_file Input file of 'g', or NULL for an initial CFF.
+ * @param d CFF parameter d.
+ * @param Fq Finite field size of the new step.
+ * @param k Maximum polynomial degree of the new step.
+ * @param format Output file format.
+ * @param output Output file path, or NULL for the default name in CFFs/.
+ * @param num_shards Number of shards the rows are split into, or 0.
+ * @param mem_limit Memory limit in bytes, or 0 for no limit.
+ * @param plan_only 1 to print the whole plan (--plan), 0 to print only the chosen strategy.
+ * @param tile_rows Rows per tile given by the user (0 if none); set to the tile size to use.
+ * @param streamed Pointer to a flag set when the input should be streamed through.
+ * @return 1 if the step fits (or there is no limit), 0 on error or if nothing fits.
+ */
+int plan_cff(char construction, char block_size, const char* cff_file, int d, long Fq, long k, char format, const char* output, int num_shards, long mem_limit, int plan_only, long* tile_rows, int* streamed) {
+    long old_rows = 0, old_cols = 0;
+    char input_format = 0;
+    int num_steps = 1;
+    struct cff_parameters* params = NULL;
+
+    if (cff_file != NULL) {
+        if (strcmp(cff_file, "-") == 0) {
+            fprintf(stderr, "Error: --plan and --mem-limit read the input file, not stdin.\n");
+            return 0;
+        }
+        if (format == 'a') {
+            params = read_parameters(cff_file);
+        } else {
+            FILE* file = fopen(cff_file, "rb");
+            if (file == NULL) {
+                printf("Input file '%s' not found.\n", cff_file);
+                return 0;
+            }
+            char magic[sizeof(CFF_BINARY_MAGIC)] = {0};
+            size_t length = fread(magic, 1, sizeof(magic) - 1, file);
+            rewind(file);
+            if (length >= 3 && memcmp(magic, "CFF", 3) == 0 && memcmp(magic, CFF_BINARY_MAGIC, sizeof(magic) - 1) != 0) {
+                fprintf(stderr, "Error: --plan and --mem-limit need a text or binary input.\n");
+                fclose(file);
+                return 0;
+            }
+
+            struct cff_row_reader* reader = open_cff_row_reader(file, &params);
+            if (reader != NULL) {
+                input_format = reader->format;
+                old_rows = reader->rows;
+                old_cols = reader->cols;
+                if (reader->format == 't') {
+                    struct stat st;
+                    long position = ftell(file);
+                    old_rows = (reader->pending > 0 && fstat(fileno(file), &st) == 0) ? 1 + (st.st_size - position) / reader->pending : 0;
+                }
+                close_cff_row_reader(reader);
+            }
+            fclose(file);
+        }
+        if (params == NULL) {
+            printf("Error reading parameters from file %s\n", cff_file);
+            return 0;
+        }
+        num_steps = params->fqs_count + 1;
+    }
+
+    long* Fq_steps = (long*) malloc(num_steps * sizeof(long));
+    long* k_steps = (long*) malloc(num_steps * sizeof(long));
+    if (Fq_steps == NULL || k_steps == NULL) exit(EXIT_FAILURE);
+    for (int i = 0; i < num_steps - 1; i++) {
+        Fq_steps[i] = params->Fqs[i];
+        k_steps[i] = (i < params->ks_count) ? params->ks[i] : k;
+    }
+    Fq_steps[num_steps - 1] = Fq;
+    k_steps[num_steps - 1] = k;
+    if (params) {
+        free(params->Fqs);
+        free(params->ks);
+        free(params);
+    }
+
+    int in_place = (cff_file != NULL && format == 'b' && input_format == 'b' && output == NULL && *tile_rows <= 0 && num_shards == 0);
+    cff_plan plan;
+    int ok = estimate_cff_plan(&plan, construction, block_size, d, Fq_steps, k_steps, num_steps, old_rows, old_cols, input_format, format, in_place, num_shards);
+    free(Fq_steps);
+    free(k_steps);
+    if (!ok) return 0;
+
+    long chosen_rows = *tile_rows;
+    char strategy = choose_cff_strategy(&plan, (double) mem_limit, &chosen_rows);
+    if (plan_only) print_cff_plan(&plan, strategy, chosen_rows, (double) mem_limit);
+
+    char limit[32], needed[32];
+    if (strategy == 0) {
+        format_bytes(limit, sizeof(limit), (double) mem_limit);
+        double tiled = cff_plan_peak(&plan, CFF_STRATEGY_TILED, (*tile_rows > 0) ? *tile_rows : 1);
+        if (tiled < 0) tiled = cff_plan_peak(&plan, CFF_STRATEGY_MEMORY, 0);
+        format_bytes(needed, sizeof(needed), tiled);
+        fprintf(stderr, "Error: The step does not fit in the memory limit of %s (it needs at least %s).\n", limit, needed);
+        return 0;
+    }
+
+    if (!plan_only) {
+        format_bytes(needed, sizeof(needed), cff_plan_peak(&plan, strategy, chosen_rows));
+        if (strategy == CFF_STRATEGY_TILED && chosen_rows > 0) {
+            printf("Strategy: %s in tiles of %ld rows (predicted peak %s).\n", strategy_name(strategy), chosen_rows, needed);
+        } else {
+            printf("Strategy: %s (predicted peak %s).\n", strategy_name(strategy), needed);
+        }
+    }
+    *tile_rows = (strategy == CFF_STRATEGY_TILED) ? chosen_rows : 0;
+    *streamed = (strategy == CFF_STRATEGY_STREAMED);
+    return 1;
+}
+
+/*
+ *  HELPER FUNCTIONS
+ */
+
+/**
+ * @brief Counts the polynomials of the union of the first steps, up to a degree.
+ * 
+ * For nested fields, a polynomial whose coefficients first all lie in the
+ * field of step L belongs to the union exactly when its degree is at most
+ * the largest k of the steps from L on, so the union is counted level by
+ * level without enumerating it.
+ * 
+ * @param sizes Array with the subfield size of every step.
+ * @param k_steps Array with maximum polynomial degrees.
+ * @param count Number of steps in the union.
+ * @param max_degree Largest degree counted.
+ * @return Number of distinct polynomials.
+ */
+static long count_union_polys(const long* sizes, const long* k_steps, int count, long max_degree) {
+    long total = 0, below = 0;
+    for (int level = 0; level < count; level++) {
+        long degree = -1;
+        for (int i = level; i < count; i++) {
+            if (k_steps[i] > degree) degree = k_steps[i];
+        }
+        if (degree > max_degree) degree = max_degree;
+        if (sizes[level] > below && degree >= 0) {
+            total = checked_add(total, checked_pow(sizes[level], degree + 1) - checked_pow(below, degree + 1));
+        }
+        if (sizes[level] > below) below = sizes[level];
+    }
+    return total;
+}
+
+/**
+ * @brief Returns the number of elements of a field of size q with x^q_step = x.
+ * 
+ * The nonzero solutions form the subgroup of order gcd(q_step - 1, q - 1)
+ * of the multiplicative group, so a step whose field is not a subfield of
+ * the last one (9 inside 27) contributes a smaller subfield (3).
+ * 
+ * @param q_step Field size of a step.
+ * @param q Field size of the last step.
+ * @return Size of the subfield partition_by_subfields finds for the step.
+ */
+static long subfield_size(long q_step, long q) {
+    long a = q_step - 1, b = q - 1;
+    while (b != 0) {
+        long r = a % b;
+        a = b;
+        b = r;
+    }
+    return 1 + a;
+}
+
+/**
+ * @brief Returns the capacity a dynamic list reaches for a number of entries.
+ * 
+ * @param count Number of entries.
+ * @return Capacity, as grown by add_pair_to_list and add_element_to_list.
+ */
+static double list_capacity(long count) {
+    if (count <= 0) return 0;
+    double capacity = 8;
+    while (capacity < count) capacity *= 2;
+    return capacity;
+}
+
+/**
+ * @brief Returns the heap memory of a bitmap block.
+ * 
+ * @param rows Number of rows.
+ * @param cols Number of columns.
+ * @return Memory in bytes, with one allocation per row.
+ */
+static double bitmap_bytes(long rows, long cols) {
+    if (rows <= 0) return 0;
+    return (double) rows * (sizeof(uint64_t*) + CFF_PLAN_ALLOC_OVERHEAD + WORDS_FOR_BITS(cols) * sizeof(uint64_t));
+}
+
+/**
+ * @brief Returns the size of a file holding a matrix.
+ * 
+ * @param format File format.
+ * @param rows Number of rows.
+ * @param cols Number of columns.
+ * @return Size in bytes (the bitmap size for formats other than text and binary).
+ */
+static double file_bytes(char format, long rows, long cols) {
+    if (format == 't') return 2.0 * rows * cols;
+    return CFF_BINARY_DATA_OFFSET + (double) rows * WORDS_FOR_BITS(cols) * sizeof(uint64_t);
+}
+
+/**
+ * @brief Returns the number of rows one process generates.
+ * 
+ * @param plan Plan of the step.
+ * @return Rows of the largest shard, or all rows.
+ */
+static long shard_rows(const cff_plan* plan) {
+    if (plan->num_shards <= 0) return plan->rows;
+    return (plan->rows + plan->num_shards - 1) / plan->num_shards;
+}
+
+/**
+ * @brief Appends a phase to a plan.
+ * 
+ * @param plan Plan of the step.
+ * @param name Name of the phase.
+ * @param bytes Memory of the structure the phase builds.
+ * @param seconds Predicted time of the phase.
+ */
+static void add_plan_phase(cff_plan* plan, const char* name, double bytes, double seconds) {
+    if (plan->num_phases == CFF_PLAN_MAX_PHASES) return;
+    plan->phases[plan->num_phases++] = (cff_plan_phase) { name, bytes, seconds };
+}
+
+/**
+ * @brief Formats a size in bytes with a binary unit.
+ * 
+ * @param out Buffer to store the text.
+ * @param size Size of the buffer.
+ * @param bytes Size in bytes.
+ */
+static void format_bytes(char* out, size_t size, double bytes) {
+    static const char* units[] = { "B", "KiB", "MiB", "GiB", "TiB", "PiB", "EiB" };
+    int unit = 0;
+    while (bytes >= 1024 && unit < 6) {
+        bytes /= 1024;
+        unit++;
+    }
+    snprintf(out, size, (unit == 0) ? "%.0f %s" : "%.1f %s", bytes, units[unit]);
+}
+
+/**
+ * @brief Returns the name of a strategy.
+ * 
+ * @param strategy Strategy.
+ * @return Name of the strategy.
+ */
+static const char* strategy_name(char strategy) {
+    switch (strategy) {
+        case CFF_STRATEGY_MEMORY: return "in memory";
+        case CFF_STRATEGY_STREAMED: return "streamed";
+        case CFF_STRATEGY_TILED: return "tiled";
+        default: return "none";
+    }
+}
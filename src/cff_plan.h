@@ -0,0 +1,197 @@
+/**
+ * @file cff_plan.h
+ * @brief Definitions for memory and time estimates of a generation step.
+ * 
+ * A plan predicts, from the parameters of a step and the size of its
+ * input alone, the memory of every structure the builder allocates (field
+ * elements, polynomials, pairs, evaluation tables or inverted indexes, new
+ * blocks and embedded matrix) and the time of each phase, and picks the
+ * generation strategy whose peak memory stays within a limit.
+ */
+
+#ifndef CFF_PLAN_H
+#define CFF_PLAN_H
+
+#include "cff_builder.h"
+
+/*
+ * ESTIMATE CONSTANTS
+ */
+
+/** @brief Polynomial comparisons and copies per second while partitioning polynomials and pairs (single thread). */
+#ifndef CFF_PLAN_POLY_OPS_PER_SECOND
+#define CFF_PLAN_POLY_OPS_PER_SECOND 3e7
+#endif
+
+/** @brief Horner steps per second and thread while building evaluation tables or inverted indexes. */
+#ifndef CFF_PLAN_EVALS_PER_SECOND
+#define CFF_PLAN_EVALS_PER_SECOND 2e7
+#endif
+
+/** @brief Matrix cells per second and thread generated from an evaluation table. */
+#ifndef CFF_PLAN_CELLS_PER_SECOND
+#define CFF_PLAN_CELLS_PER_SECOND 2e9
+#endif
+
+/** @brief Postings per second and thread set from an inverted index. */
+#ifndef CFF_PLAN_POSTINGS_PER_SECOND
+#define CFF_PLAN_POSTINGS_PER_SECOND 3e8
+#endif
+
+/** @brief Bytes per second zeroed or copied into matrices in memory. */
+#ifndef CFF_PLAN_COPY_BYTES_PER_SECOND
+#define CFF_PLAN_COPY_BYTES_PER_SECOND 4e9
+#endif
+
+/** @brief Bytes per second read from or written to files. */
+#ifndef CFF_PLAN_IO_BYTES_PER_SECOND
+#define CFF_PLAN_IO_BYTES_PER_SECOND 1e9
+#endif
+
+/** @brief Bytes of allocator bookkeeping counted for every heap allocation. */
+#ifndef CFF_PLAN_ALLOC_OVERHEAD
+#define CFF_PLAN_ALLOC_OVERHEAD 16
+#endif
+
+/** @brief Maximum number of phases of a plan. */
+#define CFF_PLAN_MAX_PHASES 6
+
+/*
+ * STRATEGIES
+ */
+
+/** @brief The whole matrix is held in memory (or mapped, for binary embeddings in place). */
+#define CFF_STRATEGY_MEMORY 'm'
+
+/** @brief The input rows are combined with the new blocks and written as they are read. */
+#define CFF_STRATEGY_STREAMED 's'
+
+/** @brief The new blocks are generated and written in row tiles (out of core). */
+#define CFF_STRATEGY_TILED 't'
+
+/*
+ * DATA STRUCTURES
+ */
+
+/**
+ * @brief Structure to store the estimate of one phase of a step.
+ */
+typedef struct {
+    const char* name;           /**< Name of the phase. */
+    double bytes;               /**< Memory of the structure the phase builds, in bytes. */
+    double seconds;             /**< Predicted time of the phase. */
+} cff_plan_phase;
+
+/**
+ * @brief Structure to store the memory and time estimates of a step.
+ * 
+ * Sizes are in bytes, as doubles, so estimates of instances too large to
+ * generate are still reported instead of overflowing.
+ */
+typedef struct {
+    char action;                /**< 'f' (initial CFF) or 'g' (embedding). */
+    char format;                /**< Output format. */
+    char input_format;          /**< Format of the input CFF ('b' or 't'), or 0 if none is read. */
+    int in_place;               /**< 1 if the embedding is written in place into a mapped binary file. */
+    int num_shards;             /**< Number of shards the rows are split into, or 0. */
+    int threads;                /**< Number of threads the estimate assumes. */
+    long old_rows;              /**< Number of rows of the input CFF. */
+    long old_cols;              /**< Number of columns of the input CFF. */
+    long rows;                  /**< Number of rows of the generated CFF. */
+    long cols;                  /**< Number of columns of the generated CFF. */
+    long num_old_polys;         /**< Number of old polynomials (columns of new_old). */
+    long num_new_polys;         /**< Number of new polynomials (columns of old_new and new_new). */
+    long num_old_pairs;         /**< Number of old pairs (rows of old_new). */
+    long num_new_rows;          /**< Number of new rows (rows of new_old and new_new). */
+    int use_table;              /**< 1 if evaluation tables are used, 0 for inverted indexes. */
+    double step_bytes;          /**< Field elements, polynomials and pairs of the step. */
+    double index_bytes;         /**< Evaluation tables or inverted indexes of the old and new polynomials. */
+    double blocks_bytes;        /**< The three new blocks. */
+    double pointer_bytes;       /**< Row pointer arrays of the blocks, kept whole when tiled. */
+    double tile_row_bytes;      /**< One row of each new block, the cost of one more row per tile. */
+    double matrix_bytes;        /**< Embedded matrix built on the heap. */
+    double input_bytes;         /**< Input matrix parsed onto the heap (text input). */
+    double stream_bytes;        /**< Buffers of the streaming writer. */
+    double output_bytes;        /**< Size of the output file. */
+    cff_plan_phase phases[CFF_PLAN_MAX_PHASES]; /**< Estimates of the phases, in order. */
+    int num_phases;             /**< Number of phases. */
+} cff_plan;
+
+/*
+ * FUNCTION PROTOTYPES
+ */
+
+/**
+ * @brief Estimates the memory and time of a step without generating it.
+ * 
+ * @param plan Structure to be filled.
+ * @param construction Construction type ('p' or 'm').
+ * @param block_size Define the size of CFF rows.
+ * @param d CFF parameter d.
+ * @param Fq_steps Array with finite field sizes, including the new step.
+ * @param k_steps Array with maximum polynomial degrees, including the new step.
+ * @param num_steps Number of steps (1 for an initial CFF).
+ * @param old_rows Number of rows of the input CFF (0 for an initial CFF).
+ * @param old_cols Number of columns of the input CFF (0 for an initial CFF).
+ * @param input_format Format of the input CFF ('b' or 't'), or 0 if none is read.
+ * @param format Output file format.
+ * @param in_place 1 if a binary embedding is written in place into a mapped file.
+ * @param num_shards Number of shards the rows are split into, or 0.
+ * @return 1 on success, 0 if the last field size is not a prime power.
+ */
+int estimate_cff_plan(cff_plan* plan, char construction, char block_size, int d, const long* Fq_steps, const long* k_steps, int num_steps, long old_rows, long old_cols, char input_format, char format, int in_place, int num_shards);
+
+/**
+ * @brief Returns the predicted peak memory of a strategy.
+ * 
+ * @param plan Plan of the step.
+ * @param strategy CFF_STRATEGY_MEMORY, CFF_STRATEGY_STREAMED or CFF_STRATEGY_TILED.
+ * @param tile_rows Rows per tile for CFF_STRATEGY_TILED, or 0 for one tile per shard.
+ * @return Peak memory in bytes, or -1 if the strategy does not apply to the step.
+ */
+double cff_plan_peak(const cff_plan* plan, char strategy, long tile_rows);
+
+/**
+ * @brief Chooses the fastest strategy whose peak memory fits in a limit.
+ * 
+ * @param plan Plan of the step.
+ * @param mem_limit Memory limit in bytes, or 0 for no limit.
+ * @param tile_rows Rows per tile fixed by the caller (0 if free); set to the chosen tile size.
+ * @return The chosen strategy, or 0 if none fits.
+ */
+char choose_cff_strategy(const cff_plan* plan, double mem_limit, long* tile_rows);
+
+/**
+ * @brief Prints a plan with its phases and the peak memory of every strategy.
+ * 
+ * @param plan Plan of the step.
+ * @param strategy Chosen strategy, or 0 if none fits.
+ * @param tile_rows Rows per tile of the chosen strategy.
+ * @param mem_limit Memory limit in bytes, or 0 for no limit.
+ */
+void print_cff_plan(const cff_plan* plan, char strategy, long tile_rows, double mem_limit);
+
+/**
+ * @brief Plans a 'f' or 'g' step and chooses how to generate it.
+ * 
+ * The input of 'g' must be a text or binary file (any file for archive
+ * output); only its header and size are read.
+ * 
+ * @param construction Construction type ('p' or 'm').
+ * @param block_size Define the size of CFF rows.
+ * @param cff_file Input file of 'g', or NULL for an initial CFF.
+ * @param d CFF parameter d.
+ * @param Fq Finite field size of the new step.
+ * @param k Maximum polynomial degree of the new step.
+ * @param format Output file format.
+ * @param output Output file path, or NULL for the default name in CFFs/.
+ * @param num_shards Number of shards the rows are split into, or 0.
+ * @param mem_limit Memory limit in bytes, or 0 for no limit.
+ * @param plan_only 1 to print the whole plan (--plan), 0 to print only the chosen strategy.
+ * @param tile_rows Rows per tile given by the user (0 if none); set to the tile size to use.
+ * @param streamed Pointer to a flag set when the input should be streamed through.
+ * @return 1 if the step fits (or there is no limit), 0 on error or if nothing fits.
+ */
+int plan_cff(char construction, char block_size, const char* cff_file, int d, long Fq, long k, char format, const char* output, int num_shards, long mem_limit, int plan_only, long* tile_rows, int* streamed);
+
+#endif /* CFF_PLAN_H */
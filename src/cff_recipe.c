@@ -0,0 +1,326 @@
+/**
+ * @file cff_recipe.c
+ * @brief Implementation of CFF recipes and random-access regeneration.
+ * 
+ * This file contains the functions responsible for reading and writing
+ * recipe files and for answering bit, row and column queries on the CFF
+ * they describe by evaluating the polynomials of each step.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "flint/fq_nmod.h"
+#include "flint/fq_nmod_poly.h"
+#include "cff_recipe.h"
+
+/*
+ *  HELPER FUNCTION PROTOTYPES
+ */
+
+/**
+ * @brief Returns one bit of the matrix of an oracle level.
+ * 
+ * @param oracle Oracle of the CFF.
+ * @param level Level index.
+ * @param row Row index.
+ * @param col Column index.
+ * @return 1 if the bit is set, 0 otherwise.
+ */
+static int level_get_bit(const cff_oracle* oracle, int level, long row, long col);
+
+/**
+ * @brief Checks whether a polynomial evaluates to y at x for a pair (x, y).
+ * 
+ * @param poly Polynomial (column).
+ * @param pair Element pair (row).
+ * @param ctx Finite field context.
+ * @return 1 if P(x) = y, 0 otherwise.
+ */
+static int pair_matches(const fq_nmod_poly_t poly, const element_pair* pair, const fq_nmod_ctx_t ctx);
+
+/*
+ *  RECIPE FILE FUNCTIONS
+ */
+
+/**
+ * @brief Writes a recipe file.
+ * 
+ * @param filename Output file path.
+ * @param recipe Recipe to be written.
+ * @return 1 on success, 0 on error.
+ */
+int write_cff_recipe(const char* filename, const cff_recipe* recipe) {
+    FILE* file = fopen(filename, "w");
+    if (file == NULL) {
+        printf("Error opening file '%s' for writing.\n", filename);
+        return 0;
+    }
+
+    int ok = (fprintf(file, "%s %d", CFF_RECIPE_MAGIC, recipe->d) >= 0);
+    for (int i = 0; i < recipe->num_steps && ok; i++) {
+        const cff_recipe_step* step = &recipe->steps[i];
+        ok = (fprintf(file, " %c%c:%ld:%ld", step->construction, step->block_size ? step->block_size : '-', step->q, step->k) >= 0);
+    }
+    if (ok) ok = (fprintf(file, "\n") >= 0);
+
+    if (fclose(file) != 0) ok = 0;
+    if (!ok) printf("Error writing file '%s'.\n", filename);
+    return ok;
+}
+
+/**
+ * @brief Reads a recipe file.
+ * 
+ * @param filename Path to the file to be read.
+ * @param recipe Pointer to store the recipe.
+ * @return 1 on success, 0 if the file is missing or not a recipe.
+ */
+int read_cff_recipe(const char* filename, cff_recipe* recipe) {
+    FILE* file = fopen(filename, "r");
+    if (file == NULL) {
+        printf("Input file '%s' not found.\n", filename);
+        return 0;
+    }
+
+    int ok = read_cff_recipe_stream(file, recipe);
+    fclose(file);
+    return ok;
+}
+
+/**
+ * @brief Reads a recipe from an open file positioned at its start.
+ * 
+ * @param file Open file.
+ * @param recipe Pointer to store the recipe.
+ * @return 1 on success, 0 if the file is not a recipe.
+ */
+int read_cff_recipe_stream(FILE* file, cff_recipe* recipe) {
+    char magic[sizeof(CFF_RECIPE_MAGIC)];
+    if (fread(magic, 1, sizeof(magic) - 1, file) != sizeof(magic) - 1) return 0;
+    if (memcmp(magic, CFF_RECIPE_MAGIC, sizeof(magic) - 1) != 0) return 0;
+
+    memset(recipe, 0, sizeof(*recipe));
+    if (fscanf(file, "%d", &recipe->d) != 1) {
+        printf("Error: Invalid recipe, missing d.\n");
+        return 0;
+    }
+
+    cff_recipe_step step;
+    while (fscanf(file, " %c%c:%ld:%ld", &step.construction, &step.block_size, &step.q, &step.k) == 4) {
+        if (recipe->num_steps == CFF_RECIPE_MAX_STEPS) {
+            printf("Error: Recipes store at most %d steps.\n", CFF_RECIPE_MAX_STEPS);
+            return 0;
+        }
+        recipe->steps[recipe->num_steps++] = step;
+    }
+
+    if (recipe->num_steps == 0) {
+        printf("Error: Invalid recipe, no steps.\n");
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ *  ORACLE FUNCTIONS
+ */
+
+/**
+ * @brief Builds an oracle for the CFF described by a recipe.
+ * 
+ * Prepares the field, polynomials and pairs of every step, exactly as
+ * generate_new_cff_blocks does when the CFF is generated, so the answers
+ * match the generated matrix bit for bit. Memory is proportional to the
+ * number of rows and columns, not to their product.
+ * 
+ * @param recipe Recipe of the CFF.
+ * @return Oracle (freed with free_cff_oracle), or NULL on error.
+ */
+cff_oracle* create_cff_oracle(const cff_recipe* recipe) {
+    int num_steps = recipe->num_steps;
+    long Fq_steps[CFF_RECIPE_MAX_STEPS], k_steps[CFF_RECIPE_MAX_STEPS];
+    for (int i = 0; i < num_steps; i++) {
+        Fq_steps[i] = recipe->steps[i].q;
+        k_steps[i] = recipe->steps[i].k;
+    }
+
+    cff_oracle* oracle = (cff_oracle*) calloc(1, sizeof(cff_oracle));
+    if (oracle == NULL) exit(EXIT_FAILURE);
+    oracle->levels = (cff_oracle_level*) calloc(num_steps, sizeof(cff_oracle_level));
+    if (oracle->levels == NULL) exit(EXIT_FAILURE);
+
+    for (int s = 0; s < num_steps; s++) {
+        cff_oracle_level* level = &oracle->levels[s];
+        const cff_recipe_step* step = &recipe->steps[s];
+
+        if (!prepare_cff_step(&level->step, step->construction, step->block_size, recipe->d, Fq_steps, k_steps, s + 1)) {
+            free_cff_oracle(oracle);
+            return NULL;
+        }
+        oracle->num_levels = s + 1;
+
+        long num_old_polys = level->step.poly_part.num_old_polys;
+        long num_new_polys = level->step.poly_part.num_new_polys;
+
+        if (s == 0) {
+            level->rows = level->step.num_new_rows;
+            level->cols = num_new_polys;
+        } else {
+            level->old_rows = oracle->levels[s - 1].rows;
+            level->old_cols = oracle->levels[s - 1].cols;
+            level->rows = level->old_rows + level->step.num_new_rows;
+            long width_top = level->old_cols + num_new_polys;
+            long width_bottom = num_old_polys + num_new_polys;
+            level->cols = (width_top > width_bottom) ? width_top : width_bottom;
+        }
+    }
+
+    oracle->rows = oracle->levels[num_steps - 1].rows;
+    oracle->cols = oracle->levels[num_steps - 1].cols;
+    return oracle;
+}
+
+/**
+ * @brief Returns one bit of the CFF.
+ * 
+ * @param oracle Oracle of the CFF.
+ * @param row Row index.
+ * @param col Column index.
+ * @return 1 if the bit is set, 0 otherwise (also outside the matrix).
+ */
+int cff_get_bit(const cff_oracle* oracle, long row, long col) {
+    if (row < 0 || col < 0 || row >= oracle->rows || col >= oracle->cols) return 0;
+    return level_get_bit(oracle, oracle->num_levels - 1, row, col);
+}
+
+/**
+ * @brief Returns one row of the CFF in bitmap format.
+ * 
+ * @param oracle Oracle of the CFF.
+ * @param row Row index.
+ * @param out Buffer of WORDS_FOR_BITS(oracle->cols) words to store the row.
+ */
+void cff_get_row(const cff_oracle* oracle, long row, uint64_t* out) {
+    memset(out, 0, WORDS_FOR_BITS(oracle->cols) * sizeof(uint64_t));
+    for (long j = 0; j < oracle->cols; j++) {
+        if (cff_get_bit(oracle, row, j)) SET_BIT(out, j);
+    }
+}
+
+/**
+ * @brief Returns the rows where one column of the CFF is set.
+ * 
+ * @param oracle Oracle of the CFF.
+ * @param col Column index.
+ * @param rows_out Buffer of oracle->rows entries to store the row indices, ascending.
+ * @return Number of rows stored.
+ */
+long cff_get_column(const cff_oracle* oracle, long col, long* rows_out) {
+    long count = 0;
+    for (long i = 0; i < oracle->rows; i++) {
+        if (cff_get_bit(oracle, i, col)) rows_out[count++] = i;
+    }
+    return count;
+}
+
+/**
+ * @brief Builds the whole CFF matrix described by an oracle.
+ * 
+ * Rows are independent queries, so they are built in parallel.
+ * 
+ * @param oracle Oracle of the CFF.
+ * @return CFF matrix in bitmap format.
+ */
+uint64_t** materialize_cff(const cff_oracle* oracle) {
+    if (oracle->rows == 0) return NULL;
+
+    long words_per_row = WORDS_FOR_BITS(oracle->cols);
+    uint64_t** matrix = (uint64_t**) malloc(oracle->rows * sizeof(uint64_t*));
+    if (matrix == NULL) exit(EXIT_FAILURE);
+
+    #pragma omp parallel for schedule(dynamic)
+    for (long i = 0; i < oracle->rows; i++) {
+        matrix[i] = (uint64_t*) malloc(words_per_row * sizeof(uint64_t));
+        if (matrix[i] == NULL) exit(EXIT_FAILURE);
+        cff_get_row(oracle, i, matrix[i]);
+    }
+    return matrix;
+}
+
+/**
+ * @brief Frees an oracle.
+ * 
+ * @param oracle Oracle to be freed.
+ */
+void free_cff_oracle(cff_oracle* oracle) {
+    if (!oracle) return;
+    for (int s = 0; s < oracle->num_levels; s++) free_cff_step(&oracle->levels[s].step);
+    free(oracle->levels);
+    free(oracle);
+}
+
+/*
+ *  HELPER FUNCTIONS
+ */
+
+/**
+ * @brief Returns one bit of the matrix of an oracle level.
+ * 
+ * Mirrors embed_cff_matrix: the previous level sits in the top-left corner,
+ * old_new to its right (old pairs, new polynomials), and new_old followed
+ * by new_new below it (new pairs, old then new polynomials). The first
+ * level is its new_new block alone.
+ * 
+ * @param oracle Oracle of the CFF.
+ * @param level Level index.
+ * @param row Row index.
+ * @param col Column index.
+ * @return 1 if the bit is set, 0 otherwise.
+ */
+static int level_get_bit(const cff_oracle* oracle, int level, long row, long col) {
+    const cff_oracle_level* lv = &oracle->levels[level];
+    const cff_step* step = &lv->step;
+    long num_old_polys = step->poly_part.num_old_polys;
+    long num_new_polys = step->poly_part.num_new_polys;
+
+    if (level == 0) {
+        return pair_matches(step->poly_part.new_polys[col], &step->combos.combos_new[row], step->ctx);
+    }
+
+    if (row < lv->old_rows && col < lv->old_cols && level_get_bit(oracle, level - 1, row, col)) {
+        return 1;
+    }
+    if (row < step->combos.count_old && col >= lv->old_cols && col < lv->old_cols + num_new_polys &&
+        pair_matches(step->poly_part.new_polys[col - lv->old_cols], &step->combos.combos_old[row], step->ctx)) {
+        return 1;
+    }
+    if (row >= lv->old_rows && row < lv->old_rows + step->num_new_rows) {
+        const element_pair* pair = &step->combos.combos_new[row - lv->old_rows];
+        if (col < num_old_polys) {
+            return pair_matches(step->poly_part.old_polys[col], pair, step->ctx);
+        }
+        if (col < num_old_polys + num_new_polys) {
+            return pair_matches(step->poly_part.new_polys[col - num_old_polys], pair, step->ctx);
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Checks whether a polynomial evaluates to y at x for a pair (x, y).
+ * 
+ * @param poly Polynomial (column).
+ * @param pair Element pair (row).
+ * @param ctx Finite field context.
+ * @return 1 if P(x) = y, 0 otherwise.
+ */
+static int pair_matches(const fq_nmod_poly_t poly, const element_pair* pair, const fq_nmod_ctx_t ctx) {
+    fq_nmod_t value;
+    fq_nmod_init(value, ctx);
+    fq_nmod_poly_evaluate_fq_nmod(value, poly, pair->x, ctx);
+    int match = fq_nmod_equal(value, pair->y, ctx);
+    fq_nmod_clear(value, ctx);
+    return match;
+}
@@ -0,0 +1,161 @@
+/**
+ * @file cff_recipe.h
+ * @brief Definitions for parametric CFF recipes and random-access regeneration.
+ * 
+ * A CFF produced by this tool is fully determined by d and the construction,
+ * block size, field size and degree of each step. A recipe stores only these
+ * parameters, and an oracle built from it answers bit, row and column queries
+ * by field evaluation without materialising the matrix.
+ */
+
+#ifndef CFF_RECIPE_H
+#define CFF_RECIPE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "cff_builder.h"
+
+/*
+ * RECIPE FORMAT CONSTANTS
+ */
+
+/** @brief Magic word at the start of a recipe file. */
+#define CFF_RECIPE_MAGIC "CFFRECIPE1"
+
+/** @brief Maximum number of steps in a recipe. */
+#define CFF_RECIPE_MAX_STEPS 32
+
+/*
+ * DATA STRUCTURES
+ */
+
+/**
+ * @brief Structure to store the parameters of one step of a recipe.
+ */
+typedef struct {
+    char construction;          /**< Construction type of the step ('p' or 'm'). */
+    char block_size;            /**< Block size of the step ('m', 'f', or '-' if unused). */
+    long q;                     /**< Finite field size. */
+    long k;                     /**< Maximum polynomial degree. */
+} cff_recipe_step;
+
+/**
+ * @brief Structure to store a CFF recipe.
+ * 
+ * Stored on disk as a single line:
+ * "CFFRECIPE1 <d> <construction><block_size>:<q>:<k> ...".
+ */
+typedef struct {
+    int d;                                          /**< CFF parameter d. */
+    int num_steps;                                  /**< Number of steps. */
+    cff_recipe_step steps[CFF_RECIPE_MAX_STEPS];    /**< Parameters of every step. */
+} cff_recipe;
+
+/**
+ * @brief Structure to store one level (embedding step) of an oracle.
+ * 
+ * The matrix of a level is the matrix of the previous level in its top-left
+ * corner plus the old_new, new_old and new_new blocks of the step.
+ */
+typedef struct {
+    cff_step step;              /**< Field, polynomials and pairs of the step. */
+    long old_rows;              /**< Number of rows of the previous level. */
+    long old_cols;              /**< Number of columns of the previous level. */
+    long rows;                  /**< Number of rows of this level. */
+    long cols;                  /**< Number of columns of this level. */
+} cff_oracle_level;
+
+/**
+ * @brief Structure to answer queries on the CFF described by a recipe.
+ */
+typedef struct {
+    cff_oracle_level* levels;   /**< One level per recipe step. */
+    int num_levels;             /**< Number of levels. */
+    long rows;                  /**< Number of rows of the CFF. */
+    long cols;                  /**< Number of columns of the CFF. */
+} cff_oracle;
+
+/*
+ * FUNCTION PROTOTYPES
+ */
+
+/**
+ * @brief Writes a recipe file.
+ * 
+ * @param filename Output file path.
+ * @param recipe Recipe to be written.
+ * @return 1 on success, 0 on error.
+ */
+int write_cff_recipe(const char* filename, const cff_recipe* recipe);
+
+/**
+ * @brief Reads a recipe file.
+ * 
+ * @param filename Path to the file to be read.
+ * @param recipe Pointer to store the recipe.
+ * @return 1 on success, 0 if the file is missing or not a recipe.
+ */
+int read_cff_recipe(const char* filename, cff_recipe* recipe);
+
+/**
+ * @brief Reads a recipe from an open file positioned at its start.
+ * 
+ * @param file Open file.
+ * @param recipe Pointer to store the recipe.
+ * @return 1 on success, 0 if the file is not a recipe.
+ */
+int read_cff_recipe_stream(FILE* file, cff_recipe* recipe);
+
+/**
+ * @brief Builds an oracle for the CFF described by a recipe.
+ * 
+ * @param recipe Recipe of the CFF.
+ * @return Oracle (freed with free_cff_oracle), or NULL on error.
+ */
+cff_oracle* create_cff_oracle(const cff_recipe* recipe);
+
+/**
+ * @brief Returns one bit of the CFF.
+ * 
+ * @param oracle Oracle of the CFF.
+ * @param row Row index.
+ * @param col Column index.
+ * @return 1 if the bit is set, 0 otherwise (also outside the matrix).
+ */
+int cff_get_bit(const cff_oracle* oracle, long row, long col);
+
+/**
+ * @brief Returns one row of the CFF in bitmap format.
+ * 
+ * @param oracle Oracle of the CFF.
+ * @param row Row index.
+ * @param out Buffer of WORDS_FOR_BITS(oracle->cols) words to store the row.
+ */
+void cff_get_row(const cff_oracle* oracle, long row, uint64_t* out);
+
+/**
+ * @brief Returns the rows where one column of the CFF is set.
+ * 
+ * @param oracle Oracle of the CFF.
+ * @param col Column index.
+ * @param rows_out Buffer of oracle->rows entries to store the row indices, ascending.
+ * @return Number of rows stored.
+ */
+long cff_get_column(const cff_oracle* oracle, long col, long* rows_out);
+
+/**
+ * @brief Builds the whole CFF matrix described by an oracle.
+ * 
+ * @param oracle Oracle of the CFF.
+ * @return CFF matrix in bitmap format.
+ */
+uint64_t** materialize_cff(const cff_oracle* oracle);
+
+/**
+ * @brief Frees an oracle.
+ * 
+ * @param oracle Oracle to be freed.
+ */
+void free_cff_oracle(cff_oracle* oracle);
+
+#endif /* CFF_RECIPE_H */
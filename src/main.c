@@ -7,8 +7,159 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "cff_builder.h"
+#include "cff_plan.h"
 #include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @brief Parses a list of step values such as "[2,4,16]" or "2,4,16".
+ * 
+ * @param arg Command line argument.
+ * @param count Pointer to store the number of values.
+ * @return Dynamically allocated array, or NULL if the list is empty or invalid.
+ */
+static long* parse_step_list(const char* arg, int* count) {
+    *count = 0;
+    long* list = (long*) malloc((strlen(arg) / 2 + 1) * sizeof(long));
+    if (list == NULL) return NULL;
+
+    const char* cursor = arg;
+    while (*cursor != '\0') {
+        if (*cursor == '[' || *cursor == ']' || *cursor == ',' || *cursor == ' ') {
+            cursor++;
+            continue;
+        }
+        char* end;
+        long value = strtol(cursor, &end, 10);
+        if (end == cursor || value <= 0) {
+            free(list);
+            *count = 0;
+            return NULL;
+        }
+        list[(*count)++] = value;
+        cursor = end;
+    }
+
+    if (*count == 0) {
+        free(list);
+        return NULL;
+    }
+    return list;
+}
+
+/**
+ * @brief Parses a memory size such as "512M", "16G" or "1048576".
+ * 
+ * Suffixes K, M, G and T (optionally followed by "B" or "iB") are powers of 1024.
+ * 
+ * @param arg Command line argument.
+ * @return Size in bytes, or -1 if the size is invalid.
+ */
+static long parse_memory_size(const char* arg) {
+    char* end;
+    double value = strtod(arg, &end);
+    if (end == arg || value <= 0) return -1;
+
+    const char* units = "KMGT";
+    const char* unit = (*end != '\0') ? strchr(units, *end) : NULL;
+    if (unit != NULL) {
+        for (long i = 0; i <= unit - units; i++) value *= 1024;
+        end++;
+    }
+    if (*end != '\0' && strcmp(end, "B") != 0 && strcmp(end, "iB") != 0) return -1;
+    if (value >= 9.2e18) return -1;
+    return (long) value;
+}
+
+/**
+ * @brief Removes the "--option" arguments from argv and applies them.
+ * 
+ * Options may appear anywhere on the command line; the remaining
+ * positional arguments are compacted to the front of argv.
+ * 
+ * @param argc Pointer to the number of arguments, updated on return.
+ * @param argv Array of arguments.
+ * @param format Pointer to store the output format ('b' binary, 't' text, 'c' CSC, 'e' Elias-Fano, 'm' Matrix Market, 's' CSR, 'r' recipe, 'a' archive).
+ * @param output Pointer to store the output path given with --output, or NULL if absent.
+ * @param labels Pointer to a flag set by --labels.
+ * @param tile_rows Pointer to store the rows per tile given with --tile-rows, or 0 if absent.
+ * @param shard Pointer to store the shard index given with --shard.
+ * @param num_shards Pointer to store the number of shards given with --shard, or 0 if absent.
+ * @param plan_only Pointer to a flag set by --plan.
+ * @param mem_limit Pointer to store the memory limit in bytes given with --mem-limit, or 0 if absent.
+ * @param bind Pointer to store the thread placement given with --bind ('c' close, 's' spread), or 0 if absent.
+ * @param huge_pages Pointer to store the huge page mode given with --huge-pages ('t' transparent, 'h' hugetlb), or 0 if absent.
+ * @return 1 on success, 0 on an unknown or invalid option.
+ */
+static int parse_options(int* argc, char* argv[], char* format, const char** output, int* labels, long* tile_rows, int* shard, int* num_shards, int* plan_only, long* mem_limit, char* bind, char* huge_pages) {
+    int kept = 1;
+    for (int i = 1; i < *argc; i++) {
+        if (strncmp(argv[i], "--", 2) != 0) {
+            argv[kept++] = argv[i];
+        } else if (strcmp(argv[i], "--format=binary") == 0) {
+            *format = 'b';
+        } else if (strcmp(argv[i], "--format=text") == 0) {
+            *format = 't';
+        } else if (strcmp(argv[i], "--format=csc") == 0) {
+            *format = 'c';
+        } else if (strcmp(argv[i], "--format=ef") == 0) {
+            *format = 'e';
+        } else if (strcmp(argv[i], "--format=mtx") == 0) {
+            *format = 'm';
+        } else if (strcmp(argv[i], "--format=csr") == 0) {
+            *format = 's';
+        } else if (strcmp(argv[i], "--format=recipe") == 0) {
+            *format = 'r';
+        } else if (strcmp(argv[i], "--format=archive") == 0) {
+            *format = 'a';
+        } else if (strncmp(argv[i], "--output=", 9) == 0 && argv[i][9] != '\0') {
+            *output = argv[i] + 9;
+            if (strlen(*output) >= CFF_PATH_MAX) {
+                fprintf(stderr, "Error: Output path is longer than %d characters.\n", CFF_PATH_MAX - 1);
+                return 0;
+            }
+        } else if (strcmp(argv[i], "--labels") == 0) {
+            *labels = 1;
+        } else if (strncmp(argv[i], "--tile-rows=", 12) == 0) {
+            char* end;
+            *tile_rows = strtol(argv[i] + 12, &end, 10);
+            if (end == argv[i] + 12 || *end != '\0' || *tile_rows <= 0) {
+                fprintf(stderr, "Error: Invalid tile size '%s'.\n", argv[i] + 12);
+                return 0;
+            }
+        } else if (strncmp(argv[i], "--shard=", 8) == 0 || (strcmp(argv[i], "--shard") == 0 && i + 1 < *argc)) {
+            const char* value = (argv[i][7] == '=') ? argv[i] + 8 : argv[++i];
+            char extra;
+            if (sscanf(value, "%d/%d%c", shard, num_shards, &extra) != 2 || *num_shards < 1 || *shard < 0 || *shard >= *num_shards) {
+                fprintf(stderr, "Error: Invalid shard '%s', expected I/N with 0 <= I < N.\n", value);
+                return 0;
+            }
+        } else if (strcmp(argv[i], "--plan") == 0) {
+            *plan_only = 1;
+        } else if (strncmp(argv[i], "--mem-limit=", 12) == 0) {
+            *mem_limit = parse_memory_size(argv[i] + 12);
+            if (*mem_limit <= 0) {
+                fprintf(stderr, "Error: Invalid memory limit '%s'.\n", argv[i] + 12);
+                return 0;
+            }
+        } else if (strcmp(argv[i], "--bind=close") == 0) {
+            *bind = 'c';
+        } else if (strcmp(argv[i], "--bind=spread") == 0) {
+            *bind = 's';
+        } else if (strcmp(argv[i], "--huge-pages=thp") == 0) {
+            *huge_pages = 't';
+        } else if (strcmp(argv[i], "--huge-pages=hugetlb") == 0) {
+            *huge_pages = 'h';
+        } else {
+            fprintf(stderr, "Error: Unknown option '%s'.\n", argv[i]);
+            return 0;
+        }
+    }
+    *argc = kept;
+    return 1;
+}
 
 /**
  * @brief Main function of the program.
@@ -19,16 +170,157 @@
  *   - Polynomial first: ./generate_cff p f <m|f> <d> <q> <k>
  *   - Embedding CFFs:   ./generate_cff p g <m|f> <cff_file> <d> <q> <k>
  *   - Monotone CFFs:    ./generate_cff m g <cff_file> <d> <q> <k>
+ *   - Embedding chain:  ./generate_cff p c <m|f> <d> <[q0,q1,...]> <[k0,k1,...]>
+ *   - Monotone chain:   ./generate_cff m c <d> <[q0,q1,...]> <[k0,k1,...]>
+ *   - Archive extract:  ./generate_cff x <archive_file> <step>
+ *   - Merge shards:     ./generate_cff j <output_file> <shard_file> ...
+ *   - Recipe query:     ./generate_cff q <recipe_file> <bit <row> <col> | row <row> | col <col>>
+ * 
+ * Options:
+ *   - --format=text     Write the 0/1 text .txt format (default).
+ *   - --format=binary   Write packed binary .cff files.
+ *   - --format=csc      Write compressed sparse column .csc files.
+ *   - --format=ef       Write Elias-Fano compressed column .cef files.
+ *   - --format=mtx      Write Matrix Market coordinate .mtx files (export only).
+ *   - --format=csr      Write binary compressed sparse row .csr files (export only).
+ *   - --format=recipe   Write only the parameters (.rcp), without generating the matrix.
+ *   - --format=archive  Write a chain archive (.cfa); 'g' appends the new step to its input archive.
+ *   - --output=PATH     Write to PATH instead of CFFs/; "-" writes to stdout (not for chains).
+ *   - --labels          Also write the row/column labels of the step to a .lbl side file.
+ *   - --tile-rows=N     Generate and write N rows at a time (binary or text, not for chains or 'x').
+ *   - --shard=I/N       Generate only shard I of N of the rows, to <file>.shardIofN (binary or text, not for chains or 'x').
+ *   - --plan            Print the predicted memory and time of 'f' or 'g' without generating anything.
+ *   - --mem-limit=SIZE  Choose the in-memory, streamed or tiled path of 'f' or 'g' to stay within SIZE (e.g. 16G).
+ *   - --bind=close      Run with OMP_PROC_BIND=close and one OMP_PLACES place per CPU, ordered by NUMA node.
+ *   - --bind=spread     Same with OMP_PROC_BIND=spread: threads spaced evenly over all places, and so over all nodes.
+ *   - --huge-pages=thp  Back large matrix, table and index buffers with prefaulted transparent huge pages (Linux).
+ *   - --huge-pages=hugetlb  Use explicit hugetlb pages for them, falling back to transparent and then normal pages (Linux).
+ * 
+ * Input files of 'g' may be in any format not marked export only. A <cff_file> of "-"
+ * reads a text or binary CFF from stdin. When writing to stdout, progress
+ * messages go to stderr.
  * 
  * @param argc Number of arguments.
  * @param argv Array of arguments.
  * @return 0 on success, 1 on error.
  */
 int main(int argc, char *argv[]) {
+    char format = 't';
+    const char* output = NULL;
+    int labels = 0;
+    long tile_rows = 0;
+    int shard = 0, num_shards = 0;
+    int plan_only = 0;
+    long mem_limit = 0;
+    char bind = 0;
+    char huge_pages = 0;
+    // parse_options drops the options from argv; --bind runs the program again with all of them
+    char** all_args = (char**) malloc((argc + 1) * sizeof(char*));
+    if (all_args == NULL) return 1;
+    memcpy(all_args, argv, (argc + 1) * sizeof(char*));
+    if (!parse_options(&argc, argv, &format, &output, &labels, &tile_rows, &shard, &num_shards, &plan_only, &mem_limit, &bind, &huge_pages)) {
+        free(all_args);
+        return 1;
+    }
+    set_cff_huge_pages(huge_pages);
+    if (bind) {
+        // The OpenMP runtime reads OMP_PROC_BIND and OMP_PLACES when it starts, so they are set
+        // and the program replaced by a fresh copy of itself, which finds them already set.
+        const char* current = getenv("OMP_PROC_BIND");
+        if (current == NULL || strcmp(current, (bind == 's') ? "spread" : "close") != 0) {
+            if (!bind_cff_threads(bind)) {
+                fprintf(stderr, "Error: --bind cannot set OMP_PROC_BIND and OMP_PLACES.\n");
+                return 1;
+            }
+#if defined(__linux__)
+            execv("/proc/self/exe", all_args);
+#endif
+            execvp(all_args[0], all_args);
+            fprintf(stderr, "Error: --bind cannot restart '%s' with the new thread placement.\n", all_args[0]);
+            return 1;
+        }
+    }
+    free(all_args);
+    int planned = (plan_only || mem_limit > 0);
+    if (planned && format == 'r') {
+        fprintf(stderr, "Error: Recipes are not generated; --plan and --mem-limit do not apply.\n");
+        return 1;
+    }
+    if (tile_rows > 0 && format != 'b' && format != 't') {
+        fprintf(stderr, "Error: --tile-rows writes binary or text matrices only.\n");
+        return 1;
+    }
+    if (num_shards > 0 && ((format != 'b' && format != 't') || (output != NULL && strcmp(output, "-") == 0))) {
+        fprintf(stderr, "Error: --shard writes binary or text shard files (not stdout).\n");
+        return 1;
+    }
+    if (labels && (format == 'r' || format == 'a' || (output != NULL && strcmp(output, "-") == 0))) {
+        fprintf(stderr, "Error: --labels needs a matrix written to a file (not a recipe, archive or stdout).\n");
+        return 1;
+    }
+
+    char stdout_path[32];
+    if (output != NULL && strcmp(output, "-") == 0) {
+        if (format == 'a') {
+            fprintf(stderr, "Error: Archives cannot be written to stdout.\n");
+            return 1;
+        }
+        int data_fd = dup(STDOUT_FILENO);
+        if (data_fd < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+            fprintf(stderr, "Error: Failed to redirect stdout.\n");
+            return 1;
+        }
+        snprintf(stdout_path, sizeof(stdout_path), "/dev/fd/%d", data_fd);
+        output = stdout_path;
+    }
+
     if (argc < 3) {
         fprintf(stderr, "Error: Insufficient arguments.\n");
         return 1;
     }
+
+    if (planned && (argv[1][0] == 'x' || argv[1][0] == 'j' || argv[1][0] == 'q' || (argc > 2 && argv[2][0] == 'c'))) {
+        fprintf(stderr, "Error: --plan and --mem-limit apply to a single 'f' or 'g' step.\n");
+        return 1;
+    }
+
+    if (argv[1][0] == 'x') {
+        if (argc != 4) {
+            fprintf(stderr, "Error (x): Incorrect number of arguments.\n");
+            fprintf(stderr, "Usage: ./generate_cff x <archive_file> <step>\n");
+            return 1;
+        }
+        if (tile_rows > 0 || num_shards > 0) {
+            fprintf(stderr, "Error: Steps are extracted whole; --tile-rows and --shard are not supported.\n");
+            return 1;
+        }
+        if (format == 'a') {
+            fprintf(stderr, "Error: Steps cannot be extracted in archive format.\n");
+            return 1;
+        }
+        if (output == NULL) mkdir("CFFs", 0777);
+        return extract_cff(argv[2], atoi(argv[3]), format, output, labels) ? 0 : 1;
+    }
+
+    if (argv[1][0] == 'j') {
+        if (argc < 4) {
+            fprintf(stderr, "Error (j): Incorrect number of arguments.\n");
+            fprintf(stderr, "Usage: ./generate_cff j <output_file> <shard_file> ...\n");
+            return 1;
+        }
+        return merge_cff(argv[2], argv + 3, argc - 3) ? 0 : 1;
+    }
+
+    if (argv[1][0] == 'q') {
+        int bit_query = (argc == 6 && strcmp(argv[3], "bit") == 0);
+        int line_query = (argc == 5 && (strcmp(argv[3], "row") == 0 || strcmp(argv[3], "col") == 0));
+        if (!bit_query && !line_query) {
+            fprintf(stderr, "Error (q): Incorrect arguments.\n");
+            fprintf(stderr, "Usage: ./generate_cff q <recipe_file> bit <row> <col> | row <row> | col <col>\n");
+            return 1;
+        }
+        return query_cff(argv[2], argv[3][0], atol(argv[4]), bit_query ? atol(argv[5]) : 0) ? 0 : 1;
+    }
     
     char construction = argv[1][0];
     char action = argv[2][0];
@@ -42,7 +334,7 @@ int main(int argc, char *argv[]) {
         block_size = argv[3][0];
     }
 
-    mkdir("CFFs", 0777);
+    if (output == NULL) mkdir("CFFs", 0777);
 
     if (action == 'g') {
         if (construction == 'p') {
@@ -80,7 +372,18 @@ int main(int argc, char *argv[]) {
             k = atol(argv[6]);
         }
 
-        embed_cff(construction, block_size, cff_file, d, Fq, k);
+        if (strcmp(cff_file, "-") == 0 && (format == 'r' || format == 'a')) {
+            fprintf(stderr, "Error: Recipes and archives cannot be built from stdin.\n");
+            return 1;
+        }
+
+        int streamed = 0;
+        if (planned) {
+            if (!plan_cff(construction, block_size, cff_file, d, Fq, k, format, output, num_shards, mem_limit, plan_only, &tile_rows, &streamed)) return 1;
+            if (plan_only) return 0;
+        }
+
+        embed_cff(construction, block_size, cff_file, d, Fq, k, format, output, labels, tile_rows, shard, num_shards, streamed);
 
     } else if (action == 'f') {
         if (construction != 'p') {
@@ -104,10 +407,77 @@ int main(int argc, char *argv[]) {
         long Fq = atol(argv[5]);
         long k = atol(argv[6]);
 
-        generate_cff(construction, block_size, d, Fq, k);
+        if (planned) {
+            int streamed = 0;
+            if (!plan_cff(construction, block_size, NULL, d, Fq, k, format, output, num_shards, mem_limit, plan_only, &tile_rows, &streamed)) return 1;
+            if (plan_only) return 0;
+        }
+
+        generate_cff(construction, block_size, d, Fq, k, format, output, labels, tile_rows, shard, num_shards);
+
+    } else if (action == 'c') {
+        const char *fqs_arg = NULL, *ks_arg = NULL;
+        int d = 0;
+
+        if (output != NULL) {
+            fprintf(stderr, "Error: Chains write one file per step; --output is not supported.\n");
+            return 1;
+        }
+        if (tile_rows > 0 || num_shards > 0) {
+            fprintf(stderr, "Error: Chains keep each step in memory; --tile-rows and --shard are not supported.\n");
+            return 1;
+        }
+
+        if (construction == 'p') {
+            if (argc != 7) {
+                fprintf(stderr, "Error (p c): Incorrect number of arguments.\n");
+                fprintf(stderr, "Usage: ./generate_cff p c <m|f> <d> <[q0,q1,...]> <[k0,k1,...]>\n");
+                return 1;
+            }
+            if (block_size != 'm' && block_size != 'f') {
+                fprintf(stderr, "Error: Block size must be 'm' (minimum) or 'f' (full).\n");
+                return 1;
+            }
+            d = atoi(argv[4]);
+            fqs_arg = argv[5];
+            ks_arg = argv[6];
+        } else if (construction == 'm') {
+            if (argc != 6) {
+                fprintf(stderr, "Error (m c): Incorrect number of arguments.\n");
+                fprintf(stderr, "Usage: ./generate_cff m c <d> <[q0,q1,...]> <[k0,k1,...]>\n");
+                return 1;
+            }
+            d = atoi(argv[3]);
+            fqs_arg = argv[4];
+            ks_arg = argv[5];
+        } else {
+            fprintf(stderr, "Error: Unknown construction '%c'. Use 'p' or 'm'.\n", construction);
+            return 1;
+        }
+
+        int fqs_count = 0, ks_count = 0;
+        long* Fq_steps = parse_step_list(fqs_arg, &fqs_count);
+        long* k_steps = parse_step_list(ks_arg, &ks_count);
+        if (Fq_steps == NULL || k_steps == NULL || fqs_count != ks_count) {
+            fprintf(stderr, "Error: q and k lists must be non-empty and have the same length.\n");
+            free(Fq_steps);
+            free(k_steps);
+            return 1;
+        }
+
+        if (!check_cff_field_steps(construction, Fq_steps, fqs_count)) {
+            free(Fq_steps);
+            free(k_steps);
+            return 1;
+        }
+
+        chain_cff(construction, block_size, d, Fq_steps, k_steps, fqs_count, format, labels);
+
+        free(Fq_steps);
+        free(k_steps);
 
     } else {
-        fprintf(stderr, "Error: Unknown action '%c'. Use 'g' or 'f'.\n", action);
+        fprintf(stderr, "Error: Unknown action '%c'. Use 'g', 'f' or 'c'.\n", action);
         return 1;
     }
 
@@ -0,0 +1,52 @@
+/**
+ * @file cff_to_text.c
+ * @brief Prints the rows of a CFF file of any readable format as 0/1 text.
+ * 
+ * The rows are printed without the parameter header, in the layout of
+ * output.txt, so the files written in every format can be compared with
+ * the text output of the same construction.
+ * 
+ * run: make test (builds it together with generate_cff)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include "cff_file_generator.h"
+
+/**
+ * @brief Main function of the conversion program.
+ * 
+ * Usage: ./cff_to_text <cff_file>
+ * 
+ * @return 0 on success, 1 if the file cannot be read.
+ */
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <cff_file>\n", argv[0]);
+        return 1;
+    }
+
+    // Loader messages go to stdout; keep them out of the rows.
+    FILE* out = fdopen(dup(fileno(stdout)), "w");
+    if (out == NULL || freopen("/dev/null", "w", stdout) == NULL) return 1;
+
+    long rows, cols;
+    int mapped;
+    struct cff_parameters* params;
+    uint64_t** matrix = load_cff_file(argv[1], &rows, &cols, &params, &mapped);
+    if (matrix == NULL || params == NULL) {
+        fprintf(stderr, "Error: cannot read '%s'.\n", argv[1]);
+        return 1;
+    }
+
+    // The process exits right after printing, so the matrix is not freed.
+    for (long i = 0; i < rows; i++) {
+        for (long j = 0; j < cols; j++) {
+            fputc(((matrix[i][j / 64] >> (j % 64)) & 1) ? '1' : '0', out);
+            fputc((j + 1 < cols) ? ' ' : '\n', out);
+        }
+    }
+    return (fclose(out) == 0) ? 0 : 1;
+}
@@ -0,0 +1,75 @@
+#!/bin/bash
+# lib.sh - Helpers shared by the test_*.sh scripts (sourced, not run).
+#
+# Each test runs generate_cff in a scratch directory and compares what it
+# wrote with the text output of the same construction: cff_to_text prints
+# the rows of a file of any readable format in the layout of output.txt.
+
+TEST_DIR=$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)
+CFF=${CFF:-$TEST_DIR/../generate_cff}
+TO_TEXT=${TO_TEXT:-$TEST_DIR/cff_to_text}
+VERIFY=${VERIFY:-$TEST_DIR/verify}
+FAILED=0
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+cd "$WORK" || exit 1
+
+# Reports a failed check; the test keeps going and exits with 1 at the end.
+fail() {
+    echo "  FAIL: $*"
+    FAILED=1
+}
+
+# Runs generate_cff; it must succeed without printing an error.
+cff() {
+    if ! "$CFF" "$@" > cff.log 2>&1 || grep -q "Error" cff.log; then
+        fail "generate_cff $*"
+        sed 's/^/    /' cff.log
+        return 1
+    fi
+}
+
+# Runs generate_cff; it must fail with an error message.
+cff_error() {
+    if "$CFF" "$@" > cff.log 2>&1 && ! grep -q "Error" cff.log; then
+        fail "generate_cff $* was expected to fail"
+        return 1
+    fi
+}
+
+# Runs generate_cff; it must print an error and exit with a non-zero status.
+cff_exit_error() {
+    if "$CFF" "$@" > cff.log 2>&1 || ! grep -q "Error" cff.log; then
+        fail "generate_cff $* was expected to fail with a non-zero status"
+        return 1
+    fi
+}
+
+# same_rows <file> <text_file>: the rows of <file>, in any readable format,
+# must be the rows of the text file <text_file> (its header is skipped).
+same_rows() {
+    if ! cmp -s <("$TO_TEXT" "$1") <(tail -n +2 "$2"); then
+        fail "'$1' does not match '$2'"
+    fi
+}
+
+# same_files <file> <file>: both files must be byte for byte identical.
+same_files() {
+    if ! cmp -s "$1" "$2"; then
+        fail "'$1' differs from '$2'"
+    fi
+}
+
+# is_cff <file> <d>: the matrix in <file> must be a d-CFF (checked by verify.c).
+is_cff() {
+    "$TO_TEXT" "$1" > rows.txt
+    if [ "$("$VERIFY" rows.txt "$2")" != "Yes" ]; then
+        fail "'$1' is not a $2-CFF"
+    fi
+}
+
+# Ends the test with the status of its checks.
+finish() {
+    exit $FAILED
+}
@@ -0,0 +1,28 @@
+#!/bin/bash
+# run_tests.sh - Runs every test_*.sh script and reports the ones that fail.
+#
+# Usage: ./run_tests.sh [test_name ...]
+# The binaries are taken from the repository root and this directory, or
+# from $CFF, $TO_TEXT and $VERIFY (see lib.sh).
+
+cd "$(dirname "$0")" || exit 1
+
+tests=("$@")
+[ ${#tests[@]} -eq 0 ] && tests=(test_*.sh)
+
+failed=0
+for t in "${tests[@]}"; do
+    if bash "${t%.sh}.sh"; then
+        echo "PASS ${t%.sh}"
+    else
+        echo "FAIL ${t%.sh}"
+        failed=$((failed + 1))
+    fi
+done
+
+if [ $failed -eq 0 ]; then
+    echo "All ${#tests[@]} tests passed."
+else
+    echo "$failed of ${#tests[@]} tests failed."
+fi
+[ $failed -eq 0 ]
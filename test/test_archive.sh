@@ -0,0 +1,36 @@
+#!/bin/bash
+# Chain archives: every step extracted, and steps appended by 'g'.
+source "$(dirname "$0")/lib.sh"
+
+cff p c f 1 [2,4,16] [1,1,1]
+cff p c f 1 [2,4,16] [1,1,1] --format=archive
+mv "CFFs/1-CFF(4,4).cfa" chain.cfa
+steps=("CFFs/1-CFF(4,4).txt" "CFFs/1-CFF(8,16).txt" "CFFs/1-CFF(32,256).txt")
+for s in 1 2 3; do
+    cff x chain.cfa $s --output=step$s.txt
+    same_files step$s.txt "${steps[$((s - 1))]}"
+done
+cff x chain.cfa 2 --format=binary --output=step2.cff
+same_rows step2.cff "${steps[1]}"
+cff_exit_error x chain.cfa 4
+"$CFF" x missing.cfa 1 > cff.log 2>&1 && fail "x on a missing archive exited with 0"
+
+# An archive used as input stands for its last step; with --format=archive
+# 'g' appends the new step to it.
+cff p c f 1 [2,4] [1,1] --format=archive
+mv "CFFs/1-CFF(4,4).cfa" short.cfa
+same_rows short.cfa "${steps[1]}"
+cff p g f short.cfa 1 16 1 --format=archive
+cff x short.cfa 3 --output=appended.txt
+same_files appended.txt "${steps[2]}"
+same_rows short.cfa "${steps[2]}"
+
+# The appended step must continue the chain: same d, a field extension,
+# and no --output, since the archive is appended in place.
+cff_error p g f short.cfa 2 256 1 --format=archive
+cff_error p g f short.cfa 1 512 1 --format=archive
+cff_error p g f short.cfa 1 256 1 --format=archive --output=other.cfa
+[ -e other.cfa ] && fail "--output created 'other.cfa'"
+"$CFF" x short.cfa 4 > cff.log 2>&1 && fail "a rejected step was appended"
+
+finish
@@ -0,0 +1,27 @@
+#!/bin/bash
+# Packed binary files, mapped on input.
+source "$(dirname "$0")/lib.sh"
+
+# Text stays the default format.
+cff p f f 1 4 1
+[ -f "CFFs/1-CFF(16,16).txt" ] || fail "the default format is not text"
+
+cff p f f 1 4 1 --format=binary --output=16.cff
+same_rows 16.cff "CFFs/1-CFF(16,16).txt"
+
+# Embedding from a mapped binary input, into text and into binary.
+cff p g f "CFFs/1-CFF(16,16).txt" 1 16 1 --output=256.txt
+cff p g f 16.cff 1 16 1 --output=256-from-bin.txt
+cff p g f 16.cff 1 16 1 --format=binary --output=256.cff
+same_files 256-from-bin.txt 256.txt
+same_rows 256.cff 256.txt
+
+# A header written in the other byte order is rejected, not misread.
+# The marker is the int32 at offset 20 of the header.
+cp 16.cff swapped.cff
+set -- $(od -A n -t x1 -j 20 -N 4 16.cff)
+printf "\x$4\x$3\x$2\x$1" | dd of=swapped.cff bs=1 seek=20 conv=notrunc 2> /dev/null
+cmp -s 16.cff swapped.cff && fail "the byte order marker was not swapped"
+cff_error p g f swapped.cff 1 16 1 --output=bad.txt
+
+finish
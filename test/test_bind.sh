@@ -0,0 +1,27 @@
+#!/bin/bash
+# Thread pinning with --bind: placement never changes the matrix.
+source "$(dirname "$0")/lib.sh"
+
+cff p f f 1 4 1 --format=binary --output=16.cff
+cff p f f 1 131 1 --format=binary --output=131.cff
+cff p g f 16.cff 1 16 1 --format=binary --output=256.cff
+
+for bind in close spread; do
+    for t in 1 3; do
+        OMP_NUM_THREADS=$t cff p f f 1 131 1 --bind=$bind --format=binary --output=131-$bind-$t.cff
+        same_files 131-$bind-$t.cff 131.cff
+        OMP_NUM_THREADS=$t cff p g f 16.cff 1 16 1 --bind=$bind --format=binary --output=256-$bind-$t.cff
+        same_files 256-$bind-$t.cff 256.cff
+    done
+    cff p f f 1 131 1 --bind=$bind --tile-rows=50 --format=binary --output=131-$bind-tiled.cff
+    same_files 131-$bind-tiled.cff 131.cff
+done
+
+# The placement is applied by the OpenMP runtime, through OMP_PROC_BIND and OMP_PLACES.
+OMP_DISPLAY_ENV=true "$CFF" p f f 1 4 1 --bind=spread --output=16-shown.txt > cff.log 2>&1
+grep -qi "OMP_PROC_BIND.*spread" cff.log || fail "--bind=spread did not reach OMP_PROC_BIND"
+same_files 16-shown.txt <("$CFF" p f f 1 4 1 --output=- 2> /dev/null)
+
+cff_error p f f 1 4 1 --bind=nowhere
+
+finish
@@ -0,0 +1,29 @@
+#!/bin/bash
+# Embedding chains built in one process.
+source "$(dirname "$0")/lib.sh"
+
+# Every step of a chain is the file the separate f and g steps write.
+cff p c f 1 [2,4,16] [1,1,1]
+cff p f f 1 2 1 --output=4.txt
+cff p g f 4.txt 1 4 1 --output=16.txt
+cff p g f 16.txt 1 16 1 --output=256.txt
+same_files "CFFs/1-CFF(4,4).txt" 4.txt
+same_files "CFFs/1-CFF(8,16).txt" 16.txt
+same_files "CFFs/1-CFF(32,256).txt" 256.txt
+
+cff m c 2 [3,9,27] [1,1,1]
+cff p f m 2 3 1 --output=9.txt
+cff m g 9.txt 2 9 1 --output=81.txt
+cff m g 81.txt 2 27 1 --output=729.txt
+same_files "CFFs/2-CFF(9,9).txt" 9.txt
+same_files "CFFs/2-CFF(27,81).txt" 81.txt
+same_files "CFFs/2-CFF(81,729).txt" 729.txt
+
+# Fields that do not extend the previous one are rejected up front.
+rm -rf CFFs
+cff_error p c f 1 [2,3] [1,1]
+cff_error p c f 1 [4,2] [1,1]
+cff_error p c f 1 [4,8] [1,1]
+[ -e CFFs ] && [ -n "$(ls CFFs)" ] && fail "a rejected chain wrote files"
+
+finish
@@ -0,0 +1,23 @@
+#!/bin/bash
+# Text inputs parsed in line-aligned chunks, one per thread.
+source "$(dirname "$0")/lib.sh"
+
+cff p f f 1 131 1 --output=131.txt
+for t in 1 2 3 7; do
+    OMP_NUM_THREADS=$t "$TO_TEXT" 131.txt > rows-$t.txt
+    cmp -s rows-$t.txt <(tail -n +2 131.txt) || fail "131.txt read with $t threads"
+done
+
+# A row of the wrong length is reported by index, wherever its chunk is.
+cff p f f 1 4 1 --output=16.txt
+sed '4s/ 0$//' 16.txt > short.txt
+sed '4s/$/ 1/' 16.txt > long.txt
+for input in short long; do
+    cff_error p g f $input.txt 1 16 1 --output=out.txt
+    grep -q "Row 2 of '$input.txt'" cff.log || fail "bad row of $input.txt not reported"
+done
+sed '201s/$/ 0/' 131.txt > late.txt
+OMP_NUM_THREADS=3 cff_error p g f late.txt 1 131 1 --output=out.txt
+grep -q "Row 199 of 'late.txt' has 17162 columns" cff.log || fail "bad row of late.txt not reported"
+
+finish
@@ -0,0 +1,45 @@
+#!/bin/bash
+# Compressed sparse column files.
+source "$(dirname "$0")/lib.sh"
+
+cff p f f 1 4 1 --output=16.txt
+cff p f f 1 4 1 --format=csc --output=16.csc
+same_rows 16.csc 16.txt
+
+cff p g f 16.txt 1 16 1 --output=256.txt
+cff p g f 16.csc 1 16 1 --format=csc --output=256.csc
+same_rows 256.csc 256.txt
+
+# Monotone CFFs have columns of different weights, stored as several runs.
+cff p f m 2 3 1 --output=9.txt
+cff m g 9.txt 2 9 1 --output=81.txt
+cff m g 81.txt 2 27 1 --output=729.txt
+cff m g 81.txt 2 27 1 --format=csc --output=729.csc
+same_rows 729.csc 729.txt
+
+# Matrices beyond 2^32 rows store 64-bit row indices; widen a small file to
+# that layout and read it back.
+python3 - 256.csc 256-wide.csc <<'PY'
+import struct, sys
+
+with open(sys.argv[1], "rb") as f:
+    data = f.read()
+# struct cff_csc_header: magic, construction, padding, d, num_steps,
+# index_bytes, rows, cols, num_ones, num_runs, Fq_steps[32], k_steps[32].
+layout = "=8sc3xiiiqqqq"
+_, _, _, _, index_bytes, _, _, ones, runs = struct.unpack_from(layout, data)
+offset = struct.calcsize(layout) + 2 * 32 * 8 + 2 * 8 * runs
+idx = struct.unpack_from("=%d%s" % (ones, "H" if index_bytes == 2 else "I"), data, offset)
+header = bytearray(data[:offset])
+struct.pack_into("=i", header, 20, 8)
+with open(sys.argv[2], "wb") as f:
+    f.write(bytes(header) + struct.pack("=%dQ" % ones, *idx))
+PY
+same_rows 256-wide.csc 256.txt
+
+# A failed write is reported, even when it only shows up when the file is closed.
+if [ -w /dev/full ]; then
+    cff_error p f f 1 4 1 --format=csc --output=/dev/full
+fi
+
+finish
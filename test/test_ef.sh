@@ -0,0 +1,31 @@
+#!/bin/bash
+# Elias-Fano compressed columns.
+source "$(dirname "$0")/lib.sh"
+
+cff p f f 1 4 1 --output=16.txt
+cff p f f 1 4 1 --format=ef --output=16.cef
+same_rows 16.cef 16.txt
+
+cff p g f 16.txt 1 16 1 --output=256.txt
+cff p g f 16.cef 1 16 1 --format=ef --output=256.cef
+same_rows 256.cef 256.txt
+
+cff p f m 2 3 1 --output=9.txt
+cff m g 9.txt 2 9 1 --output=81.txt
+cff m g 81.txt 2 27 1 --output=729.txt
+cff m g 81.txt 2 27 1 --format=ef --output=729.cef
+same_rows 729.cef 729.txt
+
+# A larger matrix takes less space than as CSC.
+cff p f f 1 131 1 --output=131.txt
+cff p f f 1 131 1 --format=ef --output=131.cef
+cff p f f 1 131 1 --format=csc --output=131.csc
+same_rows 131.cef 131.txt
+[ "$(wc -c < 131.cef)" -lt "$(wc -c < 131.csc)" ] || fail "131.cef is not smaller than 131.csc"
+
+# A failed write is reported, even when it only shows up when the file is closed.
+if [ -w /dev/full ]; then
+    cff_error p f f 1 4 1 --format=ef --output=/dev/full
+fi
+
+finish
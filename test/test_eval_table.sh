@@ -0,0 +1,16 @@
+#!/bin/bash
+# Rows generated from the evaluation table (fields of at most 256 elements).
+source "$(dirname "$0")/lib.sh"
+
+# output.txt is the 2-CFF(9,9) of the original generator.
+cff p f m 2 3 1 --output=9.txt
+cmp -s <(tail -n +2 9.txt) "$TEST_DIR/output.txt" || fail "2-CFF(9,9) differs from output.txt"
+is_cff 9.txt 2
+
+cff m g 9.txt 2 9 1 --output=81.txt
+is_cff 81.txt 2
+
+cff p f f 1 16 1 --output=256.txt
+is_cff 256.txt 1
+
+finish
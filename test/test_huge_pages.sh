@@ -0,0 +1,23 @@
+#!/bin/bash
+# Huge-page backed buffers: same matrices, with or without reserved pages.
+source "$(dirname "$0")/lib.sh"
+
+# Over F_257 the inverted index and the matrix are past CFF_HUGE_PAGE_MIN_BYTES.
+cff p f f 1 257 1 --format=binary --output=257.cff
+cff p f f 1 4 1 --format=binary --output=16.cff
+cff p g f 16.cff 1 16 1 --format=binary --output=256.cff
+
+# hugetlb falls back to transparent and then normal pages when none are reserved.
+for pages in thp hugetlb; do
+    cff p f f 1 257 1 --huge-pages=$pages --format=binary --output=257-$pages.cff
+    same_files 257-$pages.cff 257.cff
+    cff p g f 16.cff 1 16 1 --huge-pages=$pages --format=binary --output=256-$pages.cff
+    same_files 256-$pages.cff 256.cff
+done
+cff p f f 1 131 1 --huge-pages=thp --tile-rows=64 --output=131-tiled.txt
+cff p f f 1 131 1 --output=131.txt
+same_files 131-tiled.txt 131.txt
+
+cff_error p f f 1 4 1 --huge-pages=gigantic
+
+finish
@@ -0,0 +1,17 @@
+#!/bin/bash
+# Rows generated from the inverted index (fields of more than 256 elements).
+source "$(dirname "$0")/lib.sh"
+
+# The index is filled by all threads at once: the result must not depend
+# on how many there are.
+OMP_NUM_THREADS=1 cff p f f 1 257 1 --format=binary --output=1.cff
+OMP_NUM_THREADS=3 cff p f f 1 257 1 --format=binary --output=3.cff
+same_files 1.cff 3.cff
+
+# One 1 per point in every column, checked on the first and last columns.
+"$TO_TEXT" 3.cff | cut -d ' ' -f 1-1000,65050- | awk -v q=257 '
+    { for (j = 1; j <= NF; j++) sum[j] += $j }
+    NR % q == 0 { for (j = 1; j <= NF; j++) if (sum[j] != 1) bad++; delete sum }
+    END { exit (NR % q != 0 || bad > 0) }' || fail "a column does not have one 1 per point"
+
+finish
@@ -0,0 +1,50 @@
+#!/bin/bash
+# Row/column label side files: a bit of the new blocks is set exactly when P(x) = y.
+source "$(dirname "$0")/lib.sh"
+
+# check_labels <text_file> <label_file>, for prime fields, where element
+# indices are the integers mod p.
+check_labels() {
+    python3 - "$1" "$2" <<'PY'
+import struct, sys
+
+rows = [l.split() for l in open(sys.argv[1]).read().splitlines()[1:]]
+data = open(sys.argv[2], "rb").read()
+fmt = "=8sii9q"  # struct cff_labels_header
+magic, step, width, q, p, old_rows, old_cols, n_old_pairs, n_new_pairs, n_old_polys, n_new_polys, coeffs = struct.unpack_from(fmt, data)
+assert magic == b"CFFLBL1\0" and q == p
+offset = struct.calcsize(fmt)
+
+def take(count):
+    global offset
+    values = struct.unpack_from("=%d%s" % (count, {1: "B", 2: "H", 4: "I"}[width]), data, offset)
+    offset += count * width
+    return values
+
+old_pairs, new_pairs = take(2 * n_old_pairs), take(2 * n_new_pairs)
+take(n_old_polys * coeffs)
+new_polys = take(n_new_polys * coeffs)
+assert offset == len(data)
+
+# Old pairs label the first rows (old_new), new pairs the rows after the old matrix.
+labelled = [(i, old_pairs[2 * i], old_pairs[2 * i + 1]) for i in range(n_old_pairs)]
+labelled += [(old_rows + i, new_pairs[2 * i], new_pairs[2 * i + 1]) for i in range(n_new_pairs)]
+for row, x, y in labelled:
+    for j in range(n_new_polys):
+        value = sum(c * pow(x, e, p) for e, c in enumerate(new_polys[j * coeffs:(j + 1) * coeffs])) % p
+        if (rows[row][old_cols + j] == "1") != (value == y):
+            sys.exit(f"bit ({row}, {old_cols + j}) does not match its labels")
+PY
+}
+
+cff p f f 1 5 1 --labels --output=5.txt
+check_labels 5.txt 5.lbl || fail "labels of 5.txt"
+cff p g f 5.txt 1 5 2 --labels --output=125.txt
+check_labels 125.txt 125.lbl || fail "labels of 125.txt"
+cff p f m 2 7 1 --labels --format=binary --output=7.cff
+cff p f m 2 7 1 --output=7.txt
+check_labels 7.txt 7.lbl || fail "labels of 7.cff"
+
+cff_error p f f 1 5 1 --labels --output=-
+
+finish
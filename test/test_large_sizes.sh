@@ -0,0 +1,21 @@
+#!/bin/bash
+# 64-bit sizes: dimensions past 2^32 are planned exactly, and overflows are refused.
+source "$(dirname "$0")/lib.sh"
+
+cff p f f 1 65536 1 --plan
+grep -q "131072x4294967296 matrix" cff.log || fail "2^32 columns were not planned exactly"
+cff p f f 1 65536 2 --plan
+grep -q "196608x281474976710656 matrix" cff.log || fail "2^48 columns were not planned exactly"
+
+# q^(k+1) columns past 2^63: a clear error and no file, instead of a
+# wrapped size.
+cff p f f 1 4 1 --output=16.txt
+for args in "p f f 1 65536 4" "p f f 1 65536 3 --plan" "p g f 16.txt 1 65536 4"; do
+    "$CFF" $args --output=big.txt > big.log 2>&1
+    status=$?
+    [ $status -eq 1 ] || fail "generate_cff $args exited with $status"
+    grep -q "Size overflow" big.log || fail "generate_cff $args did not report the overflow"
+    [ -e big.txt ] && fail "generate_cff $args wrote a file"
+done
+
+finish
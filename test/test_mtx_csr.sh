@@ -0,0 +1,60 @@
+#!/bin/bash
+# Matrix Market and binary CSR exports, decoded here since they are not inputs.
+source "$(dirname "$0")/lib.sh"
+
+# Prints the rows of a .mtx or .csr file in the layout of output.txt.
+export_rows() {
+    python3 - "$1" <<'PY'
+import struct, sys
+
+path = sys.argv[1]
+with open(path, "rb") as f:
+    data = f.read()
+if path.endswith(".mtx"):
+    lines = [l for l in data.decode().splitlines() if not l.startswith("%")]
+    rows, cols, ones = map(int, lines[0].split())
+    entries = [tuple(int(x) - 1 for x in l.split()) for l in lines[1:]]
+    assert len(entries) == ones
+else:
+    # struct cff_csr_header: magic, construction, padding, d, num_steps,
+    # index_bytes, rows, cols, num_ones, Fq_steps[32], k_steps[32].
+    magic, _, _, _, index_bytes, rows, cols, ones = struct.unpack_from("=8sc3xiiiqqq", data)
+    assert magic == b"CFFCSR1\0"
+    offset = struct.calcsize("=8sc3xiiiqqq") + 2 * 32 * 8
+    ptr = struct.unpack_from("=%dq" % (rows + 1), data, offset)
+    offset += 8 * (rows + 1)
+    idx = struct.unpack_from("=%d%s" % (ones, "I" if index_bytes == 4 else "Q"), data, offset)
+    assert ptr[rows] == ones and len(data) == offset + index_bytes * ones
+    entries = [(i, idx[k]) for i in range(rows) for k in range(ptr[i], ptr[i + 1])]
+matrix = [["0"] * cols for _ in range(rows)]
+for i, j in entries:
+    matrix[i][j] = "1"
+for row in matrix:
+    print(" ".join(row))
+PY
+}
+
+cff p f f 1 4 1 --output=16.txt
+cff p g f 16.txt 1 16 1 --output=256.txt
+cff p f m 2 3 1 --output=9.txt
+cff m g 9.txt 2 9 1 --output=81.txt
+declare -A commands=([16]="p f f 1 4 1" [256]="p g f 16.txt 1 16 1" [81]="m g 9.txt 2 9 1")
+for name in 16 256 81; do
+    for format in mtx csr; do
+        cff ${commands[$name]} --format=$format --output=$name.$format
+        cmp -s <(export_rows $name.$format) <(tail -n +2 $name.txt) || fail "$name.$format does not match $name.txt"
+    done
+done
+grep -qx "% p \[4\] \[1\]" 16.mtx || fail "16.mtx has no parameter comment"
+
+# Exports cannot be read back as inputs.
+cff_error p g f 16.mtx 1 16 1
+cff_error p g f 16.csr 1 16 1
+
+# A failed write is reported, even when it only shows up when the file is closed.
+if [ -w /dev/full ]; then
+    cff_error p f f 1 4 1 --format=mtx --output=/dev/full
+    cff_error p f f 1 4 1 --format=csr --output=/dev/full
+fi
+
+finish
@@ -0,0 +1,46 @@
+#!/bin/bash
+# --plan predictions and the strategy chosen by --mem-limit.
+source "$(dirname "$0")/lib.sh"
+
+# check_plan <output_file> <generate_cff args...>: the planned dimensions are
+# those of the result, and the planned output size is within 3% of the file
+# (text and binary) or an upper bound of it (sparse formats are planned at
+# their bitmap size).
+check_plan() {
+    local output=$1
+    shift
+    cff "$@" --plan --output=$output
+    [ -e $output ] && fail "--plan wrote $output"
+    local planned
+    planned=$(sed -n 's/^Plan of .*: \([0-9]*x[0-9]*\) matrix\.$/\1/p' cff.log)
+    local size
+    size=$(awk '/Output of/ {
+        unit = $4; sub(/;/, "", unit)
+        scale = (unit == "KiB") ? 1024 : (unit == "MiB") ? 1048576 : (unit == "GiB") ? 1073741824 : 1
+        printf "%.0f", $3 * scale }' cff.log)
+
+    cff "$@" --output=$output
+    "$TO_TEXT" $output > rows.txt
+    [ "$planned" = "$(wc -l < rows.txt | tr -d ' ')x$(head -1 rows.txt | wc -w | tr -d ' ')" ] || fail "planned $planned for $output"
+    local slack=1.03
+    case $output in *.txt | *.cff) ;; *) slack=1000 ;; esac
+    awk -v planned="$size" -v actual="$(wc -c < $output)" -v slack=$slack 'BEGIN { exit (planned < 0.97 * actual || planned > slack * actual) }' ||
+        fail "planned $size bytes for $output, wrote $(wc -c < $output)"
+}
+
+check_plan 131.txt p f f 1 131 1
+check_plan 131.cff p f f 1 131 1 --format=binary
+check_plan 131.csc p f f 1 131 1 --format=csc
+check_plan 16.cff p f f 1 4 1 --format=binary
+check_plan 256.txt p g f 16.cff 1 16 1
+check_plan 256.cff p g f 16.cff 1 16 1 --format=binary
+check_plan 81.txt p f m 2 9 1
+
+# A limit between the tiled and in-memory peaks picks tiles; the matrix is the same.
+cff p f f 1 131 1 --mem-limit=43.5M --output=limited.txt
+grep -q "Strategy: tiled" cff.log || fail "--mem-limit=43.5M did not choose tiles"
+same_files limited.txt 131.txt
+"$CFF" p f f 1 131 1 --mem-limit=1M --output=none.txt > none.log 2>&1 && fail "--mem-limit=1M did not fail"
+[ -e none.txt ] && fail "--mem-limit=1M wrote a file"
+
+finish
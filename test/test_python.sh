@@ -0,0 +1,58 @@
+#!/bin/bash
+# Python module (built by 'make python'), compared with generate_cff.
+source "$(dirname "$0")/lib.sh"
+
+PYTHON_DIR=$TEST_DIR/../python
+if ! ls "$PYTHON_DIR"/cff*.so > /dev/null 2>&1; then
+    echo "  SKIP: the Python module is not built (make python)"
+    finish
+fi
+
+cff p f f 1 4 1 --output=16.txt
+cff p g f 16.txt 1 16 1 --output=256.txt
+cff p f m 2 3 1 --output=9.txt
+cff m g 9.txt 2 9 1 --output=81.txt
+
+PYTHONPATH=$PYTHON_DIR python3 - <<'PY' || fail "Python module checks"
+import sys
+import cff
+
+def rows(m):
+    """Rows of a matrix, read through the buffer protocol, as in output.txt."""
+    view = memoryview(m)
+    assert view.readonly and view.shape[0] == m.rows
+    return [" ".join(str((row[j // 8] >> (j % 8)) & 1) for j in range(m.cols)) for row in view.tolist()]
+
+def text_rows(path):
+    with open(path) as f:
+        return f.read().splitlines()[1:]
+
+def check(m, path):
+    if rows(m) != text_rows(path):
+        sys.exit(f"matrix does not match {path}")
+
+m = cff.generate(1, 4, 1)
+check(m, "16.txt")
+e = cff.embed(m, 16, 1)
+check(e, "256.txt")
+assert e.steps == [(4, 1), (16, 1)] and e.d == 1 and e.construction == "p"
+
+# The CSC view holds the same ones as the bitmap.
+csc = e.csc()
+indptr, indices = memoryview(csc.indptr).tolist(), memoryview(csc.indices).tolist()
+bits = [r.split() for r in rows(e)]
+for j in range(e.cols):
+    assert indices[indptr[j]:indptr[j + 1]] == [i for i in range(e.rows) if bits[i][j] == "1"]
+
+check(cff.embed(cff.generate(2, 3, 1, block_size="m"), 9, 1, construction="m"), "81.txt")
+
+# Fields that do not extend the previous one are refused with the reason.
+for q, reason in ((6, "not a prime power"), (9, "not a power of 2"), (8, "does not contain")):
+    try:
+        cff.embed(m, q, 1)
+        sys.exit(f"embed with q = {q} did not fail")
+    except ValueError as error:
+        assert reason in str(error), error
+PY
+
+finish
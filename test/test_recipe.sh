@@ -0,0 +1,36 @@
+#!/bin/bash
+# Recipe files, materialized or queried without the matrix.
+source "$(dirname "$0")/lib.sh"
+
+cff p c f 1 [2,4,16] [1,1,1]
+cff p c f 1 [2,4,16] [1,1,1] --format=recipe
+text="CFFs/1-CFF(32,256).txt"
+recipe="CFFs/1-CFF(32,256).rcp"
+same_rows "$recipe" "$text"
+same_rows "CFFs/1-CFF(8,16).rcp" "CFFs/1-CFF(8,16).txt"
+
+# Queries answer from the oracle what the materialized matrix holds.
+rows=$(($(wc -l < "$text") - 1))
+for ((r = 0; r < rows; r++)); do
+    [ "$("$CFF" q "$recipe" row $r)" = "$(sed -n "$((r + 2))p" "$text")" ] || fail "row $r"
+done
+for c in 0 17 128 255; do
+    expected=$(tail -n +2 "$text" | awk -v c=$((c + 1)) '$c == 1 { printf "%s%d", sep, NR - 1; sep = " " }')
+    [ "$("$CFF" q "$recipe" col $c)" = "$expected" ] || fail "column $c"
+    for r in 0 5 $((rows - 1)); do
+        expected=$(sed -n "$((r + 2))p" "$text" | cut -d ' ' -f $((c + 1)))
+        [ "$("$CFF" q "$recipe" bit $r $c)" = "$expected" ] || fail "bit ($r, $c)"
+    done
+done
+cff_error q "$recipe" row $rows
+cff_error q "$recipe" col 256
+
+# An embedded recipe must keep the recipe's d and extend its last field.
+cff p g f "CFFs/1-CFF(8,16).rcp" 1 16 1 --format=recipe --output=embedded.rcp
+same_rows embedded.rcp "$text"
+cff_error p g f "CFFs/1-CFF(8,16).rcp" 2 16 1 --format=recipe --output=bad.rcp
+cff_error p g f "CFFs/1-CFF(8,16).rcp" 1 6 1 --format=recipe --output=bad.rcp
+cff_error p g f "CFFs/1-CFF(8,16).rcp" 1 8 1 --format=recipe --output=bad.rcp
+[ -e bad.rcp ] && fail "a rejected recipe step was written"
+
+finish
@@ -0,0 +1,17 @@
+#!/bin/bash
+# Rows grouped by evaluation point and tiled over columns.
+source "$(dirname "$0")/lib.sh"
+
+# With q = 131 a group of 131 rows spans two column tiles of CFF_TILE_BYTES.
+OMP_NUM_THREADS=1 cff p f f 1 131 1 --output=1.txt
+OMP_NUM_THREADS=3 cff p f f 1 131 1 --output=3.txt
+same_files 1.txt 3.txt
+
+# Each group of q rows belongs to one point x: every polynomial (column)
+# takes exactly one value there, so it has exactly one 1 in the group.
+tail -n +2 3.txt | awk -v q=131 '
+    { for (j = 1; j <= NF; j++) sum[j] += $j }
+    NR % q == 0 { for (j = 1; j <= NF; j++) if (sum[j] != 1) bad++; delete sum }
+    END { exit (NR % q != 0 || bad > 0) }' || fail "a column does not have one 1 per point"
+
+finish
@@ -0,0 +1,40 @@
+#!/bin/bash
+# Row-range shards generated separately and merged with 'j'.
+source "$(dirname "$0")/lib.sh"
+
+cff p f f 1 4 1 --output=16.txt
+cff p f f 1 4 1 --format=binary --output=16.cff
+cff p g f 16.txt 1 16 1 --output=256.txt
+cff p g f 16.txt 1 16 1 --format=binary --output=256.cff
+
+# shard_and_merge <n> <name> <generate_cff args...>
+shard_and_merge() {
+    local n=$1 name=$2
+    shift 2
+    for ((i = 0; i < n; i++)); do
+        cff "$@" --shard=$i/$n --output=$name
+    done
+    cff j merged-$name $name.shard*of$n
+}
+
+# Embeddings are sharded from binary inputs, whose header gives the rows.
+for n in 1 3 4; do
+    shard_and_merge $n f$n.txt p f f 1 4 1
+    same_files merged-f$n.txt 16.txt
+    shard_and_merge $n g$n.txt p g f 16.cff 1 16 1
+    same_files merged-g$n.txt 256.txt
+    shard_and_merge $n g$n.cff p g f 16.cff 1 16 1 --format=binary
+    same_files merged-g$n.cff 256.cff
+done
+
+# More shards than rows: some shards are empty.
+shard_and_merge 11 f11.txt p f f 1 4 1
+same_files merged-f11.txt 16.txt
+
+cff_error p f f 1 4 1 --shard=4/4
+cff_error p g f 16.txt 1 16 1 --shard=0/2
+rm f3.txt.shard1of3
+cff_exit_error j missing.txt f3.txt.shard*of3
+cff_exit_error j mixed.txt f4.txt.shard0of4 g4.txt.shard1of4 f4.txt.shard2of4 f4.txt.shard3of4
+
+finish
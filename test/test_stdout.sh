@@ -0,0 +1,27 @@
+#!/bin/bash
+# Streaming to stdout and embedding from stdin.
+source "$(dirname "$0")/lib.sh"
+
+cff p f f 1 4 1 --output=16.txt
+cff p g f 16.txt 1 16 1 --output=256.txt
+
+# Only the matrix goes to stdout; progress messages go to stderr.
+"$CFF" p f f 1 4 1 --output=- > stdout.txt 2> stderr.txt || fail "text to stdout"
+same_files stdout.txt 16.txt
+
+for format in text binary; do
+    "$CFF" p f f 1 4 1 --format=$format --output=- 2> /dev/null |
+        "$CFF" p g f - 1 16 1 --output=- 2> /dev/null > piped-$format.txt
+    same_files piped-$format.txt 256.txt
+done
+"$CFF" p f f 1 4 1 --format=binary --output=- 2> /dev/null |
+    "$CFF" p g f - 1 16 1 --format=binary --output=- 2> /dev/null > piped.cff
+same_rows piped.cff 256.txt
+
+cff_error p c f 1 [2,4] [1,1] --output=-
+
+# A path too long for a file name buffer is rejected, not cut.
+long_path=$(printf 'x%.0s' $(seq 5000))
+"$CFF" p f f 1 4 1 --output=$long_path > cff.log 2>&1 && fail "long --output accepted"
+
+finish
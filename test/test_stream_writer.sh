@@ -0,0 +1,24 @@
+#!/bin/bash
+# Rows handed to the writer thread through the ring of buffers.
+source "$(dirname "$0")/lib.sh"
+
+# More rows than one buffer holds, with the writer and 1 or 3 formatters.
+for t in 1 3; do
+    OMP_NUM_THREADS=$t cff p f f 1 131 1 --output=131-$t.txt
+done
+same_files 131-1.txt 131-3.txt
+cff p f f 1 131 1 --format=binary --output=131.cff
+same_rows 131.cff 131-1.txt
+
+# A failed write is reported once and the producers stop instead of
+# waiting on the writer.
+if [ -w /dev/full ]; then
+    cff p f f 1 4 1 --output=16.txt
+    for args in "p f f 1 131 1" "p f f 1 131 1 --tile-rows=16" "p g f 16.txt 1 16 1" "p g f 16.txt 1 16 1 --tile-rows=4"; do
+        timeout 60 "$CFF" $args --output=/dev/full > full.log 2>&1
+        [ $? -eq 124 ] && fail "generate_cff $args hangs on a full disk"
+        [ "$(grep -c "Error writing file '/dev/full'" full.log)" = 1 ] || fail "generate_cff $args did not report the failed write"
+    done
+fi
+
+finish
@@ -0,0 +1,22 @@
+#!/bin/bash
+# Embedding steps, whose index builds and blocks run as one task graph.
+source "$(dirname "$0")/lib.sh"
+
+cff p f f 1 4 1 --output=16.txt
+for t in 1 2 4; do
+    OMP_NUM_THREADS=$t cff p g f 16.txt 1 16 1 --output=256-$t.txt
+done
+same_files 256-1.txt 256-2.txt
+same_files 256-1.txt 256-4.txt
+
+# The old matrix is the top-left block of the embedded one.
+cmp -s <(tail -n +2 16.txt) <(sed -n 2,9p 256-1.txt | cut -d ' ' -f 1-16) || fail "old block changed"
+
+# Same with the monotone construction.
+cff p f m 2 3 1 --output=9.txt
+for t in 1 3; do
+    OMP_NUM_THREADS=$t cff m g 9.txt 2 9 1 --output=81-$t.txt
+done
+same_files 81-1.txt 81-3.txt
+
+finish
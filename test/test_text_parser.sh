@@ -0,0 +1,21 @@
+#!/bin/bash
+# Text input parsed in a single mapped pass.
+source "$(dirname "$0")/lib.sh"
+
+cff p f f 1 4 1 --output=16.txt
+cff p g f 16.txt 1 16 1 --output=256.txt
+
+# Windows line ends and a missing final newline parse to the same matrix.
+sed 's/$/\r/' 16.txt > crlf.txt
+head -c -1 16.txt > no-newline.txt
+for input in crlf.txt no-newline.txt; do
+    same_rows $input 16.txt
+    cff p g f $input 1 16 1 --output=256-$input
+    same_files 256-$input 256.txt
+done
+
+# Wide rows, converted many columns at a time.
+cff p f f 1 131 1 --output=131.txt
+same_rows 131.txt 131.txt
+
+finish
@@ -0,0 +1,20 @@
+#!/bin/bash
+# Text output formatted through the byte lookup table.
+source "$(dirname "$0")/lib.sh"
+
+# Column counts that are not multiples of 8 end inside a table byte.
+for q in 3 5 7; do
+    cff p f f 1 $q 1 --output=$q.txt
+    cff p f f 1 $q 1 --format=binary --output=$q.cff
+    same_rows $q.cff $q.txt
+done
+grep -q ' $' 7.txt && fail "rows of 7.txt end with a space"
+head -1 5.txt | grep -qx "p \[5\] \[1\]" || fail "wrong header line in 5.txt"
+
+# A matrix of more than one ring buffer (CFF_TEXT_BUFFER_BYTES / CFF_WRITE_RING_SLOTS).
+cff p f f 1 131 1 --output=131.txt
+cff p f f 1 131 1 --format=binary --output=131.cff
+same_rows 131.cff 131.txt
+tail -n +2 131.txt | awk 'NF != 17161 || /[^01 ]/ { bad++ } END { exit (NR != 262 || bad > 0) }' || fail "malformed rows in 131.txt"
+
+finish
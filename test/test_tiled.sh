@@ -0,0 +1,29 @@
+#!/bin/bash
+# Out-of-core generation, a tile of rows at a time.
+source "$(dirname "$0")/lib.sh"
+
+cff p f f 1 4 1 --output=16.txt
+cff p f f 1 4 1 --format=binary --output=16.cff
+cff p g f 16.txt 1 16 1 --output=256.txt
+cff p f f 1 131 1 --output=131.txt
+cff p f m 2 3 1 --output=9.txt
+cff m g 9.txt 2 9 1 --output=81.txt
+
+for tile in 1 7 64; do
+    cff p f f 1 131 1 --tile-rows=$tile --output=131-$tile.txt
+    same_files 131-$tile.txt 131.txt
+    cff p f f 1 131 1 --tile-rows=$tile --format=binary --output=131-$tile.cff
+    same_rows 131-$tile.cff 131.txt
+
+    cff p g f 16.txt 1 16 1 --tile-rows=$tile --output=256-$tile.txt
+    same_files 256-$tile.txt 256.txt
+    cff p g f 16.cff 1 16 1 --tile-rows=$tile --format=binary --output=256-$tile.cff
+    same_rows 256-$tile.cff 256.txt
+
+    cff m g 9.txt 2 9 1 --tile-rows=$tile --output=81-$tile.txt
+    same_files 81-$tile.txt 81.txt
+done
+
+cff_error p c f 1 [2,4] [1,1] --tile-rows=4
+
+finish
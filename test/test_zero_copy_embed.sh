@@ -0,0 +1,32 @@
+#!/bin/bash
+# Binary embeddings generated straight into the mapped output file.
+source "$(dirname "$0")/lib.sh"
+
+cff p f f 1 4 1 --format=binary --output=16.cff
+cff p g f 16.cff 1 16 1 --output=256.txt
+for t in 1 3; do
+    OMP_NUM_THREADS=$t cff p g f 16.cff 1 16 1 --format=binary --output=256-$t.cff
+    same_rows 256-$t.cff 256.txt
+done
+
+cff p f m 2 3 1 --format=binary --output=9.cff
+cff m g 9.cff 2 9 1 --format=binary --output=81.cff
+cff m g 81.cff 2 27 1 --output=729.txt
+cff m g 81.cff 2 27 1 --format=binary --output=729.cff
+same_rows 729.cff 729.txt
+
+# An output that is the input under another name is not mapped twice:
+# the embedding goes through memory and then replaces the input.
+for alias in link hard dot; do
+    cp 16.cff $alias-in.cff
+done
+ln -s link-in.cff link-out.cff
+ln hard-in.cff hard-out.cff
+cff p g f link-in.cff 1 16 1 --format=binary --output=link-out.cff
+cff p g f hard-in.cff 1 16 1 --format=binary --output=hard-out.cff
+cff p g f dot-in.cff 1 16 1 --format=binary --output=./dot-in.cff
+same_rows link-in.cff 256.txt
+same_rows hard-in.cff 256.txt
+same_rows dot-in.cff 256.txt
+
+finish
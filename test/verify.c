@@ -167,12 +167,14 @@ void free_blocks(Block *blocks, int num_blocks) {
 /**
  * @brief Main function of the CFF verification program.
  * 
- * Reads a matrix from 'output.txt' and verifies if it is a valid 1-CFF.
+ * Reads a matrix from 'output.txt', or from the file given as first
+ * argument, and verifies if it is a valid d-CFF (d = 2 unless given as
+ * second argument).
  * 
  * @return 0 on success, 1 on error.
  */
-int main() {
-    const char *file_path = "output.txt";
+int main(int argc, char *argv[]) {
+    const char *file_path = (argc > 1) ? argv[1] : "output.txt";
     
     Matrix *matrix = read_matrix_from_file(file_path);
     if (!matrix) {
@@ -182,7 +184,7 @@ int main() {
     int num_blocks;
     Block *blocks = process_columns(matrix, &num_blocks);
 
-    int d = 2;
+    int d = (argc > 2) ? atoi(argv[2]) : 2;
     is_cff(blocks, num_blocks, d);
     
     free_blocks(blocks, num_blocks);